@@ -3,29 +3,157 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
 
 #include "elf.h"
+#include "libalfur.h"
+#include "output.h"
+#include "batch.h"
+#include "symindex.h"
+#include "hashtab.h"
+#include "cache.h"
+#include "record.h"
+#include "segmap.h"
+#include "diff.h"
+#include "sizeprof.h"
+#include "stats.h"
+#include "strscan.h"
+#include "zsection.h"
+#include "reloc.h"
+#include "deps.h"
+#include "demangle.h"
+#include "disasm.h"
+#include "note.h"
+#include "buildid.h"
+#include "dwarf.h"
+#include "cfi.h"
+#include "serve.h"
 
-// General structure for manipulating ELF
+// What to do with the files
+#define MODE_DUMP          0
+#define MODE_ADDR2SYM      1
+#define MODE_LOOKUP        2
+#define MODE_HASH_CHECK    3
+#define MODE_SUMMARY       4
+#define MODE_BUILD_ID      5
+#define MODE_DIFF          6
+#define MODE_SIZE          7
+#define MODE_STRINGS       8
+#define MODE_RELOC_SUMMARY 9
+#define MODE_DEPS          10
+#define MODE_INDEX         11
+#define MODE_FIND_DEBUG    12
+#define MODE_ADDR2LINE     13
+#define MODE_CFI           14
+#define MODE_CHECK_CFI     15
+#define MODE_SERVE         16
+#define MODE_INDIRECT      17
 
-typedef struct {
-    Elf64_Ehdr *elf_head; // ELF Header
-    char *elf_shead; // Start of section headers
-    char *elf_phead; // Start of program headers
-    Elf64_Shdr* shstr_table_header;
-    char *shstr_table;
-    char *elf_image;
-} Elf64_data;
+// Long options without a short equivalent
+#define OPT_ADDR2SYM      0x100
+#define OPT_LOOKUP        0x101
+#define OPT_HASH_CHECK    0x102
+#define OPT_SUMMARY       0x103
+#define OPT_CACHE         0x104
+#define OPT_BUILD_ID      0x105
+#define OPT_PREAD         0x106
+#define OPT_FORMAT        0x107
+#define OPT_RELOCS        0x108
+#define OPT_SECTION       0x109
+#define OPT_DIFF          0x10a
+#define OPT_SIZE          0x10b
+#define OPT_STATS         0x10c
+#define OPT_STRINGS       0x10d
+#define OPT_RELOC_SUMMARY 0x10e
+#define OPT_DEPS          0x10f
+#define OPT_DISASSEMBLE   0x110
+#define OPT_INDEX         0x111
+#define OPT_FIND_DEBUG    0x112
+#define OPT_ADDR2LINE     0x113
+#define OPT_CFI           0x114
+#define OPT_CHECK_CFI     0x115
+#define OPT_SERVE         0x116
+#define OPT_INDIRECT      0x117
 
-Elf64_Shdr *get_section(Elf64_data *data, uint64_t index) {
-    return (Elf64_Shdr*)(data->elf_shead + (index * data->elf_head->e_shentsize));
+// Directory of the summary cache, if any
+const char *cache_dir = NULL;
+
+// Build-ids found by --index-buildids
+Buildid_index build_ids;
+
+// Flags for alfur_open
+int open_flags = ALFUR_WARN;
+
+// Format of machine readable dumps, NULL for text
+const Record_format *record_output = NULL;
+
+// Parts of the files to dump, everything when none is selected
+#define SELECT_HEADER   0x1  // -h
+#define SELECT_SEGMENTS 0x2  // -l
+#define SELECT_SECTIONS 0x4  // -S
+#define SELECT_SYMBOLS  0x8  // -s
+#define SELECT_RELOCS   0x10 // --relocs
+#define SELECT_CONTENTS 0x20 // -p and --section, see section_names and string_names
+#define SELECT_CODE     0x40 // -d and --disassemble
+#define SELECT_NOTES    0x80 // -n
+int selected = 0;
+
+// Sections to decode (--section) and to dump as strings (-p), by name or
+// number
+const char **section_names = NULL;
+int section_count = 0;
+const char **string_names = NULL;
+int string_count = 0;
+
+// Shortest run printed by --strings
+uint64_t strings_min = 4;
+
+// Bytes of the whole file scanned at once by --strings
+#define STRINGS_WINDOW (1 << 20)
+
+// Threads working on one file, decompressing its sections or resolving its
+// libraries, only one when files are dumped in parallel
+int section_jobs = 1;
+
+// Whether symbol names are demangled (-C)
+int demangle_names = 0;
+
+// Symbol whose code is disassembled (--disassemble=symbol), all of it if NULL
+const char *code_symbol = NULL;
+
+// Whether part of the files is dumped
+int is_selected(int part) {
+    return selected == 0 || (selected & part);
 }
 
+
 void usage(void) {
-    fprintf(stderr, "Usage: alfur <file>\n");
+    fprintf(stderr, "Usage: alfur [-j jobs] [-r dir]... [--summary [--cache dir]] [file]...\n"
+                    "       alfur [-j jobs] [-r dir]... [--format=text|ndjson|bin]\n"
+                    "             [-h] [-l] [-S] [-s] [-n] [-C] [--relocs] [-p section]... [--section=name]...\n"
+                    "             [-d] [--disassemble[=symbol]]\n"
+                    "             [file]...\n"
+                    "       alfur --cache <dir> --build-id <hex>\n"
+                    "       alfur [-j jobs] [-r dir]... --cache <dir> --index-buildids <dir> [file]...\n"
+                    "       alfur --cache <dir> --find-debug <build-id>\n"
+                    "       alfur [--cache <dir>] --serve <socket>\n"
+                    "       alfur [-j jobs] [-r dir]... --size-profile [file]...\n"
+                    "       alfur [-j jobs] [-r dir]... --strings[=min] [--section=name]... [file]...\n"
+                    "       alfur [-j jobs] [-r dir]... --reloc-summary [file]...\n"
+                    "       alfur [-j jobs] [-r dir]... --deps [file]...\n"
+                    "       alfur [-j jobs] [-r dir]... --check-cfi [file]...\n"
+                    "       alfur [-j jobs] [-r dir]... [-C] --indirect [file]...\n"
+                    "       alfur [-j jobs] --diff <old> <new>\n"
+                    "       alfur --addr2sym <file> < addresses\n"
+                    "       alfur --addr2line <file> < addresses\n"
+                    "       alfur [-C] --lookup <symbol> <file>\n"
+                    "       alfur --hash-check <file>\n"
+                    "       alfur --cfi <address> <file>\n"
+                    "Any of them with --stats[=text|ndjson] prints the cost of each phase on stderr\n");
     exit(1);
 }
 
@@ -34,12 +162,10 @@ void error(const char *message) {
     exit(1);
 }
 
-void test_valid(char *elf_image) {
-    uint8_t *magic = (uint8_t*)elf_image;
-    if (*magic != ELFMAG0 || (strncmp(magic+1, "ELF", 3) != 0)) {
-        fprintf(stderr, "The file is not a valid ELF file!\n");
-        exit(1);
-    }
+int file_error(const char *elf_path, const char *message) {
+    fprintf(stderr, "%s: ", elf_path);
+    fprintf(stderr, message, strerror(errno));
+    return -1;
 }
 
 void display_header(Elf64_data* file, char* elf_path) {
@@ -51,35 +177,30 @@ void display_header(Elf64_data* file, char* elf_path) {
     else if (elf_head->e_ident[EI_DATA] == ELFDATA2MSB)
         strncpy(encoding, "Big Endian", 16);
 
-    fprintf(stdout, "=== Alfur ===\n");
-    fprintf(stdout, "ELF statistics for %s, %s, ELF version %d\n",
+    out_printf(file->out, "=== Alfur ===\n");
+    out_printf(file->out, "ELF statistics for %s, %s, ELF version %d\n",
             elf_path, encoding, elf_head->e_ident[EI_VERSION]);
-    fprintf(stdout, "  Class:                      %s\n", get_class(elf_head->e_ident[EI_CLASS]));
-    fprintf(stdout, "  Version:                    %d\n", elf_head->e_ident[EI_VERSION]);
-    fprintf(stdout, "  OS/ABI:                     %s\n", get_osabi(elf_head->e_ident[EI_OSABI]));
-    fprintf(stdout, "  ABI Version:                %d\n", elf_head->e_ident[EI_ABIVERSION]);
-    fprintf(stdout, "  Type:                       %s\n", get_etype(elf_head->e_type));
-    fprintf(stdout, "  Machine:                    %s\n", get_machine(elf_head->e_machine));
-    fprintf(stdout, "  Version:                    0x%x\n", elf_head->e_version);
-    fprintf(stdout, "  Entry Point Access:         0x%lx\n", elf_head->e_entry);
-    fprintf(stdout, "  Start of program headers:   %lu\n", elf_head->e_phoff);
-    fprintf(stdout, "  Start of section headers:   %lu\n", elf_head->e_shoff);
-    fprintf(stdout, "  Flags:                      %d\n", elf_head->e_flags);
-    fprintf(stdout, "  Size of this header:        %d\n", elf_head->e_ehsize);
-    fprintf(stdout, "  Size of program headers:    %d\n", elf_head->e_phentsize);
-    fprintf(stdout, "  Number of program headers:  %d\n", elf_head->e_phnum);
-    fprintf(stdout, "  Size of section headers:    %d\n", elf_head->e_shentsize);
-    fprintf(stdout, "  Number of section headers:  %d\n", elf_head->e_shnum);
-    fprintf(stdout, "  Section header table index: %d\n", elf_head->e_shstrndx);
-
-    file->elf_phead = file->elf_image + file->elf_head->e_phoff;
-    file->elf_shead = file->elf_image + file->elf_head->e_shoff;
-    file->shstr_table_header = get_section(file, file->elf_head->e_shstrndx);
-    file->shstr_table = file->elf_image + file->shstr_table_header->sh_offset;
+    out_printf(file->out, "  Class:                      %s\n", get_class(elf_head->e_ident[EI_CLASS]));
+    out_printf(file->out, "  Version:                    %d\n", elf_head->e_ident[EI_VERSION]);
+    out_printf(file->out, "  OS/ABI:                     %s\n", get_osabi(elf_head->e_ident[EI_OSABI]));
+    out_printf(file->out, "  ABI Version:                %d\n", elf_head->e_ident[EI_ABIVERSION]);
+    out_printf(file->out, "  Type:                       %s\n", get_etype(elf_head->e_type));
+    out_printf(file->out, "  Machine:                    %s\n", get_machine(elf_head->e_machine));
+    out_printf(file->out, "  Version:                    0x%x\n", elf_head->e_version);
+    out_printf(file->out, "  Entry Point Access:         0x%lx\n", elf_head->e_entry);
+    out_printf(file->out, "  Start of program headers:   %lu\n", elf_head->e_phoff);
+    out_printf(file->out, "  Start of section headers:   %lu\n", elf_head->e_shoff);
+    out_printf(file->out, "  Flags:                      %d\n", elf_head->e_flags);
+    out_printf(file->out, "  Size of this header:        %d\n", elf_head->e_ehsize);
+    out_printf(file->out, "  Size of program headers:    %d\n", elf_head->e_phentsize);
+    out_printf(file->out, "  Number of program headers:  %d\n", elf_head->e_phnum);
+    out_printf(file->out, "  Size of section headers:    %d\n", elf_head->e_shentsize);
+    out_printf(file->out, "  Number of section headers:  %d\n", elf_head->e_shnum);
+    out_printf(file->out, "  Section header table index: %d\n", elf_head->e_shstrndx);
 }
 
 void display_programs(Elf64_data *file) {
-    fprintf(stdout, "\n== Program Headers ==\n");
+    out_str(file->out, "\n== Program Headers ==\n");
 
     if (file->elf_head->e_phnum == 0) {
         fprintf(stderr, "\nNo progam header\n");
@@ -87,24 +208,38 @@ void display_programs(Elf64_data *file) {
     }
     Elf64_Phdr *elf_phead = (Elf64_Phdr*)file->elf_phead;
 
+    Output *out = file->out;
+
     for (int i = 0; i < file->elf_head->e_phnum; i++, elf_phead++) {
-        fprintf(stdout, "\n* %s\n",
-                elf_phead->p_type ^ PT_INTERP
-                    ? get_ptype(elf_phead->p_type)
-                    : get_interp(elf_phead, file->elf_image));
-        fprintf(stdout, "            Offset 0x%16.16lx   0x%16.16lx Virtual Address\n", elf_phead->p_offset, elf_phead->p_vaddr);
-        fprintf(stdout, "  Physical Address 0x%16.16lx   0x%16.16lx File Size\n", elf_phead->p_paddr, elf_phead->p_filesz);
-        fprintf(stdout, "       Memory Size 0x%16.16lx   %c%c%c   0x%-10lx Flags & Align\n", elf_phead->p_memsz,
-                (elf_phead->p_flags & PF_R ? 'R' : ' '),
-                (elf_phead->p_flags & PF_W ? 'W' : ' '),
-                (elf_phead->p_flags & PF_X ? 'X' : ' '),
-                elf_phead->p_align);
+        out_str(out, "\n* ");
+        out_str(out, elf_phead->p_type ^ PT_INTERP
+                         ? get_ptype(elf_phead->p_type)
+                         : get_interp(elf_fetch(file, elf_phead->p_offset, elf_phead->p_filesz),
+                                      elf_phead->p_filesz));
+        out_str(out, "\n            Offset 0x");
+        out_hex(out, elf_phead->p_offset, 16, OUT_ZERO);
+        out_str(out, "   0x");
+        out_hex(out, elf_phead->p_vaddr, 16, OUT_ZERO);
+        out_str(out, " Virtual Address\n  Physical Address 0x");
+        out_hex(out, elf_phead->p_paddr, 16, OUT_ZERO);
+        out_str(out, "   0x");
+        out_hex(out, elf_phead->p_filesz, 16, OUT_ZERO);
+        out_str(out, " File Size\n       Memory Size 0x");
+        out_hex(out, elf_phead->p_memsz, 16, OUT_ZERO);
+        out_str(out, "   ");
+        out_char(out, elf_phead->p_flags & PF_R ? 'R' : ' ');
+        out_char(out, elf_phead->p_flags & PF_W ? 'W' : ' ');
+        out_char(out, elf_phead->p_flags & PF_X ? 'X' : ' ');
+        out_str(out, "   0x");
+        out_hex(out, elf_phead->p_align, 10, OUT_LEFT);
+        out_str(out, " Flags & Align\n");
     }
 
+    display_segmap(file);
 }
 
 void display_sections(Elf64_data *file) {
-    fprintf(stdout, "\n== Section Headers ==\n\n");
+    out_str(file->out, "\n== Section Headers ==\n\n");
 
     if (file->elf_head->e_shnum == 0) {
         fprintf(stderr, "No section header\n");
@@ -113,227 +248,1361 @@ void display_sections(Elf64_data *file) {
 
     Elf64_Shdr *elf_shead = (Elf64_Shdr*)file->elf_shead;
 
+    Output *out = file->out;
+
     for (int i = 0; i < file->elf_head->e_shnum; i++, elf_shead++) {
-        fprintf(stdout, "  [%2d] %s (%s)\n", i,
-                get_string(file->shstr_table, elf_shead->sh_name), get_stype(elf_shead->sh_type));
-        fprintf(stdout, "      Address 0x%16.16lx   0x%16.16lx Offset\n", elf_shead->sh_addr, elf_shead->sh_offset);
-        fprintf(stdout, "         Size 0x%16.16lx   0x%16.16lx EntSize\n", elf_shead->sh_size, elf_shead->sh_entsize);
-        fprintf(stdout, "        Flags %18s   %-9d %-8d Link & Info\n", get_sflags(elf_shead->sh_flags), elf_shead->sh_link, elf_shead->sh_info);
-        fprintf(stdout, "        Align %ld\n", elf_shead->sh_addralign);
+        out_str(out, "  [");
+        out_dec(out, i, 2, 0);
+        out_str(out, "] ");
+        out_str(out, elf_section_name(file, elf_shead));
+        out_str(out, " (");
+        out_str(out, get_stype(elf_shead->sh_type));
+        out_str(out, ")\n      Address 0x");
+        out_hex(out, elf_shead->sh_addr, 16, OUT_ZERO);
+        out_str(out, "   0x");
+        out_hex(out, elf_shead->sh_offset, 16, OUT_ZERO);
+        out_str(out, " Offset\n         Size 0x");
+        out_hex(out, elf_shead->sh_size, 16, OUT_ZERO);
+        out_str(out, "   0x");
+        out_hex(out, elf_shead->sh_entsize, 16, OUT_ZERO);
+        out_str(out, " EntSize\n        Flags ");
+        out_pad_str(out, get_sflags(elf_shead->sh_flags), 18, 0);
+        out_str(out, "   ");
+        out_dec(out, (int32_t)elf_shead->sh_link, 9, OUT_LEFT);
+        out_char(out, ' ');
+        out_dec(out, (int32_t)elf_shead->sh_info, 8, OUT_LEFT);
+        out_str(out, " Link & Info\n        Align ");
+        out_dec(out, elf_shead->sh_addralign, 0, 0);
+        out_char(out, '\n');
     }
 }
 
+// Name of a symbol, section symbols being named after their section
+const char *symbol_name(Elf64_data *file, Elf64_Sym *sym, char *sym_names_table, uint64_t names_size) {
+    return ELF64_ST_TYPE(sym->st_info) == STT_SECTION && sym->st_shndx < file->elf_head->e_shnum
+        ? elf_section_name(file, get_section(file, sym->st_shndx))
+        : elf_string(sym_names_table, names_size, sym->st_name);
+}
+
+void display_symbol(Elf64_data *file, uint64_t i, Elf64_Sym *sym, char *sym_names_table, uint64_t names_size) {
+    Output *out = file->out;
+
+    out_str(out, "  {");
+    out_dec(out, i, 5, 0);
+    out_str(out, "}: ");
+    out_hex(out, sym->st_value, 16, OUT_ZERO);
+    out_char(out, ' ');
+    out_dec(out, sym->st_size, 4, 0);
+    out_char(out, ' ');
+    out_pad_str(out, get_sym_type(sym->st_info), 7, OUT_LEFT);
+    out_char(out, ' ');
+    out_pad_str(out, get_sym_bind(sym->st_info), 6, OUT_LEFT);
+    out_char(out, ' ');
+    out_pad_str(out, get_sym_vis(sym->st_other), 9, OUT_LEFT);
+    out_str(out, "  ");
+    out_str(out, get_sym_ndx(sym->st_shndx));
+    out_char(out, ' ');
+    out_str(out, demangle_names ? demangle_symbol(file, symbol_name(file, sym, sym_names_table, names_size))
+                                : symbol_name(file, sym, sym_names_table, names_size));
+    out_char(out, '\n');
+}
+
 void display_symbols(Elf64_Shdr *section, Elf64_data *file) {
-    fprintf(stdout, "\n= Symbol table %s =\n\n",
-            get_string(file->shstr_table, section->sh_name));
+    Output *out = file->out;
+
+    out_str(out, "\n= Symbol table ");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, " =\n\n");
 
     if (section->sh_entsize == 0) {
         fprintf(stderr, "Symbol table %s has a sh_entsize of 0\n",
-            get_string(file->shstr_table, section->sh_name));
+            elf_section_name(file, section));
         return;
     }
 
-    uint64_t sym_num = section->sh_size / section->sh_entsize;
-    Elf64_Sym *sym = (Elf64_Sym*)(file->elf_image + section->sh_offset);
-    Elf64_Shdr *sym_names_table_header = get_section(file, section->sh_link);
-    char *sym_names_table = file->elf_image + sym_names_table_header->sh_offset;
+    Elf64_Sym *sym;
+    char *sym_names_table;
+    uint64_t names_size;
+    uint64_t sym_num = elf_symbols(file, section, &sym, &sym_names_table, &names_size);
 
-    fprintf(stdout, "  Num:  Value            Size Type    Bind   Visibility Ndx Name\n");
-    for (int i = 0; i < sym_num; i++, sym++) {
-        fprintf(stdout, "  {%5d}: %16.16lx %4ld", i, sym->st_value, sym->st_size);
-        fprintf(stdout, " %-7s %-6s %-9s", get_sym_type(sym->st_info), get_sym_bind(sym->st_info),
-                get_sym_vis(sym->st_other));
-        fprintf(stdout, "  %s %s\n", get_sym_ndx(sym->st_shndx),
-                ELF64_ST_TYPE(sym->st_info) & STT_SECTION
-                    ? get_string(file->shstr_table, get_section(file, sym->st_shndx)->sh_name)
-                    : get_string(sym_names_table, sym->st_name));
-    }
+    if (demangle_names)
+        demangle_prefetch(file, sym, sym_num, sym_names_table, names_size, section_jobs);
 
+    out_str(out, "  Num:  Value            Size Type    Bind   Visibility Ndx Name\n");
+    for (int i = 0; i < sym_num; i++, sym++)
+        display_symbol(file, i, sym, sym_names_table, names_size);
 }
 
 void display_strings(Elf64_Shdr *section, Elf64_data *file) {
-    fprintf(stdout, "\n= String table '%s' =\n\n", get_string(file->shstr_table, section->sh_name));
-    uint8_t newline = 0;
-    char *data, *start, *end;
-    data = start = file->elf_image + section->sh_offset;
-    end = start + section->sh_size;
-
-    while (data < end) {
-        while (!isprint(*data))
-            if (++data >= end)
-                break;
-        if (data < end) {
-            size_t maxlen = end - data;
-
-            if (newline) {
-                fprintf(stdout, "                 ");
-                newline = 0;
-            }
+    Output *out = file->out;
+    uint64_t size;
+    char *data;
 
-            fprintf(stdout, "   [|%8tx|]  ", data - start);
-            if (maxlen > 0) {
-                char c = 0;
-                while (maxlen) {
-                    c = *data++;
-
-                    if (c == 0)
-                        break;
-
-                    if (c == '\n') {
-                        fprintf(stdout, "\\n\n");
-                        if (*data != 0)
-                            newline = 1;
-                        break;
-                    }
-
-                    if (iscntrl(c))
-                        fprintf(stdout, "^%c", c + 0x40);
-                    else if (isprint(c))
-                        fputc(c, stdout);
-                    else
-                        fprintf(stdout, "%.1s", data - 1);
-                }
-
-                if (c != '\n')
-                    fputc('\n', stdout);
-            }
-        }
+    out_str(out, "\n= String table '");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, "' =\n\n");
+    // Compressed sections that fail to decompress have told why already
+    if ((data = zsection_contents(file, section, &size)) == NULL) {
+        if (!zsection_compressed(file, section))
+            fprintf(stderr, "String table %s is out of the file\n",
+                elf_section_name(file, section));
+        return;
     }
+
+    strscan_table(out, data, size);
 }
 
 void display_rel(Elf64_Shdr *section, Elf64_data *file) {
-    fprintf(stdout, "\n= Relocation table '%s' =\n\n", get_string(file->shstr_table, section->sh_name));
+    Output *out = file->out;
+
+    out_str(out, "\n= Relocation table '");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, "' =\n\n");
 
     if (section->sh_entsize == 0) {
         fprintf(stderr, "Relocations table %s has a sh_entsize of 0\n",
-            get_string(file->shstr_table, section->sh_name));
+            elf_section_name(file, section));
         return;
     }
 
-    Elf64_Shdr *symtab_header = get_section(file, section->sh_link);
-    char *symtab = file->elf_image + symtab_header->sh_offset;
-    Elf64_Shdr *sym_names_table_header = get_section(file, symtab_header->sh_link);
-
-    char *sym_names_table = file->elf_image + sym_names_table_header->sh_offset;
+    Elf64_Sym *symtab = NULL;
+    char *sym_names_table = NULL;
+    uint64_t names_size = 0;
+    uint64_t sym_num = 0;
+    if (section->sh_link < file->elf_head->e_shnum)
+        sym_num = elf_symbols(file, get_section(file, section->sh_link), &symtab, &sym_names_table, &names_size);
+    if (demangle_names)
+        demangle_prefetch(file, symtab, sym_num, sym_names_table, names_size, section_jobs);
 
-    uint64_t relo_num = section->sh_size / section->sh_entsize;
-    Elf64_Rel *entry = (Elf64_Rel*)(file->elf_image + section->sh_offset);
+    uint64_t relo_num;
+    Elf64_Rel *entry = elf_table(file, section, ELF_T_REL, &relo_num);
     Elf64_Sym *sym;
+    static Elf64_Sym no_symbol;
 
-    fputs("Offset        Info          Type  Symbol Value     Name\n", stdout);
+    if (entry == NULL) {
+        fprintf(stderr, "Relocations table %s is out of the file\n",
+            elf_section_name(file, section));
+        return;
+    }
+
+    out_str(out, "Offset        Info          Type  Symbol Value     Name\n");
     for (int i = 0; i < relo_num; i++, entry++) {
-        sym = (Elf64_Sym*)(sym_names_table + symtab_header->sh_entsize * ELF64_R_SYM(entry->r_info));
-        fprintf(stdout, "%12lx  %12lx %5ld %16lx %s",
-                entry->r_offset, entry->r_info, ELF64_R_TYPE(entry->r_info),
-                sym->st_value, get_string(sym_names_table, sym->st_name));
+        sym = ELF64_R_SYM(entry->r_info) < sym_num ? &symtab[ELF64_R_SYM(entry->r_info)] : &no_symbol;
+        out_hex(out, entry->r_offset, 12, 0);
+        out_str(out, "  ");
+        out_hex(out, entry->r_info, 12, 0);
+        out_char(out, ' ');
+        out_dec(out, ELF64_R_TYPE(entry->r_info), 5, 0);
+        out_char(out, ' ');
+        out_hex(out, sym->st_value, 16, 0);
+        out_char(out, ' ');
+        out_str(out, demangle_names ? demangle_symbol(file, symbol_name(file, sym, sym_names_table, names_size))
+                                    : symbol_name(file, sym, sym_names_table, names_size));
+        out_char(out, '\n');
     }
 }
 
 void display_rela(Elf64_Shdr *section, Elf64_data *file) {
-    fprintf(stdout, "\n= Relocation table '%s' =\n\n", get_string(file->shstr_table, section->sh_name));
+    Output *out = file->out;
+
+    out_str(out, "\n= Relocation table '");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, "' =\n\n");
 
     if (section->sh_entsize == 0) {
         fprintf(stderr, "Relocations table %s has a sh_entsize of 0\n",
-            get_string(file->shstr_table, section->sh_name));
+            elf_section_name(file, section));
         return;
     }
 
-    Elf64_Shdr *symtab_header = get_section(file, section->sh_link);
-    char *symtab = file->elf_image + symtab_header->sh_offset;
-    Elf64_Shdr *sym_names_table_header = get_section(file, symtab_header->sh_link);
-
-    char *sym_names_table = file->elf_image + sym_names_table_header->sh_offset;
+    Elf64_Sym *symtab = NULL;
+    char *sym_names_table = NULL;
+    uint64_t names_size = 0;
+    uint64_t sym_num = 0;
+    if (section->sh_link < file->elf_head->e_shnum)
+        sym_num = elf_symbols(file, get_section(file, section->sh_link), &symtab, &sym_names_table, &names_size);
+    if (demangle_names)
+        demangle_prefetch(file, symtab, sym_num, sym_names_table, names_size, section_jobs);
 
-    uint64_t relo_num = section->sh_size / section->sh_entsize;
-    Elf64_Rela *entry = (Elf64_Rela*)(file->elf_image + section->sh_offset);
+    uint64_t relo_num;
+    Elf64_Rela *entry = elf_table(file, section, ELF_T_RELA, &relo_num);
     Elf64_Sym *sym;
+    static Elf64_Sym no_symbol;
 
-    fputs("Offset        Info          Type  Symbol Value     Name ; Addend\n", stdout);
+    if (entry == NULL) {
+        fprintf(stderr, "Relocations table %s is out of the file\n",
+            elf_section_name(file, section));
+        return;
+    }
+
+    out_str(out, "Offset        Info          Type  Symbol Value     Name ; Addend\n");
     for (int i = 0; i < relo_num; i++, entry++) {
-        sym = (Elf64_Sym*)(symtab + symtab_header->sh_entsize * ELF64_R_SYM(entry->r_info));
-        fprintf(stdout, "%12.12lx  %12.12lx %5ld  %16.16lx %s ; %ld\n",
-                entry->r_offset, entry->r_info, ELF64_R_TYPE(entry->r_info),
-                sym->st_value, get_string(sym_names_table, sym->st_name), entry->r_addend);
+        sym = ELF64_R_SYM(entry->r_info) < sym_num ? &symtab[ELF64_R_SYM(entry->r_info)] : &no_symbol;
+        out_hex(out, entry->r_offset, 12, OUT_ZERO);
+        out_str(out, "  ");
+        out_hex(out, entry->r_info, 12, OUT_ZERO);
+        out_char(out, ' ');
+        out_dec(out, ELF64_R_TYPE(entry->r_info), 5, 0);
+        out_str(out, "  ");
+        out_hex(out, sym->st_value, 16, OUT_ZERO);
+        out_char(out, ' ');
+        out_str(out, demangle_names ? demangle_symbol(file, symbol_name(file, sym, sym_names_table, names_size))
+                                    : symbol_name(file, sym, sym_names_table, names_size));
+        out_str(out, " ; ");
+        out_dec(out, entry->r_addend, 0, 0);
+        out_char(out, '\n');
+    }
+}
+
+// Relative relocations packed in a RELR table, expanded as they are printed
+void display_relr(Elf64_Shdr *section, Elf64_data *file) {
+    Output *out = file->out;
+    Relr_iter iter;
+    uint64_t entries, address;
+
+    out_str(out, "\n= Relocation table '");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, "' =\n\n");
+
+    if (relr_begin(&iter, file, section, &entries) < 0) {
+        fprintf(stderr, "Relocations table %s is out of the file\n",
+            elf_section_name(file, section));
+        return;
+    }
+
+    out_str(out, "Offset        Type\n");
+    while (relr_next(&iter, &address)) {
+        out_hex(out, address, 12, OUT_ZERO);
+        out_char(out, ' ');
+        out_dec(out, relr_type(file->elf_head->e_machine), 5, 0);
+        out_char(out, '\n');
+    }
+}
+
+// Whether the value of a dynamic entry is an offset in its string table
+int is_dynamic_string(int64_t tag) {
+    switch (tag) {
+        case DT_NEEDED:
+        case DT_SONAME:
+        case DT_RPATH:
+        case DT_RUNPATH:
+        case DT_CONFIG:
+        case DT_DEPAUDIT:
+        case DT_AUDIT:
+        case DT_AUXILIARY:
+        case DT_FILTER:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void display_dynamic(Elf64_Shdr *section, Elf64_data *file) {
+    Output *out = file->out;
+    char *strings = NULL;
+    uint64_t count, strings_size = 0;
+
+    out_str(out, "\n= Dynamic section '");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, "' =\n\n");
+
+    Elf64_Dyn *entry = elf_table(file, section, ELF_T_DYN, &count);
+    if (entry == NULL) {
+        fprintf(stderr, "Dynamic section %s is out of the file\n",
+            elf_section_name(file, section));
+        return;
+    }
+    if (section->sh_link < file->elf_head->e_shnum)
+        strings = zsection_contents(file, get_section(file, section->sh_link), &strings_size);
+
+    out_str(out, "Tag              Value\n");
+    for (uint64_t i = 0; i < count; i++, entry++) {
+        out_pad_str(out, get_dtag(entry->d_tag), 16, OUT_LEFT);
+        out_char(out, ' ');
+        if (!is_dynamic_string(entry->d_tag)) {
+            out_hex(out, entry->d_val, 16, OUT_ZERO);
+        } else if (strings != NULL && entry->d_val < strings_size) {
+            out_strn(out, strings + entry->d_val, strnlen(strings + entry->d_val, strings_size - entry->d_val));
+        } else {
+            out_str(out, "[bad string offset]");
+        }
+        out_char(out, '\n');
+        if (entry->d_tag == DT_NULL)
+            break;
     }
 }
 
 void display_note(Elf64_Shdr *section, Elf64_data *file) {
-    fprintf(stdout, "\n= Note '%s' =\n\n", get_string(file->shstr_table, section->sh_name));
+    out_printf(file->out, "\n= Note '%s' =\n\n", elf_section_name(file, section));
+    display_notes(file, section->sh_offset, section->sh_size, section->sh_addralign);
+}
+
+// Notes of the PT_NOTE segments, for files without sections such as cores
+void display_segment_notes(Elf64_data *file) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    Stat_mark mark;
+
+    stats_begin(&mark, &file->source);
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        if (segment->p_type != PT_NOTE)
+            continue;
+        out_printf(file->out, "\n= Notes of segment %d =\n\n", i);
+        display_notes(file, segment->p_offset, segment->p_filesz, segment->p_align);
+    }
+    stats_end(&mark, STAT_CONTENTS, &file->source);
+}
+
+// Run a section display routine, counted under phase with --stats
+void display_counted(int phase, void (*display)(Elf64_Shdr*, Elf64_data*), Elf64_Shdr *section,
+                     Elf64_data *file) {
+    Stat_mark mark;
+
+    stats_begin(&mark, &file->source);
+    display(section, file);
+    stats_end(&mark, phase, &file->source);
+}
+
+void display_section_content(Elf64_Shdr *section, Elf64_data *file) {
+    switch (section->sh_type) {
+        case SHT_NULL:
+        case SHT_NOBITS:
+        case SHT_PROGBITS:
+            break;
+        case SHT_SYMTAB:
+        case SHT_DYNSYM:
+            display_counted(STAT_SYMBOLS, display_symbols, section, file);
+            break;
+        case SHT_STRTAB:
+            display_counted(STAT_STRINGS, display_strings, section, file);
+            break;
+        case SHT_RELA:
+            display_counted(STAT_RELOCS, display_rela, section, file);
+            break;
+        case SHT_REL:
+            display_counted(STAT_RELOCS, display_rel, section, file);
+            break;
+        case SHT_RELR:
+            display_counted(STAT_RELOCS, display_relr, section, file);
+            break;
+        case SHT_DYNAMIC:
+            display_counted(STAT_CONTENTS, display_dynamic, section, file);
+            break;
+        case SHT_HASH:
+        case SHT_GNU_HASH:
+            display_counted(STAT_HASH, display_hash, section, file);
+            break;
+        case SHT_NOTE:
+            display_counted(STAT_CONTENTS, display_note, section, file);
+            break;
+        default:
+            out_printf(file->out, "= TODO %s =\n", elf_section_name(file, section));
+    }
 }
 
 void display_section_contents(Elf64_data *file) {
-    fprintf(stdout, "\n== Sections contents ==\n");
+    out_printf(file->out, "\n== Sections contents ==\n");
 
     if (file->elf_head->e_shnum == 0) {
         fprintf(stderr, "No sections\n");
+        display_segment_notes(file);
+        return;
+    }
+
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++)
+        display_section_content(section, file);
+}
+
+void display_hex(Elf64_Shdr *section, Elf64_data *file) {
+    Output *out = file->out;
+    uint64_t size;
+    unsigned char *data = (unsigned char*)zsection_contents(file, section, &size);
+
+    out_str(out, "\n= Hex dump of '");
+    out_str(out, elf_section_name(file, section));
+    out_str(out, zsection_compressed(file, section) ? "', decompressed =\n\n" : "' =\n\n");
+
+    if (data == NULL) {
+        if (!zsection_compressed(file, section))
+            fprintf(stderr, "Section %s has no data in the file\n",
+                elf_section_name(file, section));
         return;
     }
 
+    for (uint64_t line = 0; line < size; line += 16) {
+        uint64_t n = size - line < 16 ? size - line : 16;
+
+        out_str(out, "  0x");
+        out_hex(out, section->sh_addr + line, 16, OUT_ZERO);
+        out_char(out, ' ');
+        for (uint64_t i = 0; i < 16; i++) {
+            if (i % 4 == 0)
+                out_char(out, ' ');
+            if (i < n)
+                out_hex(out, data[line + i], 2, OUT_ZERO);
+            else
+                out_str(out, "  ");
+        }
+        out_str(out, "  ");
+        for (uint64_t i = 0; i < n; i++)
+            out_char(out, isprint(data[line + i]) ? data[line + i] : '.');
+        out_char(out, '\n');
+    }
+}
+
+int is_code(Elf64_Shdr *section) {
+    return section->sh_type == SHT_PROGBITS && (section->sh_flags & SHF_EXECINSTR);
+}
+
+void display_code(Elf64_Shdr *section, Elf64_data *file) {
+    disasm_section(file, section, code_symbol, demangle_names);
+}
+
+// Whether section number index is one of names, given by name or number
+int section_matches(Elf64_data *file, int index, Elf64_Shdr *section, const char **names, int count) {
+    for (int i = 0; i < count; i++) {
+        char *end;
+        long number = strtol(names[i], &end, 10);
+
+        if ((*end == 0 && end != names[i] && number == index)
+            || strcmp(names[i], elf_section_name(file, section)) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+void warn_missing(Elf64_data *file, const char *elf_path, const char **names, int count) {
+    for (int i = 0; i < count; i++) {
+        Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+        int found = 0;
+
+        for (int j = 0; j < file->elf_head->e_shnum && !found; j++, section++)
+            found = section_matches(file, j, section, names + i, 1);
+        if (!found)
+            fprintf(stderr, "%s: No section %s\n", elf_path, names[i]);
+    }
+}
+
+// Decompress the sections named with -p and --section on section_jobs threads
+void prefetch_named(Elf64_data *file) {
+    uint32_t *sections = malloc(file->elf_head->e_shnum * sizeof(uint32_t));
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+    uint64_t n = 0;
+
+    if (sections == NULL)
+        return;
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++)
+        if (section_matches(file, i, section, section_names, section_count)
+            || section_matches(file, i, section, string_names, string_count))
+            sections[n++] = i;
+    zsection_prefetch(file, sections, n, section_jobs);
+    free(sections);
+}
+
+// Dump the contents selected with -s, --relocs, -p, --section, -d and -n,
+// touching no other section
+void display_selected_contents(Elf64_data *file, const char *elf_path) {
     Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
 
+    prefetch_named(file);
+
     for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        uint32_t type = section->sh_type;
+
+        if (section_matches(file, i, section, section_names, section_count)) {
+            switch (type) {
+                case SHT_SYMTAB:
+                case SHT_DYNSYM:
+                case SHT_STRTAB:
+                case SHT_RELA:
+                case SHT_REL:
+                case SHT_RELR:
+                case SHT_DYNAMIC:
+                case SHT_HASH:
+                case SHT_GNU_HASH:
+                case SHT_NOTE:
+                    display_section_content(section, file);
+                    break;
+                default:
+                    if (is_code(section))
+                        display_counted(STAT_CODE, display_code, section, file);
+                    else // No decoder for it
+                        display_counted(STAT_CONTENTS, display_hex, section, file);
+            }
+        } else if (section_matches(file, i, section, string_names, string_count)) {
+            display_counted(STAT_STRINGS, display_strings, section, file);
+        } else if ((selected & SELECT_SYMBOLS) && (type == SHT_SYMTAB || type == SHT_DYNSYM)) {
+            display_counted(STAT_SYMBOLS, display_symbols, section, file);
+        } else if ((selected & SELECT_RELOCS) && (type == SHT_REL || type == SHT_RELA || type == SHT_RELR)) {
+            display_section_content(section, file);
+        } else if ((selected & SELECT_CODE) && is_code(section)) {
+            display_counted(STAT_CODE, display_code, section, file);
+        } else if ((selected & SELECT_NOTES) && type == SHT_NOTE) {
+            display_counted(STAT_CONTENTS, display_note, section, file);
+        }
+    }
+    if ((selected & SELECT_NOTES) && file->elf_head->e_shnum == 0)
+        display_segment_notes(file);
+
+    if (code_symbol != NULL && file->elf_head->e_machine == EM_X86_64 && !disasm_has_symbol(file, code_symbol))
+        fprintf(stderr, "%s: No symbol %s\n", elf_path, code_symbol);
+    warn_missing(file, elf_path, section_names, section_count);
+    warn_missing(file, elf_path, string_names, string_count);
+}
+
+int open_image(Elf64_data *file, const char *elf_path, int skip_invalid) {
+    switch (alfur_open(file, elf_path, open_flags)) {
+        case ALFUR_OK:
+            return 0;
+        case ALFUR_EIO:
+            return file_error(elf_path, "Failed opening the file! %s\n");
+        case ALFUR_EFORMAT:
+            if (skip_invalid)
+                return 1;
+            fprintf(stderr, "%s: The file is not a valid ELF file!\n", elf_path);
+            return -1;
+        default:
+            errno = ENOMEM;
+            return file_error(elf_path, "Failed opening the file! %s\n");
+    }
+}
+
+// Map elf_path and set up file. Returns 0 on success, -1 on error and 1 if
+// the file is not an ELF file and skip_invalid is set.
+int open_file(Elf64_data *file, const char *elf_path, int skip_invalid) {
+    Stat_mark mark;
+    int status;
+
+    stats_begin(&mark, NULL);
+    status = open_image(file, elf_path, skip_invalid);
+    stats_end(&mark, STAT_OPEN, &file->source);
+    return status;
+}
+
+int close_file(Elf64_data *file, const char *elf_path) {
+    Stat_mark mark;
+    int status = 0;
+
+    stats_begin(&mark, &file->source);
+    demangle_release(file);
+    disasm_release(file);
+    if (alfur_close(file) < 0)
+        status = file_error(elf_path, "Failed closing the file! %s\n");
+    stats_end(&mark, STAT_CLOSE, &file->source);
+    return status;
+}
+
+// Dump one file to out. Returns 0 on success, -1 on error and 1 if the file
+// is not an ELF file and skip_invalid is set.
+int dump_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    Stat_mark mark;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+
+    // Section contents are counted per section, by display_counted
+    if (selected == 0 || (selected & SELECT_HEADER)) {
+        stats_begin(&mark, &file.source);
+        display_header(&file, (char*)elf_path);
+        stats_end(&mark, STAT_HEADER, &file.source);
+    }
+    if (selected == 0 || (selected & SELECT_SEGMENTS)) {
+        stats_begin(&mark, &file.source);
+        display_programs(&file);
+        stats_end(&mark, STAT_PROGRAMS, &file.source);
+    }
+    if (selected == 0 || (selected & SELECT_SECTIONS)) {
+        stats_begin(&mark, &file.source);
+        display_sections(&file);
+        stats_end(&mark, STAT_SECTIONS, &file.source);
+    }
+    if (selected == 0)
+        display_section_contents(&file);
+    else if (selected & (SELECT_SYMBOLS | SELECT_RELOCS | SELECT_CONTENTS | SELECT_CODE | SELECT_NOTES))
+        display_selected_contents(&file, elf_path);
+
+    return close_file(&file, elf_path);
+}
+
+void record_symbols(Elf64_data *file, const char *elf_path, uint64_t table, Elf64_Shdr *section) {
+    Elf64_Sym *sym;
+    char *names;
+    uint64_t names_size;
+    uint64_t sym_num = elf_symbols(file, section, &sym, &names, &names_size);
+
+    for (uint64_t i = 0; i < sym_num; i++, sym++)
+        record_output->symbol(file->out, elf_path, table, i, sym, symbol_name(file, sym, names, names_size));
+}
+
+// RELR tables give a relative relocation, with no symbol, per address
+void record_relr(Elf64_data *file, const char *elf_path, uint64_t table, Elf64_Shdr *section) {
+    Elf64_Rela rela = { .r_info = ELF64_R_INFO((uint64_t)0, relr_type(file->elf_head->e_machine)) };
+    Relr_iter iter;
+    uint64_t entries;
+
+    if (relr_begin(&iter, file, section, &entries) < 0)
+        return;
+    for (uint64_t i = 0; relr_next(&iter, &rela.r_offset); i++)
+        record_output->reloc(file->out, elf_path, table, i, &rela, 0, "");
+}
+
+void record_relocations(Elf64_data *file, const char *elf_path, uint64_t table, Elf64_Shdr *section) {
+    int has_addend = section->sh_type == SHT_RELA;
+    uint64_t relo_num;
+    void *entries = elf_table(file, section, has_addend ? ELF_T_RELA : ELF_T_REL, &relo_num);
+    Elf64_Sym *symtab = NULL;
+    char *names;
+    uint64_t names_size;
+    uint64_t sym_num = 0;
+
+    if (entries == NULL)
+        return;
+    if (section->sh_link < file->elf_head->e_shnum)
+        sym_num = elf_symbols(file, get_section(file, section->sh_link), &symtab, &names, &names_size);
+
+    for (uint64_t i = 0; i < relo_num; i++) {
+        Elf64_Rela rela = { 0 };
+        const char *symbol = "";
+
+        if (has_addend) {
+            rela = ((Elf64_Rela*)entries)[i];
+        } else {
+            rela.r_offset = ((Elf64_Rel*)entries)[i].r_offset;
+            rela.r_info = ((Elf64_Rel*)entries)[i].r_info;
+        }
+        if (ELF64_R_SYM(rela.r_info) < sym_num)
+            symbol = symbol_name(file, &symtab[ELF64_R_SYM(rela.r_info)], names, names_size);
+
+        record_output->reloc(file->out, elf_path, table, i, &rela, has_addend, symbol);
+    }
+}
+
+// Write the records of one file, in the order of the text dump. Same return
+// values as dump_file.
+int record_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+    record_output->file(out, elf_path);
+    if (is_selected(SELECT_HEADER))
+        record_output->header(out, elf_path, file.elf_head);
+
+    Elf64_Phdr *segment = (Elf64_Phdr*)file.elf_phead;
+    for (int i = 0; i < file.elf_head->e_phnum && is_selected(SELECT_SEGMENTS); i++, segment++)
+        record_output->segment(out, elf_path, i, segment);
+
+    Elf64_Shdr *section = (Elf64_Shdr*)file.elf_shead;
+    for (int i = 0; i < file.elf_head->e_shnum && is_selected(SELECT_SECTIONS); i++, section++)
+        record_output->section(out, elf_path, i, section,
+                               elf_section_name(&file, section));
+
+    section = (Elf64_Shdr*)file.elf_shead;
+    for (int i = 0; i < file.elf_head->e_shnum; i++, section++) {
+        int named = section_matches(&file, i, section, section_names, section_count);
+
         switch (section->sh_type) {
-            case SHT_NULL:
-            case SHT_NOBITS:
-            case SHT_PROGBITS:
-                break;
             case SHT_SYMTAB:
             case SHT_DYNSYM:
-                display_symbols(section, file);
-                break;
-            case SHT_STRTAB:
-                display_strings(section, file);
+                if (named || is_selected(SELECT_SYMBOLS))
+                    record_symbols(&file, elf_path, i, section);
                 break;
+            case SHT_REL:
             case SHT_RELA:
-                display_rela(section, file);
+                if (named || is_selected(SELECT_RELOCS))
+                    record_relocations(&file, elf_path, i, section);
                 break;
-            case SHT_REL:
-                display_rel(section, file);
+            case SHT_RELR:
+                if (named || is_selected(SELECT_RELOCS))
+                    record_relr(&file, elf_path, i, section);
                 break;
-            case SHT_NOTE:
-                display_note(section, file);
-            default:
-                fprintf(stdout, "= TODO %s =\n", get_string(file->shstr_table, section->sh_name));
         }
     }
+
+    return close_file(&file, elf_path);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc < 2)
-        usage();
+// Text runs of the sections named with --section, or of the whole file. Same
+// return values as dump_file.
+int strings_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    out_printf(out, "== Strings of %s ==\n", elf_path);
+
+    if (section_count == 0) {
+        Stat_mark mark;
+        Strscan_runs scan;
+        const char *data;
+
+        // In windows, so that files read with pread are not read whole
+        out_char(out, '\n');
+        stats_begin(&mark, &file.source);
+        strscan_begin(&scan, out, strings_min);
+        for (uint64_t at = 0; at < file.source.size; at += STRINGS_WINDOW) {
+            uint64_t size = file.source.size - at < STRINGS_WINDOW ? file.source.size - at : STRINGS_WINDOW;
+            if ((data = source_window(&file.source, at, size)) == NULL)
+                break;
+            strscan_feed(&scan, data, size);
+        }
+        strscan_end(&scan);
+        stats_end(&mark, STAT_STRINGS, &file.source);
+        return close_file(&file, elf_path);
+    }
+
+    Elf64_Shdr *section = (Elf64_Shdr*)file.elf_shead;
+
+    prefetch_named(&file);
+
+    for (int i = 0; i < file.elf_head->e_shnum; i++, section++) {
+        if (!section_matches(&file, i, section, section_names, section_count))
+            continue;
+
+        Stat_mark mark;
+        uint64_t size;
+        char *data;
+
+        out_printf(out, "\n= Strings of '%s' =\n\n", elf_section_name(&file, section));
+        stats_begin(&mark, &file.source);
+        if ((data = zsection_contents(&file, section, &size)) != NULL)
+            strscan_runs(out, data, size, strings_min);
+        stats_end(&mark, STAT_STRINGS, &file.source);
+    }
+    warn_missing(&file, elf_path, section_names, section_count);
+
+    return close_file(&file, elf_path);
+}
+
+// Count the relocations of one file by table, type and target section. Same
+// return values as dump_file.
+int reloc_summary_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+    display_reloc_summary(&file, elf_path);
+    return close_file(&file, elf_path);
+}
+
+// Resolve the libraries one file needs. Same return values as dump_file.
+int deps_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    Stat_mark mark;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+    stats_begin(&mark, &file.source);
+    display_deps(&file, elf_path, section_jobs);
+    stats_end(&mark, STAT_DEPS, &file.source);
+    return close_file(&file, elf_path);
+}
+
+// Check the unwind information of one file. Same return values as dump_file.
+int check_cfi_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+    check_cfi(&file, elf_path);
+    return close_file(&file, elf_path);
+}
 
-    Elf64_data *file = calloc(1, sizeof(Elf64_data));
-    char elf_path[128];
-    int elf_fd;
+// List the indirect branches of one file. Same return values as dump_file.
+int indirect_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    Stat_mark mark;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+    stats_begin(&mark, &file.source);
+    disasm_indirect(&file, elf_path, demangle_names);
+    stats_end(&mark, STAT_CODE, &file.source);
+    return close_file(&file, elf_path);
+}
+
+// Attribute the bytes of one file to its segments, sections and symbols. Same
+// return values as dump_file.
+int size_profile_file(const char *elf_path, Output *out, int skip_invalid) {
+    Elf64_data file;
+    int status;
+
+    if ((status = open_file(&file, elf_path, skip_invalid)) != 0)
+        return status;
+
+    file.out = out;
+    display_size_profile(&file, elf_path);
+    return close_file(&file, elf_path);
+}
+
+void display_summary(Cache_entry *entry, const char *elf_path, Output *out) {
+    Elf64_Ehdr *elf_head = &entry->header;
+    char *names = CACHE_NAMES(entry);
+
+    out_printf(out, "== %s ==\n", elf_path);
+    out_printf(out, "  %s %s %s, %s, entry 0x%lx\n", get_class(elf_head->e_ident[EI_CLASS]),
+               elf_head->e_ident[EI_DATA] == ELFDATA2MSB ? "MSB" : "LSB",
+               get_etype(elf_head->e_type), get_machine(elf_head->e_machine), elf_head->e_entry);
+
+    if (entry->build_id_len > 0) {
+        out_str(out, "  Build-id ");
+        for (uint32_t i = 0; i < entry->build_id_len; i++)
+            out_hex(out, entry->build_id[i], 2, OUT_ZERO);
+        out_char(out, '\n');
+    }
+
+    out_printf(out, "  %u segments, %u sections, %lu symbols, %lu dynamic symbols\n",
+               entry->phnum, entry->shnum, entry->symbols, entry->dynamic_symbols);
+
+    Elf64_Phdr *segment = CACHE_PHDRS(entry);
+    for (int i = 0; i < entry->phnum; i++, segment++)
+        out_printf(out, "  segment %-12s %c%c%c  offset 0x%-8lx vaddr 0x%-12lx filesz 0x%-8lx memsz 0x%lx\n",
+                   get_ptype(segment->p_type),
+                   segment->p_flags & PF_R ? 'R' : ' ',
+                   segment->p_flags & PF_W ? 'W' : ' ',
+                   segment->p_flags & PF_X ? 'X' : ' ',
+                   segment->p_offset, segment->p_vaddr, segment->p_filesz, segment->p_memsz);
+
+    Elf64_Shdr *section = CACHE_SHDRS(entry);
+    for (int i = 0; i < entry->shnum; i++, section++)
+        out_printf(out, "  section %-20s %-12s offset 0x%-8lx size 0x%lx\n",
+                   elf_string(names, entry->names_size, section->sh_name),
+                   get_stype(section->sh_type), section->sh_offset, section->sh_size);
+}
+
+// Summary of a file, from the cache when it did not change since it was last
+// seen. Sets mapped when the entry is mapped from the cache rather than
+// allocated, see release_summary. Returns NULL on error.
+Cache_entry *load_summary(const char *elf_path, size_t *size, int *mapped) {
     struct stat elf_stat;
+    Cache_entry *entry = NULL;
+    int status;
+
+    *mapped = 0;
+    if ((strcmp(elf_path, "-") == 0 ? fstat(STDIN_FILENO, &elf_stat) : stat(elf_path, &elf_stat)) < 0) {
+        file_error(elf_path, "Failed determining file size! %s\n");
+        return NULL;
+    }
+
+    // Only regular files have a stable identity to cache
+    int cached = cache_dir != NULL && S_ISREG(elf_stat.st_mode);
+
+    if (cached && (entry = cache_load(cache_dir, &elf_stat, size)) != NULL) {
+        *mapped = 1;
+        return entry;
+    }
+
+    Elf64_data file;
+
+    if ((status = open_file(&file, elf_path, 1)) < 0)
+        return NULL;
 
-    // Get filename
-    strncpy(elf_path, argv[1], 128);
+    if (status == 1) {
+        // Remember it is not an ELF file either
+        entry = cache_build(NULL, elf_path, &elf_stat, size);
+    } else {
+        entry = cache_build(&file, elf_path, &elf_stat, size);
+        close_file(&file, elf_path);
+    }
+
+    if (entry == NULL) {
+        file_error(elf_path, "Failed summarizing the file! %s\n");
+        return NULL;
+    }
 
-    // Open file
-    if ((elf_fd = open(elf_path, O_RDONLY)) < 0)
-        error("Failed opening the file! %s\n");
+    if (cached && cache_store(cache_dir, entry, *size) < 0)
+        file_error(elf_path, "Failed writing to the cache! %s\n");
 
-    // Get file size
-    if (stat(elf_path, &elf_stat) < 0)
-        error("Failed determining file size! %s\n");
+    return entry;
+}
+
+void release_summary(Cache_entry *entry, size_t size, int mapped) {
+    if (mapped)
+        cache_release(entry, size);
+    else
+        free(entry);
+}
+
+// Return value of a batch function for a summary that is not of an ELF file
+int not_elf(const char *elf_path, int skip_invalid) {
+    if (skip_invalid)
+        return 1;
+    fprintf(stderr, "%s: The file is not a valid ELF file!\n", elf_path);
+    return -1;
+}
 
-    // Map file in virtual memory
-    if ((file->elf_image = mmap(NULL, elf_stat.st_size, PROT_READ, MAP_PRIVATE, elf_fd, 0)) < 0)
-        error("Failed to mmap file to memory! %s\n");
+// Print the summary of a file. Same return values as dump_file.
+int summary_file(const char *elf_path, Output *out, int skip_invalid) {
+    Cache_entry *entry;
+    size_t size;
+    int mapped;
+    int status = 0;
 
-    test_valid(file->elf_image);
+    if ((entry = load_summary(elf_path, &size, &mapped)) == NULL)
+        return -1;
 
-    file->elf_head = (Elf64_Ehdr*)file->elf_image;
+    if (entry->flags & CACHE_NOT_ELF)
+        status = not_elf(elf_path, skip_invalid);
+    else
+        display_summary(entry, elf_path, out);
+
+    release_summary(entry, size, mapped);
+    return status;
+}
+
+// Add the build-id of a file to build_ids, under its absolute path. Same
+// return values as dump_file.
+int index_file(const char *elf_path, Output *out, int skip_invalid) {
+    char path[PATH_MAX];
+    Cache_entry *entry;
+    size_t size;
+    int mapped;
+    int status = 0;
+
+    (void)out;
+    if (realpath(elf_path, path) == NULL)
+        return file_error(elf_path, "Failed resolving the path! %s\n");
+    if ((entry = load_summary(elf_path, &size, &mapped)) == NULL)
+        return -1;
+
+    if (entry->flags & CACHE_NOT_ELF)
+        status = not_elf(elf_path, skip_invalid);
+    else if (buildid_add(&build_ids, entry, path) < 0)
+        fprintf(stderr, "%s: Build-id too long to index\n", elf_path);
+
+    release_summary(entry, size, mapped);
+    return status;
+}
+
+// Parse a build-id given in hexadecimal. Returns its length, or -1 if it is
+// not one.
+int parse_build_id(const char *hex, uint8_t *id, uint32_t max) {
+    uint32_t len = 0;
+
+    for (; hex[0] && hex[1] && len < max; hex += 2) {
+        unsigned int byte;
+        if (sscanf(hex, "%2x", &byte) != 1)
+            break;
+        id[len++] = byte;
+    }
 
-    display_header(file, elf_path);
-    display_programs(file);
-    display_sections(file);
-    display_section_contents(file);
+    return *hex == 0 && len > 0 ? (int)len : -1;
+}
+
+// Print the cached summary of the file with the given build-id
+int summary_build_id(const char *hex) {
+    uint8_t id[CACHE_BUILD_ID_MAX];
+    int len = parse_build_id(hex, id, CACHE_BUILD_ID_MAX);
+    Cache_entry *entry;
+    size_t size;
+
+    if (cache_dir == NULL || len < 0 || (entry = cache_load_build_id(cache_dir, id, len, &size)) == NULL) {
+        fprintf(stderr, "No cached file with this build-id\n");
+        return -1;
+    }
+
+    Output out;
+    int status;
+
+    out_open_fd(&out, STDOUT_FILENO);
+    display_summary(entry, CACHE_PATH(entry), &out);
+    status = out_close(&out);
+    cache_release(entry, size);
+    return status;
+}
+
+// Print the indexed files with the given build-id, debug files first
+int find_debug(const char *hex) {
+    uint8_t id[BUILDID_MAX];
+    int len = parse_build_id(hex, id, BUILDID_MAX);
+    Output out;
+    int status;
+
+    if (len < 0) {
+        fprintf(stderr, "Invalid build-id %s\n", hex);
+        return -1;
+    }
+
+    out_open_fd(&out, STDOUT_FILENO);
+    status = buildid_find(cache_dir, id, len, &out);
+    if (out_close(&out) < 0)
+        status = -1;
+    return status;
+}
+
+// Index the build-ids of the batch into the cache directory
+int index_build_ids(Batch *batch, int jobs) {
+    int status;
+
+    buildid_init(&build_ids);
+    status = batch_run(batch, jobs, index_file);
+    if (buildid_write(&build_ids, cache_dir) < 0) {
+        fprintf(stderr, "Failed writing the build-id index! %s\n", strerror(errno));
+        status = -1;
+    } else {
+        printf("%zu build-ids indexed in %s/%s\n", build_ids.count, cache_dir, BUILDID_FILE);
+        if (fflush(stdout) != 0) {
+            fprintf(stderr, "alfur: cannot write the output: %s\n", strerror(errno));
+            status = -1;
+        }
+    }
+    buildid_release(&build_ids);
+    return status;
+}
+
+// Resolve a dynamic symbol through the hash table, like ld.so
+int display_lookup(Elf64_data *file, const char *name) {
+    Dyn_hash hash;
+    int64_t index;
+
+    if (hash_find(&hash, file) < 0) {
+        fprintf(stderr, "No usable hash table\n");
+        return -1;
+    }
 
-    if (munmap(file->elf_image, elf_stat.st_size) < 0)
-        error("Failed unmapping the file! %s\n");
+    if ((index = hash_lookup(&hash, name)) < 0) {
+        fprintf(stderr, "%s: symbol not found\n", name);
+        return -1;
+    }
 
-    free(file);
+    out_str(file->out, "  Num:  Value            Size Type    Bind   Visibility Ndx Name\n");
+    display_symbol(file, index, &hash.symbols[index], hash.names, hash.names_size);
     return 0;
 }
+
+// Answer a query about a single file, reading its input from stdin
+int query_file(const char *elf_path, int mode, const char *arg) {
+    Elf64_data file;
+    Output out;
+    int status;
+
+    if ((status = open_file(&file, elf_path, 0)) != 0)
+        return status;
+
+    out_open_fd(&out, STDOUT_FILENO);
+    file.out = &out;
+
+    switch (mode) {
+        case MODE_ADDR2SYM:
+            addr2sym(&file, STDIN_FILENO);
+            break;
+        case MODE_ADDR2LINE:
+            addr2line(&file, STDIN_FILENO);
+            break;
+        case MODE_LOOKUP:
+            status = display_lookup(&file, arg);
+            break;
+        case MODE_HASH_CHECK:
+            status = hash_check(&file);
+            break;
+        case MODE_CFI:
+            status = display_cfi(&file, arg);
+            break;
+    }
+
+    if (out_close(&out) < 0)
+        status = -1;
+    if (close_file(&file, elf_path) < 0)
+        return -1;
+    return status;
+}
+
+// Compare two files, hashing their sections on jobs threads
+int diff_paths(const char *old_path, const char *new_path, int jobs) {
+    Elf64_data old, new;
+    Output out;
+    int status;
+
+    if ((status = open_file(&old, old_path, 0)) != 0)
+        return status;
+    if ((status = open_file(&new, new_path, 0)) != 0) {
+        close_file(&old, old_path);
+        return status;
+    }
+
+    out_open_fd(&out, STDOUT_FILENO);
+    out_printf(&out, "=== %s -> %s ===\n", old_path, new_path);
+    status = diff_files(&old, &new, &out, jobs);
+    if (out_close(&out) < 0)
+        status = -1;
+
+    if (close_file(&old, old_path) < 0 || close_file(&new, new_path) < 0)
+        return -1;
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        { "addr2sym", no_argument, NULL, OPT_ADDR2SYM },
+        { "addr2line", no_argument, NULL, OPT_ADDR2LINE },
+        { "lookup", required_argument, NULL, OPT_LOOKUP },
+        { "hash-check", no_argument, NULL, OPT_HASH_CHECK },
+        { "summary", no_argument, NULL, OPT_SUMMARY },
+        { "cache", required_argument, NULL, OPT_CACHE },
+        { "build-id", required_argument, NULL, OPT_BUILD_ID },
+        { "pread", no_argument, NULL, OPT_PREAD },
+        { "format", required_argument, NULL, OPT_FORMAT },
+        { "relocs", no_argument, NULL, OPT_RELOCS },
+        { "section", required_argument, NULL, OPT_SECTION },
+        { "diff", no_argument, NULL, OPT_DIFF },
+        { "size-profile", no_argument, NULL, OPT_SIZE },
+        { "strings", optional_argument, NULL, OPT_STRINGS },
+        { "reloc-summary", no_argument, NULL, OPT_RELOC_SUMMARY },
+        { "deps", no_argument, NULL, OPT_DEPS },
+        { "disassemble", optional_argument, NULL, OPT_DISASSEMBLE },
+        { "index-buildids", required_argument, NULL, OPT_INDEX },
+        { "find-debug", required_argument, NULL, OPT_FIND_DEBUG },
+        { "cfi", required_argument, NULL, OPT_CFI },
+        { "check-cfi", no_argument, NULL, OPT_CHECK_CFI },
+        { "indirect", no_argument, NULL, OPT_INDIRECT },
+        { "serve", required_argument, NULL, OPT_SERVE },
+        { "demangle", no_argument, NULL, 'C' },
+        { "stats", optional_argument, NULL, OPT_STATS },
+        { NULL, 0, NULL, 0 }
+    };
+    Batch batch = { 0 };
+    int mode = MODE_DUMP;
+    const char *mode_arg = NULL;
+    int jobs = 0;
+    int opt;
+
+    stats_phase(STAT_ARGS);
+
+    section_names = calloc(argc, sizeof(char*));
+    string_names = calloc(argc, sizeof(char*));
+    if (section_names == NULL || string_names == NULL)
+        error("Failed allocating memory! %s\n");
+
+    while ((opt = getopt_long(argc, argv, "j:r:hlSsnp:Cd", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'r':
+                if (batch_add_tree(&batch, optarg) < 0)
+                    file_error(optarg, "Failed walking the directory! %s\n");
+                break;
+            case 'h':
+                selected |= SELECT_HEADER;
+                break;
+            case 'l':
+                selected |= SELECT_SEGMENTS;
+                break;
+            case 'S':
+                selected |= SELECT_SECTIONS;
+                break;
+            case 's':
+                selected |= SELECT_SYMBOLS;
+                break;
+            case 'n':
+                selected |= SELECT_NOTES;
+                break;
+            case 'C':
+                demangle_names = 1;
+                break;
+            case 'd':
+                selected |= SELECT_CODE;
+                break;
+            case OPT_DISASSEMBLE:
+                selected |= SELECT_CODE;
+                code_symbol = optarg;
+                break;
+            case OPT_RELOCS:
+                selected |= SELECT_RELOCS;
+                break;
+            case 'p':
+                selected |= SELECT_CONTENTS;
+                string_names[string_count++] = optarg;
+                break;
+            case OPT_SECTION:
+                selected |= SELECT_CONTENTS;
+                section_names[section_count++] = optarg;
+                break;
+            case OPT_ADDR2SYM:
+                mode = MODE_ADDR2SYM;
+                break;
+            case OPT_ADDR2LINE:
+                mode = MODE_ADDR2LINE;
+                break;
+            case OPT_LOOKUP:
+                mode = MODE_LOOKUP;
+                mode_arg = optarg;
+                break;
+            case OPT_HASH_CHECK:
+                mode = MODE_HASH_CHECK;
+                break;
+            case OPT_SUMMARY:
+                mode = MODE_SUMMARY;
+                break;
+            case OPT_BUILD_ID:
+                mode = MODE_BUILD_ID;
+                mode_arg = optarg;
+                break;
+            case OPT_DIFF:
+                mode = MODE_DIFF;
+                break;
+            case OPT_INDEX:
+                mode = MODE_INDEX;
+                if (batch_add_tree(&batch, optarg) < 0)
+                    file_error(optarg, "Failed walking the directory! %s\n");
+                break;
+            case OPT_FIND_DEBUG:
+                mode = MODE_FIND_DEBUG;
+                mode_arg = optarg;
+                break;
+            case OPT_SIZE:
+                mode = MODE_SIZE;
+                break;
+            case OPT_RELOC_SUMMARY:
+                mode = MODE_RELOC_SUMMARY;
+                break;
+            case OPT_CFI:
+                mode = MODE_CFI;
+                mode_arg = optarg;
+                break;
+            case OPT_CHECK_CFI:
+                mode = MODE_CHECK_CFI;
+                break;
+            case OPT_INDIRECT:
+                mode = MODE_INDIRECT;
+                break;
+            case OPT_SERVE:
+                mode = MODE_SERVE;
+                mode_arg = optarg;
+                break;
+            case OPT_DEPS:
+                mode = MODE_DEPS;
+                break;
+            case OPT_STRINGS:
+                mode = MODE_STRINGS;
+                if (optarg != NULL && (strings_min = strtoull(optarg, NULL, 10)) == 0)
+                    usage();
+                break;
+            case OPT_PREAD:
+                open_flags |= ALFUR_PREAD;
+                break;
+            case OPT_FORMAT:
+                if (strcmp(optarg, "text") != 0 && (record_output = record_format(optarg)) == NULL)
+                    usage();
+                break;
+            case OPT_STATS:
+                if (optarg != NULL && strcmp(optarg, "text") != 0 && strcmp(optarg, "ndjson") != 0)
+                    usage();
+                stats_enable(optarg != NULL && strcmp(optarg, "ndjson") == 0);
+                break;
+            case OPT_CACHE:
+                if (cache_open(optarg) < 0)
+                    error("Failed creating the cache directory! %s\n");
+                cache_dir = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    // --section picks the sections --strings scans
+    int strings_sections = mode == MODE_STRINGS && selected == SELECT_CONTENTS && string_count == 0;
+    if ((record_output != NULL || (selected != 0 && !strings_sections)) && mode != MODE_DUMP)
+        usage();
+
+    stats_phase(STAT_RUN);
+
+    Batch_dump dump = mode == MODE_SUMMARY ? summary_file
+                    : mode == MODE_SIZE ? size_profile_file
+                    : mode == MODE_STRINGS ? strings_file
+                    : mode == MODE_RELOC_SUMMARY ? reloc_summary_file
+                    : mode == MODE_DEPS ? deps_file
+                    : mode == MODE_CHECK_CFI ? check_cfi_file
+                    : mode == MODE_INDIRECT ? indirect_file
+                    : record_output != NULL ? record_file : dump_file;
+
+    if (mode == MODE_BUILD_ID) {
+        if (batch.count != 0 || argc != optind)
+            usage();
+        return summary_build_id(mode_arg) < 0;
+    }
+
+    if (mode == MODE_FIND_DEBUG) {
+        if (cache_dir == NULL || batch.count != 0 || argc != optind)
+            usage();
+        return find_debug(mode_arg) < 0;
+    }
+
+    if (mode == MODE_SERVE) {
+        if (batch.count != 0 || argc != optind)
+            usage();
+        return serve(mode_arg, cache_dir) < 0;
+    }
+
+    if (mode == MODE_INDEX) {
+        if (cache_dir == NULL)
+            usage();
+        for (int i = optind; i < argc; i++)
+            batch_add(&batch, argv[i], 0);
+        if (jobs <= 0)
+            jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        return index_build_ids(&batch, jobs) < 0;
+    }
+
+    if (mode == MODE_DIFF) {
+        if (batch.count != 0 || argc - optind != 2)
+            usage();
+        if (jobs <= 0)
+            jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        return diff_paths(argv[optind], argv[optind + 1], jobs) < 0;
+    }
+
+    if (mode != MODE_DUMP && mode != MODE_SUMMARY && mode != MODE_SIZE && mode != MODE_STRINGS
+        && mode != MODE_RELOC_SUMMARY && mode != MODE_DEPS && mode != MODE_CHECK_CFI && mode != MODE_INDIRECT) {
+        if (batch.count != 0 || argc - optind != 1)
+            usage();
+        return query_file(argv[optind], mode, mode_arg) < 0;
+    }
+
+    // Single file: dump it straight to stdout, like it always did
+    if (batch.count == 0 && argc - optind == 1) {
+        Output out;
+        int status;
+
+        section_jobs = jobs > 0 ? jobs : sysconf(_SC_NPROCESSORS_ONLN);
+
+        out_open_fd(&out, STDOUT_FILENO);
+        status = dump(argv[optind], &out, 0);
+        if (out_close(&out) < 0)
+            status = -1;
+        return status < 0;
+    }
+
+    for (int i = optind; i < argc; i++)
+        batch_add(&batch, argv[i], 0);
+
+    if (batch.count == 0)
+        usage();
+
+    if (jobs <= 0)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return batch_run(&batch, jobs, dump) < 0;
+}
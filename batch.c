@@ -0,0 +1,244 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "batch.h"
+
+// Bytes of finished dumps waiting to be written past which no more are started
+#define BATCH_BUFFERED (32 << 20)
+
+typedef struct {
+    Batch *batch;
+    Batch_dump dump;
+    size_t next;    // Next entry to hand to a worker
+    size_t written; // Entries written and freed, the others being buffered
+    size_t window;  // Entries handed out past written at most
+    size_t buffered; // Bytes of the dumps done and not written yet
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    pthread_cond_t writable; // written moved on
+} Batch_pool;
+
+void batch_add(Batch *batch, const char *path, int skip_invalid) {
+    if (batch->count == batch->capacity) {
+        batch->capacity = batch->capacity ? batch->capacity * 2 : 64;
+        batch->entries = realloc(batch->entries, batch->capacity * sizeof(Batch_entry));
+        if (batch->entries == NULL) {
+            perror("alfur");
+            exit(1);
+        }
+    }
+
+    Batch_entry *entry = &batch->entries[batch->count++];
+    memset(entry, 0, sizeof(Batch_entry));
+    entry->path = strdup(path);
+    entry->skip_invalid = skip_invalid;
+}
+
+int walk_tree(Batch *batch, const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    struct stat st;
+    size_t dir_len = strlen(dir);
+
+    if (d == NULL)
+        return -1;
+
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+
+        size_t len = dir_len + strlen(ent->d_name) + 2;
+        char path[len];
+        if (dir_len > 0 && dir[dir_len - 1] == '/')
+            snprintf(path, len, "%s%s", dir, ent->d_name);
+        else
+            snprintf(path, len, "%s/%s", dir, ent->d_name);
+
+        // Never follow symbolic links, the target is either in the tree or
+        // was not asked for
+        if (lstat(path, &st) < 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            walk_tree(batch, path);
+        else if (S_ISREG(st.st_mode))
+            batch_add(batch, path, 1);
+    }
+
+    closedir(d);
+    return 0;
+}
+
+int compare_entries(const void *a, const void *b) {
+    return strcmp(((const Batch_entry*)a)->path, ((const Batch_entry*)b)->path);
+}
+
+// Add every regular file under dir, sorted by path so the output does not
+// depend on the directory order
+int batch_add_tree(Batch *batch, const char *dir) {
+    size_t first = batch->count;
+
+    if (walk_tree(batch, dir) < 0)
+        return -1;
+
+    qsort(batch->entries + first, batch->count - first, sizeof(Batch_entry), compare_entries);
+    return 0;
+}
+
+// Dump an entry into its buffer and hand it to the writer
+void batch_dump(Batch_pool *pool, Batch_entry *entry) {
+    out_open_memory(&entry->output);
+    entry->status = pool->dump(entry->path, &entry->output, entry->skip_invalid);
+
+    pthread_mutex_lock(&pool->lock);
+    entry->done = 1;
+    pool->buffered += entry->output.size;
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Dump the entries in turn. An entry is only taken once the writer is close
+// enough behind, so that at most window dumps, and about BATCH_BUFFERED bytes
+// past the one being dumped, are held whatever the speed of the output.
+void *batch_worker(void *arg) {
+    Batch_pool *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->next < pool->batch->count
+               && (pool->next - pool->written >= pool->window || pool->buffered > BATCH_BUFFERED))
+            pthread_cond_wait(&pool->writable, &pool->lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->batch->count)
+            break;
+
+        batch_dump(pool, &pool->batch->entries[i]);
+    }
+
+    return NULL;
+}
+
+// Write the dumps of entries [first, last) with as few writev as possible
+int batch_write(Batch *batch, size_t first, size_t last) {
+    struct iovec iov[64];
+    int n = 0;
+    int status = 0;
+
+    for (size_t i = first; i < last; i++) {
+        Batch_entry *entry = &batch->entries[i];
+
+        if (entry->output.len > 0) {
+            iov[n].iov_base = entry->output.buf;
+            iov[n].iov_len = entry->output.len;
+            n++;
+        }
+
+        if (n == 64 || (i + 1 == last && n > 0)) {
+            struct iovec *v = iov;
+
+            // Short writes leave us in the middle of an iovec
+            while (n > 0) {
+                ssize_t written = writev(STDOUT_FILENO, v, n);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    status = -1;
+                    break;
+                }
+                while (n > 0 && (size_t)written >= v->iov_len) {
+                    written -= v->iov_len;
+                    v++;
+                    n--;
+                }
+                if (n > 0) {
+                    v->iov_base = (char*)v->iov_base + written;
+                    v->iov_len -= written;
+                }
+            }
+            n = 0;
+        }
+    }
+
+    return status;
+}
+
+// Dump every file of the batch on jobs threads. Each dump is buffered and
+// written whole, in the order the files were added. At most 2 * jobs of them
+// are buffered at once, fewer when they are big, see batch_worker.
+int batch_run(Batch *batch, int jobs, Batch_dump dump) {
+    Batch_pool pool = { .batch = batch, .dump = dump, .next = 0, .written = 0, .window = 2 * jobs };
+    int status = 0, started = 0, write_failed = 0;
+
+    if (batch->count == 0) {
+        free(batch->entries);
+        return 0;
+    }
+    if ((size_t)jobs > batch->count)
+        jobs = batch->count;
+
+    pthread_t threads[jobs];
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pthread_cond_init(&pool.writable, NULL);
+
+    // Go on with the threads that could be started; without any, each dump
+    // is made here just before it is written
+    while (started < jobs && pthread_create(&threads[started], NULL, batch_worker, &pool) == 0)
+        started++;
+
+    for (size_t i = 0; i < batch->count;) {
+        size_t last = i, freed = 0;
+
+        if (started == 0)
+            batch_dump(&pool, &batch->entries[i]);
+
+        // Wait for the next entry, then take every following one already done
+        pthread_mutex_lock(&pool.lock);
+        while (!batch->entries[i].done)
+            pthread_cond_wait(&pool.done, &pool.lock);
+        while (last < batch->count && batch->entries[last].done)
+            last++;
+        pthread_mutex_unlock(&pool.lock);
+
+        if (batch_write(batch, i, last) < 0 && !write_failed) {
+            fprintf(stderr, "alfur: cannot write the output: %s\n", strerror(errno));
+            write_failed = 1;
+        }
+
+        for (; i < last; i++) {
+            Batch_entry *entry = &batch->entries[i];
+
+            if (entry->status < 0)
+                status = -1;
+            freed += entry->output.size;
+            out_close(&entry->output);
+            free(entry->path);
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        pool.written = i;
+        pool.buffered -= freed;
+        pthread_cond_broadcast(&pool.writable);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.done);
+    pthread_cond_destroy(&pool.writable);
+    free(batch->entries);
+
+    return write_failed ? -1 : status;
+}
@@ -0,0 +1,31 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#include "output.h"
+
+// Batch of files dumped by a pool of worker threads
+
+typedef struct {
+    char *path;
+    int skip_invalid; // Found while walking a tree: silently skip non-ELF files
+    Output output;    // Dump of the file, kept until it is its turn to be printed
+    int status;
+    int done;
+} Batch_entry;
+
+typedef struct {
+    Batch_entry *entries;
+    size_t count;
+    size_t capacity;
+} Batch;
+
+// Dump function run on each file, see dump_file in alfur.c
+typedef int (*Batch_dump)(const char *elf_path, Output *out, int skip_invalid);
+
+void batch_add(Batch *batch, const char *path, int skip_invalid);
+int batch_add_tree(Batch *batch, const char *dir);
+int batch_run(Batch *batch, int jobs, Batch_dump dump);
+
+#endif
@@ -0,0 +1,258 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "buildid.h"
+#include "cache.h"
+#include "elf.h"
+#include "output.h"
+
+// Paths of the index being sorted, for compare_entries
+static const char *sort_paths;
+
+void buildid_init(Buildid_index *index) {
+    memset(index, 0, sizeof(Buildid_index));
+    pthread_mutex_init(&index->lock, NULL);
+}
+
+static void *grow(void *data, size_t *capacity, size_t needed, size_t unit) {
+    size_t size = *capacity ? *capacity : 1024;
+
+    while (size < needed)
+        size *= 2;
+    if (size == *capacity)
+        return data;
+    if ((data = realloc(data, size * unit)) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    *capacity = size;
+    return data;
+}
+
+// What the sections of a summarized file hold
+static int entry_flags(const Cache_entry *entry) {
+    Elf64_Shdr *section = CACHE_SHDRS(entry);
+    char *names = CACHE_NAMES(entry);
+    int flags = 0;
+
+    for (int i = 0; i < entry->shnum; i++, section++) {
+        const char *name = elf_string(names, entry->names_size, section->sh_name);
+
+        if (section->sh_type == SHT_SYMTAB)
+            flags |= BUILDID_SYMTAB;
+        else if (section->sh_type != SHT_NOBITS && section->sh_size > 0
+                 && (strcmp(name, ".debug_info") == 0 || strcmp(name, ".zdebug_info") == 0))
+            flags |= BUILDID_DEBUG_INFO;
+    }
+
+    return flags;
+}
+
+// Index the file summarized by entry under path. Returns 1 if it has no
+// build-id, -1 if its build-id is too long to index.
+int buildid_add(Buildid_index *index, const Cache_entry *entry, const char *path) {
+    size_t path_size = strlen(path) + 1;
+
+    if (entry->build_id_len == 0)
+        return 1;
+    if (entry->build_id_len > BUILDID_MAX)
+        return -1;
+
+    Buildid_entry added = { 0 };
+
+    memcpy(added.id, entry->build_id, entry->build_id_len);
+    added.len = entry->build_id_len;
+    added.flags = entry_flags(entry);
+    added.size = entry->size;
+    added.mtime_sec = entry->mtime_sec;
+
+    pthread_mutex_lock(&index->lock);
+    index->entries = grow(index->entries, &index->capacity, index->count + 1, sizeof(Buildid_entry));
+    index->paths = grow(index->paths, &index->paths_capacity, index->paths_size + path_size, 1);
+    added.path = index->paths_size;
+    index->entries[index->count++] = added;
+    memcpy(index->paths + index->paths_size, path, path_size);
+    index->paths_size += path_size;
+    pthread_mutex_unlock(&index->lock);
+
+    return 0;
+}
+
+// Order of the build-ids, files of one build-id by what they hold
+static int compare_ids(const Buildid_entry *a, const uint8_t *id, uint32_t len) {
+    int c = memcmp(a->id, id, BUILDID_MAX);
+
+    return c ? c : (int)a->len - (int)len;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const Buildid_entry *x = a, *y = b;
+    int c = compare_ids(x, y->id, y->len);
+
+    if (c)
+        return c;
+    if ((x->flags ^ y->flags) & BUILDID_DEBUG_INFO)
+        return x->flags & BUILDID_DEBUG_INFO ? -1 : 1;
+    if ((x->flags ^ y->flags) & BUILDID_SYMTAB)
+        return x->flags & BUILDID_SYMTAB ? -1 : 1;
+    return strcmp(sort_paths + x->path, sort_paths + y->path);
+}
+
+// Sort the index and replace the one of the cache directory dir
+int buildid_write(Buildid_index *index, const char *dir) {
+    size_t entries_size = index->count * sizeof(Buildid_entry);
+    size_t size = sizeof(Buildid_header) + entries_size + index->paths_size;
+    char path[4096];
+    char *data;
+    int status;
+
+    sort_paths = index->paths;
+    qsort(index->entries, index->count, sizeof(Buildid_entry), compare_entries);
+
+    if ((data = malloc(size)) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+
+    Buildid_header *header = (Buildid_header*)data;
+
+    memset(header, 0, sizeof(Buildid_header));
+    memcpy(header->magic, BUILDID_MAGIC, 8);
+    header->count = index->count;
+    header->paths_size = index->paths_size;
+    memcpy(header + 1, index->entries, entries_size);
+    memcpy(data + sizeof(Buildid_header) + entries_size, index->paths, index->paths_size);
+
+    snprintf(path, sizeof(path), "%s/%s", dir, BUILDID_FILE);
+    status = cache_write(dir, path, data, size);
+    free(data);
+    return status;
+}
+
+void buildid_release(Buildid_index *index) {
+    free(index->entries);
+    free(index->paths);
+    pthread_mutex_destroy(&index->lock);
+}
+
+// Whether size bytes mapped at header hold a whole index
+static int index_valid(const Buildid_header *header, size_t size) {
+    if (size < sizeof(Buildid_header) || memcmp(header->magic, BUILDID_MAGIC, 8) != 0)
+        return 0;
+    if (header->count > (size - sizeof(Buildid_header)) / sizeof(Buildid_entry))
+        return 0;
+    return size == sizeof(Buildid_header) + header->count * sizeof(Buildid_entry) + header->paths_size
+        && (header->paths_size == 0 || ((const char*)header)[size - 1] == 0);
+}
+
+// Map the index of the cache directory dir. Returns -1, having said why, if
+// there is none or it is not valid.
+int buildid_open(Buildid_map *map, const char *dir) {
+    char path[4096];
+    struct stat st;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, BUILDID_FILE);
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        fprintf(stderr, "No build-id index in %s\n", dir);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0
+        || (map->header = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        fprintf(stderr, "Failed reading the build-id index of %s\n", dir);
+        return -1;
+    }
+    close(fd);
+
+    map->size = st.st_size;
+    map->ino = st.st_ino;
+    map->mtime_sec = st.st_mtim.tv_sec;
+    map->mtime_nsec = st.st_mtim.tv_nsec;
+    if (!index_valid(map->header, map->size)) {
+        munmap(map->header, map->size);
+        fprintf(stderr, "Invalid build-id index in %s\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+void buildid_close(Buildid_map *map) {
+    munmap(map->header, map->size);
+}
+
+// Start iterating over the entries of a build-id
+void buildid_begin(Buildid_iter *iter, Buildid_map *map, const uint8_t *id, uint32_t len) {
+    Buildid_entry *entries = (Buildid_entry*)(map->header + 1);
+    size_t low = 0, high = map->header->count;
+
+    iter->map = map;
+    iter->len = len;
+    memset(iter->key, 0, BUILDID_MAX);
+    memcpy(iter->key, id, len);
+
+    // First entry not below the build-id
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (compare_ids(&entries[mid], iter->key, len) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    iter->next = low;
+}
+
+// Path of the next file indexed under the build-id, NULL after the last.
+// changed is set if the file changed since it was indexed.
+const char *buildid_next(Buildid_iter *iter, int *changed) {
+    Buildid_header *header = iter->map->header;
+    Buildid_entry *entries = (Buildid_entry*)(header + 1), *entry;
+    const char *paths = (const char*)(entries + header->count);
+    struct stat st;
+
+    if (iter->next >= header->count || compare_ids(&entries[iter->next], iter->key, iter->len) != 0)
+        return NULL;
+    entry = &entries[iter->next++];
+
+    const char *file = paths + (entry->path < header->paths_size ? entry->path : header->paths_size - 1);
+
+    *changed = stat(file, &st) < 0 || (uint64_t)st.st_size != entry->size || st.st_mtim.tv_sec != entry->mtime_sec;
+    return file;
+}
+
+// Print the paths indexed under a build-id, skipping the files that changed
+// since. Returns -1 if there are none.
+int buildid_find(const char *dir, const uint8_t *id, uint32_t len, Output *out) {
+    Buildid_map map;
+    Buildid_iter iter;
+    const char *file;
+    int changed, found = 0;
+
+    if (buildid_open(&map, dir) < 0)
+        return -1;
+
+    buildid_begin(&iter, &map, id, len);
+    while ((file = buildid_next(&iter, &changed)) != NULL) {
+        if (changed) {
+            fprintf(stderr, "%s: Changed since it was indexed\n", file);
+            continue;
+        }
+        out_str(out, file);
+        out_char(out, '\n');
+        found++;
+    }
+
+    buildid_close(&map);
+    if (found == 0) {
+        fprintf(stderr, "No indexed file with this build-id\n");
+        return -1;
+    }
+    return 0;
+}
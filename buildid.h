@@ -0,0 +1,82 @@
+#ifndef BUILDID_H
+#define BUILDID_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "output.h"
+
+// Index of build-ids to paths, for --index-buildids and --find-debug.
+//
+// The index is built from the summaries of the cache, so indexing a tree
+// again only reads the files that changed, and written whole to the file
+// build-ids of the cache directory. It is a header, entries sorted by
+// build-id and the paths they point to, mapped as is: a query is a binary
+// search touching a few pages. The files of one build-id are sorted with
+// those carrying debug information first, then those with a symbol table.
+
+#define BUILDID_MAGIC "ALFURB1"
+#define BUILDID_FILE  "build-ids"
+
+#define BUILDID_MAX 32 // Longest build-id indexed, SHA-256
+
+// Values for flags
+#define BUILDID_DEBUG_INFO 0x1 // .debug_info with contents
+#define BUILDID_SYMTAB     0x2
+
+typedef struct {
+    char magic[8];
+    uint64_t count;
+    uint64_t paths_size;
+} Buildid_header;
+
+typedef struct {
+    uint8_t id[BUILDID_MAX]; // Zero padded
+    uint8_t len;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t path;           // Offset in the paths
+    uint64_t size;           // Of the file when it was indexed
+    int64_t mtime_sec;
+} Buildid_entry;
+
+// Index being built by several threads
+typedef struct {
+    Buildid_entry *entries;
+    size_t count;
+    size_t capacity;
+    char *paths;
+    size_t paths_size;
+    size_t paths_capacity;
+    pthread_mutex_t lock;
+} Buildid_index;
+
+// Index mapped for queries
+typedef struct {
+    Buildid_header *header;
+    size_t size;
+    uint64_t ino;          // Of the index file, to notice it was replaced
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} Buildid_map;
+
+typedef struct {
+    Buildid_map *map;
+    uint8_t key[BUILDID_MAX];
+    uint32_t len;
+    size_t next;
+} Buildid_iter;
+
+void buildid_init(Buildid_index *index);
+int buildid_add(Buildid_index *index, const Cache_entry *entry, const char *path);
+int buildid_write(Buildid_index *index, const char *dir);
+void buildid_release(Buildid_index *index);
+int buildid_open(Buildid_map *map, const char *dir);
+void buildid_close(Buildid_map *map);
+void buildid_begin(Buildid_iter *iter, Buildid_map *map, const uint8_t *id, uint32_t len);
+const char *buildid_next(Buildid_iter *iter, int *changed);
+int buildid_find(const char *dir, const uint8_t *id, uint32_t len, Output *out);
+
+#endif
@@ -0,0 +1,222 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "elf.h"
+#include "cache.h"
+
+// Create the cache directory if needed
+int cache_open(const char *dir) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return -1;
+    return 0;
+}
+
+static void entry_path(char *path, size_t len, const char *dir, struct stat *st) {
+    snprintf(path, len, "%s/%lx-%lx", dir, (unsigned long)st->st_dev, (unsigned long)st->st_ino);
+}
+
+static void build_id_path(char *path, size_t len, const char *dir, const uint8_t *id, uint32_t id_len) {
+    int n = snprintf(path, len, "%s/id-", dir);
+
+    for (uint32_t i = 0; i < id_len && n + 3 < (int)len; i++)
+        n += snprintf(path + n, len - n, "%02x", id[i]);
+}
+
+// Whether size bytes mapped at entry hold a whole entry
+static int entry_valid(Cache_entry *entry, size_t size) {
+    if (size < sizeof(Cache_entry) || memcmp(entry->magic, CACHE_MAGIC, 8) != 0)
+        return 0;
+    return size == sizeof(Cache_entry) + entry->phnum * sizeof(Elf64_Phdr)
+        + entry->shnum * sizeof(Elf64_Shdr) + entry->names_size + entry->path_size
+        && entry->path_size > 0 && CACHE_PATH(entry)[entry->path_size - 1] == 0;
+}
+
+static Cache_entry *map_entry(const char *path, size_t *size) {
+    struct stat st;
+    Cache_entry *entry;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    entry = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (entry == MAP_FAILED)
+        return NULL;
+
+    if (!entry_valid(entry, st.st_size)) {
+        munmap(entry, st.st_size);
+        return NULL;
+    }
+
+    *size = st.st_size;
+    return entry;
+}
+
+// Entry of the file described by st, or NULL if it is missing or stale
+Cache_entry *cache_load(const char *dir, struct stat *st, size_t *size) {
+    char path[4096];
+    Cache_entry *entry;
+
+    entry_path(path, sizeof(path), dir, st);
+    if ((entry = map_entry(path, size)) == NULL)
+        return NULL;
+
+    if (entry->dev != (uint64_t)st->st_dev || entry->ino != (uint64_t)st->st_ino
+        || entry->size != (uint64_t)st->st_size
+        || entry->mtime_sec != st->st_mtim.tv_sec || entry->mtime_nsec != st->st_mtim.tv_nsec) {
+        munmap(entry, *size);
+        return NULL;
+    }
+
+    return entry;
+}
+
+// Entry of any file with this build-id
+Cache_entry *cache_load_build_id(const char *dir, const uint8_t *id, uint32_t len, size_t *size) {
+    char path[4096];
+    Cache_entry *entry;
+
+    if (len == 0 || len > CACHE_BUILD_ID_MAX)
+        return NULL;
+
+    build_id_path(path, sizeof(path), dir, id, len);
+    if ((entry = map_entry(path, size)) == NULL)
+        return NULL;
+
+    if (entry->build_id_len != len || memcmp(entry->build_id, id, len) != 0) {
+        munmap(entry, *size);
+        return NULL;
+    }
+
+    return entry;
+}
+
+void cache_release(Cache_entry *entry, size_t size) {
+    munmap(entry, size);
+}
+
+// Summarize a mapped file into a new entry, or a CACHE_NOT_ELF entry when
+// file is NULL. The entry is to be freed.
+Cache_entry *cache_build(Elf64_data *file, const char *path, struct stat *st, size_t *size) {
+    uint16_t phnum = 0, shnum = 0;
+    uint32_t names_size = 0;
+    uint32_t path_size = strlen(path) + 1;
+    Cache_entry *entry;
+
+    if (file != NULL) {
+        phnum = file->elf_head->e_phnum;
+        shnum = file->elf_head->e_shnum;
+        if (file->shstr_table_header != NULL && elf_section_data(file, file->shstr_table_header) != NULL)
+            names_size = file->shstr_table_header->sh_size;
+    }
+
+    *size = sizeof(Cache_entry) + phnum * sizeof(Elf64_Phdr) + shnum * sizeof(Elf64_Shdr)
+        + names_size + path_size;
+    if ((entry = calloc(1, *size)) == NULL)
+        return NULL;
+
+    memcpy(entry->magic, CACHE_MAGIC, 8);
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime_sec = st->st_mtim.tv_sec;
+    entry->mtime_nsec = st->st_mtim.tv_nsec;
+    entry->path_size = path_size;
+
+    if (file == NULL) {
+        entry->flags = CACHE_NOT_ELF;
+        memcpy(CACHE_PATH(entry), path, path_size);
+        return entry;
+    }
+
+    const uint8_t *id;
+    uint32_t id_len = elf_build_id(file, &id);
+    if (id_len > 0 && id_len <= CACHE_BUILD_ID_MAX) {
+        entry->build_id_len = id_len;
+        memcpy(entry->build_id, id, id_len);
+    }
+
+    entry->header = *file->elf_head;
+    entry->phnum = phnum;
+    entry->shnum = shnum;
+    entry->names_size = names_size;
+
+    memcpy(CACHE_PHDRS(entry), file->elf_phead, phnum * sizeof(Elf64_Phdr));
+    for (int i = 0; i < shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+
+        CACHE_SHDRS(entry)[i] = *section;
+        if (section->sh_entsize == 0)
+            continue;
+        if (section->sh_type == SHT_SYMTAB)
+            entry->symbols += section->sh_size / section->sh_entsize;
+        else if (section->sh_type == SHT_DYNSYM)
+            entry->dynamic_symbols += section->sh_size / section->sh_entsize;
+    }
+    memcpy(CACHE_NAMES(entry), file->shstr_table, names_size);
+    memcpy(CACHE_PATH(entry), path, path_size);
+
+    return entry;
+}
+
+// Write size bytes to path through a temporary file of dir, so that readers
+// only ever see whole files
+int cache_write(const char *dir, const char *path, const void *data, size_t size) {
+    char tmp[4096];
+    int fd;
+
+    snprintf(tmp, sizeof(tmp), "%s/.tmp-XXXXXX", dir);
+    if ((fd = mkstemp(tmp)) < 0)
+        return -1;
+
+    size_t left = size;
+    while (left > 0) {
+        ssize_t n = write(fd, data, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            close(fd);
+            unlink(tmp);
+            return -1;
+        }
+        data = (const char*)data + n;
+        left -= n;
+    }
+
+    if (close(fd) < 0 || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int cache_store(const char *dir, Cache_entry *entry, size_t size) {
+    char path[4096];
+    struct stat st = { 0 };
+
+    st.st_dev = entry->dev;
+    st.st_ino = entry->ino;
+    entry_path(path, sizeof(path), dir, &st);
+    if (cache_write(dir, path, entry, size) < 0)
+        return -1;
+
+    if (entry->build_id_len > 0) {
+        build_id_path(path, sizeof(path), dir, entry->build_id, entry->build_id_len);
+        if (cache_write(dir, path, entry, size) < 0)
+            return -1;
+    }
+
+    return 0;
+}
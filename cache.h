@@ -0,0 +1,57 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "elf.h"
+
+// On-disk cache of file summaries. Each file has an entry named after its
+// device and inode, valid as long as its size and mtime did not change.
+// Entries with a build-id are also stored under it, so the summary of a
+// binary can be found from a build-id alone.
+
+#define CACHE_MAGIC "ALFURC2"
+
+// Values for flags
+#define CACHE_NOT_ELF 0x1
+
+#define CACHE_BUILD_ID_MAX 64
+
+// Entry, mapped as is. Followed by phnum Elf64_Phdr, shnum Elf64_Shdr, the
+// section names string table and the path of the file.
+typedef struct {
+    char magic[8];
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t flags;
+    uint32_t build_id_len;
+    uint8_t build_id[CACHE_BUILD_ID_MAX];
+    Elf64_Ehdr header;
+    uint16_t phnum;
+    uint16_t shnum;
+    uint32_t names_size;
+    uint32_t path_size;
+    uint32_t reserved;
+    uint64_t symbols;         // Entries of the SYMTAB sections
+    uint64_t dynamic_symbols; // Entries of the DYNSYM sections
+} Cache_entry;
+
+#define CACHE_PHDRS(entry) ((Elf64_Phdr*)((entry) + 1))
+#define CACHE_SHDRS(entry) ((Elf64_Shdr*)(CACHE_PHDRS(entry) + (entry)->phnum))
+#define CACHE_NAMES(entry) ((char*)(CACHE_SHDRS(entry) + (entry)->shnum))
+#define CACHE_PATH(entry)  (CACHE_NAMES(entry) + (entry)->names_size)
+
+int cache_open(const char *dir);
+Cache_entry *cache_load(const char *dir, struct stat *st, size_t *size);
+Cache_entry *cache_load_build_id(const char *dir, const uint8_t *id, uint32_t len, size_t *size);
+void cache_release(Cache_entry *entry, size_t size);
+Cache_entry *cache_build(Elf64_data *file, const char *path, struct stat *st, size_t *size);
+int cache_store(const char *dir, Cache_entry *entry, size_t size);
+int cache_write(const char *dir, const char *path, const void *data, size_t size);
+
+#endif
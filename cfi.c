@@ -0,0 +1,815 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfi.h"
+#include "dwarf.h"
+#include "elf.h"
+#include "output.h"
+
+// Instructions of call frames, the high two bits or the whole byte
+#define DW_CFA_advance_loc        0x40
+#define DW_CFA_offset             0x80
+#define DW_CFA_restore            0xc0
+#define DW_CFA_nop                0x00
+#define DW_CFA_set_loc            0x01
+#define DW_CFA_advance_loc1       0x02
+#define DW_CFA_advance_loc2       0x03
+#define DW_CFA_advance_loc4       0x04
+#define DW_CFA_offset_extended    0x05
+#define DW_CFA_restore_extended   0x06
+#define DW_CFA_undefined          0x07
+#define DW_CFA_same_value         0x08
+#define DW_CFA_register           0x09
+#define DW_CFA_remember_state     0x0a
+#define DW_CFA_restore_state      0x0b
+#define DW_CFA_def_cfa            0x0c
+#define DW_CFA_def_cfa_register   0x0d
+#define DW_CFA_def_cfa_offset     0x0e
+#define DW_CFA_def_cfa_expression 0x0f
+#define DW_CFA_expression         0x10
+#define DW_CFA_offset_extended_sf 0x11
+#define DW_CFA_def_cfa_sf         0x12
+#define DW_CFA_def_cfa_offset_sf  0x13
+#define DW_CFA_val_offset         0x14
+#define DW_CFA_val_offset_sf      0x15
+#define DW_CFA_val_expression     0x16
+#define DW_CFA_GNU_window_save    0x2d // DW_CFA_AARCH64_negate_ra_state on AArch64
+#define DW_CFA_GNU_args_size      0x2e
+#define DW_CFA_GNU_negative_offset_extended 0x2f
+
+// Address of what c reads in .eh_frame_hdr (in_hdr set) or .eh_frame
+static uint64_t cursor_address(Cfi_table *table, Dwarf_cursor *c, int in_hdr) {
+    if (in_hdr)
+        return table->hdr_addr + (c->p - table->hdr);
+    return table->frame_addr + (c->p - table->frame);
+}
+
+// Pointer in encoding enc, read from .eh_frame_hdr (in_hdr set) or
+// .eh_frame. Values relative to the text or the GOT cannot be resolved
+// without them and are left as is. Returns -1 if the encoding is unknown.
+static int read_encoded(Cfi_table *table, Dwarf_cursor *c, int in_hdr, int enc, uint64_t *value) {
+    uint64_t address = cursor_address(table, c, in_hdr);
+
+    if ((enc & 0x70) == DW_EH_PE_aligned) {
+        uint64_t align = table->address_size;
+
+        dwarf_skip(c, (align - address % align) % align);
+        address = cursor_address(table, c, in_hdr);
+    }
+
+    switch (enc & 0x0f) {
+        case DW_EH_PE_absptr:  *value = dwarf_sized(c, table->address_size); break;
+        case DW_EH_PE_uleb128: *value = dwarf_uleb(c); break;
+        case DW_EH_PE_udata2:  *value = dwarf_u16(c); break;
+        case DW_EH_PE_udata4:  *value = dwarf_u32(c); break;
+        case DW_EH_PE_udata8:  *value = dwarf_u64(c); break;
+        case DW_EH_PE_sleb128: *value = dwarf_sleb(c); break;
+        case DW_EH_PE_sdata2:  *value = (int16_t)dwarf_u16(c); break;
+        case DW_EH_PE_sdata4:  *value = (int32_t)dwarf_u32(c); break;
+        case DW_EH_PE_sdata8:  *value = dwarf_u64(c); break;
+        default:
+            c->error = 1;
+            return -1;
+    }
+
+    switch (enc & 0x70) {
+        case DW_EH_PE_absptr:
+        case DW_EH_PE_aligned:
+        case DW_EH_PE_textrel:
+        case DW_EH_PE_funcrel:
+            break;
+        case DW_EH_PE_pcrel:
+            *value += address;
+            break;
+        case DW_EH_PE_datarel:
+            // Relative to the header in it, to the GOT in .eh_frame
+            if (in_hdr)
+                *value += table->hdr_addr;
+            break;
+        default:
+            c->error = 1;
+            return -1;
+    }
+    if (table->address_size == 4)
+        *value &= 0xffffffff;
+
+    return c->error ? -1 : 0;
+}
+
+// Bytes of a loaded segment from address, to its end
+static const uint8_t *segment_data(Elf64_data *file, uint64_t address, uint64_t *size) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        if (segment->p_type != PT_LOAD || address < segment->p_vaddr
+            || address - segment->p_vaddr >= segment->p_filesz)
+            continue;
+        *size = segment->p_filesz - (address - segment->p_vaddr);
+        return (const uint8_t*)elf_fetch(file, segment->p_offset + (address - segment->p_vaddr), *size);
+    }
+
+    return NULL;
+}
+
+static Elf64_Shdr *find_section(Elf64_data *file, const char *name) {
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++)
+        if (section->sh_type != SHT_NOBITS && strcmp(elf_section_name(file, section), name) == 0)
+            return section;
+    return NULL;
+}
+
+// Size of a pair of the search table, 0 if its entries are not all the same size
+static int entry_size(int enc, int address_size) {
+    if ((enc & 0x70) != DW_EH_PE_absptr && (enc & 0x70) != DW_EH_PE_datarel)
+        return 0;
+    switch (enc & 0x0f) {
+        case DW_EH_PE_absptr: return 2 * address_size;
+        case DW_EH_PE_udata2: case DW_EH_PE_sdata2: return 4;
+        case DW_EH_PE_udata4: case DW_EH_PE_sdata4: return 8;
+        case DW_EH_PE_udata8: case DW_EH_PE_sdata8: return 16;
+        default: return 0;
+    }
+}
+
+// Sections of the call frames, and the search table of .eh_frame_hdr if it
+// has a usable one. Returns -1 if the file has no .eh_frame.
+int cfi_open(Cfi_table *table, Elf64_data *file) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    Elf64_Shdr *section;
+
+    memset(table, 0, sizeof(Cfi_table));
+    table->file = file;
+    table->address_size = file->elf_head->e_ident[EI_CLASS] == ELFCLASS32 ? 4 : 8;
+
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        if (segment->p_type == PT_GNU_EH_FRAME) {
+            table->hdr = (const uint8_t*)elf_fetch(file, segment->p_offset, segment->p_filesz);
+            table->hdr_size = segment->p_filesz;
+            table->hdr_addr = segment->p_vaddr;
+            break;
+        }
+    }
+    if (table->hdr == NULL && (section = find_section(file, ".eh_frame_hdr")) != NULL) {
+        table->hdr = (const uint8_t*)elf_section_data(file, section);
+        table->hdr_size = section->sh_size;
+        table->hdr_addr = section->sh_addr;
+    }
+    if ((section = find_section(file, ".eh_frame")) != NULL) {
+        table->frame = (const uint8_t*)elf_section_data(file, section);
+        table->frame_size = section->sh_size;
+        table->frame_addr = section->sh_addr;
+    }
+
+    if (table->hdr != NULL) {
+        Dwarf_cursor c = { file, table->hdr, table->hdr + table->hdr_size, 0 };
+        uint64_t frame_addr, count = 0;
+        int version = dwarf_u8(&c);
+        int frame_enc = dwarf_u8(&c);
+        int count_enc = dwarf_u8(&c);
+        int table_enc = dwarf_u8(&c);
+
+        if (version != 1 || frame_enc == DW_EH_PE_omit || read_encoded(table, &c, 1, frame_enc, &frame_addr) < 0) {
+            table->hdr = NULL;
+        } else {
+            if (table->frame == NULL) {
+                table->frame = segment_data(file, frame_addr, &table->frame_size);
+                table->frame_addr = frame_addr;
+            }
+            if (count_enc != DW_EH_PE_omit && table_enc != DW_EH_PE_omit
+                && read_encoded(table, &c, 1, count_enc, &count) == 0
+                && (table->entry_size = entry_size(table_enc, table->address_size)) != 0
+                && count <= (uint64_t)(c.end - c.p) / table->entry_size) {
+                table->table = c.p;
+                table->count = count;
+                table->table_enc = table_enc;
+            }
+        }
+    }
+
+    return table->frame == NULL ? -1 : 0;
+}
+
+// What an FDE takes from its CIE, at offset of .eh_frame
+static int decode_cie(Cfi_table *table, uint64_t offset, Cfi_fde *fde) {
+    Dwarf_cursor c = { table->file, table->frame + offset, table->frame + table->frame_size, 0 };
+    const uint8_t *end;
+    int offset_size;
+
+    fde->cie = offset;
+    if (dwarf_unit_length(&c, &offset_size, &end) < 0 || dwarf_u32(&c) != 0)
+        return -1;
+    c.end = end;
+
+    int version = dwarf_u8(&c);
+    const char *augmentation = dwarf_string(&c);
+
+    if ((version != 1 && version != 3 && version != 4) || augmentation == NULL)
+        return -1;
+    fde->augmentation = augmentation;
+    if (strncmp(augmentation, "eh", 2) == 0)
+        dwarf_skip(&c, table->address_size);
+    if (version == 4) {
+        // Address and segment selector sizes
+        if (dwarf_u8(&c) != table->address_size || dwarf_u8(&c) != 0)
+            return -1;
+    }
+    fde->code_align = dwarf_uleb(&c);
+    fde->data_align = dwarf_sleb(&c);
+    fde->ra = version == 1 ? dwarf_u8(&c) : dwarf_uleb(&c);
+    fde->fde_enc = DW_EH_PE_absptr;
+    fde->lsda_enc = fde->personality_enc = DW_EH_PE_omit;
+    fde->signal = 0;
+
+    if (augmentation[0] == 'z') {
+        uint64_t length = dwarf_uleb(&c);
+        Dwarf_cursor data = c;
+
+        if (!dwarf_has(&c, length))
+            return -1;
+        data.end = c.p + length;
+        for (const char *a = augmentation + 1; *a != 0 && !data.error; a++) {
+            if (*a == 'L') {
+                fde->lsda_enc = dwarf_u8(&data);
+            } else if (*a == 'P') {
+                fde->personality_enc = dwarf_u8(&data);
+                read_encoded(table, &data, 0, fde->personality_enc & 0x7f, &fde->personality);
+            } else if (*a == 'R') {
+                fde->fde_enc = dwarf_u8(&data);
+            } else if (*a == 'S') {
+                fde->signal = 1;
+            } else if (*a != 'B' && *a != 'G') {
+                break; // Unknown, the length still gives the instructions
+            }
+        }
+        if (data.error)
+            return -1;
+        c.p = data.end;
+    } else if (augmentation[0] != 0 && strcmp(augmentation, "eh") != 0) {
+        return -1;
+    }
+
+    fde->initial = c.p;
+    fde->initial_end = end;
+    return c.error ? -1 : 0;
+}
+
+// Decode the record at offset of .eh_frame, and give where the next one is.
+// Returns 1 for an FDE, 0 for a CIE or the terminator (next is then the end),
+// -1 if the record is malformed.
+int cfi_decode(Cfi_table *table, uint64_t offset, Cfi_fde *fde, uint64_t *next) {
+    Dwarf_cursor c = { table->file, table->frame + offset, table->frame + table->frame_size, 0 };
+    const uint8_t *end;
+    int offset_size;
+
+    if (offset >= table->frame_size || dwarf_unit_length(&c, &offset_size, &end) < 0)
+        return -1;
+    if (end == c.p) {
+        *next = table->frame_size;
+        return 0;
+    }
+    *next = end - table->frame;
+    c.end = end;
+
+    uint64_t pointer_at = c.p - table->frame;
+    uint64_t pointer = dwarf_u32(&c);
+
+    if (c.error)
+        return -1;
+    if (pointer == 0)
+        return 0;
+    if (pointer > pointer_at || decode_cie(table, pointer_at - pointer, fde) < 0)
+        return -1;
+
+    uint64_t range;
+
+    fde->offset = offset;
+    if (read_encoded(table, &c, 0, fde->fde_enc, &fde->start) < 0
+        || read_encoded(table, &c, 0, fde->fde_enc & 0x0f, &range) < 0)
+        return -1;
+    fde->end = fde->start + range;
+    fde->lsda = 0;
+    if (fde->augmentation[0] == 'z') {
+        uint64_t length = dwarf_uleb(&c);
+        Dwarf_cursor data = c;
+
+        if (!dwarf_has(&c, length))
+            return -1;
+        data.end = c.p + length;
+        if (fde->lsda_enc != DW_EH_PE_omit)
+            read_encoded(table, &data, 0, fde->lsda_enc & 0x7f, &fde->lsda);
+        c.p = data.end;
+    }
+    fde->instructions = c.p;
+    fde->instructions_end = end;
+    return c.error ? -1 : 1;
+}
+
+// Start address of entry i of the search table, and the FDE it points to
+static uint64_t table_entry(Cfi_table *table, uint64_t i, uint64_t *fde_addr) {
+    const uint8_t *entry = table->table + i * table->entry_size;
+    Dwarf_cursor c = { table->file, entry, entry + table->entry_size, 0 };
+    uint64_t start;
+
+    read_encoded(table, &c, 1, table->table_enc, &start);
+    read_encoded(table, &c, 1, table->table_enc, fde_addr);
+    return start;
+}
+
+// FDE covering address. Returns -1 if there is none.
+int cfi_find(Cfi_table *table, uint64_t address, Cfi_fde *fde) {
+    uint64_t offset, next;
+
+    if (table->table == NULL) {
+        // No search table, every record is tried
+        for (offset = 0; offset < table->frame_size; offset = next) {
+            int kind = cfi_decode(table, offset, fde, &next);
+
+            if (kind < 0)
+                return -1;
+            if (kind == 1 && fde->start <= address && address < fde->end)
+                return 0;
+        }
+        return -1;
+    }
+
+    // Last entry starting at or before address
+    uint64_t low = 0, high = table->count, fde_addr;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+
+        if (table_entry(table, mid, &fde_addr) <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return -1;
+    table_entry(table, low - 1, &fde_addr);
+
+    offset = fde_addr - table->frame_addr;
+    if (fde_addr < table->frame_addr || offset >= table->frame_size)
+        return -1;
+    if (cfi_decode(table, offset, fde, &next) != 1 || address < fde->start || address >= fde->end)
+        return -1;
+    return 0;
+}
+
+static int set_rule(Cfi_state *state, uint64_t reg, int kind, int64_t value) {
+    if (reg >= CFI_REGS)
+        return -1;
+    state->regs[reg] = (Cfi_rule){ kind, 0, value };
+    return 0;
+}
+
+// Run instructions of a CIE (initial NULL) or an FDE until they move past
+// address. Returns -1 if they are malformed or need more registers or
+// remembered states than kept.
+static int execute(Cfi_table *table, Cfi_fde *fde, const uint8_t *p, const uint8_t *end, uint64_t address,
+                   Cfi_state *state, const Cfi_state *initial) {
+    Dwarf_cursor c = { table->file, p, end, 0 };
+    Cfi_state stack[CFI_STACK];
+    int depth = 0, status = 0;
+
+    while (c.p < c.end && !c.error && status == 0) {
+        int op = dwarf_u8(&c);
+        uint64_t reg, location = state->location, value;
+        int64_t offset;
+
+        if (op & 0xc0) {
+            switch (op & 0xc0) {
+                case DW_CFA_advance_loc:
+                    location += (op & 0x3f) * fde->code_align;
+                    break;
+                case DW_CFA_offset:
+                    status = set_rule(state, op & 0x3f, CFI_OFFSET, dwarf_uleb(&c) * fde->data_align);
+                    break;
+                case DW_CFA_restore:
+                    reg = op & 0x3f;
+                    if (initial == NULL)
+                        status = -1;
+                    else
+                        state->regs[reg] = initial->regs[reg];
+                    break;
+            }
+            op = -1; // Operand in the opcode, done
+        }
+
+        switch (op) {
+            case -1:
+            case DW_CFA_nop:
+                break;
+            case DW_CFA_set_loc:
+                if (read_encoded(table, &c, 0, fde->fde_enc, &value) < 0)
+                    return -1;
+                location = value;
+                break;
+            case DW_CFA_advance_loc1:
+                location += dwarf_u8(&c) * fde->code_align;
+                break;
+            case DW_CFA_advance_loc2:
+                location += dwarf_u16(&c) * fde->code_align;
+                break;
+            case DW_CFA_advance_loc4:
+                location += dwarf_u32(&c) * fde->code_align;
+                break;
+            case DW_CFA_offset_extended:
+                reg = dwarf_uleb(&c);
+                status = set_rule(state, reg, CFI_OFFSET, dwarf_uleb(&c) * fde->data_align);
+                break;
+            case DW_CFA_offset_extended_sf:
+                reg = dwarf_uleb(&c);
+                status = set_rule(state, reg, CFI_OFFSET, dwarf_sleb(&c) * fde->data_align);
+                break;
+            case DW_CFA_GNU_negative_offset_extended:
+                reg = dwarf_uleb(&c);
+                status = set_rule(state, reg, CFI_OFFSET, -(int64_t)dwarf_uleb(&c) * fde->data_align);
+                break;
+            case DW_CFA_val_offset:
+                reg = dwarf_uleb(&c);
+                status = set_rule(state, reg, CFI_VAL_OFFSET, dwarf_uleb(&c) * fde->data_align);
+                break;
+            case DW_CFA_val_offset_sf:
+                reg = dwarf_uleb(&c);
+                status = set_rule(state, reg, CFI_VAL_OFFSET, dwarf_sleb(&c) * fde->data_align);
+                break;
+            case DW_CFA_restore_extended:
+                reg = dwarf_uleb(&c);
+                if (initial == NULL || reg >= CFI_REGS)
+                    status = -1;
+                else
+                    state->regs[reg] = initial->regs[reg];
+                break;
+            case DW_CFA_undefined:
+                status = set_rule(state, dwarf_uleb(&c), CFI_UNDEFINED, 0);
+                break;
+            case DW_CFA_same_value:
+                status = set_rule(state, dwarf_uleb(&c), CFI_SAME, 0);
+                break;
+            case DW_CFA_register:
+                reg = dwarf_uleb(&c);
+                value = dwarf_uleb(&c);
+                if ((status = set_rule(state, reg, CFI_REGISTER, 0)) == 0)
+                    state->regs[reg].reg = value;
+                break;
+            case DW_CFA_remember_state:
+                if (depth == CFI_STACK)
+                    return -1;
+                stack[depth++] = *state;
+                break;
+            case DW_CFA_restore_state:
+                if (depth == 0)
+                    return -1;
+                *state = stack[--depth];
+                state->location = location;
+                break;
+            case DW_CFA_def_cfa:
+                reg = dwarf_uleb(&c);
+                state->cfa = (Cfi_rule){ CFI_CFA_REGISTER, reg, dwarf_uleb(&c) };
+                break;
+            case DW_CFA_def_cfa_sf:
+                reg = dwarf_uleb(&c);
+                state->cfa = (Cfi_rule){ CFI_CFA_REGISTER, reg, dwarf_sleb(&c) * fde->data_align };
+                break;
+            case DW_CFA_def_cfa_register:
+                state->cfa.kind = CFI_CFA_REGISTER;
+                state->cfa.reg = dwarf_uleb(&c);
+                break;
+            case DW_CFA_def_cfa_offset:
+                state->cfa.value = dwarf_uleb(&c);
+                break;
+            case DW_CFA_def_cfa_offset_sf:
+                state->cfa.value = dwarf_sleb(&c) * fde->data_align;
+                break;
+            case DW_CFA_def_cfa_expression:
+                state->cfa = (Cfi_rule){ CFI_CFA_EXPRESSION, 0, c.p - table->frame };
+                dwarf_skip(&c, dwarf_uleb(&c));
+                break;
+            case DW_CFA_expression:
+            case DW_CFA_val_expression:
+                reg = dwarf_uleb(&c);
+                offset = c.p - table->frame;
+                status = set_rule(state, reg, op == DW_CFA_expression ? CFI_EXPRESSION : CFI_VAL_EXPRESSION, offset);
+                dwarf_skip(&c, dwarf_uleb(&c));
+                break;
+            case DW_CFA_GNU_window_save:
+                if (table->file->elf_head->e_machine != EM_ARM64)
+                    return -1;
+                state->ra_signed ^= 1;
+                break;
+            case DW_CFA_GNU_args_size:
+                dwarf_uleb(&c);
+                break;
+            default:
+                return -1;
+        }
+
+        if (location != state->location) {
+            if (location > address)
+                return 0;
+            state->location = location;
+        }
+    }
+
+    return c.error ? -1 : status;
+}
+
+// Rules of the registers at address, which fde covers. Returns -1 if its
+// instructions cannot be run.
+int cfi_run(Cfi_table *table, Cfi_fde *fde, uint64_t address, Cfi_state *state) {
+    Cfi_state initial;
+
+    memset(state, 0, sizeof(Cfi_state));
+    state->location = fde->start;
+    if (execute(table, fde, fde->initial, fde->initial_end, address, state, NULL) < 0)
+        return -1;
+    initial = *state;
+    return execute(table, fde, fde->instructions, fde->instructions_end, address, state, &initial);
+}
+
+// DWARF name of a register
+static const char *register_name(uint16_t machine, uint64_t reg) {
+    static const char *x86_64[] = {
+        "rax", "rdx", "rcx", "rbx", "rsi", "rdi", "rbp", "rsp",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rip"
+    };
+    static const char *x86[] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "eip" };
+    static _Thread_local char s[16];
+
+    switch (machine) {
+        case EM_X86_64:
+            if (reg < 17)
+                return x86_64[reg];
+            if (reg < 33) {
+                snprintf(s, sizeof(s), "xmm%lu", reg - 17);
+                return s;
+            }
+            break;
+        case EM_X86:
+            if (reg < 9)
+                return x86[reg];
+            break;
+        case EM_ARM64:
+            if (reg == 31)
+                return "sp";
+            if (reg < 31 || (reg >= 64 && reg < 96)) {
+                snprintf(s, sizeof(s), reg < 31 ? "x%lu" : "v%lu", reg < 31 ? reg : reg - 64);
+                return s;
+            }
+            break;
+    }
+    snprintf(s, sizeof(s), "r%lu", reg);
+    return s;
+}
+
+// Bytes of the expression at offset of .eh_frame
+static void print_expression(Output *out, Cfi_table *table, int64_t offset) {
+    Dwarf_cursor c = { table->file, table->frame + offset, table->frame + table->frame_size, 0 };
+    uint64_t length = dwarf_uleb(&c);
+
+    out_str(out, "expression");
+    for (uint64_t i = 0; i < length && dwarf_has(&c, 1); i++)
+        out_printf(out, " %02lx", dwarf_u8(&c));
+}
+
+static void print_rule(Output *out, Cfi_table *table, Cfi_rule *rule) {
+    uint16_t machine = table->file->elf_head->e_machine;
+
+    switch (rule->kind) {
+        case CFI_UNDEFINED:      out_str(out, "undefined"); break;
+        case CFI_SAME:           out_str(out, "same value"); break;
+        case CFI_OFFSET:         out_printf(out, "at CFA%+ld", rule->value); break;
+        case CFI_VAL_OFFSET:     out_printf(out, "CFA%+ld", rule->value); break;
+        case CFI_REGISTER:       out_printf(out, "in %s", register_name(machine, rule->reg)); break;
+        case CFI_EXPRESSION:     out_str(out, "at "); print_expression(out, table, rule->value); break;
+        case CFI_VAL_EXPRESSION: print_expression(out, table, rule->value); break;
+    }
+}
+
+// Print the FDE covering address and the rules of the registers there
+int display_cfi(Elf64_data *file, const char *arg) {
+    Output *out = file->out;
+    uint16_t machine = file->elf_head->e_machine;
+    Cfi_table table;
+    Cfi_state state;
+    Cfi_fde fde;
+    char *end;
+    uint64_t address = strtoull(arg, &end, 16);
+
+    if (*arg == 0 || *end != 0) {
+        fprintf(stderr, "%s: Not a hexadecimal address\n", arg);
+        return -1;
+    }
+    if (file->elf_head->e_type == ET_REL) {
+        fprintf(stderr, "Relocatable file, .eh_frame is not relocated\n");
+        return -1;
+    }
+    if (cfi_open(&table, file) < 0) {
+        fprintf(stderr, "No .eh_frame\n");
+        return -1;
+    }
+    if (cfi_find(&table, address, &fde) < 0) {
+        fprintf(stderr, "No FDE covers 0x%lx\n", address);
+        return -1;
+    }
+
+    out_printf(out, "FDE at 0x%lx for 0x%lx..0x%lx, CIE at 0x%lx%s\n", table.frame_addr + fde.offset,
+               fde.start, fde.end, table.frame_addr + fde.cie,
+               table.table != NULL ? "" : ", found without .eh_frame_hdr");
+    out_printf(out, "  Augmentation \"%s\", code alignment %lu, data alignment %ld, return address %s\n",
+               fde.augmentation, fde.code_align, fde.data_align, register_name(machine, fde.ra));
+    if (fde.personality_enc != DW_EH_PE_omit)
+        out_printf(out, "  Personality %s0x%lx\n", fde.personality_enc & DW_EH_PE_indirect ? "at " : "",
+                   fde.personality);
+    if (fde.lsda_enc != DW_EH_PE_omit && fde.lsda != 0)
+        out_printf(out, "  LSDA 0x%lx\n", fde.lsda);
+    if (fde.signal)
+        out_str(out, "  Signal frame\n");
+
+    if (cfi_run(&table, &fde, address, &state) < 0) {
+        fprintf(stderr, "Malformed call frame instructions in FDE at 0x%lx\n", table.frame_addr + fde.offset);
+        return -1;
+    }
+
+    out_printf(out, "\nRules at 0x%lx, from 0x%lx\n", address, state.location);
+    out_str(out, "  CFA    ");
+    if (state.cfa.kind == CFI_CFA_REGISTER)
+        out_printf(out, "%s%+ld", register_name(machine, state.cfa.reg), state.cfa.value);
+    else if (state.cfa.kind == CFI_CFA_EXPRESSION)
+        print_expression(out, &table, state.cfa.value);
+    else
+        out_str(out, "undefined");
+    out_char(out, '\n');
+
+    for (uint64_t reg = 0; reg < CFI_REGS; reg++) {
+        if (state.regs[reg].kind == CFI_UNSPECIFIED)
+            continue;
+        out_printf(out, "  %-6s ", register_name(machine, reg));
+        print_rule(out, &table, &state.regs[reg]);
+        out_char(out, '\n');
+    }
+    if (state.ra_signed)
+        out_str(out, "  Return address signed\n");
+
+    return 0;
+}
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    const char *name;
+} Cfi_function;
+
+static int compare_functions(const void *a, const void *b) {
+    const Cfi_function *x = a, *y = b;
+
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+// Functions of SYMTAB, or DYNSYM without it, one per address, sorted
+static Cfi_function *collect_functions(Elf64_data *file, uint64_t *count) {
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead, *symbols = NULL;
+    Cfi_function *functions;
+    Elf64_Sym *s;
+    char *names;
+    uint64_t n = 0;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++)
+        if (section->sh_type == SHT_SYMTAB || (section->sh_type == SHT_DYNSYM && symbols == NULL))
+            symbols = section;
+
+    *count = 0;
+    uint64_t names_size;
+    uint64_t sym_num = symbols != NULL ? elf_symbols(file, symbols, &s, &names, &names_size) : 0;
+    if ((functions = malloc((sym_num ? sym_num : 1) * sizeof(Cfi_function))) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+
+    for (uint64_t i = 0; i < sym_num; i++, s++) {
+        uint8_t type = ELF64_ST_TYPE(s->st_info);
+
+        if ((type == STT_FUNC || type == STT_GNU_IFUNC) && s->st_size > 0
+            && s->st_shndx != SHN_UNDEF && s->st_shndx != SHN_ABS)
+            functions[n++] = (Cfi_function){ s->st_value, s->st_value + s->st_size, elf_string(names, names_size, s->st_name) };
+    }
+    qsort(functions, n, sizeof(Cfi_function), compare_functions);
+
+    for (uint64_t i = 0; i < n; i++)
+        if (*count == 0 || functions[*count - 1].start != functions[i].start)
+            functions[(*count)++] = functions[i];
+    return functions;
+}
+
+// Check that every record of .eh_frame decodes and the instructions of every
+// FDE run, then the search table against them. Returns the problems found.
+static uint64_t check_table(Cfi_table *table, Output *out) {
+    uint64_t problems = 0, fdes = 0, offset, next, previous_end = 0;
+    Cfi_fde fde;
+
+    for (offset = 0; offset < table->frame_size; offset = next) {
+        Cfi_state state;
+        int kind = cfi_decode(table, offset, &fde, &next);
+
+        if (kind < 0) {
+            out_printf(out, "Malformed record at 0x%lx of .eh_frame\n", table->frame_addr + offset);
+            return problems + 1;
+        }
+        if (kind == 0)
+            continue;
+        fdes++;
+        if (cfi_run(table, &fde, fde.end, &state) < 0) {
+            out_printf(out, "FDE at 0x%lx: malformed call frame instructions\n", table->frame_addr + offset);
+            problems++;
+        }
+    }
+
+    if (table->hdr == NULL && fdes == 0)
+        return problems;
+    if (table->hdr == NULL) {
+        out_str(out, "No .eh_frame_hdr, lookups walk .eh_frame\n");
+        return problems + 1;
+    }
+    if (table->table == NULL) {
+        out_str(out, "No usable search table in .eh_frame_hdr, lookups walk .eh_frame\n");
+        return problems + 1;
+    }
+    if (table->count != fdes) {
+        out_printf(out, "Search table has %lu entries, .eh_frame %lu FDEs\n", table->count, fdes);
+        problems++;
+    }
+
+    for (uint64_t i = 0; i < table->count; i++) {
+        uint64_t fde_addr, start = table_entry(table, i, &fde_addr);
+
+        offset = fde_addr - table->frame_addr;
+        if (i > 0 && start <= table_entry(table, i - 1, &next)) {
+            out_printf(out, "Search table not sorted at entry %lu\n", i);
+            problems++;
+        }
+        if (fde_addr < table->frame_addr || offset >= table->frame_size
+            || cfi_decode(table, offset, &fde, &next) != 1) {
+            out_printf(out, "Search table entry %lu: no FDE at 0x%lx\n", i, fde_addr);
+            problems++;
+            continue;
+        }
+        if (fde.start != start) {
+            out_printf(out, "Search table entry %lu: FDE at 0x%lx is for 0x%lx, not 0x%lx\n", i, fde_addr,
+                       fde.start, start);
+            problems++;
+        }
+        if (i > 0 && fde.start < previous_end) {
+            out_printf(out, "FDE at 0x%lx for 0x%lx overlaps the one before, up to 0x%lx\n", fde_addr,
+                       fde.start, previous_end);
+            problems++;
+        }
+        previous_end = fde.end;
+    }
+
+    return problems;
+}
+
+// Check the unwind information of a file, printing what is wrong
+void check_cfi(Elf64_data *file, const char *elf_path) {
+    Output *out = file->out;
+    Cfi_table table;
+    Cfi_fde fde;
+    uint64_t count, missing = 0, problems = 0;
+    Cfi_function *functions;
+
+    out_printf(out, "== Unwind information of %s ==\n\n", elf_path);
+
+    if (file->elf_head->e_type == ET_REL) {
+        out_str(out, "Relocatable file, .eh_frame is not relocated\n\n");
+        return;
+    }
+
+    functions = collect_functions(file, &count);
+    if (cfi_open(&table, file) < 0) {
+        out_printf(out, "No .eh_frame, %lu functions without unwind information\n\n", count);
+        free(functions);
+        return;
+    }
+    problems = check_table(&table, out);
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t address = functions[i].start;
+
+        // A function may be split over several FDEs, they must follow each other
+        while (address < functions[i].end && cfi_find(&table, address, &fde) == 0 && fde.end > address)
+            address = fde.end;
+        if (address == functions[i].start) {
+            out_printf(out, "%s at 0x%lx: no FDE\n", functions[i].name, address);
+            missing++;
+        } else if (address < functions[i].end) {
+            out_printf(out, "%s at 0x%lx: no FDE from 0x%lx\n", functions[i].name, functions[i].start, address);
+            missing++;
+        }
+    }
+
+    out_printf(out, "%lu functions, %lu without full unwind information, %lu other problems\n\n",
+               count, missing, problems);
+    free(functions);
+}
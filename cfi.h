@@ -0,0 +1,109 @@
+#ifndef CFI_H
+#define CFI_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Call frame information of .eh_frame, for --cfi and --check-cfi.
+//
+// .eh_frame_hdr, found through PT_GNU_EH_FRAME, holds the start address of
+// every FDE sorted by address: finding the FDE of an address is a binary
+// search in it, then the FDE and its CIE are decoded in place and their
+// instructions run up to the address into a state given by the caller.
+// Nothing is allocated once the table is open, so an unwinder can call
+// cfi_find and cfi_run for every frame. Without the search table
+// (relocatable files, linkers that do not write it) .eh_frame is walked.
+
+// Pointer encodings of .eh_frame
+#define DW_EH_PE_absptr  0x00
+#define DW_EH_PE_uleb128 0x01
+#define DW_EH_PE_udata2  0x02
+#define DW_EH_PE_udata4  0x03
+#define DW_EH_PE_udata8  0x04
+#define DW_EH_PE_sleb128 0x09
+#define DW_EH_PE_sdata2  0x0a
+#define DW_EH_PE_sdata4  0x0b
+#define DW_EH_PE_sdata8  0x0c
+#define DW_EH_PE_pcrel   0x10
+#define DW_EH_PE_textrel 0x20
+#define DW_EH_PE_datarel 0x30
+#define DW_EH_PE_funcrel 0x40
+#define DW_EH_PE_aligned 0x50
+#define DW_EH_PE_indirect 0x80
+#define DW_EH_PE_omit    0xff
+
+typedef struct {
+    Elf64_data *file;
+    const uint8_t *frame;  // .eh_frame
+    uint64_t frame_size;
+    uint64_t frame_addr;
+    const uint8_t *hdr;    // .eh_frame_hdr, NULL if none
+    uint64_t hdr_size;
+    uint64_t hdr_addr;
+    const uint8_t *table;  // Search table of the header, NULL if unusable
+    uint64_t count;
+    int table_enc;
+    int entry_size;        // Of a pair of the table
+    int address_size;
+} Cfi_table;
+
+// An FDE with what it takes from its CIE
+typedef struct {
+    uint64_t offset;       // In .eh_frame
+    uint64_t cie;
+    uint64_t start;
+    uint64_t end;
+    const char *augmentation;
+    uint64_t code_align;
+    int64_t data_align;
+    uint64_t ra;           // Register of the return address
+    int fde_enc;
+    int lsda_enc;
+    int personality_enc;
+    uint64_t personality;
+    uint64_t lsda;
+    int signal;            // Frame of a signal handler
+    const uint8_t *initial, *initial_end;           // Instructions of the CIE
+    const uint8_t *instructions, *instructions_end;
+} Cfi_fde;
+
+// Rules of the registers
+#define CFI_UNSPECIFIED  0
+#define CFI_UNDEFINED    1
+#define CFI_SAME         2
+#define CFI_OFFSET       3 // Saved at CFA+value
+#define CFI_VAL_OFFSET   4 // Is CFA+value
+#define CFI_REGISTER     5 // Saved in register reg
+#define CFI_EXPRESSION   6 // Saved at the address the expression at value gives
+#define CFI_VAL_EXPRESSION 7
+
+// Rules of the CFA
+#define CFI_CFA_REGISTER   1 // reg+value
+#define CFI_CFA_EXPRESSION 2
+
+#define CFI_REGS  96 // x86-64 up to the XMM registers, AArch64 up to V31
+#define CFI_STACK 4  // Depth of DW_CFA_remember_state
+
+typedef struct {
+    uint8_t kind;
+    uint32_t reg;          // Of CFI_REGISTER and CFI_CFA_REGISTER
+    int64_t value;         // Offset, or offset of the expression in .eh_frame
+} Cfi_rule;
+
+typedef struct {
+    uint64_t location;     // First address the rules are for
+    Cfi_rule cfa;
+    Cfi_rule regs[CFI_REGS];
+    int ra_signed;         // AArch64 return address signed, DW_CFA_AARCH64_negate_ra_state
+} Cfi_state;
+
+int cfi_open(Cfi_table *table, Elf64_data *file);
+int cfi_decode(Cfi_table *table, uint64_t offset, Cfi_fde *fde, uint64_t *next);
+int cfi_find(Cfi_table *table, uint64_t address, Cfi_fde *fde);
+int cfi_run(Cfi_table *table, Cfi_fde *fde, uint64_t address, Cfi_state *state);
+
+int display_cfi(Elf64_data *file, const char *address);
+void check_cfi(Elf64_data *file, const char *elf_path);
+
+#endif
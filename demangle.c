@@ -0,0 +1,2416 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "demangle.h"
+#include "elf.h"
+
+// Limits against names built to blow up: nesting of the grammar and of the
+// printer, and length of a demangled name
+#define DM_DEPTH      256
+#define DM_OUT_MAX    (1 << 20)
+#define DM_ARENA      (64 << 10)
+
+// Names handed to a worker at once by demangle_prefetch
+#define DM_BATCH      256
+// Fewer names than this are not worth starting threads for
+#define DM_PARALLEL   4096
+
+// Kinds of nodes
+#define K_NAME        0  // text
+#define K_NESTED      1  // a::b
+#define K_TEMPLATE    2  // a<b>, b a K_ARGS
+#define K_ARGS        3  // list
+#define K_QUAL        4  // a with quals
+#define K_POINTER     5  // a then text: *, & or &&
+#define K_FUNC        6  // Function type: a returning, taking list, then quals and ref
+#define K_ENCODING    7  // Function a, returning b if a template, taking list
+#define K_ARRAY       8  // a [b]
+#define K_PTRMEM      9  // Type b of class a
+#define K_SPECIAL     10 // text then a
+#define K_CTOR_VTABLE 11 // construction vtable for b-in-a
+#define K_CTOR        12 // Constructor or destructor named text
+#define K_CONV        13 // operator a
+#define K_ABI_TAG     14 // a[abi:text]
+#define K_LAMBDA      15 // {lambda(list)#text}
+#define K_LOCAL       16 // Entity b local to the function a
+#define K_CLONE       17 // a [clone text]
+#define K_PACK        18 // Template argument pack, list
+#define K_EXPANSION   19 // a...
+#define K_DECLTYPE    20 // decltype (a)
+#define K_VECTOR      21 // a __vector(b)
+#define K_LITERAL     22 // text of type a
+#define K_BINARY      23 // a text b
+#define K_PREFIX      24 // text a
+#define K_POSTFIX     25 // a text
+#define K_TERNARY     26 // a ? b : c
+#define K_CALL        27 // a(list)
+#define K_CAST        28 // text<a>(b)
+#define K_CONVERSION  29 // (a)(list)
+#define K_SIZEOF_TYPE 30 // text (a)
+#define K_MEMBER      31 // a text b
+#define K_INIT_LIST   32 // a{list}
+#define K_PARAM_SUB   33 // Substitution of the template parameter len, a as first read
+
+// Qualifiers
+#define Q_CONST    0x1
+#define Q_VOLATILE 0x2
+#define Q_RESTRICT 0x4
+
+typedef struct Dm_node {
+    uint8_t kind;
+    uint8_t quals;      // Q_*
+    uint8_t ref;        // Ref-qualifier of member functions: 0, 1 for &, 2 for &&
+    uint8_t dtor;       // K_CTOR: destructor
+    uint8_t noexcept;   // K_FUNC: 1 for noexcept, 2 for noexcept(c)
+    const char *text;
+    uint32_t len;
+    struct Dm_node *a, *b, *c;
+    struct Dm_node **list;
+    uint32_t count;
+} Dm_node;
+
+typedef struct Dm_chunk {
+    struct Dm_chunk *next;
+    size_t used;
+    char data[DM_ARENA];
+} Dm_chunk;
+
+typedef struct {
+    const char *p;
+    const char *end;
+    Dm_chunk *chunks;
+    Dm_node **subs;        // Substitution candidates, S_ is the first
+    uint32_t sub_count;
+    uint32_t sub_capacity;
+    Dm_node *params;       // K_ARGS that T_ refers to
+    Dm_node *last_name;    // Last source name, that constructors are named after
+    int referenced;        // Whether the type read next is the one of a reference
+    int lambda;            // Whether lambda parameters are read, where T_ is auto
+    int type_depth;        // Types being parsed, template arguments within do
+                           // not become params
+    int depth;
+    int error;
+} Dm_parser;
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int pack_index;        // Element of the pack being expanded, -1 outside
+    char last;             // Last character appended, kept when empty list
+                           // items are taken back, like c++filt does
+    int depth;
+    int error;
+} Dm_out;
+
+// std:: abbreviations, with their expansion as c++filt prints it and the
+// name of their constructors and destructors
+typedef struct {
+    char code;
+    const char *full;
+    const char *ctor;
+} Dm_std;
+
+static const Dm_std std_subs[] = {
+    { 'a', "std::allocator", "allocator" },
+    { 'b', "std::basic_string", "basic_string" },
+    { 's', "std::basic_string<char, std::char_traits<char>, std::allocator<char> >", "basic_string" },
+    { 'i', "std::basic_istream<char, std::char_traits<char> >", "basic_istream" },
+    { 'o', "std::basic_ostream<char, std::char_traits<char> >", "basic_ostream" },
+    { 'd', "std::basic_iostream<char, std::char_traits<char> >", "basic_iostream" },
+};
+
+typedef struct {
+    const char code[3];
+    const char *name;
+    int arity; // In expressions
+} Dm_operator;
+
+static const Dm_operator operators[] = {
+    { "aN", "&=", 2 }, { "aS", "=", 2 }, { "aa", "&&", 2 }, { "ad", "&", 1 },
+    { "an", "&", 2 }, { "aw", "co_await", 1 }, { "cl", "()", 2 }, { "cm", ",", 2 },
+    { "co", "~", 1 }, { "dV", "/=", 2 }, { "da", "delete[]", 1 }, { "de", "*", 1 },
+    { "dl", "delete", 1 }, { "dt", ".", 2 }, { "dv", "/", 2 }, { "eO", "^=", 2 },
+    { "eo", "^", 2 }, { "eq", "==", 2 }, { "ge", ">=", 2 }, { "gt", ">", 2 },
+    { "ix", "[]", 2 }, { "lS", "<<=", 2 }, { "le", "<=", 2 }, { "ls", "<<", 2 },
+    { "lt", "<", 2 }, { "mI", "-=", 2 }, { "mL", "*=", 2 }, { "mi", "-", 2 },
+    { "ml", "*", 2 }, { "mm", "--", 1 }, { "na", "new[]", 3 }, { "ne", "!=", 2 },
+    { "ng", "-", 1 }, { "nt", "!", 1 }, { "nw", "new", 3 }, { "oR", "|=", 2 },
+    { "oo", "||", 2 }, { "or", "|", 2 }, { "pL", "+=", 2 }, { "pl", "+", 2 },
+    { "pm", "->*", 2 }, { "pp", "++", 1 }, { "ps", "+", 1 }, { "pt", "->", 2 },
+    { "qu", "?", 3 }, { "rM", "%=", 2 }, { "rS", ">>=", 2 }, { "rm", "%", 2 },
+    { "rs", ">>", 2 }, { "ss", "<=>", 2 },
+};
+
+// Builtin types by code, after 'D' for the second half
+static const char *builtins[26] = {
+    ['a' - 'a'] = "signed char", ['b' - 'a'] = "bool", ['c' - 'a'] = "char",
+    ['d' - 'a'] = "double", ['e' - 'a'] = "long double", ['f' - 'a'] = "float",
+    ['g' - 'a'] = "__float128", ['h' - 'a'] = "unsigned char", ['i' - 'a'] = "int",
+    ['j' - 'a'] = "unsigned int", ['l' - 'a'] = "long", ['m' - 'a'] = "unsigned long",
+    ['n' - 'a'] = "__int128", ['o' - 'a'] = "unsigned __int128", ['s' - 'a'] = "short",
+    ['t' - 'a'] = "unsigned short", ['v' - 'a'] = "void", ['w' - 'a'] = "wchar_t",
+    ['x' - 'a'] = "long long", ['y' - 'a'] = "unsigned long long", ['z' - 'a'] = "...",
+};
+
+static const char *d_builtins[26] = {
+    ['a' - 'a'] = "auto", ['c' - 'a'] = "decltype(auto)", ['d' - 'a'] = "decimal64",
+    ['e' - 'a'] = "decimal128", ['f' - 'a'] = "decimal32", ['h' - 'a'] = "half",
+    ['i' - 'a'] = "char32_t", ['n' - 'a'] = "decltype(nullptr)", ['s' - 'a'] = "char16_t",
+    ['u' - 'a'] = "char8_t",
+};
+
+static Dm_node *parse_encoding(Dm_parser *p);
+static Dm_node *parse_inner_encoding(Dm_parser *p);
+static Dm_node *parse_name(Dm_parser *p, Dm_node *qualified);
+static Dm_node *parse_type(Dm_parser *p);
+static Dm_node *parse_expression(Dm_parser *p);
+static Dm_node *parse_template_args(Dm_parser *p);
+static void print_node(Dm_out *out, Dm_node *node);
+
+// Parser helpers
+
+static void *arena_alloc(Dm_parser *p, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (size > DM_ARENA)
+        return NULL;
+    if (p->chunks == NULL || p->chunks->used + size > DM_ARENA) {
+        Dm_chunk *chunk = malloc(sizeof(Dm_chunk));
+        if (chunk == NULL)
+            return NULL;
+        chunk->next = p->chunks;
+        chunk->used = 0;
+        p->chunks = chunk;
+    }
+    void *data = p->chunks->data + p->chunks->used;
+    p->chunks->used += size;
+    return data;
+}
+
+static Dm_node *new_node(Dm_parser *p, int kind) {
+    Dm_node *node = arena_alloc(p, sizeof(Dm_node));
+
+    if (node == NULL) {
+        p->error = 1;
+        return NULL;
+    }
+    memset(node, 0, sizeof(Dm_node));
+    node->kind = kind;
+    return node;
+}
+
+static Dm_node *new_text(Dm_parser *p, int kind, const char *text, size_t len) {
+    Dm_node *node = new_node(p, kind);
+
+    if (node != NULL) {
+        node->text = text;
+        node->len = len;
+    }
+    return node;
+}
+
+static Dm_node *new_name(Dm_parser *p, const char *text) {
+    return new_text(p, K_NAME, text, strlen(text));
+}
+
+static Dm_node *new_pair(Dm_parser *p, int kind, Dm_node *a, Dm_node *b) {
+    Dm_node *node;
+
+    if (a == NULL || (node = new_node(p, kind)) == NULL)
+        return NULL;
+    node->a = a;
+    node->b = b;
+    return node;
+}
+
+// Copy of text owned by the parser
+static const char *arena_text(Dm_parser *p, const char *text, size_t len) {
+    char *copy = arena_alloc(p, len + 1);
+
+    if (copy == NULL) {
+        p->error = 1;
+        return NULL;
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// Growing list of nodes, moved to the arena when complete
+typedef struct {
+    Dm_node *inline_nodes[16];
+    Dm_node **nodes;
+    uint32_t count;
+    uint32_t cap;
+} Dm_list;
+
+static void list_init(Dm_list *list) {
+    list->nodes = list->inline_nodes;
+    list->count = 0;
+    list->cap = 16;
+}
+
+static int list_add(Dm_list *list, Dm_node *node) {
+    if (node == NULL)
+        return -1;
+    if (list->count == list->cap) {
+        Dm_node **nodes = malloc(list->cap * 2 * sizeof(Dm_node*));
+        if (nodes == NULL)
+            return -1;
+        memcpy(nodes, list->nodes, list->count * sizeof(Dm_node*));
+        if (list->nodes != list->inline_nodes)
+            free(list->nodes);
+        list->nodes = nodes;
+        list->cap *= 2;
+    }
+    list->nodes[list->count++] = node;
+    return 0;
+}
+
+// Move the list to node, freeing it. Returns node, NULL on error.
+static Dm_node *list_finish(Dm_parser *p, Dm_list *list, Dm_node *node) {
+    if (node != NULL && list->count > 0) {
+        node->list = arena_alloc(p, list->count * sizeof(Dm_node*));
+        if (node->list == NULL) {
+            p->error = 1;
+            node = NULL;
+        } else {
+            memcpy(node->list, list->nodes, list->count * sizeof(Dm_node*));
+            node->count = list->count;
+        }
+    }
+    if (list->nodes != list->inline_nodes)
+        free(list->nodes);
+    return node;
+}
+
+static int peek(Dm_parser *p, int offset) {
+    return p->p + offset < p->end ? p->p[offset] : '\0';
+}
+
+static int consume(Dm_parser *p, char c) {
+    if (peek(p, 0) == c) {
+        p->p++;
+        return 1;
+    }
+    return 0;
+}
+
+static int consume2(Dm_parser *p, const char *s) {
+    if (peek(p, 0) == s[0] && peek(p, 1) == s[1]) {
+        p->p += 2;
+        return 1;
+    }
+    return 0;
+}
+
+static int is_digit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+static int is_lower(int c) {
+    return c >= 'a' && c <= 'z';
+}
+
+// Decimal number, with a leading n for negative ones when negative is set.
+// Returns -1 when there is none.
+static int parse_number(Dm_parser *p, uint64_t *value, int *negative) {
+    if (negative != NULL)
+        *negative = consume(p, 'n');
+    if (!is_digit(peek(p, 0)))
+        return -1;
+    *value = 0;
+    while (is_digit(peek(p, 0))) {
+        if (*value > (UINT64_MAX - 9) / 10)
+            return -1;
+        *value = *value * 10 + (*p->p++ - '0');
+    }
+    return 0;
+}
+
+// Optional number then '_': 0 for '_' alone, n + 1 for n_
+static int parse_seq_underscore(Dm_parser *p, uint64_t *value) {
+    *value = 0;
+    if (consume(p, '_'))
+        return 0;
+    if (parse_number(p, value, NULL) < 0 || !consume(p, '_'))
+        return -1;
+    (*value)++;
+    return 0;
+}
+
+static int add_sub(Dm_parser *p, Dm_node *node) {
+    if (node == NULL)
+        return -1;
+    if (p->sub_count == p->sub_capacity) {
+        uint32_t cap = p->sub_capacity ? p->sub_capacity * 2 : 32;
+        Dm_node **subs = realloc(p->subs, cap * sizeof(Dm_node*));
+        if (subs == NULL) {
+            p->error = 1;
+            return -1;
+        }
+        p->subs = subs;
+        p->sub_capacity = cap;
+    }
+    p->subs[p->sub_count++] = node;
+    return 0;
+}
+
+static Dm_node *fail(Dm_parser *p) {
+    p->error = 1;
+    return NULL;
+}
+
+// Grammar
+
+static Dm_node *parse_source_name(Dm_parser *p) {
+    uint64_t len;
+
+    if (parse_number(p, &len, NULL) < 0 || len == 0 || len > (uint64_t)(p->end - p->p))
+        return fail(p);
+
+    const char *name = p->p;
+    p->p += len;
+    if (len >= 10 && memcmp(name, "_GLOBAL_", 8) == 0
+        && (name[8] == '.' || name[8] == '_' || name[8] == '$') && name[9] == 'N')
+        p->last_name = new_name(p, "(anonymous namespace)");
+    else
+        p->last_name = new_text(p, K_NAME, name, len);
+    return p->last_name;
+}
+
+// Skip a discriminator of local names, which is not printed
+static void skip_discriminator(Dm_parser *p) {
+    uint64_t value;
+
+    if (peek(p, 0) != '_')
+        return;
+    if (peek(p, 1) == '_') {
+        p->p += 2;
+        if (parse_number(p, &value, NULL) < 0 || !consume(p, '_'))
+            p->error = 1;
+    } else if (is_digit(peek(p, 1))) {
+        p->p += 2;
+    }
+}
+
+static const Dm_operator *find_operator(const char *code) {
+    int low = 0, high = sizeof(operators) / sizeof(operators[0]);
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int order = strncmp(operators[mid].code, code, 2);
+        if (order == 0)
+            return &operators[mid];
+        if (order < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NULL;
+}
+
+static Dm_node *parse_operator_name(Dm_parser *p) {
+    char code[3] = { (char)peek(p, 0), (char)peek(p, 1), 0 };
+    const Dm_operator *op;
+
+    if (code[0] == 'c' && code[1] == 'v') {
+        p->p += 2;
+        // The type of a conversion operator refers to the template parameters
+        // of the function it is in, not of the arguments that follow
+        return new_pair(p, K_CONV, parse_type(p), NULL);
+    }
+    if (code[0] == 'l' && code[1] == 'i') {
+        p->p += 2;
+        Dm_node *suffix = parse_source_name(p);
+        if (suffix == NULL)
+            return NULL;
+        char *text = arena_alloc(p, suffix->len + 12);
+        if (text == NULL)
+            return fail(p);
+        sprintf(text, "operator\"\" %.*s", (int)suffix->len, suffix->text);
+        return new_name(p, text);
+    }
+    if (code[0] == 'v' && is_digit(code[1])) {
+        p->p += 2;
+        Dm_node *name = parse_source_name(p);
+        if (name == NULL)
+            return NULL;
+        char *text = arena_alloc(p, name->len + 10);
+        if (text == NULL)
+            return fail(p);
+        sprintf(text, "operator %.*s", (int)name->len, name->text);
+        return new_name(p, text);
+    }
+    if ((op = find_operator(code)) == NULL)
+        return fail(p);
+    p->p += 2;
+
+    char *text = arena_alloc(p, strlen(op->name) + 10);
+    if (text == NULL)
+        return fail(p);
+    sprintf(text, is_lower(op->name[0]) ? "operator %s" : "operator%s", op->name);
+    return new_name(p, text);
+}
+
+// Name of the constructors and destructors of a scope
+// Constructors and destructors are named after the last source name read
+static Dm_node *parse_ctor_dtor(Dm_parser *p) {
+    Dm_node *base = p->last_name;
+    int dtor = peek(p, 0) == 'D';
+    Dm_node *node;
+
+    if (base == NULL)
+        return fail(p);
+    p->p++;
+    if (!dtor && consume(p, 'I')) {
+        // Inheriting constructor, of the base class that follows
+        if (!is_digit(peek(p, 0)))
+            return fail(p);
+        p->p++;
+        if (parse_type(p) == NULL)
+            return NULL;
+    } else if (is_digit(peek(p, 0))) {
+        p->p++;
+    } else {
+        return fail(p);
+    }
+
+    if ((node = new_node(p, K_CTOR)) == NULL)
+        return NULL;
+    node->text = base->text;
+    node->len = base->len;
+    node->dtor = dtor;
+    return node;
+}
+
+// {lambda(params)#n} and {unnamed type#n}
+static Dm_node *parse_unnamed(Dm_parser *p) {
+    Dm_list params;
+    Dm_node *node;
+    uint64_t n;
+
+    if (consume2(p, "Ut")) {
+        if (parse_seq_underscore(p, &n) < 0)
+            return fail(p);
+        char *text = arena_alloc(p, 40);
+        if (text == NULL)
+            return fail(p);
+        sprintf(text, "{unnamed type#%lu}", n + 1);
+        return new_name(p, text);
+    }
+    if (!consume2(p, "Ul"))
+        return fail(p);
+
+    list_init(&params);
+    if (peek(p, 0) == 'v' && peek(p, 1) == 'E') {
+        p->p++;
+    } else {
+        int lambda = p->lambda;
+        p->lambda = 1;
+        while (!p->error && peek(p, 0) != 'E' && p->p < p->end) {
+            if (list_add(&params, parse_type(p)) < 0)
+                p->error = 1;
+        }
+        p->lambda = lambda;
+    }
+    if (!consume(p, 'E') || parse_seq_underscore(p, &n) < 0)
+        p->error = 1;
+
+    node = list_finish(p, &params, new_node(p, K_LAMBDA));
+    if (node == NULL || p->error)
+        return fail(p);
+    char *text = arena_alloc(p, 24);
+    if (text == NULL)
+        return fail(p);
+    node->len = sprintf(text, "%lu", n + 1);
+    node->text = text;
+    return node;
+}
+
+static Dm_node *parse_abi_tags(Dm_parser *p, Dm_node *name) {
+    Dm_node *last_name = p->last_name;
+
+    while (name != NULL && consume(p, 'B')) {
+        Dm_node *tag = parse_source_name(p);
+        p->last_name = last_name;
+        if (tag == NULL)
+            return NULL;
+        name = new_pair(p, K_ABI_TAG, name, NULL);
+        if (name != NULL) {
+            name->text = tag->text;
+            name->len = tag->len;
+        }
+    }
+    return name;
+}
+
+static Dm_node *parse_unqualified_name(Dm_parser *p) {
+    int c = peek(p, 0);
+    Dm_node *name;
+
+    if (c == 'L') {
+        // Internal linkage, not printed
+        p->p++;
+        c = peek(p, 0);
+    }
+
+    if (is_digit(c))
+        name = parse_source_name(p);
+    else if (c == 'C' || (c == 'D' && is_digit(peek(p, 1))))
+        name = parse_ctor_dtor(p);
+    else if (c == 'U')
+        name = parse_unnamed(p);
+    else if (is_lower(c))
+        name = parse_operator_name(p);
+    else
+        return fail(p);
+
+    if (name != NULL && peek(p, 0) == 'B')
+        name = parse_abi_tags(p, name);
+    return name;
+}
+
+// A substitution read for the type of a reference is resolved where its
+// template parameter was first read, as c++filt saves the scope of those
+static Dm_node *parse_substitution(Dm_parser *p, int referenced) {
+    uint64_t index = 0;
+    int c;
+
+    if (!consume(p, 'S'))
+        return fail(p);
+
+    c = peek(p, 0);
+    if (is_lower(c)) {
+        for (size_t i = 0; i < sizeof(std_subs) / sizeof(std_subs[0]); i++) {
+            if (std_subs[i].code == c) {
+                p->p++;
+                p->last_name = new_name(p, std_subs[i].ctor);
+                return new_name(p, std_subs[i].full);
+            }
+        }
+        return fail(p);
+    }
+
+    if (!consume(p, '_')) {
+        while ((c = peek(p, 0)) != '_') {
+            if (is_digit(c))
+                index = index * 36 + (c - '0');
+            else if (c >= 'A' && c <= 'Z')
+                index = index * 36 + (c - 'A' + 10);
+            else
+                return fail(p);
+            if (index > UINT32_MAX)
+                return fail(p);
+            p->p++;
+        }
+        p->p++;
+        index++;
+    }
+    if (index >= p->sub_count)
+        return fail(p);
+
+    // c++filt resolves a substituted template parameter against the template
+    // of where the substitution is used, which differs from where it was read
+    // when that was in a function local to a template argument
+    Dm_node *node = p->subs[index];
+    if (node->kind == K_PARAM_SUB && referenced)
+        return node->a;
+    if (node->kind == K_PARAM_SUB)
+        return p->params != NULL && node->len < p->params->count ? p->params->list[node->len] : node->a;
+    return node;
+}
+
+static Dm_node *parse_template_param_index(Dm_parser *p, uint64_t *index) {
+    if (!consume(p, 'T') || parse_seq_underscore(p, index) < 0)
+        return fail(p);
+    if (p->lambda) {
+        char *text = arena_alloc(p, 32);
+        if (text == NULL)
+            return fail(p);
+        sprintf(text, "auto:%lu", *index + 1);
+        return new_name(p, text);
+    }
+    if (p->params == NULL || *index >= p->params->count)
+        return fail(p);
+    return p->params->list[*index];
+}
+
+static Dm_node *parse_template_param(Dm_parser *p) {
+    uint64_t index;
+    return parse_template_param_index(p, &index);
+}
+
+static Dm_node *parse_decltype(Dm_parser *p) {
+    Dm_node *expr;
+
+    if (!consume(p, 'D') || (!consume(p, 't') && !consume(p, 'T')))
+        return fail(p);
+    expr = parse_expression(p);
+    if (expr == NULL || !consume(p, 'E'))
+        return fail(p);
+    return new_pair(p, K_DECLTYPE, expr, NULL);
+}
+
+// N [quals] [ref] prefix... E, setting the qualifiers of the member function
+// it names on qualified
+static Dm_node *parse_nested_name(Dm_parser *p, Dm_node *qualified) {
+    Dm_node *so_far = NULL;
+
+    if (!consume(p, 'N'))
+        return fail(p);
+    while (1) {
+        if (consume(p, 'r'))
+            qualified->quals |= Q_RESTRICT;
+        else if (consume(p, 'V'))
+            qualified->quals |= Q_VOLATILE;
+        else if (consume(p, 'K'))
+            qualified->quals |= Q_CONST;
+        else
+            break;
+    }
+    if (consume(p, 'R'))
+        qualified->ref = 1;
+    else if (consume(p, 'O'))
+        qualified->ref = 2;
+
+    while (!consume(p, 'E')) {
+        int c = peek(p, 0);
+        Dm_node *part;
+
+        if (p->error || p->p >= p->end)
+            return fail(p);
+
+        if (c == 'S' && peek(p, 1) == 't') {
+            p->p += 2;
+            if (so_far != NULL)
+                return fail(p);
+            so_far = new_name(p, "std");
+            continue;
+        } else if (c == 'S') {
+            if (so_far != NULL)
+                return fail(p);
+            so_far = parse_substitution(p, 0);
+            continue;
+        } else if (c == 'I') {
+            if (so_far == NULL)
+                return fail(p);
+            part = parse_template_args(p);
+            if (p->type_depth == 0)
+                p->params = part;
+            so_far = new_pair(p, K_TEMPLATE, so_far, part);
+            if (part == NULL)
+                return fail(p);
+        } else if (c == 'T') {
+            if (so_far != NULL)
+                return fail(p);
+            so_far = parse_template_param(p);
+        } else if (c == 'D' && (peek(p, 1) == 't' || peek(p, 1) == 'T')) {
+            if (so_far != NULL)
+                return fail(p);
+            so_far = parse_decltype(p);
+        } else if (c == 'M') {
+            // Closure of a data member initializer
+            p->p++;
+            continue;
+        } else {
+            part = parse_unqualified_name(p);
+            so_far = so_far == NULL ? part : new_pair(p, K_NESTED, so_far, part);
+            if (part == NULL)
+                return fail(p);
+        }
+
+        if (so_far == NULL)
+            return fail(p);
+        if (peek(p, 0) != 'E' && add_sub(p, so_far) < 0)
+            return NULL;
+    }
+    if (so_far == NULL)
+        return fail(p);
+    return so_far;
+}
+
+// Z encoding E entity [discriminator], and the string literals and default
+// arguments of functions
+static Dm_node *parse_local_name(Dm_parser *p, Dm_node *qualified) {
+    Dm_node *function, *entity;
+
+    if (!consume(p, 'Z'))
+        return fail(p);
+    function = parse_inner_encoding(p);
+    if (function == NULL || !consume(p, 'E'))
+        return fail(p);
+    // The return type of the function is left out
+    if (function->kind == K_ENCODING)
+        function->b = NULL;
+
+    if (consume(p, 's')) {
+        skip_discriminator(p);
+        return new_pair(p, K_LOCAL, function, new_name(p, "string literal"));
+    }
+    if (consume(p, 'd')) {
+        uint64_t n;
+        char *text = arena_alloc(p, 40);
+
+        if (text == NULL || parse_seq_underscore(p, &n) < 0)
+            return fail(p);
+        sprintf(text, "{default arg#%lu}", n + 1);
+        function = new_pair(p, K_LOCAL, function, new_name(p, text));
+    }
+
+    entity = parse_name(p, qualified);
+    skip_discriminator(p);
+    if (entity == NULL)
+        return fail(p);
+    return new_pair(p, K_LOCAL, function, entity);
+}
+
+static Dm_node *parse_name(Dm_parser *p, Dm_node *qualified) {
+    Dm_node *name, *args;
+
+    switch (peek(p, 0)) {
+        case 'N':
+            return parse_nested_name(p, qualified);
+        case 'Z':
+            return parse_local_name(p, qualified);
+        case 'S':
+            if (peek(p, 1) != 't') {
+                // A substitution is only a name with template arguments
+                name = parse_substitution(p, 0);
+                if (name == NULL || peek(p, 0) != 'I')
+                    return fail(p);
+                args = parse_template_args(p);
+                if (p->type_depth == 0)
+                    p->params = args;
+                return args == NULL ? NULL : new_pair(p, K_TEMPLATE, name, args);
+            }
+            p->p += 2;
+            name = parse_unqualified_name(p);
+            name = name == NULL ? NULL : new_pair(p, K_NESTED, new_name(p, "std"), name);
+            break;
+        default:
+            name = parse_unqualified_name(p);
+    }
+
+    if (name != NULL && peek(p, 0) == 'I') {
+        if (add_sub(p, name) < 0)
+            return NULL;
+        args = parse_template_args(p);
+        if (p->type_depth == 0)
+            p->params = args;
+        name = args == NULL ? NULL : new_pair(p, K_TEMPLATE, name, args);
+    }
+    return name;
+}
+
+static Dm_node *parse_template_arg(Dm_parser *p) {
+    Dm_node *arg;
+    Dm_list pack;
+
+    switch (peek(p, 0)) {
+        case 'X':
+            p->p++;
+            arg = parse_expression(p);
+            if (arg == NULL || !consume(p, 'E'))
+                return fail(p);
+            return arg;
+        case 'L':
+            return parse_expression(p);
+        case 'J':
+            p->p++;
+            list_init(&pack);
+            while (!consume(p, 'E')) {
+                if (p->error || p->p >= p->end || list_add(&pack, parse_template_arg(p)) < 0) {
+                    list_finish(p, &pack, NULL);
+                    return fail(p);
+                }
+            }
+            return list_finish(p, &pack, new_node(p, K_PACK));
+        default:
+            return parse_type(p);
+    }
+}
+
+// The names in template arguments do not name constructors
+static Dm_node *parse_template_args(Dm_parser *p) {
+    Dm_node *last_name = p->last_name;
+    Dm_list args;
+
+    if (!consume(p, 'I'))
+        return fail(p);
+    list_init(&args);
+    while (!consume(p, 'E')) {
+        if (p->error || p->p >= p->end || list_add(&args, parse_template_arg(p)) < 0) {
+            list_finish(p, &args, NULL);
+            return fail(p);
+        }
+    }
+    p->last_name = last_name;
+    return list_finish(p, &args, new_node(p, K_ARGS));
+}
+
+static int is_void(Dm_node *node) {
+    return node->kind == K_NAME && node->text == builtins['v' - 'a'];
+}
+
+// Parameter types up to 'E' or the end of the name into node. A lone void
+// stands for no parameters.
+static Dm_node *parse_params(Dm_parser *p, Dm_node *node, int function_type) {
+    Dm_list params;
+
+    list_init(&params);
+    while (p->p < p->end && peek(p, 0) != 'E' && peek(p, 0) != '.') {
+        if (function_type && (peek(p, 0) == 'R' || peek(p, 0) == 'O') && peek(p, 1) == 'E') {
+            node->ref = peek(p, 0) == 'R' ? 1 : 2;
+            p->p++;
+            break;
+        }
+        if (list_add(&params, parse_type(p)) < 0) {
+            list_finish(p, &params, NULL);
+            return fail(p);
+        }
+    }
+    if (params.count == 1 && is_void(params.nodes[0]))
+        params.count = 0;
+    return list_finish(p, &params, node);
+}
+
+// F [Y] return params [ref] E
+static Dm_node *parse_function_type(Dm_parser *p) {
+    Dm_node *node = new_node(p, K_FUNC);
+
+    if (node == NULL || !consume(p, 'F'))
+        return fail(p);
+    consume(p, 'Y');
+    if ((node->a = parse_type(p)) == NULL || parse_params(p, node, 1) == NULL || !consume(p, 'E'))
+        return fail(p);
+    return node;
+}
+
+// Array dimension, a number, an expression or nothing, then '_'
+static Dm_node *parse_dimension(Dm_parser *p) {
+    const char *start = p->p;
+    Dm_node *dimension = NULL;
+
+    if (is_digit(peek(p, 0))) {
+        while (is_digit(peek(p, 0)))
+            p->p++;
+        dimension = new_text(p, K_NAME, start, p->p - start);
+    } else if (peek(p, 0) != '_') {
+        dimension = parse_expression(p);
+    }
+    if (p->error || !consume(p, '_'))
+        return fail(p);
+    return dimension;
+}
+
+static Dm_node *parse_type_inner(Dm_parser *p) {
+    int c = peek(p, 0);
+    Dm_node *node, *args, *dimension, *param;
+    Dm_node qualified = { 0 };
+    uint64_t index;
+    int referenced = p->referenced;
+
+    p->referenced = 0;
+    if (is_lower(c) && builtins[c - 'a'] != NULL) {
+        p->p++;
+        return new_name(p, builtins[c - 'a']);
+    }
+
+    switch (c) {
+        case 'u':
+            p->p++;
+            node = parse_source_name(p);
+            break;
+        case 'r':
+        case 'V':
+        case 'K': {
+            int quals = 0;
+            for (;; p->p++) {
+                if (peek(p, 0) == 'r')
+                    quals |= Q_RESTRICT;
+                else if (peek(p, 0) == 'V')
+                    quals |= Q_VOLATILE;
+                else if (peek(p, 0) == 'K')
+                    quals |= Q_CONST;
+                else
+                    break;
+            }
+            // A qualified function type is substituted, the function type alone is not
+            Dm_node *child = peek(p, 0) == 'F' ? parse_function_type(p) : parse_type(p);
+            if (child == NULL)
+                return NULL;
+            if (child->kind == K_FUNC) {
+                // Qualifiers of member function types follow their parameters
+                if ((node = new_node(p, K_FUNC)) != NULL) {
+                    *node = *child;
+                    node->quals |= quals;
+                }
+            } else if ((node = new_pair(p, K_QUAL, child, NULL)) != NULL) {
+                node->quals = quals;
+            }
+            break;
+        }
+        case 'P':
+        case 'R':
+        case 'O':
+        case 'C':
+        case 'G':
+            p->p++;
+            p->referenced = c == 'R' || c == 'O';
+            node = new_pair(p, K_POINTER, parse_type(p), NULL);
+            if (node != NULL)
+                node->text = c == 'P' ? "*" : c == 'R' ? "&" : c == 'O' ? "&&"
+                           : c == 'C' ? " _Complex" : " _Imaginary";
+            break;
+        case 'F':
+            node = parse_function_type(p);
+            break;
+        case 'A':
+            p->p++;
+            dimension = parse_dimension(p);
+            if (p->error)
+                return NULL;
+            node = new_pair(p, K_ARRAY, parse_type(p), dimension);
+            break;
+        case 'M':
+            p->p++;
+            node = parse_type(p);
+            node = node == NULL ? NULL : new_pair(p, K_PTRMEM, node, parse_type(p));
+            if (node != NULL && node->b == NULL)
+                return fail(p);
+            break;
+        case 'T':
+            if (peek(p, 1) == 's' || peek(p, 1) == 'u' || peek(p, 1) == 'e') {
+                // struct, union or enum, not printed
+                p->p += 2;
+                node = parse_name(p, &qualified);
+                break;
+            }
+            node = parse_template_param_index(p, &index);
+            if ((param = new_pair(p, K_PARAM_SUB, node, NULL)) == NULL)
+                return NULL;
+            param->len = index;
+            if (add_sub(p, param) < 0)
+                return NULL;
+            if (peek(p, 0) != 'I')
+                return node;
+            args = parse_template_args(p);
+            node = args == NULL ? NULL : new_pair(p, K_TEMPLATE, node, args);
+            break;
+        case 'S':
+            if (peek(p, 1) == 't') {
+                node = parse_name(p, &qualified);
+                break;
+            }
+            node = parse_substitution(p, referenced);
+            if (node == NULL || peek(p, 0) != 'I')
+                return node;
+            args = parse_template_args(p);
+            node = args == NULL ? NULL : new_pair(p, K_TEMPLATE, node, args);
+            break;
+        case 'D':
+            c = peek(p, 1);
+            if (c == 't' || c == 'T') {
+                node = parse_decltype(p);
+            } else if (c == 'p') {
+                p->p += 2;
+                node = new_pair(p, K_EXPANSION, parse_type(p), NULL);
+            } else if (c == 'v') {
+                p->p += 2;
+                dimension = parse_dimension(p);
+                if (p->error)
+                    return NULL;
+                node = new_pair(p, K_VECTOR, parse_type(p), dimension);
+            } else if (c == 'o' || c == 'O') {
+                Dm_node *expression = NULL;
+                p->p += 2;
+                if (c == 'O' && ((expression = parse_expression(p)) == NULL || !consume(p, 'E')))
+                    return fail(p);
+                if ((node = parse_type(p)) == NULL || node->kind != K_FUNC)
+                    return fail(p);
+                node->noexcept = c == 'o' ? 1 : 2;
+                node->c = expression;
+                return node;
+            } else if (c == 'F') {
+                const char *start;
+                p->p += 2;
+                start = p->p;
+                while (is_digit(peek(p, 0)))
+                    p->p++;
+                if (p->p == start || !consume(p, '_'))
+                    return fail(p);
+                char *text = arena_alloc(p, p->p - start + 8);
+                if (text == NULL)
+                    return fail(p);
+                sprintf(text, "_Float%.*s", (int)(p->p - 1 - start), start);
+                return new_name(p, text);
+            } else if (is_lower(c) && d_builtins[c - 'a'] != NULL) {
+                p->p += 2;
+                return new_name(p, d_builtins[c - 'a']);
+            } else {
+                return fail(p);
+            }
+            break;
+        case 'N':
+        case 'Z':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            node = parse_name(p, &qualified);
+            break;
+        default:
+            return fail(p);
+    }
+
+    if (node == NULL || add_sub(p, node) < 0)
+        return fail(p);
+    return node;
+}
+
+static Dm_node *parse_type(Dm_parser *p) {
+    Dm_node *node;
+
+    if (++p->depth > DM_DEPTH)
+        return fail(p);
+    p->type_depth++;
+    node = parse_type_inner(p);
+    p->type_depth--;
+    p->depth--;
+    return node;
+}
+
+// Expressions
+
+// L type value E, L type E, or L _Z encoding E
+static Dm_node *parse_expr_primary(Dm_parser *p) {
+    Dm_node *type, *node;
+    const char *start;
+
+    if (!consume(p, 'L'))
+        return fail(p);
+    if (consume2(p, "_Z") || consume(p, 'Z')) {
+        node = parse_inner_encoding(p);
+        if (node == NULL || !consume(p, 'E'))
+            return fail(p);
+        return node;
+    }
+
+    if ((type = parse_type(p)) == NULL)
+        return NULL;
+    start = p->p;
+    while (p->p < p->end && peek(p, 0) != 'E')
+        p->p++;
+    if (!consume(p, 'E'))
+        return fail(p);
+
+    node = new_pair(p, K_LITERAL, type, NULL);
+    if (node != NULL) {
+        node->text = start;
+        node->len = p->p - 1 - start;
+    }
+    return node;
+}
+
+static Dm_node *parse_function_param(Dm_parser *p) {
+    uint64_t n = 0, level;
+
+    if (consume2(p, "fL")) {
+        if (parse_number(p, &level, NULL) < 0 || !consume(p, 'p'))
+            return fail(p);
+    } else if (!consume2(p, "fp")) {
+        return fail(p);
+    }
+    while (peek(p, 0) == 'r' || peek(p, 0) == 'V' || peek(p, 0) == 'K')
+        p->p++;
+    if (parse_seq_underscore(p, &n) < 0)
+        return fail(p);
+
+    char *text = arena_alloc(p, 32);
+    if (text == NULL)
+        return fail(p);
+    sprintf(text, "{parm#%lu}", n + 1);
+    return new_name(p, text);
+}
+
+// Source name, operator or destructor name, with template arguments
+static Dm_node *parse_base_unresolved_name(Dm_parser *p) {
+    Dm_node *name;
+
+    if (consume2(p, "on")) {
+        name = parse_operator_name(p);
+    } else if (consume2(p, "dn")) {
+        Dm_node *type = is_digit(peek(p, 0)) ? parse_source_name(p) : parse_type(p);
+        if (type == NULL)
+            return NULL;
+        name = new_node(p, K_CTOR);
+        if (name != NULL) {
+            Dm_out tmp = { 0 };
+            print_node(&tmp, type);
+            name->text = tmp.error ? NULL : arena_text(p, tmp.buf, tmp.len);
+            name->len = tmp.len;
+            name->dtor = 1;
+            free(tmp.buf);
+            if (name->text == NULL)
+                return fail(p);
+        }
+        return name;
+    } else {
+        name = parse_source_name(p);
+    }
+    if (name != NULL && peek(p, 0) == 'I') {
+        Dm_node *args = parse_template_args(p);
+        name = args == NULL ? NULL : new_pair(p, K_TEMPLATE, name, args);
+    }
+    return name;
+}
+
+// sr and its qualifiers
+static int starts_base_unresolved_name(Dm_parser *p) {
+    return is_digit(peek(p, 0)) || (peek(p, 0) == 'o' && peek(p, 1) == 'n')
+        || (peek(p, 0) == 'd' && peek(p, 1) == 'n');
+}
+
+// Qualifier levels then 'E', as in sr 3std 9is_signed IT_E E 5value
+static Dm_node *parse_qualifier_levels(Dm_parser *p) {
+    Dm_node *levels = NULL;
+
+    while (is_digit(peek(p, 0)) && !p->error) {
+        Dm_node *level = parse_base_unresolved_name(p);
+        levels = levels == NULL || level == NULL ? level : new_pair(p, K_NESTED, levels, level);
+    }
+    if (levels == NULL || p->error || peek(p, 0) != 'E')
+        return NULL;
+    p->p++;
+    return starts_base_unresolved_name(p) ? levels : NULL;
+}
+
+static Dm_node *parse_unresolved_name(Dm_parser *p, int global) {
+    Dm_node *name = NULL;
+
+    if (!consume2(p, "sr"))
+        return fail(p);
+
+    // Else the qualifier is a single type, the way GCC mangles them
+    if (is_digit(peek(p, 0))) {
+        const char *start = p->p;
+        uint32_t sub_count = p->sub_count;
+
+        if ((name = parse_qualifier_levels(p)) == NULL) {
+            p->p = start;
+            p->sub_count = sub_count;
+            p->error = 0;
+        }
+    }
+    if (name == NULL && (name = parse_type(p)) == NULL)
+        return fail(p);
+
+    // The template arguments apply to the whole name, which c++filt then
+    // parenthesizes in calls
+    Dm_node *base = parse_base_unresolved_name(p);
+    Dm_node *args = NULL;
+    if (base != NULL && base->kind == K_TEMPLATE) {
+        args = base->b;
+        base = base->a;
+    }
+    if (base == NULL || (name = new_pair(p, K_NESTED, name, base)) == NULL)
+        return fail(p);
+    if (global)
+        name = new_pair(p, K_NESTED, new_name(p, ""), name);
+    if (args != NULL)
+        name = new_pair(p, K_TEMPLATE, name, args);
+    return name;
+}
+
+// Expressions up to 'E' into node
+static Dm_node *parse_expression_list(Dm_parser *p, Dm_node *node) {
+    Dm_list list;
+
+    list_init(&list);
+    while (!consume(p, 'E')) {
+        if (p->error || p->p >= p->end || list_add(&list, parse_expression(p)) < 0) {
+            list_finish(p, &list, NULL);
+            return fail(p);
+        }
+    }
+    return list_finish(p, &list, node);
+}
+
+static Dm_node *new_op(Dm_parser *p, int kind, const char *text, Dm_node *a, Dm_node *b) {
+    Dm_node *node;
+
+    if (a == NULL || (kind == K_BINARY && b == NULL) || (node = new_pair(p, kind, a, b)) == NULL)
+        return fail(p);
+    node->text = text;
+    node->len = strlen(text);
+    return node;
+}
+
+static Dm_node *parse_expression_inner(Dm_parser *p) {
+    int c0 = peek(p, 0), c1 = peek(p, 1);
+    char code[3] = { (char)c0, (char)c1, 0 };
+    const Dm_operator *op;
+    Dm_node *a, *b;
+
+    if (c0 == 'L')
+        return parse_expr_primary(p);
+    if (c0 == 'T')
+        return parse_template_param(p);
+    if (c0 == 'f' && (c1 == 'p' || c1 == 'L'))
+        return parse_function_param(p);
+    if (is_digit(c0) || (c0 == 'o' && c1 == 'n') || (c0 == 'd' && c1 == 'n'))
+        return parse_base_unresolved_name(p);
+    if (c0 == 's' && c1 == 'r')
+        return parse_unresolved_name(p, 0);
+    if (c0 == 'g' && c1 == 's') {
+        p->p += 2;
+        if (peek(p, 0) == 's' && peek(p, 1) == 'r')
+            return parse_unresolved_name(p, 1);
+        return new_op(p, K_PREFIX, "::", parse_expression(p), NULL);
+    }
+
+    if (code[0] == 'p' && code[1] == 'p' && peek(p, 2) == '_') {
+        p->p += 3;
+        return new_op(p, K_PREFIX, "++", parse_expression(p), NULL);
+    }
+    if (code[0] == 'm' && code[1] == 'm' && peek(p, 2) == '_') {
+        p->p += 3;
+        return new_op(p, K_PREFIX, "--", parse_expression(p), NULL);
+    }
+
+    p->p += 2;
+    switch (c0 << 8 | c1) {
+        case 's' << 8 | 't':
+        case 'a' << 8 | 't':
+            return new_op(p, K_SIZEOF_TYPE, c0 == 's' ? "sizeof " : "alignof ", parse_type(p), NULL);
+        case 's' << 8 | 'z':
+        case 'a' << 8 | 'z':
+            return new_op(p, K_PREFIX, c0 == 's' ? "sizeof " : "alignof ", parse_expression(p), NULL);
+        case 's' << 8 | 'Z':
+            a = peek(p, 0) == 'T' ? parse_template_param(p) : parse_function_param(p);
+            return new_op(p, K_SIZEOF_TYPE, "sizeof...", a, NULL);
+        case 's' << 8 | 'p':
+            return new_pair(p, K_EXPANSION, parse_expression(p), NULL);
+        case 'n' << 8 | 'x':
+            return new_op(p, K_SIZEOF_TYPE, "noexcept ", parse_expression(p), NULL);
+        case 't' << 8 | 'e':
+            return new_op(p, K_SIZEOF_TYPE, "typeid ", parse_expression(p), NULL);
+        case 't' << 8 | 'i':
+            return new_op(p, K_SIZEOF_TYPE, "typeid ", parse_type(p), NULL);
+        case 't' << 8 | 'w':
+            return new_op(p, K_PREFIX, "throw ", parse_expression(p), NULL);
+        case 't' << 8 | 'r':
+            return new_name(p, "throw");
+        case 'c' << 8 | 'l':
+            if ((a = parse_expression(p)) == NULL)
+                return NULL;
+            return parse_expression_list(p, new_pair(p, K_CALL, a, NULL));
+        case 'c' << 8 | 'v':
+            if ((a = parse_type(p)) == NULL)
+                return NULL;
+            if (consume(p, '_'))
+                return parse_expression_list(p, new_pair(p, K_CONVERSION, a, NULL));
+            if ((b = parse_expression(p)) == NULL)
+                return NULL;
+            a = new_pair(p, K_CONVERSION, a, NULL);
+            if (a != NULL && (a->list = arena_alloc(p, sizeof(Dm_node*))) != NULL) {
+                a->list[0] = b;
+                a->count = 1;
+                return a;
+            }
+            return fail(p);
+        case 'd' << 8 | 'c':
+        case 's' << 8 | 'c':
+        case 'c' << 8 | 'c':
+        case 'r' << 8 | 'c':
+            a = parse_type(p);
+            b = a == NULL ? NULL : parse_expression(p);
+            return new_op(p, K_CAST, c0 == 'd' ? "dynamic_cast" : c0 == 's' ? "static_cast"
+                                   : c0 == 'c' ? "const_cast" : "reinterpret_cast", a, b);
+        case 'd' << 8 | 't':
+        case 'p' << 8 | 't':
+            a = parse_expression(p);
+            b = a == NULL ? NULL : parse_expression(p);
+            return new_op(p, K_MEMBER, c0 == 'd' ? "." : "->", a, b);
+        case 'd' << 8 | 's':
+            a = parse_expression(p);
+            b = a == NULL ? NULL : parse_expression(p);
+            return new_op(p, K_BINARY, ".*", a, b);
+        case 'i' << 8 | 'l':
+            return parse_expression_list(p, new_node(p, K_INIT_LIST));
+        case 't' << 8 | 'l':
+            if ((a = parse_type(p)) == NULL)
+                return NULL;
+            return parse_expression_list(p, new_pair(p, K_INIT_LIST, a, NULL));
+        case 'q' << 8 | 'u':
+            a = parse_expression(p);
+            b = a == NULL ? NULL : parse_expression(p);
+            if (b == NULL || (a = new_pair(p, K_TERNARY, a, b)) == NULL
+                || (a->c = parse_expression(p)) == NULL)
+                return fail(p);
+            return a;
+    }
+
+    if ((op = find_operator(code)) == NULL || op->arity == 3)
+        return fail(p);
+    if (op->arity == 1) {
+        // Postfix unless marked with '_', handled above
+        if (strcmp(op->name, "++") == 0 || strcmp(op->name, "--") == 0)
+            return new_op(p, K_POSTFIX, op->name, parse_expression(p), NULL);
+        return new_op(p, K_PREFIX, op->name, parse_expression(p), NULL);
+    }
+    a = parse_expression(p);
+    b = a == NULL ? NULL : parse_expression(p);
+    return new_op(p, K_BINARY, op->name, a, b);
+}
+
+static Dm_node *parse_expression(Dm_parser *p) {
+    Dm_node *node;
+
+    if (++p->depth > DM_DEPTH)
+        return fail(p);
+    node = parse_expression_inner(p);
+    p->depth--;
+    return node;
+}
+
+// Special names
+
+// h offset _ or v offset _ virtual offset _, not printed
+static int skip_call_offset(Dm_parser *p) {
+    uint64_t value;
+    int negative;
+
+    if (consume(p, 'h'))
+        return parse_number(p, &value, &negative) < 0 || !consume(p, '_') ? -1 : 0;
+    if (consume(p, 'v'))
+        return parse_number(p, &value, &negative) < 0 || !consume(p, '_')
+            || parse_number(p, &value, &negative) < 0 || !consume(p, '_') ? -1 : 0;
+    return -1;
+}
+
+static Dm_node *new_special(Dm_parser *p, const char *text, Dm_node *child) {
+    Dm_node *node;
+
+    if (child == NULL || (node = new_pair(p, K_SPECIAL, child, NULL)) == NULL)
+        return fail(p);
+    node->text = text;
+    node->len = strlen(text);
+    return node;
+}
+
+static Dm_node *parse_special_name(Dm_parser *p) {
+    Dm_node qualified = { 0 };
+    Dm_node *a, *b;
+    uint64_t n;
+
+    if (consume(p, 'T')) {
+        switch (*p->p++) {
+            case 'V': return new_special(p, "vtable for ", parse_type(p));
+            case 'T': return new_special(p, "VTT for ", parse_type(p));
+            case 'I': return new_special(p, "typeinfo for ", parse_type(p));
+            case 'S': return new_special(p, "typeinfo name for ", parse_type(p));
+            case 'H': return new_special(p, "TLS init function for ", parse_name(p, &qualified));
+            case 'W': return new_special(p, "TLS wrapper function for ", parse_name(p, &qualified));
+            case 'A': return new_special(p, "template parameter object for ", parse_template_arg(p));
+            case 'h':
+                p->p--;
+                if (skip_call_offset(p) < 0)
+                    return fail(p);
+                return new_special(p, "non-virtual thunk to ", parse_encoding(p));
+            case 'v':
+                p->p--;
+                if (skip_call_offset(p) < 0)
+                    return fail(p);
+                return new_special(p, "virtual thunk to ", parse_encoding(p));
+            case 'c':
+                if (skip_call_offset(p) < 0 || skip_call_offset(p) < 0)
+                    return fail(p);
+                return new_special(p, "covariant return thunk to ", parse_encoding(p));
+            case 'C':
+                if ((a = parse_type(p)) == NULL || parse_number(p, &n, NULL) < 0 || !consume(p, '_'))
+                    return fail(p);
+                b = parse_type(p);
+                return b == NULL ? NULL : new_pair(p, K_CTOR_VTABLE, a, b);
+            default:
+                return fail(p);
+        }
+    }
+
+    if (!consume(p, 'G'))
+        return fail(p);
+    if (consume(p, 'V'))
+        return new_special(p, "guard variable for ", parse_name(p, &qualified));
+    if (consume(p, 'A'))
+        return new_special(p, "hidden alias for ", parse_encoding(p));
+    if (consume2(p, "Tt"))
+        return new_special(p, "transaction clone for ", parse_encoding(p));
+    if (consume2(p, "Tn"))
+        return new_special(p, "non-transaction clone for ", parse_encoding(p));
+    return fail(p);
+}
+
+// Whether a function name is that of a template, which encodes its return
+// type, but for constructors, destructors and conversion operators
+static int has_return_type(Dm_node *name) {
+    while (name->kind == K_LOCAL)
+        name = name->b;
+    if (name->kind != K_TEMPLATE)
+        return 0;
+    name = name->a;
+    while (name->kind == K_NESTED || name->kind == K_LOCAL)
+        name = name->b;
+    while (name->kind == K_ABI_TAG)
+        name = name->a;
+    return name->kind != K_CTOR && name->kind != K_CONV;
+}
+
+// Encoding within a name. Its template parameters are its own, and the ones
+// of the name around it are back once it is read.
+static Dm_node *parse_inner_encoding(Dm_parser *p) {
+    Dm_node *params = p->params;
+    int type_depth = p->type_depth;
+    Dm_node *encoding;
+
+    p->type_depth = 0;
+    encoding = parse_encoding(p);
+    p->params = params;
+    p->type_depth = type_depth;
+    return encoding;
+}
+
+static Dm_node *parse_encoding(Dm_parser *p) {
+    Dm_node *encoding, *name;
+    int c = peek(p, 0);
+
+    if (++p->depth > DM_DEPTH)
+        return fail(p);
+    if (c == 'T' || (c == 'G' && (peek(p, 1) == 'V' || peek(p, 1) == 'R' || peek(p, 1) == 'A'
+                                  || peek(p, 1) == 'T'))) {
+        encoding = parse_special_name(p);
+        p->depth--;
+        return encoding;
+    }
+
+    if ((encoding = new_node(p, K_ENCODING)) == NULL || (name = parse_name(p, encoding)) == NULL)
+        return fail(p);
+    p->depth--;
+
+    // Data
+    if (p->p >= p->end || peek(p, 0) == 'E' || peek(p, 0) == '.')
+        return name;
+
+    encoding->a = name;
+    if (has_return_type(name) && (encoding->b = parse_type(p)) == NULL)
+        return fail(p);
+    return parse_params(p, encoding, 0);
+}
+
+// Printer
+
+static void out_append(Dm_out *out, const char *s, size_t n) {
+    if (out->error)
+        return;
+    if (out->len + n + 1 > out->cap) {
+        size_t cap = out->cap ? out->cap : 256;
+        while (out->len + n + 1 > cap)
+            cap *= 2;
+        char *buf = cap > DM_OUT_MAX ? NULL : realloc(out->buf, cap);
+        if (buf == NULL) {
+            out->error = 1;
+            return;
+        }
+        out->buf = buf;
+        out->cap = cap;
+    }
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+    if (n > 0)
+        out->last = s[n - 1];
+    out->buf[out->len] = '\0';
+}
+
+static void out_s(Dm_out *out, const char *s) {
+    out_append(out, s, strlen(s));
+}
+
+static char last_char(Dm_out *out) {
+    return out->last;
+}
+
+// Element of a pack being expanded, or node itself. The packs within the
+// element are arguments of its own templates and are not expanded, so index
+// is set to -1 once an element is taken.
+static Dm_node *pack_element_at(Dm_node *node, int *index) {
+    if (node->kind == K_PACK && *index >= 0 && (uint32_t)*index < node->count) {
+        node = node->list[*index];
+        *index = -1;
+    }
+    return node;
+}
+
+static Dm_node *pack_element(Dm_out *out, Dm_node *node) {
+    int index = out->pack_index;
+    return pack_element_at(node, &index);
+}
+
+static int has_function(Dm_out *out, Dm_node *node) {
+    return pack_element(out, node)->kind == K_FUNC;
+}
+
+// Qualified arrays are arrays of qualified elements
+static int has_array(Dm_out *out, Dm_node *node) {
+    int index = out->pack_index;
+
+    node = pack_element_at(node, &index);
+    while (node->kind == K_QUAL)
+        node = pack_element_at(node->a, &index);
+    return node->kind == K_ARRAY;
+}
+
+// Whether a type prints a part after the declarator, as function and array
+// types and the pointers to those do
+static int has_right(Dm_out *out, Dm_node *node) {
+    int index = out->pack_index;
+
+    for (;;) {
+        switch ((node = pack_element_at(node, &index))->kind) {
+            case K_FUNC:
+            case K_ARRAY:
+                return 1;
+            case K_POINTER:
+            case K_QUAL:
+                node = node->a;
+                break;
+            case K_PTRMEM:
+                node = node->b;
+                break;
+            default:
+                return 0;
+        }
+    }
+}
+
+// References to references collapse, to & unless both are &&. Returns the
+// type referred to, setting text to the reference printed. The pack index is
+// dropped when that type is within a pack element, callers restore it.
+static Dm_node *collapse_reference(Dm_out *out, Dm_node *node, const char **text) {
+    Dm_node *pointee = node->a;
+    int index = out->pack_index;
+
+    *text = node->text;
+    if (node->text[0] != '&')
+        return pointee;
+    for (;;) {
+        Dm_node *inner = pack_element_at(pointee, &index);
+        if (inner->kind != K_POINTER || inner->text[0] != '&')
+            return pointee;
+        if (strcmp(inner->text, "&") == 0)
+            *text = "&";
+        pointee = inner->a;
+        out->pack_index = index;
+    }
+}
+
+static void print_left(Dm_out *out, Dm_node *node);
+static void print_right(Dm_out *out, Dm_node *node);
+
+// Nodes of a list joined by ", ". Like c++filt, only the empty ones at the
+// end are left out, as expansions of empty packs.
+static void print_list(Dm_out *out, Dm_node **list, uint32_t count) {
+    size_t keep = out->len;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0)
+            out_s(out, ", ");
+        size_t mark = out->len;
+        print_node(out, list[i]);
+        if (out->len != mark || i == 0)
+            keep = out->len;
+    }
+    out->len = keep;
+    if (out->buf != NULL)
+        out->buf[out->len] = '\0';
+}
+
+static void print_quals(Dm_out *out, int quals) {
+    if (quals & Q_CONST)
+        out_s(out, " const");
+    if (quals & Q_VOLATILE)
+        out_s(out, " volatile");
+    if (quals & Q_RESTRICT)
+        out_s(out, " restrict");
+}
+
+static void print_function_suffix(Dm_out *out, Dm_node *node) {
+    print_quals(out, node->quals);
+    if (node->ref == 1)
+        out_s(out, " &");
+    else if (node->ref == 2)
+        out_s(out, " &&");
+}
+
+// Pack an expansion expands, NULL if none
+static Dm_node *find_pack(Dm_node *node, int depth) {
+    Dm_node *pack = NULL;
+
+    if (node == NULL || depth > DM_DEPTH || node->kind == K_EXPANSION)
+        return NULL;
+    if (node->kind == K_PACK)
+        return node;
+    if ((pack = find_pack(node->a, depth + 1)) != NULL || (pack = find_pack(node->b, depth + 1)) != NULL
+        || (pack = find_pack(node->c, depth + 1)) != NULL)
+        return pack;
+    for (uint32_t i = 0; i < node->count; i++)
+        if ((pack = find_pack(node->list[i], depth + 1)) != NULL)
+            return pack;
+    return NULL;
+}
+
+// Operand of an expression, in parentheses but for names and parameters
+static void print_subexpr(Dm_out *out, Dm_node *node) {
+    int simple = node->kind == K_NAME || node->kind == K_NESTED || node->kind == K_INIT_LIST;
+
+    if (!simple)
+        out_s(out, "(");
+    print_node(out, node);
+    if (!simple)
+        out_s(out, ")");
+}
+
+static void print_literal(Dm_out *out, Dm_node *node) {
+    const char *type = node->a->kind == K_NAME ? node->a->text : NULL;
+    const char *suffix = NULL;
+    const char *value = node->text;
+    uint32_t len = node->len;
+
+    if (type == builtins['b' - 'a'] && len == 1 && (value[0] == '0' || value[0] == '1')) {
+        out_s(out, value[0] == '1' ? "true" : "false");
+        return;
+    }
+    if (type == builtins['i' - 'a'])
+        suffix = "";
+    else if (type == builtins['j' - 'a'])
+        suffix = "u";
+    else if (type == builtins['l' - 'a'])
+        suffix = "l";
+    else if (type == builtins['m' - 'a'])
+        suffix = "ul";
+    else if (type == builtins['x' - 'a'])
+        suffix = "ll";
+    else if (type == builtins['y' - 'a'])
+        suffix = "ull";
+
+    if (suffix == NULL) {
+        out_s(out, "(");
+        print_node(out, node->a);
+        out_s(out, ")");
+    }
+    if (len > 0 && value[0] == 'n') {
+        out_s(out, "-");
+        value++;
+        len--;
+    }
+    out_append(out, value, len);
+    if (suffix != NULL)
+        out_s(out, suffix);
+}
+
+static void print_left(Dm_out *out, Dm_node *node) {
+    if (out->error || ++out->depth > DM_DEPTH) {
+        out->error = 1;
+        return;
+    }
+
+    switch (node->kind) {
+        case K_NAME:
+            out_append(out, node->text, node->len);
+            break;
+        case K_NESTED:
+            print_node(out, node->a);
+            out_s(out, "::");
+            print_node(out, node->b);
+            break;
+        case K_TEMPLATE:
+            print_node(out, node->a);
+            if (last_char(out) == '<')
+                out_s(out, " ");
+            out_s(out, "<");
+            print_node(out, node->b);
+            if (last_char(out) == '>')
+                out_s(out, " ");
+            out_s(out, ">");
+            break;
+        case K_ARGS:
+            print_list(out, node->list, node->count);
+            break;
+        case K_PACK:
+            if (out->pack_index >= 0 && (uint32_t)out->pack_index < node->count) {
+                int saved = out->pack_index;
+                out->pack_index = -1;
+                print_left(out, node->list[saved]);
+                out->pack_index = saved;
+            } else if (out->pack_index < 0)
+                print_list(out, node->list, node->count);
+            break;
+        case K_QUAL: {
+            // Qualifiers already on a substituted type are not repeated
+            Dm_node *inner = pack_element(out, node->a);
+            print_left(out, node->a);
+            print_quals(out, node->quals & ~(inner->kind == K_QUAL ? inner->quals : 0));
+            break;
+        }
+        case K_POINTER: {
+            const char *text;
+            int saved = out->pack_index;
+            Dm_node *pointee = collapse_reference(out, node, &text);
+
+            print_left(out, pointee);
+            if (has_array(out, pointee))
+                out_s(out, " ");
+            if (has_array(out, pointee) || has_function(out, pointee))
+                out_s(out, "(");
+            out_s(out, text);
+            out->pack_index = saved;
+            break;
+        }
+        case K_FUNC:
+            print_left(out, node->a);
+            if (!has_right(out, node->a))
+                out_s(out, " ");
+            break;
+        case K_ARRAY:
+            print_left(out, node->a);
+            break;
+        case K_PTRMEM:
+            print_left(out, node->b);
+            out_s(out, has_array(out, node->b) || has_function(out, node->b) ? "(" : " ");
+            print_node(out, node->a);
+            out_s(out, "::*");
+            break;
+        case K_ENCODING:
+            if (node->b != NULL) {
+                print_left(out, node->b);
+                if (!has_function(out, node->b) && !has_array(out, node->b) && last_char(out) != '(')
+                    out_s(out, " ");
+            }
+            print_node(out, node->a);
+            out_s(out, "(");
+            print_list(out, node->list, node->count);
+            out_s(out, ")");
+            if (node->b != NULL)
+                print_right(out, node->b);
+            print_function_suffix(out, node);
+            break;
+        case K_SPECIAL:
+            out_append(out, node->text, node->len);
+            print_node(out, node->a);
+            break;
+        case K_CTOR_VTABLE:
+            out_s(out, "construction vtable for ");
+            print_node(out, node->b);
+            out_s(out, "-in-");
+            print_node(out, node->a);
+            break;
+        case K_CTOR:
+            if (node->dtor)
+                out_s(out, "~");
+            out_append(out, node->text, node->len);
+            break;
+        case K_CONV:
+            out_s(out, "operator ");
+            print_node(out, node->a);
+            break;
+        case K_ABI_TAG:
+            print_node(out, node->a);
+            out_s(out, "[abi:");
+            out_append(out, node->text, node->len);
+            out_s(out, "]");
+            break;
+        case K_LAMBDA:
+            out_s(out, "{lambda(");
+            print_list(out, node->list, node->count);
+            out_s(out, ")#");
+            out_append(out, node->text, node->len);
+            out_s(out, "}");
+            break;
+        case K_LOCAL:
+            print_node(out, node->a);
+            out_s(out, "::");
+            print_node(out, node->b);
+            break;
+        case K_CLONE:
+            print_node(out, node->a);
+            out_s(out, " [clone ");
+            out_append(out, node->text, node->len);
+            out_s(out, "]");
+            break;
+        case K_EXPANSION: {
+            Dm_node *pack = find_pack(node->a, 0);
+            int saved = out->pack_index;
+
+            if (pack == NULL) {
+                print_node(out, node->a);
+                out_s(out, "...");
+                break;
+            }
+            for (uint32_t i = 0; i < pack->count; i++) {
+                if (i > 0)
+                    out_s(out, ", ");
+                out->pack_index = i;
+                print_node(out, node->a);
+            }
+            out->pack_index = saved;
+            break;
+        }
+        case K_DECLTYPE:
+            out_s(out, "decltype (");
+            print_node(out, node->a);
+            out_s(out, ")");
+            break;
+        case K_VECTOR:
+            print_node(out, node->a);
+            out_s(out, " __vector(");
+            if (node->b != NULL)
+                print_node(out, node->b);
+            out_s(out, ")");
+            break;
+        case K_LITERAL:
+            print_literal(out, node);
+            break;
+        case K_BINARY:
+            // A > in template arguments would close them
+            if (node->text[0] == '>' && node->len == 1)
+                out_s(out, "(");
+            print_subexpr(out, node->a);
+            out_append(out, node->text, node->len);
+            print_subexpr(out, node->b);
+            if (node->text[0] == '>' && node->len == 1)
+                out_s(out, ")");
+            break;
+        case K_PREFIX:
+            out_append(out, node->text, node->len);
+            // The address of a function is printed without its parameters
+            if (node->text[0] == '&' && node->len == 1 && node->a->kind == K_ENCODING
+                && node->a->a->kind == K_NESTED && node->a->quals == 0 && node->a->ref == 0)
+                print_node(out, node->a->a);
+            else
+                print_subexpr(out, node->a);
+            break;
+        case K_POSTFIX:
+            print_subexpr(out, node->a);
+            out_append(out, node->text, node->len);
+            break;
+        case K_TERNARY:
+            print_subexpr(out, node->a);
+            out_s(out, "?");
+            print_subexpr(out, node->b);
+            out_s(out, " : ");
+            print_subexpr(out, node->c);
+            break;
+        case K_CALL:
+            // The parameter types of functions called are left out
+            print_subexpr(out, node->a->kind == K_ENCODING ? node->a->a : node->a);
+            out_s(out, "(");
+            print_list(out, node->list, node->count);
+            out_s(out, ")");
+            break;
+        case K_CAST:
+            out_append(out, node->text, node->len);
+            out_s(out, "<");
+            print_node(out, node->a);
+            out_s(out, ">(");
+            print_node(out, node->b);
+            out_s(out, ")");
+            break;
+        case K_CONVERSION:
+            out_s(out, "(");
+            print_node(out, node->a);
+            out_s(out, ")(");
+            print_list(out, node->list, node->count);
+            out_s(out, ")");
+            break;
+        case K_SIZEOF_TYPE:
+            // The size of a known pack is its number of elements
+            if (node->a->kind == K_PACK && strcmp(node->text, "sizeof...") == 0) {
+                char count[16];
+                snprintf(count, sizeof(count), "%u", node->a->count);
+                out_s(out, count);
+                break;
+            }
+            out_append(out, node->text, node->len);
+            out_s(out, "(");
+            print_node(out, node->a);
+            out_s(out, ")");
+            break;
+        case K_MEMBER:
+            print_subexpr(out, node->a);
+            out_append(out, node->text, node->len);
+            print_node(out, node->b);
+            break;
+        case K_INIT_LIST:
+            if (node->a != NULL)
+                print_node(out, node->a);
+            out_s(out, "{");
+            print_list(out, node->list, node->count);
+            out_s(out, "}");
+            break;
+        default:
+            out->error = 1;
+    }
+    out->depth--;
+}
+
+static void print_right(Dm_out *out, Dm_node *node) {
+    if (out->error || ++out->depth > DM_DEPTH) {
+        out->error = 1;
+        return;
+    }
+
+    switch (node->kind) {
+        case K_PACK:
+            if (out->pack_index >= 0 && (uint32_t)out->pack_index < node->count) {
+                int saved = out->pack_index;
+                out->pack_index = -1;
+                print_right(out, node->list[saved]);
+                out->pack_index = saved;
+            }
+            break;
+        case K_QUAL:
+            print_right(out, node->a);
+            break;
+        case K_POINTER: {
+            const char *text;
+            int saved = out->pack_index;
+            Dm_node *pointee = collapse_reference(out, node, &text);
+
+            if (has_array(out, pointee) || has_function(out, pointee))
+                out_s(out, ")");
+            print_right(out, pointee);
+            out->pack_index = saved;
+            break;
+        }
+        case K_FUNC:
+            out_s(out, "(");
+            print_list(out, node->list, node->count);
+            out_s(out, ")");
+            print_right(out, node->a);
+            print_function_suffix(out, node);
+            if (node->noexcept == 1) {
+                out_s(out, " noexcept");
+            } else if (node->noexcept == 2) {
+                out_s(out, " noexcept(");
+                print_node(out, node->c);
+                out_s(out, ")");
+            }
+            break;
+        case K_ARRAY:
+            if (last_char(out) != ']')
+                out_s(out, " ");
+            out_s(out, "[");
+            if (node->b != NULL)
+                print_node(out, node->b);
+            out_s(out, "]");
+            print_right(out, node->a);
+            break;
+        case K_PTRMEM:
+            if (has_array(out, node->b) || has_function(out, node->b))
+                out_s(out, ")");
+            print_right(out, node->b);
+            break;
+    }
+    out->depth--;
+}
+
+static void print_node(Dm_out *out, Dm_node *node) {
+    print_left(out, node);
+    print_right(out, node);
+}
+
+// Clone suffixes added by the compiler, as in .cold or .constprop.0
+static Dm_node *parse_clones(Dm_parser *p, Dm_node *node) {
+    while (node != NULL && peek(p, 0) == '.') {
+        const char *start = p->p;
+        int c = peek(p, 1);
+
+        if (!is_lower(c) && !is_digit(c) && c != '_')
+            return fail(p);
+        p->p += 2;
+        while (is_lower(peek(p, 0)) || is_digit(peek(p, 0)) || peek(p, 0) == '_')
+            p->p++;
+        while (peek(p, 0) == '.' && is_digit(peek(p, 1))) {
+            p->p += 2;
+            while (is_digit(peek(p, 0)))
+                p->p++;
+        }
+        node = new_pair(p, K_CLONE, node, NULL);
+        if (node != NULL) {
+            node->text = start;
+            node->len = p->p - start;
+        }
+    }
+    return node;
+}
+
+// Escapes of legacy Rust names
+static const struct {
+    const char *code;
+    char c;
+} rust_escapes[] = {
+    { "SP", '@' }, { "BP", '*' }, { "RF", '&' }, { "LT", '<' },
+    { "GT", '>' }, { "LP", '(' }, { "RP", ')' }, { "C", ',' },
+};
+
+// Append a legacy Rust identifier, decoding its escapes. Returns -1 if it is
+// not one.
+static int rust_ident(Dm_out *out, const char *ident, uint64_t len) {
+    const char *end = ident + len;
+
+    if (len >= 2 && ident[0] == '_' && ident[1] == '$')
+        ident++;
+    while (ident < end) {
+        if (*ident == '.') {
+            if (ident + 1 < end && ident[1] == '.') {
+                out_s(out, "::");
+                ident += 2;
+            } else {
+                out_append(out, ident++, 1);
+            }
+            continue;
+        }
+        if (*ident != '$') {
+            out_append(out, ident++, 1);
+            continue;
+        }
+
+        const char *close = memchr(ident + 1, '$', end - ident - 1);
+        if (close == NULL)
+            return -1;
+        size_t n = close - ident - 1;
+        size_t i;
+        for (i = 0; i < sizeof(rust_escapes) / sizeof(rust_escapes[0]); i++)
+            if (strlen(rust_escapes[i].code) == n && memcmp(ident + 1, rust_escapes[i].code, n) == 0)
+                break;
+        if (i < sizeof(rust_escapes) / sizeof(rust_escapes[0])) {
+            out_append(out, &rust_escapes[i].c, 1);
+        } else if (ident[1] == 'u' && n >= 2 && n <= 3) {
+            char hex[3] = { 0 }, *hex_end, c;
+            memcpy(hex, ident + 2, n - 1);
+            c = (char)strtoul(hex, &hex_end, 16);
+            if (*hex_end != '\0')
+                return -1;
+            out_append(out, &c, 1);
+        } else {
+            return -1;
+        }
+        ident = close + 1;
+    }
+    return 0;
+}
+
+// Legacy Rust names look like nested C++ names ending with a hash, h and 16
+// hex digits, and escape what C++ identifiers cannot hold. Returns NULL if
+// name is not one.
+static char *demangle_rust(const char *name) {
+    Dm_parser p = { .p = name + 2, .end = name + strlen(name) };
+    Dm_out out = { .pack_index = -1 };
+    const char *last = NULL;
+    uint64_t len;
+
+    if (!consume(&p, 'N'))
+        return NULL;
+    while (!out.error && is_digit(peek(&p, 0))) {
+        if (parse_number(&p, &len, NULL) < 0 || len == 0 || len > (uint64_t)(p.end - p.p))
+            break;
+        if (out.len > 0)
+            out_s(&out, "::");
+        last = p.p;
+        if (rust_ident(&out, p.p, len) < 0)
+            break;
+        p.p += len;
+    }
+
+    int hash = last != NULL && p.p - last == 17 && last[0] == 'h';
+    for (int i = 1; hash && i < 17; i++)
+        hash = is_digit(last[i]) || (last[i] >= 'a' && last[i] <= 'f');
+    if (!hash || out.error || !consume(&p, 'E') || p.p != p.end) {
+        free(out.buf);
+        return NULL;
+    }
+    return out.buf;
+}
+
+int demangle_candidate(const char *name) {
+    return name[0] == '_' && name[1] == 'Z';
+}
+
+// A mangled name the way c++filt prints it, in memory to free. NULL if it is
+// not one or it cannot be demangled.
+char *demangle(const char *name) {
+    Dm_parser p = { 0 };
+    Dm_out out = { .pack_index = -1 };
+    Dm_node *node;
+
+    if (!demangle_candidate(name))
+        return NULL;
+    if (name[2] == 'N' && (out.buf = demangle_rust(name)) != NULL)
+        return out.buf;
+    p.p = name + 2;
+    p.end = name + strlen(name);
+
+    node = parse_clones(&p, parse_encoding(&p));
+    if (node != NULL && !p.error && p.p == p.end)
+        print_node(&out, node);
+    else
+        out.error = 1;
+
+    while (p.chunks != NULL) {
+        Dm_chunk *next = p.chunks->next;
+        free(p.chunks);
+        p.chunks = next;
+    }
+    free(p.subs);
+
+    if (out.error || out.buf == NULL) {
+        free(out.buf);
+        return NULL;
+    }
+    return out.buf;
+}
+
+// Per file memo of demangled names
+
+// One distinct name. demangled stays NULL when the name cannot be demangled.
+typedef struct {
+    const char *name;
+    uint64_t hash;
+    char *demangled;
+    int done;
+} Dm_text;
+
+// Where a name of a string table was interned: by_address maps name pointers
+// to texts, by_text finds the text of a name found at another address
+struct Demangle_cache {
+    Dm_text *texts;
+    uint64_t text_count;
+    uint64_t text_capacity;
+    uint64_t *by_text;        // Index + 1 into texts, 0 for empty slots
+    uint64_t text_size;       // Power of 2
+    const char **addresses;
+    uint64_t *address_texts;  // Index into texts of addresses[i]
+    uint64_t address_size;    // Power of 2
+    uint64_t address_count;
+};
+
+typedef struct {
+    Dm_text *texts;
+    uint64_t *pending;        // Indexes into texts to demangle
+    uint64_t count;
+    uint64_t next;
+    pthread_mutex_t lock;
+} Dm_work;
+
+static uint64_t hash_name(const char *name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (; *name; name++)
+        hash = (hash ^ (uint8_t)*name) * 0x100000001b3ULL;
+    return hash;
+}
+
+static uint64_t hash_address(const char *name) {
+    uint64_t key = (uint64_t)(uintptr_t)name;
+
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static void *cache_calloc(uint64_t count, size_t size) {
+    void *p = calloc(count, size);
+
+    if (p == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    return p;
+}
+
+static void grow_texts(struct Demangle_cache *cache) {
+    uint64_t size = cache->text_size ? cache->text_size * 2 : 1024;
+    uint64_t *slots = cache_calloc(size, sizeof(uint64_t));
+
+    for (uint64_t i = 0; i < cache->text_count; i++) {
+        uint64_t j = cache->texts[i].hash & (size - 1);
+        while (slots[j] != 0)
+            j = (j + 1) & (size - 1);
+        slots[j] = i + 1;
+    }
+    free(cache->by_text);
+    cache->by_text = slots;
+    cache->text_size = size;
+}
+
+static void grow_addresses(struct Demangle_cache *cache) {
+    uint64_t size = cache->address_size ? cache->address_size * 2 : 1024;
+    const char **addresses = cache_calloc(size, sizeof(char*));
+    uint64_t *texts = cache_calloc(size, sizeof(uint64_t));
+
+    for (uint64_t i = 0; i < cache->address_size; i++) {
+        if (cache->addresses[i] == NULL)
+            continue;
+        uint64_t j = hash_address(cache->addresses[i]) & (size - 1);
+        while (addresses[j] != NULL)
+            j = (j + 1) & (size - 1);
+        addresses[j] = cache->addresses[i];
+        texts[j] = cache->address_texts[i];
+    }
+    free(cache->addresses);
+    free(cache->address_texts);
+    cache->addresses = addresses;
+    cache->address_texts = texts;
+    cache->address_size = size;
+}
+
+// Text of a mangled name, added if new. Names already seen at the same
+// address are found without hashing their text.
+static Dm_text *intern(struct Demangle_cache *cache, const char *name) {
+    if (cache->address_count * 2 >= cache->address_size)
+        grow_addresses(cache);
+
+    uint64_t i = hash_address(name) & (cache->address_size - 1);
+    while (cache->addresses[i] != NULL && cache->addresses[i] != name)
+        i = (i + 1) & (cache->address_size - 1);
+    if (cache->addresses[i] == name)
+        return &cache->texts[cache->address_texts[i]];
+
+    if (cache->text_count * 2 >= cache->text_size)
+        grow_texts(cache);
+
+    uint64_t hash = hash_name(name);
+    uint64_t j = hash & (cache->text_size - 1);
+    while (cache->by_text[j] != 0) {
+        Dm_text *text = &cache->texts[cache->by_text[j] - 1];
+        if (text->hash == hash && strcmp(text->name, name) == 0)
+            break;
+        j = (j + 1) & (cache->text_size - 1);
+    }
+    if (cache->by_text[j] == 0) {
+        if (cache->text_count == cache->text_capacity) {
+            cache->text_capacity = cache->text_capacity ? cache->text_capacity * 2 : 1024;
+            cache->texts = realloc(cache->texts, cache->text_capacity * sizeof(Dm_text));
+            if (cache->texts == NULL) {
+                perror("alfur");
+                exit(1);
+            }
+        }
+        cache->texts[cache->text_count] = (Dm_text){ .name = name, .hash = hash };
+        cache->by_text[j] = ++cache->text_count;
+    }
+
+    cache->addresses[i] = name;
+    cache->address_texts[i] = cache->by_text[j] - 1;
+    cache->address_count++;
+    return &cache->texts[cache->by_text[j] - 1];
+}
+
+static struct Demangle_cache *get_cache(Elf64_data *file) {
+    if (file->demangled == NULL)
+        file->demangled = cache_calloc(1, sizeof(struct Demangle_cache));
+    return file->demangled;
+}
+
+// Name to print for a symbol named name: demangled if it can be, else itself
+const char *demangle_symbol(Elf64_data *file, const char *name) {
+    Dm_text *text;
+
+    if (!demangle_candidate(name))
+        return name;
+    text = intern(get_cache(file), name);
+    if (!text->done) {
+        text->demangled = demangle(name);
+        text->done = 1;
+    }
+    return text->demangled != NULL ? text->demangled : name;
+}
+
+static void *demangle_worker(void *arg) {
+    Dm_work *work = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&work->lock);
+        uint64_t start = work->next;
+        work->next = start + DM_BATCH < work->count ? start + DM_BATCH : work->count;
+        uint64_t end = work->next;
+        pthread_mutex_unlock(&work->lock);
+
+        if (start == end)
+            return NULL;
+        for (uint64_t i = start; i < end; i++) {
+            Dm_text *text = &work->texts[work->pending[i]];
+            text->demangled = demangle(text->name);
+            text->done = 1;
+        }
+    }
+}
+
+// Demangle the names of a symbol table before they are printed, the distinct
+// ones on jobs threads when there are enough of them
+void demangle_prefetch(Elf64_data *file, Elf64_Sym *symbols, uint64_t count, const char *names,
+                       uint64_t names_size, int jobs) {
+    struct Demangle_cache *cache = get_cache(file);
+    Dm_work work = { 0 };
+
+    work.pending = cache_calloc(count ? count : 1, sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; i++) {
+        const char *name = elf_string(names, names_size, symbols[i].st_name);
+
+        if (ELF64_ST_TYPE(symbols[i].st_info) == STT_SECTION || !demangle_candidate(name))
+            continue;
+        Dm_text *text = intern(cache, name);
+        if (!text->done) {
+            // Marked now so that duplicates are queued once
+            text->done = 1;
+            work.pending[work.count++] = text - cache->texts;
+        }
+    }
+    work.texts = cache->texts;
+
+    if (jobs > 1 && work.count >= DM_PARALLEL) {
+        pthread_t threads[jobs];
+        int started = 0;
+
+        pthread_mutex_init(&work.lock, NULL);
+        // Go on with the threads that could be started, or here without any
+        while (started < jobs && pthread_create(&threads[started], NULL, demangle_worker, &work) == 0)
+            started++;
+        if (started == 0)
+            demangle_worker(&work);
+        for (int i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&work.lock);
+    } else {
+        for (uint64_t i = 0; i < work.count; i++) {
+            Dm_text *text = &cache->texts[work.pending[i]];
+            text->demangled = demangle(text->name);
+        }
+    }
+    free(work.pending);
+}
+
+void demangle_release(Elf64_data *file) {
+    struct Demangle_cache *cache = file->demangled;
+
+    if (cache == NULL)
+        return;
+    for (uint64_t i = 0; i < cache->text_count; i++)
+        free(cache->texts[i].demangled);
+    free(cache->texts);
+    free(cache->by_text);
+    free(cache->addresses);
+    free(cache->address_texts);
+    free(cache);
+    file->demangled = NULL;
+}
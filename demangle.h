@@ -0,0 +1,25 @@
+#ifndef DEMANGLE_H
+#define DEMANGLE_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// -C: C++ names (Itanium ABI), and Rust ones of the legacy scheme, demangled
+// the way c++filt prints them. Names that are not mangled, or that cannot be
+// demangled, are printed as they are.
+//
+// The names of a file are demangled once: results are kept by the address of
+// the name in its string table, and by its text, so a name found in both
+// .dynstr and .strtab is only demangled once. The names of a symbol table are
+// demangled ahead of the dump, on a pool of threads when there are many.
+
+char *demangle(const char *name);
+int demangle_candidate(const char *name);
+
+const char *demangle_symbol(Elf64_data *file, const char *name);
+void demangle_prefetch(Elf64_data *file, Elf64_Sym *symbols, uint64_t count, const char *names,
+                       uint64_t names_size, int jobs);
+void demangle_release(Elf64_data *file);
+
+#endif
@@ -0,0 +1,621 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "deps.h"
+#include "elf.h"
+#include "libalfur.h"
+#include "output.h"
+#include "source.h"
+
+#define DEPS_BUCKETS 4096
+
+#define LDCACHE_PATH      "/etc/ld.so.cache"
+#define LDCACHE_OLD_MAGIC "ld.so-1.7.0"
+#define LDCACHE_MAGIC     "glibc-ld.so.cache1.1"
+#define LDCACHE_HEADER    48 // Magic, counts, flags and reserved words
+#define LDCACHE_ENTRY     24 // Flags, name, path, OS version and hwcaps
+
+// Searched last, unless the needing object has DF_1_NODEFLIB
+static const char *default_dirs = "/lib64:/usr/lib64:/lib:/usr/lib";
+
+// States of a library in the cache
+#define DEP_LOADING 0 // Being read by another thread
+#define DEP_OK      1
+#define DEP_MISSING 2 // No such file, or not one that can be loaded
+
+// An object parsed once, kept for the whole run
+typedef struct Dep_lib {
+    char *path;
+    int state;
+    uint8_t class;
+    uint16_t machine;
+    int dynamic;           // Whether it has a dynamic section
+    int nodeflib;          // DF_1_NODEFLIB
+    char *soname;          // NULL when the object has none, same for the others
+    char *rpath;
+    char *runpath;
+    char *interp;
+    char *origin;          // Directory $ORIGIN stands for
+    char **needed;
+    uint32_t needed_count;
+    struct Dep_lib *next;  // In its bucket
+} Dep_lib;
+
+// An object of the graph of one file
+typedef struct {
+    const char *name;   // As in DT_NEEDED
+    int loader;         // Index of the object that needs it, -1 for the file
+    Dep_lib *lib;       // NULL when not found
+} Dep_node;
+
+typedef struct {
+    Dep_node *nodes;
+    uint64_t first;     // Nodes to resolve
+    uint64_t count;
+    uint64_t next;
+    pthread_mutex_t lock;
+} Dep_pool;
+
+// Library of /etc/ld.so.cache
+typedef struct {
+    const char *name;
+    const char *path;
+    uint32_t order; // In the cache, which comes first among the same names
+} Ldcache_entry;
+
+static struct {
+    Dep_lib *buckets[DEPS_BUCKETS];
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;
+} libs = { .lock = PTHREAD_MUTEX_INITIALIZER, .loaded = PTHREAD_COND_INITIALIZER };
+
+static struct {
+    pthread_once_t once;
+    Elf_source source;
+    Ldcache_entry *entries;
+    uint32_t count;
+    const char *library_path; // LD_LIBRARY_PATH
+} ldcache = { .once = PTHREAD_ONCE_INIT };
+
+static void *deps_alloc(size_t size) {
+    void *p = calloc(1, size);
+    if (p == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    return p;
+}
+
+static char *copy_string(const char *s, size_t n) {
+    char *copy = deps_alloc(n + 1);
+    memcpy(copy, s, n);
+    return copy;
+}
+
+static int compare_ldcache(const void *a, const void *b) {
+    const Ldcache_entry *x = a, *y = b;
+    int order = strcmp(x->name, y->name);
+
+    if (order != 0)
+        return order;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+// String at offset of the cache, NULL if it is not within it
+static const char *ldcache_string(const char *base, uint64_t size, uint32_t offset) {
+    if (offset >= size || memchr(base + offset, 0, size - offset) == NULL)
+        return NULL;
+    return base + offset;
+}
+
+// Read the libraries of /etc/ld.so.cache, sorted by name. Entries for
+// glibc-hwcaps subdirectories are left out: which one is loaded depends on
+// the CPU running the program.
+static void ldcache_load(void) {
+    uint64_t start = 0, size;
+    const char *data;
+
+    ldcache.library_path = getenv("LD_LIBRARY_PATH");
+    if (source_open(&ldcache.source, LDCACHE_PATH, 0) < 0)
+        return;
+    size = ldcache.source.size;
+    if ((data = source_fetch(&ldcache.source, 0, size)) == NULL)
+        return;
+
+    // The new format may follow the old one, its offsets are from its start
+    if (size >= 16 && memcmp(data, LDCACHE_OLD_MAGIC, sizeof(LDCACHE_OLD_MAGIC) - 1) == 0) {
+        uint32_t old_count;
+        memcpy(&old_count, data + 12, 4);
+        start = (16 + (uint64_t)old_count * 12 + 7) & ~7ULL;
+    }
+    if (start + LDCACHE_HEADER > size
+        || memcmp(data + start, LDCACHE_MAGIC, sizeof(LDCACHE_MAGIC) - 1) != 0)
+        return;
+
+    const char *base = data + start;
+    uint64_t base_size = size - start;
+    uint32_t count;
+    memcpy(&count, base + 20, 4);
+    if (count > (base_size - LDCACHE_HEADER) / LDCACHE_ENTRY)
+        return;
+
+    ldcache.entries = deps_alloc((count + 1) * sizeof(Ldcache_entry));
+    for (uint32_t i = 0; i < count; i++) {
+        const char *raw = base + LDCACHE_HEADER + (uint64_t)i * LDCACHE_ENTRY;
+        uint32_t key, value;
+        uint64_t hwcap;
+        Ldcache_entry *entry = &ldcache.entries[ldcache.count];
+
+        memcpy(&key, raw + 4, 4);
+        memcpy(&value, raw + 8, 4);
+        memcpy(&hwcap, raw + 16, 8);
+        if (hwcap != 0)
+            continue;
+        entry->name = ldcache_string(base, base_size, key);
+        entry->path = ldcache_string(base, base_size, value);
+        entry->order = i;
+        if (entry->name != NULL && entry->path != NULL)
+            ldcache.count++;
+    }
+    qsort(ldcache.entries, ldcache.count, sizeof(Ldcache_entry), compare_ldcache);
+}
+
+// First entry of the cache for name, the others follow
+static Ldcache_entry *ldcache_find(const char *name) {
+    uint32_t low = 0, high = ldcache.count;
+
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (strcmp(ldcache.entries[mid].name, name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < ldcache.count && strcmp(ldcache.entries[low].name, name) == 0)
+        return &ldcache.entries[low];
+    return NULL;
+}
+
+static uint32_t hash_path(const char *path) {
+    uint32_t hash = 2166136261U;
+
+    while (*path)
+        hash = (hash ^ (uint8_t)*path++) * 16777619U;
+    return hash;
+}
+
+// File offset of size bytes at address in a loaded segment. Returns -1 if no
+// segment holds them all.
+static int address_offset(Elf64_data *file, uint64_t address, uint64_t size, uint64_t *offset) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        if (segment->p_type == PT_LOAD && address >= segment->p_vaddr
+            && address - segment->p_vaddr <= segment->p_filesz
+            && size <= segment->p_filesz - (address - segment->p_vaddr)) {
+            *offset = segment->p_offset + (address - segment->p_vaddr);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Copy of the string at offset of the dynamic string table, NULL if it is
+// out of it
+static char *dynamic_string(const char *strings, uint64_t size, uint64_t offset) {
+    if (strings == NULL || offset >= size)
+        return NULL;
+    return copy_string(strings + offset, strnlen(strings + offset, size - offset));
+}
+
+// Directory of path, with symbolic links resolved first when resolve is set
+static char *path_dir(const char *path, int resolve) {
+    char real[PATH_MAX];
+    const char *slash;
+
+    if (resolve && realpath(path, real) != NULL)
+        path = real;
+    if ((slash = strrchr(path, '/')) == NULL)
+        return copy_string(".", 1);
+    return copy_string(path, slash == path ? 1 : slash - path);
+}
+
+// Fill lib from the headers and dynamic section of file
+static void parse_object(Elf64_data *file, Dep_lib *lib, int resolve) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    uint64_t count, strtab = 0, strsz = 0, offset;
+    const char *strings = NULL;
+    Elf64_Dyn *dyn;
+
+    lib->class = file->elf_head->e_ident[EI_CLASS];
+    lib->machine = file->elf_head->e_machine;
+
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        char *interp;
+        if (segment->p_type == PT_INTERP
+            && (interp = elf_fetch(file, segment->p_offset, segment->p_filesz)) != NULL)
+            lib->interp = copy_string(interp, strnlen(interp, segment->p_filesz));
+    }
+
+    // The loader finds where programs are through /proc/self/exe, links
+    // resolved, and takes the path of libraries as they were found
+    lib->origin = path_dir(lib->path, resolve && lib->interp != NULL);
+
+    if ((dyn = elf_dynamic(file, &count)) == NULL)
+        return;
+    lib->dynamic = 1;
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (dyn[i].d_tag == DT_STRTAB)
+            strtab = dyn[i].d_val;
+        else if (dyn[i].d_tag == DT_STRSZ)
+            strsz = dyn[i].d_val;
+        else if (dyn[i].d_tag == DT_NEEDED)
+            lib->needed_count++;
+        else if (dyn[i].d_tag == DT_FLAGS_1 && (dyn[i].d_val & DF_1_NODEFLIB))
+            lib->nodeflib = 1;
+    }
+    if (address_offset(file, strtab, strsz, &offset) == 0)
+        strings = elf_fetch(file, offset, strsz);
+
+    lib->needed = deps_alloc((lib->needed_count + 1) * sizeof(char*));
+    lib->needed_count = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        char *value;
+
+        switch (dyn[i].d_tag) {
+            case DT_NEEDED:
+                if ((value = dynamic_string(strings, strsz, dyn[i].d_val)) != NULL)
+                    lib->needed[lib->needed_count++] = value;
+                break;
+            case DT_SONAME:
+                lib->soname = dynamic_string(strings, strsz, dyn[i].d_val);
+                break;
+            case DT_RPATH:
+                lib->rpath = dynamic_string(strings, strsz, dyn[i].d_val);
+                break;
+            case DT_RUNPATH:
+                lib->runpath = dynamic_string(strings, strsz, dyn[i].d_val);
+                break;
+        }
+    }
+}
+
+static void free_object(Dep_lib *lib) {
+    for (uint32_t i = 0; i < lib->needed_count; i++)
+        free(lib->needed[i]);
+    free(lib->needed);
+    free(lib->soname);
+    free(lib->rpath);
+    free(lib->runpath);
+    free(lib->interp);
+    free(lib->origin);
+}
+
+// Read the library at lib->path. Returns its state.
+static int read_library(Dep_lib *lib) {
+    Elf64_data file;
+    struct stat st;
+    int state = DEP_MISSING;
+
+    if (stat(lib->path, &st) < 0 || !S_ISREG(st.st_mode))
+        return DEP_MISSING;
+
+    if (alfur_open(&file, lib->path, ALFUR_WARN) < 0)
+        return DEP_MISSING;
+    if (file.elf_head->e_type == ET_DYN) {
+        parse_object(&file, lib, 0);
+        state = DEP_OK;
+    }
+    alfur_close(&file);
+    return state;
+}
+
+// The library at path, read the first time any thread asks for it. Threads
+// asking for one being read wait for it.
+static Dep_lib *load_library(const char *path) {
+    Dep_lib **bucket = &libs.buckets[hash_path(path) % DEPS_BUCKETS];
+    Dep_lib *lib;
+
+    pthread_mutex_lock(&libs.lock);
+    for (lib = *bucket; lib != NULL; lib = lib->next) {
+        if (strcmp(lib->path, path) == 0) {
+            while (lib->state == DEP_LOADING)
+                pthread_cond_wait(&libs.loaded, &libs.lock);
+            pthread_mutex_unlock(&libs.lock);
+            return lib;
+        }
+    }
+    lib = deps_alloc(sizeof(Dep_lib));
+    lib->path = copy_string(path, strlen(path));
+    lib->state = DEP_LOADING;
+    lib->next = *bucket;
+    *bucket = lib;
+    pthread_mutex_unlock(&libs.lock);
+
+    int state = read_library(lib);
+
+    pthread_mutex_lock(&libs.lock);
+    lib->state = state;
+    pthread_cond_broadcast(&libs.loaded);
+    pthread_mutex_unlock(&libs.lock);
+    return lib;
+}
+
+// Whether an object needing libraries can load lib
+static int compatible(const Dep_lib *lib, const Dep_lib *needing) {
+    return lib->state == DEP_OK && lib->class == needing->class && lib->machine == needing->machine;
+}
+
+static const char *platform(uint16_t machine) {
+    switch (machine) {
+        case EM_X86_64:    return "x86_64";
+        case EM_X86:       return "i686";
+        case EM_ARM64:     return "aarch64";
+        case EM_ARM:       return "arm";
+        case EM_RISCV:     return "riscv";
+        case EM_POWERPC:   return "powerpc";
+        case EM_POWERPC64: return "powerpc64";
+        case EM_S390:      return "s390x";
+        default:           return "";
+    }
+}
+
+static int is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Length of the $ORIGIN, $LIB or $PLATFORM token, or its ${} form, at the
+// start of the n bytes of path, 0 if there is none. Sets token to its number.
+static size_t path_token(const char *path, size_t n, int *token) {
+    static const char *tokens[] = { "ORIGIN", "LIB", "PLATFORM" };
+
+    for (int t = 0; t < 3; t++) {
+        size_t len = strlen(tokens[t]);
+
+        *token = t;
+        if (n > len && strncmp(path + 1, tokens[t], len) == 0
+            && (n == len + 1 || !is_name_char(path[len + 1])))
+            return len + 1;
+        if (n > len + 2 && path[1] == '{' && strncmp(path + 2, tokens[t], len) == 0
+            && path[len + 2] == '}')
+            return len + 3;
+    }
+    return 0;
+}
+
+// Expand the tokens of the n bytes of path into out, for owner, the object
+// the path comes from. Returns -1 if the result does not fit.
+static int expand_path(char *out, size_t out_size, const char *path, size_t n, const Dep_lib *owner) {
+    size_t used = 0;
+
+    for (size_t i = 0; i < n; ) {
+        const char *value = path + i;
+        size_t len = 1, skip = 1;
+        int token;
+
+        if (path[i] == '$' && (skip = path_token(path + i, n - i, &token)) > 0) {
+            value = token == 0 ? owner->origin
+                  : token == 1 ? (owner->class == ELFCLASS64 ? "lib64" : "lib")
+                  : platform(owner->machine);
+            len = strlen(value);
+        } else {
+            skip = 1;
+        }
+
+        if (used + len >= out_size)
+            return -1;
+        memcpy(out + used, value, len);
+        used += len;
+        i += skip;
+    }
+    out[used] = '\0';
+    return 0;
+}
+
+// Look for name in the directories of list, a colon-separated list from
+// owner. Returns the first library that needing can load.
+static Dep_lib *search_dirs(const char *list, const Dep_lib *owner, const char *name,
+                            const Dep_lib *needing) {
+    char path[PATH_MAX];
+
+    while (list != NULL && *list) {
+        const char *end = strchr(list, ':');
+        size_t n = end ? (size_t)(end - list) : strlen(list);
+
+        if (n > 0 && expand_path(path, sizeof(path), list, n, owner) == 0
+            && strlen(path) + strlen(name) + 2 <= sizeof(path)) {
+            Dep_lib *lib;
+
+            strcat(path, "/");
+            strcat(path, name);
+            if ((lib = load_library(path)) != NULL && compatible(lib, needing))
+                return lib;
+        }
+        list = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+// Find the library of node in the order of the dynamic loader
+static Dep_lib *resolve(Dep_node *nodes, Dep_node *node) {
+    Dep_lib *needing = nodes[node->loader].lib;
+    Dep_lib *lib;
+
+    if (strchr(node->name, '/') != NULL) {
+        char path[PATH_MAX];
+
+        if (expand_path(path, sizeof(path), node->name, strlen(node->name), needing) < 0)
+            return NULL;
+        lib = load_library(path);
+        return compatible(lib, needing) ? lib : NULL;
+    }
+
+    // DT_RPATH of the object and of those that loaded it, up to the file
+    if (needing->runpath == NULL) {
+        for (int i = node->loader; i >= 0; i = nodes[i].loader) {
+            Dep_lib *owner = nodes[i].lib;
+            if (owner->rpath != NULL && (lib = search_dirs(owner->rpath, owner, node->name, needing)) != NULL)
+                return lib;
+        }
+    }
+
+    // $ORIGIN is the directory of the file in LD_LIBRARY_PATH
+    if ((lib = search_dirs(ldcache.library_path, nodes[0].lib, node->name, needing)) != NULL)
+        return lib;
+    if (needing->runpath != NULL
+        && (lib = search_dirs(needing->runpath, needing, node->name, needing)) != NULL)
+        return lib;
+    if (needing->nodeflib)
+        return NULL;
+
+    for (Ldcache_entry *entry = ldcache_find(node->name);
+         entry != NULL && entry < ldcache.entries + ldcache.count && strcmp(entry->name, node->name) == 0;
+         entry++) {
+        if ((lib = load_library(entry->path)) != NULL && compatible(lib, needing))
+            return lib;
+    }
+
+    return search_dirs(default_dirs, needing, node->name, needing);
+}
+
+static void *deps_worker(void *arg) {
+    Dep_pool *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        uint64_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->count)
+            break;
+        Dep_node *node = &pool->nodes[pool->first + i];
+        node->lib = resolve(pool->nodes, node);
+    }
+
+    return NULL;
+}
+
+// Resolve count nodes from first on jobs threads
+static void resolve_level(Dep_node *nodes, uint64_t first, uint64_t count, int jobs) {
+    Dep_pool pool = { .nodes = nodes, .first = first, .count = count };
+
+    if ((uint64_t)jobs > count)
+        jobs = count;
+    if (jobs <= 1) {
+        for (uint64_t i = first; i < first + count; i++)
+            nodes[i].lib = resolve(nodes, &nodes[i]);
+        return;
+    }
+
+    pthread_t threads[jobs];
+    int started = 0;
+
+    pthread_mutex_init(&pool.lock, NULL);
+    // Go on with the threads that could be started, or here without any
+    while (started < jobs && pthread_create(&threads[started], NULL, deps_worker, &pool) == 0)
+        started++;
+    if (started == 0)
+        deps_worker(&pool);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&pool.lock);
+}
+
+// Whether name was loaded already, as the name of a node or the soname of its
+// library
+static int is_loaded(Dep_node *nodes, uint64_t count, const char *name, const Dep_lib *interp) {
+    if (interp != NULL && interp->soname != NULL && strcmp(interp->soname, name) == 0)
+        return 1;
+    for (uint64_t i = 0; i < count; i++) {
+        if (strcmp(nodes[i].name, name) == 0
+            || (nodes[i].lib != NULL && nodes[i].lib->soname != NULL && strcmp(nodes[i].lib->soname, name) == 0))
+            return 1;
+    }
+    return 0;
+}
+
+// Libraries needed by file, breadth first like the loader maps them, one per
+// line with where it was found, then the interpreter
+int display_deps(Elf64_data *file, const char *elf_path, int jobs) {
+    Output *out = file->out;
+    Dep_lib root = { .path = (char*)elf_path, .state = DEP_OK };
+    Dep_lib *interp = NULL;
+    Dep_node *nodes;
+    uint64_t count = 1, capacity = 16, level = 0;
+
+    pthread_once(&ldcache.once, ldcache_load);
+
+    parse_object(file, &root, 1);
+
+    out_printf(out, "== Dependencies of %s ==\n\n", elf_path);
+    if (!root.dynamic) {
+        out_str(out, "  not dynamically linked\n");
+        free_object(&root);
+        return 0;
+    }
+    if (root.interp != NULL) {
+        interp = load_library(root.interp);
+        if (interp->state != DEP_OK)
+            interp = NULL;
+    }
+
+    nodes = deps_alloc(capacity * sizeof(Dep_node));
+    nodes[0].name = elf_path;
+    nodes[0].loader = -1;
+    nodes[0].lib = &root;
+
+    // Nodes level to count - 1 are the last level found. Names loaded already
+    // are left out before resolving, libraries found under another name after.
+    while (level < count) {
+        uint64_t end = count, first = count;
+
+        for (uint64_t i = level; i < end; i++) {
+            Dep_lib *lib = nodes[i].lib;
+
+            for (uint32_t j = 0; lib != NULL && j < lib->needed_count; j++) {
+                if (is_loaded(nodes, count, lib->needed[j], interp))
+                    continue;
+                if (count == capacity) {
+                    capacity *= 2;
+                    if ((nodes = realloc(nodes, capacity * sizeof(Dep_node))) == NULL) {
+                        perror("alfur");
+                        exit(1);
+                    }
+                }
+                nodes[count].name = lib->needed[j];
+                nodes[count].loader = i;
+                nodes[count].lib = NULL;
+                count++;
+            }
+        }
+
+        resolve_level(nodes, first, count - first, jobs);
+
+        uint64_t kept = first;
+        for (uint64_t i = first; i < count; i++) {
+            int seen = nodes[i].lib != NULL && nodes[i].lib == interp;
+            for (uint64_t j = 1; j < kept && !seen && nodes[i].lib != NULL; j++)
+                seen = nodes[j].lib == nodes[i].lib;
+            if (seen)
+                continue;
+
+            out_printf(out, "  %s => %s\n", nodes[i].name,
+                       nodes[i].lib != NULL ? nodes[i].lib->path : "not found");
+            nodes[kept++] = nodes[i];
+        }
+        count = kept;
+        level = end;
+    }
+
+    if (root.interp != NULL)
+        out_printf(out, "  %s (interpreter%s)\n", root.interp, interp == NULL ? ", not found" : "");
+
+    free(nodes);
+    free_object(&root);
+    return 0;
+}
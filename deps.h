@@ -0,0 +1,18 @@
+#ifndef DEPS_H
+#define DEPS_H
+
+#include "elf.h"
+
+// Shared libraries a file needs, resolved like the dynamic loader does without
+// running anything: DT_RPATH of the needing object and of the objects that
+// loaded it when it has no DT_RUNPATH, LD_LIBRARY_PATH, DT_RUNPATH, then
+// /etc/ld.so.cache and the default directories. $ORIGIN, $LIB and $PLATFORM
+// are expanded in paths.
+//
+// Every library is read once per run into a cache shared by all the threads,
+// so the libraries common to a batch of files are parsed a single time. The
+// libraries of one level of the graph are resolved on a pool of threads.
+
+int display_deps(Elf64_data *file, const char *elf_path, int jobs);
+
+#endif
@@ -0,0 +1,475 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elf.h"
+#include "output.h"
+#include "diff.h"
+
+// Status of a matched pair
+#define DIFF_SAME    0
+#define DIFF_CHANGED 1 // Same size, other contents
+#define DIFF_GROWN   2
+#define DIFF_SHRUNK  3
+#define DIFF_ADDED   4
+#define DIFF_REMOVED 5
+
+typedef struct {
+    const char *name;
+    uint64_t size;
+    uint32_t index; // Section or symbol index, breaks ties between equal names
+    uint32_t type;
+    uint64_t entry; // Its Diff_entry, set by match_items
+} Diff_item;
+
+typedef struct {
+    const char *name;
+    uint64_t old_size;
+    uint64_t new_size;
+    int64_t delta;
+    int status;
+} Diff_entry;
+
+// Contents to hash, either mapped or read by the job itself
+typedef struct {
+    Elf_source *source;
+    const char *data; // NULL when read with pread
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+} Hash_chunk;
+
+typedef struct {
+    Hash_chunk *chunks;
+    uint64_t count;
+    uint64_t next;
+    int error;
+    pthread_mutex_t lock;
+} Hash_pool;
+
+#define P1 0x9e3779b185ebca87ULL
+#define P2 0xc2b2ae3d27d4eb4fULL
+#define P3 0x165667b19e3779f9ULL
+#define P4 0x85ebca77c2b2ae63ULL
+#define P5 0x27d4eb2f165667c5ULL
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * P2, 31) * P1;
+}
+
+static uint64_t hash_merge(uint64_t acc, uint64_t v) {
+    return (acc ^ hash_round(0, v)) * P1 + P4;
+}
+
+// XXH64 of len bytes, 32 bytes per iteration on four independent lanes
+uint64_t hash64(const void *data, uint64_t len, uint64_t seed) {
+    const uint8_t *p = data, *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+
+        for (; end - p >= 32; p += 32) {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = hash_merge(h, v1);
+        h = hash_merge(h, v2);
+        h = hash_merge(h, v3);
+        h = hash_merge(h, v4);
+    } else {
+        h = seed + P5;
+    }
+
+    h += len;
+    for (; end - p >= 8; p += 8)
+        h = rotl(h ^ hash_round(0, read64(p)), 27) * P1 + P4;
+    if (end - p >= 4) {
+        h = rotl(h ^ (read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl(h ^ (*p * P5), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    return h ^ (h >> 32);
+}
+
+static int hash_chunk(Hash_chunk *chunk, char *buf) {
+    const char *data = chunk->data;
+
+    if (data == NULL) {
+        for (uint64_t done = 0; done < chunk->size;) {
+            ssize_t n = pread(chunk->source->fd, buf + done, chunk->size - done, chunk->offset + done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return -1;
+            done += n;
+        }
+        data = buf;
+    }
+
+    chunk->hash = hash64(data, chunk->size, 0);
+    return 0;
+}
+
+static void *hash_worker(void *arg) {
+    Hash_pool *pool = arg;
+    char *buf = malloc(DIFF_CHUNK);
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        uint64_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->count)
+            break;
+        if (buf == NULL || hash_chunk(&pool->chunks[i], buf) < 0) {
+            pthread_mutex_lock(&pool->lock);
+            pool->error = 1;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+// Hash the chunks on jobs threads. Returns -1 if one could not be read.
+static int hash_chunks(Hash_chunk *chunks, uint64_t count, int jobs) {
+    Hash_pool pool = { .chunks = chunks, .count = count };
+
+    if ((uint64_t)jobs > count)
+        jobs = count;
+    if (jobs <= 0)
+        return 0;
+
+    pthread_t threads[jobs];
+    pthread_mutex_init(&pool.lock, NULL);
+    for (int i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, hash_worker, &pool) != 0) {
+            perror("alfur: pthread_create");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < jobs; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&pool.lock);
+
+    return pool.error ? -1 : 0;
+}
+
+// Add the chunks of a section to chunks, which has room for them. Returns the
+// number added, 0 if the section is out of the file.
+static uint64_t add_chunks(Elf64_data *file, Elf64_Shdr *section, Hash_chunk *chunks) {
+    uint64_t n = 0;
+
+    if (section->sh_offset > file->elf_size || section->sh_size > file->elf_size - section->sh_offset)
+        return 0;
+
+    for (uint64_t offset = 0; offset < section->sh_size; offset += DIFF_CHUNK, n++) {
+        Hash_chunk *chunk = &chunks[n];
+
+        chunk->source = &file->source;
+        chunk->offset = section->sh_offset + offset;
+        chunk->size = section->sh_size - offset < DIFF_CHUNK ? section->sh_size - offset : DIFF_CHUNK;
+        // Mapped images are hashed in place, the others read by the workers
+        chunk->data = file->source.kind == SOURCE_PREAD ? NULL
+                    : elf_fetch(file, chunk->offset, chunk->size);
+    }
+    return n;
+}
+
+static uint64_t chunk_count(Elf64_Shdr *section) {
+    return (section->sh_size + DIFF_CHUNK - 1) / DIFF_CHUNK;
+}
+
+static int compare_items(const void *a, const void *b) {
+    const Diff_item *x = a, *y = b;
+    int c = strcmp(x->name, y->name);
+
+    if (c != 0)
+        return c;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const Diff_entry *x = a, *y = b;
+    uint64_t dx = x->delta < 0 ? -(uint64_t)x->delta : (uint64_t)x->delta;
+    uint64_t dy = y->delta < 0 ? -(uint64_t)y->delta : (uint64_t)y->delta;
+
+    // Biggest changes first, then the ones of the same size
+    if (dx != dy)
+        return dx > dy ? -1 : 1;
+    if (x->delta != y->delta)
+        return x->delta > y->delta ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static Diff_item *section_items(Elf64_data *file, uint64_t *count) {
+    uint64_t n = file->elf_head->e_shnum;
+    Diff_item *items = malloc((n + 1) * sizeof(Diff_item));
+
+    *count = 0;
+    if (items == NULL)
+        return NULL;
+    // Section 0 is always empty
+    for (uint64_t i = 1; i < n; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+
+        items[*count].name = elf_section_name(file, section);
+        items[*count].size = section->sh_size;
+        items[*count].index = i;
+        items[*count].type = section->sh_type;
+        (*count)++;
+    }
+    qsort(items, *count, sizeof(Diff_item), compare_items);
+    return items;
+}
+
+// Sized functions and objects, from SYMTAB or DYNSYM when there is none. The
+// names stay in the string tables of the images.
+static Diff_item *symbol_items(Elf64_data *file, uint64_t *count) {
+    Elf64_Shdr *table = NULL;
+
+    *count = 0;
+    for (int i = 0; i < file->elf_head->e_shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+        if (section->sh_type == SHT_SYMTAB || (section->sh_type == SHT_DYNSYM && table == NULL))
+            table = section;
+    }
+
+    Elf64_Sym *syms;
+    char *names;
+    uint64_t names_size;
+    uint64_t sym_num = table == NULL ? 0 : elf_symbols(file, table, &syms, &names, &names_size);
+    Diff_item *items = malloc((sym_num + 1) * sizeof(Diff_item));
+
+    if (items == NULL)
+        return NULL;
+    for (uint64_t i = 0; i < sym_num; i++) {
+        uint8_t type = ELF64_ST_TYPE(syms[i].st_info);
+
+        if (syms[i].st_shndx == SHN_UNDEF
+            || (type != STT_FUNC && type != STT_OBJECT && type != STT_TLS))
+            continue;
+        items[*count].name = elf_string(names, names_size, syms[i].st_name);
+        items[*count].size = syms[i].st_size;
+        items[*count].index = i;
+        items[*count].type = type;
+        (*count)++;
+    }
+    qsort(items, *count, sizeof(Diff_item), compare_items);
+    return items;
+}
+
+// Pair the sorted items by name, the n-th of a name with the n-th of the same
+// name, into entries, which has room for old_n + new_n. pairs[i] is set to the
+// new item matched with old item i, -1 if there is none.
+static uint64_t match_items(Diff_item *old, uint64_t old_n, Diff_item *new, uint64_t new_n,
+                            Diff_entry *entries, int64_t *pairs) {
+    uint64_t i = 0, j = 0, n = 0;
+
+    while (i < old_n || j < new_n) {
+        int c = i == old_n ? 1 : j == new_n ? -1 : strcmp(old[i].name, new[j].name);
+        Diff_entry *entry = &entries[n];
+
+        entry->old_size = c <= 0 ? old[i].size : 0;
+        entry->new_size = c >= 0 ? new[j].size : 0;
+        if (c == 0) {
+            entry->name = old[i].name;
+            entry->status = entry->new_size > entry->old_size ? DIFF_GROWN
+                          : entry->new_size < entry->old_size ? DIFF_SHRUNK : DIFF_SAME;
+            pairs[i] = j;
+        } else if (c < 0) {
+            entry->name = old[i].name;
+            entry->status = DIFF_REMOVED;
+            pairs[i] = -1;
+        } else {
+            entry->name = new[j].name;
+            entry->status = DIFF_ADDED;
+        }
+        entry->delta = (int64_t)(entry->new_size - entry->old_size);
+
+        if (c <= 0)
+            old[i++].entry = n;
+        if (c >= 0)
+            new[j++].entry = n;
+        n++;
+    }
+
+    return n;
+}
+
+static void display_entries(Output *out, const char *title, Diff_entry *entries, uint64_t n) {
+    static const char *status[] = { "same", "changed", "grown", "shrunk", "added", "removed" };
+    uint64_t counts[6] = { 0 };
+    uint64_t shown = 0;
+    int64_t total = 0;
+
+    qsort(entries, n, sizeof(Diff_entry), compare_entries);
+
+    out_printf(out, "\n== %s ==\n", title);
+    for (uint64_t i = 0; i < n; i++) {
+        Diff_entry *entry = &entries[i];
+
+        counts[entry->status]++;
+        total += entry->delta;
+        if (entry->status == DIFF_SAME)
+            continue;
+        if (shown++ == 0)
+            out_char(out, '\n');
+        out_str(out, "  ");
+        out_pad_str(out, status[entry->status], 8, OUT_LEFT);
+        out_char(out, ' ');
+        out_char(out, entry->delta < 0 ? '-' : '+');
+        out_udec(out, entry->delta < 0 ? -(uint64_t)entry->delta : (uint64_t)entry->delta, 11, OUT_LEFT);
+        out_udec(out, entry->old_size, 12, 0);
+        out_str(out, " -> ");
+        out_udec(out, entry->new_size, 12, OUT_LEFT);
+        out_char(out, ' ');
+        out_str(out, entry->name);
+        out_char(out, '\n');
+    }
+
+    out_printf(out, "\n  %lu grown, %lu shrunk, %lu added, %lu removed, %lu changed, %lu same, %+ld bytes\n",
+               counts[DIFF_GROWN], counts[DIFF_SHRUNK], counts[DIFF_ADDED], counts[DIFF_REMOVED],
+               counts[DIFF_CHANGED], counts[DIFF_SAME], total);
+}
+
+static int same_contents(Diff_item *item, int64_t pair, Diff_item *new_items) {
+    return pair >= 0 && item->type != SHT_NOBITS && item->size == new_items[pair].size;
+}
+
+// Hash the sections of both images that have the same size and mark the ones
+// whose contents differ as changed. first, middle and last have room for
+// old_n + 1 entries, chunks for every chunk.
+static int hash_sections(Elf64_data *old, Diff_item *old_items, uint64_t old_n,
+                         Elf64_data *new, Diff_item *new_items, int64_t *pairs,
+                         Diff_entry *entries, Hash_chunk *chunks, uint64_t *first,
+                         uint64_t *middle, uint64_t *last, int jobs) {
+    uint64_t chunk_num = 0;
+
+    for (uint64_t i = 0; i < old_n; i++) {
+        first[i] = middle[i] = last[i] = chunk_num;
+        if (!same_contents(&old_items[i], pairs[i], new_items))
+            continue;
+        chunk_num += add_chunks(old, get_section(old, old_items[i].index), chunks + chunk_num);
+        middle[i] = chunk_num;
+        chunk_num += add_chunks(new, get_section(new, new_items[pairs[i]].index), chunks + chunk_num);
+        last[i] = chunk_num;
+    }
+
+    if (hash_chunks(chunks, chunk_num, jobs) < 0)
+        return -1;
+
+    for (uint64_t i = 0; i < old_n; i++) {
+        Diff_entry *entry = &entries[old_items[i].entry];
+        uint64_t chunk_n = middle[i] - first[i];
+        int same = chunk_n == last[i] - middle[i];
+
+        if (entry->status != DIFF_SAME)
+            continue;
+        for (uint64_t k = 0; same && k < chunk_n; k++)
+            same = chunks[first[i] + k].hash == chunks[middle[i] + k].hash;
+        if (!same)
+            entry->status = DIFF_CHANGED;
+    }
+
+    return 0;
+}
+
+static int diff_sections(Elf64_data *old, Elf64_data *new, Output *out, int jobs) {
+    uint64_t old_n, new_n, chunk_num = 0;
+    Diff_item *old_items = section_items(old, &old_n);
+    Diff_item *new_items = section_items(new, &new_n);
+    Diff_entry *entries = malloc((old_n + new_n + 1) * sizeof(Diff_entry));
+    int64_t *pairs = malloc((old_n + 1) * sizeof(int64_t));
+    uint64_t *bounds = malloc(3 * (old_n + 1) * sizeof(uint64_t));
+    Hash_chunk *chunks = NULL;
+    int status = -1;
+
+    if (old_items != NULL && new_items != NULL && entries != NULL && pairs != NULL && bounds != NULL) {
+        uint64_t n = match_items(old_items, old_n, new_items, new_n, entries, pairs);
+
+        for (uint64_t i = 0; i < old_n; i++)
+            if (same_contents(&old_items[i], pairs[i], new_items))
+                chunk_num += 2 * chunk_count(get_section(old, old_items[i].index));
+
+        if ((chunks = calloc(chunk_num + 1, sizeof(Hash_chunk))) != NULL
+            && hash_sections(old, old_items, old_n, new, new_items, pairs, entries, chunks,
+                             bounds, bounds + old_n + 1, bounds + 2 * (old_n + 1), jobs) == 0) {
+            display_entries(out, "Sections", entries, n);
+            status = 0;
+        }
+    }
+
+    free(old_items);
+    free(new_items);
+    free(entries);
+    free(pairs);
+    free(bounds);
+    free(chunks);
+    return status;
+}
+
+static int diff_symbols(Elf64_data *old, Elf64_data *new, Output *out) {
+    uint64_t old_n, new_n;
+    Diff_item *old_items = symbol_items(old, &old_n);
+    Diff_item *new_items = symbol_items(new, &new_n);
+    Diff_entry *entries = malloc((old_n + new_n + 1) * sizeof(Diff_entry));
+    int64_t *pairs = malloc((old_n + 1) * sizeof(int64_t));
+    int status = -1;
+
+    if (old_items != NULL && new_items != NULL && entries != NULL && pairs != NULL) {
+        uint64_t n = match_items(old_items, old_n, new_items, new_n, entries, pairs);
+        display_entries(out, "Symbols", entries, n);
+        status = 0;
+    }
+
+    free(old_items);
+    free(new_items);
+    free(entries);
+    free(pairs);
+    return status;
+}
+
+// Report the sections and symbols that differ between old and new, biggest
+// byte delta first
+int diff_files(Elf64_data *old, Elf64_data *new, Output *out, int jobs) {
+    if (diff_sections(old, new, out, jobs) < 0) {
+        fprintf(stderr, "Failed comparing the sections\n");
+        return -1;
+    }
+    if (diff_symbols(old, new, out) < 0) {
+        fprintf(stderr, "Failed comparing the symbols\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdint.h>
+
+#include "elf.h"
+#include "output.h"
+
+// Size and layout differences between two images. Sections are matched by
+// name and symbols by name; sections of the same size are told apart by a hash
+// of their contents, computed in chunks by a pool of threads.
+
+#define DIFF_CHUNK (4 << 20) // Bytes hashed by one job
+
+uint64_t hash64(const void *data, uint64_t len, uint64_t seed);
+int diff_files(Elf64_data *old, Elf64_data *new, Output *out, int jobs);
+
+#endif
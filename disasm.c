@@ -0,0 +1,3270 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "demangle.h"
+#include "disasm.h"
+#include "elf.h"
+#include "output.h"
+#include "symindex.h"
+
+// Operand specifiers of the tables, named after the Intel manual: the
+// letter gives where the operand is encoded, the rest its size. b is a
+// byte, w a word, d a doubleword, q a quadword, v the operand size (16,
+// 32 or 64 bits), y 32 or 64 bits by W, z 16 or 32 bits, x a vector of
+// VEX.L, X an xmm register whatever VEX.L is and h half a vector.
+enum {
+    O_NONE,
+    // ModRM rm, register or memory
+    O_Eb, O_Ew, O_Ed, O_Eq, O_Ev, O_Ey, O_Ev64,
+    O_Es,           // Ev of moves of segment registers, memory of no size
+    O_M,            // Memory only
+    O_Rq,           // Register only, 64 bits
+    O_Ry,
+    // ModRM reg
+    O_Gb, O_Gw, O_Gd, O_Gv, O_Gy, O_Gq,
+    O_Sw, O_Cq, O_Dq,
+    // Register in the low 3 bits of the opcode
+    O_Zb, O_Zv, O_Zv64, O_Zy,
+    // Fixed registers
+    O_AL, O_CL, O_AX, O_DX, O_rAX, O_eAX, O_FS, O_GS, O_XMM0, O_ST, O_STi,
+    // Immediates and addresses
+    O_Ib, O_Ibs, O_Iw, O_Iz, O_Iv,
+    O_Jb, O_Jz,
+    O_Ob, O_Ov,
+    O_Xb, O_Xv, O_Xz, O_Yb, O_Yv, O_Yz,
+    O_XLAT,         // (%rbx) of xlat
+    // MMX registers of ModRM reg, rm or memory, rm register
+    O_Pq, O_Qq, O_Nq,
+    O_QX,           // MMX Qq, or an xmm register or memory like WX with 66
+    // Vector registers of ModRM reg, rm or memory, rm register, VEX.vvvv and
+    // bits 7:4 of an immediate
+    O_Vx, O_Wx, O_Ux, O_Hx, O_Lx,
+    O_VX, O_WX, O_UX, O_HX,
+    O_Vh, O_Wh,
+    O_By,           // VEX.vvvv general register
+    O_Kr, O_Km, O_Kv, O_Ku, // Mask registers of ModRM reg, rm or memory, VEX.vvvv, rm register
+};
+
+// Kinds of table entries, instructions or sub-tables selected by
+#define K_INSN   0
+#define K_GROUP  1 // ModRM reg
+#define K_PREFIX 2 // Mandatory prefix: none, 66, F3, F2
+#define K_MOD    3 // Memory or register form
+#define K_RM     4 // ModRM rm of a register form
+#define K_W      5 // REX.W or VEX.W
+#define K_L      6 // VEX.L
+#define K_VEX    7 // Legacy or VEX encoding
+#define K_X87    8 // Escape D8 to DF, see x87_table
+
+// Table flags
+#define F_S      0x1       // Size suffix unless a register gives the size
+#define F_S64    0x2       // Same but for 64 bits
+#define F_SM     0x4       // Size suffix of a memory operand only
+#define F_SG     0x8       // Size suffix of the destination always, after the source one
+#define F_D64    0x10      // 64 bits operand size by default
+#define F_F64    0x20      // 64 bits operand size always
+#define F_SIZES  0x40      // Name holds the variants of 16, 32 and 64 bits, split by '|'
+#define F_WNAME  0x80      // Name holds the variants of W0 and W1
+#define F_V      0x100     // Also encoded with VEX, v prepended to the name
+#define F_VO     0x200     // Only encoded with VEX or EVEX
+#define F_NDS    0x400     // VEX.vvvv is a second source, after the destination
+#define F_NDD    0x800     // VEX.vvvv is the destination
+#define F_REP    0x1000    // F3 is rep rather than repz
+#define F_CMP    0x2000    // Immediate comparison predicate folded into the name
+#define F_CALL   0x4000
+#define F_JUMP   0x8000
+#define F_COND   0x10000
+#define F_RET    0x20000
+#define F_IND    0x40000   // Operand printed with *
+#define F_OPSIZE 0x80000   // 66 selects the operand size, not the entry
+#define F_MMX    0x100000  // MMX registers, xmm ones with 66
+#define F_P66    0x200000  // Only with 66
+#define F_NP     0x400000  // Only without mandatory prefix
+#define F_NOREV  0x800000  // Operands in Intel order
+#define F_XY     0x1000000 // x or y suffix for a memory operand whose size is ambiguous
+#define F_PCLMUL 0x2000000 // Immediate folded into the name of pclmulqdq
+#define F_ICMP   0x4000000 // Immediate integer comparison predicate folded into the name
+#define F_KSIZE  0x8000000 // Mask register size suffix, see mask_suffix
+#define F_W4     0x10000000 // W swaps the last two sources, of FMA4 and XOP
+#define F_BAD    0x20000000 // Invalid but decoded with its operands
+#define F_ANAME  0x40000000 // Name holds the variants of 64 and 32 bits addresses
+
+// Size of the memory operand of EVEX instructions, that scales 8 bits
+// displacements, when the operand specifier does not give it
+#define T_FULL    0 // Vector, or element with a broadcast
+#define T_BYTE    1
+#define T_WORD    2
+#define T_QUARTER 3 // Quarter of the vector
+#define T_EIGHTH  4
+#define T_16      5 // 128 bits
+#define T_32      6 // 256 bits
+
+typedef struct Opcode {
+    const char *name;
+    uint8_t op[4];
+    uint32_t flags;
+    uint8_t kind;
+    uint8_t tuple;
+    const struct Opcode *sub;
+} Opcode;
+
+#define I(name, a, b, c, flags)     { name, { a, b, c, 0 }, flags, K_INSN, T_FULL, NULL }
+#define I4(name, a, b, c, d, flags) { name, { a, b, c, d }, flags, K_INSN, T_FULL, NULL }
+#define E(name, a, b, c, flags, tuple) { name, { a, b, c, 0 }, flags, K_INSN, tuple, NULL }
+#define E4(name, a, b, c, d, flags, tuple) { name, { a, b, c, d }, flags, K_INSN, tuple, NULL }
+#define T(kind, table)              { NULL, { 0 }, 0, kind, T_FULL, table }
+// Sub-table whose entries without operands take these
+#define TO(kind, table, a, b, c, flags) { NULL, { a, b, c, 0 }, flags, kind, T_FULL, table }
+#define BAD                         { NULL, { 0 }, 0, K_INSN, T_FULL, NULL }
+
+#define CC16(prefix, a, b, flags) \
+    I(prefix "o", a, b, 0, flags), I(prefix "no", a, b, 0, flags), \
+    I(prefix "b", a, b, 0, flags), I(prefix "ae", a, b, 0, flags), \
+    I(prefix "e", a, b, 0, flags), I(prefix "ne", a, b, 0, flags), \
+    I(prefix "be", a, b, 0, flags), I(prefix "a", a, b, 0, flags), \
+    I(prefix "s", a, b, 0, flags), I(prefix "ns", a, b, 0, flags), \
+    I(prefix "p", a, b, 0, flags), I(prefix "np", a, b, 0, flags), \
+    I(prefix "l", a, b, 0, flags), I(prefix "ge", a, b, 0, flags), \
+    I(prefix "le", a, b, 0, flags), I(prefix "g", a, b, 0, flags)
+
+#define ALU(name) \
+    I(name, O_Eb, O_Gb, 0, F_S), I(name, O_Ev, O_Gv, 0, F_S), \
+    I(name, O_Gb, O_Eb, 0, F_S), I(name, O_Gv, O_Ev, 0, F_S), \
+    I(name, O_AL, O_Ib, 0, F_S), I(name, O_rAX, O_Iz, 0, F_S)
+
+#define R8(name, a, b, flags) \
+    I(name, a, b, 0, flags), I(name, a, b, 0, flags), I(name, a, b, 0, flags), I(name, a, b, 0, flags), \
+    I(name, a, b, 0, flags), I(name, a, b, 0, flags), I(name, a, b, 0, flags), I(name, a, b, 0, flags)
+
+#define BRANCH (F_JUMP | F_COND | F_F64)
+
+// Scalar and packed single and double floating point operations
+#define SSE4(name, flags) { \
+    I(name "ps", O_Vx, O_Wx, 0, F_V | flags), I(name "pd", O_Vx, O_Wx, 0, F_V | flags), \
+    I(name "ss", O_VX, O_WX, 0, F_V | F_NDS), I(name "sd", O_VX, O_WX, 0, F_V | F_NDS) }
+#define SSE2(name, flags) { \
+    I(name "ps", O_Vx, O_Wx, 0, F_V | flags), I(name "pd", O_Vx, O_Wx, 0, F_V | flags), BAD, BAD }
+
+// One byte map
+
+static const Opcode grp1[8] = {
+    I("add", 0, 0, 0, 0), I("or", 0, 0, 0, 0), I("adc", 0, 0, 0, 0), I("sbb", 0, 0, 0, 0),
+    I("and", 0, 0, 0, 0), I("sub", 0, 0, 0, 0), I("xor", 0, 0, 0, 0), I("cmp", 0, 0, 0, 0),
+};
+
+static const Opcode grp1a[8] = {
+    I("pop", O_Ev64, 0, 0, F_S64 | F_D64), BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+};
+
+static const Opcode grp2[8] = {
+    I("rol", 0, 0, 0, 0), I("ror", 0, 0, 0, 0), I("rcl", 0, 0, 0, 0), I("rcr", 0, 0, 0, 0),
+    I("shl", 0, 0, 0, 0), I("shr", 0, 0, 0, 0), I("shl", 0, 0, 0, 0), I("sar", 0, 0, 0, 0),
+};
+
+static const Opcode grp3b[8] = {
+    I("test", O_Eb, O_Ib, 0, F_S), I("test", O_Eb, O_Ib, 0, F_S),
+    I("not", O_Eb, 0, 0, F_S), I("neg", O_Eb, 0, 0, F_S),
+    I("mul", O_Eb, 0, 0, F_S), I("imul", O_Eb, 0, 0, F_S),
+    I("div", O_Eb, 0, 0, F_S), I("idiv", O_Eb, 0, 0, F_S),
+};
+
+static const Opcode grp3v[8] = {
+    I("test", O_Ev, O_Iz, 0, F_S), I("test", O_Ev, O_Iz, 0, F_S),
+    I("not", O_Ev, 0, 0, F_S), I("neg", O_Ev, 0, 0, F_S),
+    I("mul", O_Ev, 0, 0, F_S), I("imul", O_Ev, 0, 0, F_S),
+    I("div", O_Ev, 0, 0, F_S), I("idiv", O_Ev, 0, 0, F_S),
+};
+
+static const Opcode grp4[8] = {
+    I("inc", O_Eb, 0, 0, F_S), I("dec", O_Eb, 0, 0, F_S), BAD, BAD, BAD, BAD, BAD, BAD,
+};
+
+static const Opcode grp5[8] = {
+    I("inc", O_Ev, 0, 0, F_S), I("dec", O_Ev, 0, 0, F_S),
+    I("call", O_Ev64, 0, 0, F_S64 | F_F64 | F_CALL | F_IND), I("lcall", O_M, 0, 0, F_IND),
+    I("jmp", O_Ev64, 0, 0, F_S64 | F_F64 | F_JUMP | F_IND), I("ljmp", O_M, 0, 0, F_IND),
+    I("push", O_Ev64, 0, 0, F_S64 | F_D64), BAD,
+};
+
+static const Opcode xabort[8] = { I("xabort", O_Ib, 0, 0, 0), BAD, BAD, BAD, BAD, BAD, BAD, BAD };
+static const Opcode xbegin[8] = { I("xbegin", O_Jz, 0, 0, 0), BAD, BAD, BAD, BAD, BAD, BAD, BAD };
+static const Opcode grp11b_7[2] = { BAD, T(K_RM, xabort) };
+static const Opcode grp11v_7[2] = { BAD, T(K_RM, xbegin) };
+
+static const Opcode grp11b[8] = {
+    I("mov", O_Eb, O_Ib, 0, F_S), BAD, BAD, BAD, BAD, BAD, BAD, T(K_MOD, grp11b_7),
+};
+
+static const Opcode grp11v[8] = {
+    I("mov", O_Ev, O_Iz, 0, F_S), BAD, BAD, BAD, BAD, BAD, BAD, T(K_MOD, grp11v_7),
+};
+
+static const Opcode nop90[4] = {
+    I("nop", 0, 0, 0, 0), I("xchg", O_Zv, O_rAX, 0, F_OPSIZE), I("pause", 0, 0, 0, 0), I("nop", 0, 0, 0, 0),
+};
+
+static const Opcode one_byte[256] = {
+    ALU("add"), BAD, BAD,
+    ALU("or"), BAD, BAD,
+    ALU("adc"), BAD, BAD,
+    ALU("sbb"), BAD, BAD,
+    ALU("and"), BAD, BAD,
+    ALU("sub"), BAD, BAD,
+    ALU("xor"), BAD, BAD,
+    ALU("cmp"), BAD, BAD,
+    // 40: REX prefixes
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    R8("push", O_Zv64, 0, F_D64), R8("pop", O_Zv64, 0, F_D64),
+    // 60
+    BAD, BAD, BAD, I("movsxd|movsxd|movslq", O_Gv, O_Ed, 0, F_SIZES),
+    BAD, BAD, BAD, BAD,
+    I("push", O_Iz, 0, 0, F_S64 | F_D64), I("imul", O_Gv, O_Ev, O_Iz, 0),
+    I("push", O_Ibs, 0, 0, F_S64 | F_D64), I("imul", O_Gv, O_Ev, O_Ibs, 0),
+    I("ins", O_Yb, O_DX, 0, F_S | F_REP), I("ins", O_Yz, O_DX, 0, F_S | F_REP),
+    I("outs", O_DX, O_Xb, 0, F_S | F_REP), I("outs", O_DX, O_Xz, 0, F_S | F_REP),
+    // 70
+    CC16("j", O_Jb, 0, BRANCH),
+    // 80
+    TO(K_GROUP, grp1, O_Eb, O_Ib, 0, F_S), TO(K_GROUP, grp1, O_Ev, O_Iz, 0, F_S),
+    BAD, TO(K_GROUP, grp1, O_Ev, O_Ibs, 0, F_S),
+    I("test", O_Eb, O_Gb, 0, F_S), I("test", O_Ev, O_Gv, 0, F_S),
+    I("xchg", O_Eb, O_Gb, 0, F_S), I("xchg", O_Ev, O_Gv, 0, F_S),
+    I("mov", O_Eb, O_Gb, 0, F_S), I("mov", O_Ev, O_Gv, 0, F_S),
+    I("mov", O_Gb, O_Eb, 0, F_S), I("mov", O_Gv, O_Ev, 0, F_S),
+    I("mov", O_Es, O_Sw, 0, 0), I("lea", O_Gv, O_M, 0, 0),
+    I("mov", O_Sw, O_Es, 0, 0), T(K_GROUP, grp1a),
+    // 90
+    T(K_PREFIX, nop90), I("xchg", O_Zv, O_rAX, 0, 0), I("xchg", O_Zv, O_rAX, 0, 0), I("xchg", O_Zv, O_rAX, 0, 0),
+    I("xchg", O_Zv, O_rAX, 0, 0), I("xchg", O_Zv, O_rAX, 0, 0), I("xchg", O_Zv, O_rAX, 0, 0), I("xchg", O_Zv, O_rAX, 0, 0),
+    I("cbtw|cwtl|cltq", 0, 0, 0, F_SIZES), I("cwtd|cltd|cqto", 0, 0, 0, F_SIZES),
+    BAD, I("fwait", 0, 0, 0, 0),
+    I("pushf", 0, 0, 0, F_S64 | F_D64), I("popf", 0, 0, 0, F_S64 | F_D64),
+    I("sahf", 0, 0, 0, 0), I("lahf", 0, 0, 0, 0),
+    // A0
+    I("movabs|mov", O_AL, O_Ob, 0, F_ANAME), I("movabs|mov", O_rAX, O_Ov, 0, F_ANAME),
+    I("movabs|mov", O_Ob, O_AL, 0, F_ANAME), I("movabs|mov", O_Ov, O_rAX, 0, F_ANAME),
+    I("movs", O_Yb, O_Xb, 0, F_S | F_REP), I("movs", O_Yv, O_Xv, 0, F_S | F_REP),
+    I("cmps", O_Xb, O_Yb, 0, F_S), I("cmps", O_Xv, O_Yv, 0, F_S),
+    I("test", O_AL, O_Ib, 0, F_S), I("test", O_rAX, O_Iz, 0, F_S),
+    I("stos", O_Yb, O_AL, 0, F_S | F_REP), I("stos", O_Yv, O_rAX, 0, F_S | F_REP),
+    I("lods", O_AL, O_Xb, 0, F_S | F_REP), I("lods", O_rAX, O_Xv, 0, F_S | F_REP),
+    I("scas", O_AL, O_Yb, 0, F_S), I("scas", O_rAX, O_Yv, 0, F_S),
+    // B0
+    R8("mov", O_Zb, O_Ib, 0), R8("mov|mov|movabs", O_Zv, O_Iv, F_SIZES),
+    // C0
+    TO(K_GROUP, grp2, O_Eb, O_Ib, 0, F_S), TO(K_GROUP, grp2, O_Ev, O_Ib, 0, F_S),
+    I("ret", O_Iw, 0, 0, F_S64 | F_D64 | F_RET), I("ret", 0, 0, 0, F_S64 | F_D64 | F_RET),
+    BAD, BAD, T(K_GROUP, grp11b), T(K_GROUP, grp11v),
+    I("enter", O_Iw, O_Ib, 0, F_S64 | F_D64 | F_NOREV), I("leave", 0, 0, 0, F_S64 | F_D64),
+    I("lretw|lret|lretq", O_Iw, 0, 0, F_SIZES | F_RET), I("lretw|lret|lretq", 0, 0, 0, F_SIZES | F_RET),
+    I("int3", 0, 0, 0, 0), I("int", O_Ib, 0, 0, 0), BAD, I("iretw|iret|iretq", 0, 0, 0, F_SIZES | F_RET),
+    // D0
+    TO(K_GROUP, grp2, O_Eb, 0, 0, F_S), TO(K_GROUP, grp2, O_Ev, 0, 0, F_S),
+    TO(K_GROUP, grp2, O_Eb, O_CL, 0, F_S), TO(K_GROUP, grp2, O_Ev, O_CL, 0, F_S),
+    BAD, BAD, BAD, I("xlat", O_XLAT, 0, 0, 0),
+    T(K_X87, NULL), T(K_X87, NULL), T(K_X87, NULL), T(K_X87, NULL),
+    T(K_X87, NULL), T(K_X87, NULL), T(K_X87, NULL), T(K_X87, NULL),
+    // E0
+    I("loopne", O_Jb, 0, 0, BRANCH), I("loope", O_Jb, 0, 0, BRANCH),
+    I("loop", O_Jb, 0, 0, BRANCH), I("jrcxz", O_Jb, 0, 0, BRANCH),
+    I("in", O_AL, O_Ib, 0, F_S), I("in", O_eAX, O_Ib, 0, F_S),
+    I("out", O_Ib, O_AL, 0, F_S), I("out", O_Ib, O_eAX, 0, F_S),
+    I("call", O_Jz, 0, 0, F_CALL | F_F64), I("jmp", O_Jz, 0, 0, F_JUMP | F_F64),
+    BAD, I("jmp", O_Jb, 0, 0, F_JUMP | F_F64),
+    I("in", O_AL, O_DX, 0, F_S), I("in", O_eAX, O_DX, 0, F_S),
+    I("out", O_DX, O_AL, 0, F_S), I("out", O_DX, O_eAX, 0, F_S),
+    // F0
+    BAD, I("int1", 0, 0, 0, 0), BAD, BAD,
+    I("hlt", 0, 0, 0, 0), I("cmc", 0, 0, 0, 0), T(K_GROUP, grp3b), T(K_GROUP, grp3v),
+    I("clc", 0, 0, 0, 0), I("stc", 0, 0, 0, 0), I("cli", 0, 0, 0, 0), I("sti", 0, 0, 0, 0),
+    I("cld", 0, 0, 0, 0), I("std", 0, 0, 0, 0), T(K_GROUP, grp4), T(K_GROUP, grp5),
+};
+
+// x87, by escape byte then ModRM reg for memory forms
+
+static const char *x87_memory[8][8] = {
+    { "fadds", "fmuls", "fcoms", "fcomps", "fsubs", "fsubrs", "fdivs", "fdivrs" },
+    { "flds", NULL, "fsts", "fstps", "fldenv", "fldcw", "fnstenv", "fnstcw" },
+    { "fiaddl", "fimull", "ficoml", "ficompl", "fisubl", "fisubrl", "fidivl", "fidivrl" },
+    { "fildl", "fisttpl", "fistl", "fistpl", NULL, "fldt", NULL, "fstpt" },
+    { "faddl", "fmull", "fcoml", "fcompl", "fsubl", "fsubrl", "fdivl", "fdivrl" },
+    { "fldl", "fisttpll", "fstl", "fstpl", "frstor", NULL, "fnsave", "fnstsw" },
+    { "fiadds", "fimuls", "ficoms", "ficomps", "fisubs", "fisubrs", "fidivs", "fidivrs" },
+    { "filds", "fisttps", "fists", "fistps", "fbld", "fildll", "fbstp", "fistpll" },
+};
+
+static const Opcode d9_2[8] = { I("fnop", 0, 0, 0, 0), BAD, BAD, BAD, BAD, BAD, BAD, BAD };
+static const Opcode d9_4[8] = {
+    I("fchs", 0, 0, 0, 0), I("fabs", 0, 0, 0, 0), BAD, BAD, I("ftst", 0, 0, 0, 0), I("fxam", 0, 0, 0, 0), BAD, BAD,
+};
+static const Opcode d9_5[8] = {
+    I("fld1", 0, 0, 0, 0), I("fldl2t", 0, 0, 0, 0), I("fldl2e", 0, 0, 0, 0), I("fldpi", 0, 0, 0, 0),
+    I("fldlg2", 0, 0, 0, 0), I("fldln2", 0, 0, 0, 0), I("fldz", 0, 0, 0, 0), BAD,
+};
+static const Opcode d9_6[8] = {
+    I("f2xm1", 0, 0, 0, 0), I("fyl2x", 0, 0, 0, 0), I("fptan", 0, 0, 0, 0), I("fpatan", 0, 0, 0, 0),
+    I("fxtract", 0, 0, 0, 0), I("fprem1", 0, 0, 0, 0), I("fdecstp", 0, 0, 0, 0), I("fincstp", 0, 0, 0, 0),
+};
+static const Opcode d9_7[8] = {
+    I("fprem", 0, 0, 0, 0), I("fyl2xp1", 0, 0, 0, 0), I("fsqrt", 0, 0, 0, 0), I("fsincos", 0, 0, 0, 0),
+    I("frndint", 0, 0, 0, 0), I("fscale", 0, 0, 0, 0), I("fsin", 0, 0, 0, 0), I("fcos", 0, 0, 0, 0),
+};
+static const Opcode da_5[8] = { BAD, I("fucompp", 0, 0, 0, 0), BAD, BAD, BAD, BAD, BAD, BAD };
+static const Opcode db_4[8] = {
+    I("fneni(8087 only)", 0, 0, 0, 0), I("fndisi(8087 only)", 0, 0, 0, 0), I("fnclex", 0, 0, 0, 0), I("fninit", 0, 0, 0, 0),
+    I("fnsetpm(287 only)", 0, 0, 0, 0), I("frstpm(287 only)", 0, 0, 0, 0), BAD, BAD,
+};
+static const Opcode de_3[8] = { BAD, I("fcompp", 0, 0, 0, 0), BAD, BAD, BAD, BAD, BAD, BAD };
+static const Opcode df_4[8] = { I("fnstsw", O_AX, 0, 0, 0), BAD, BAD, BAD, BAD, BAD, BAD, BAD };
+
+// Register forms, by escape byte then ModRM reg
+static const Opcode x87_register[8][8] = {
+    {
+        I("fadd", O_ST, O_STi, 0, 0), I("fmul", O_ST, O_STi, 0, 0), I("fcom", O_STi, 0, 0, 0), I("fcomp", O_STi, 0, 0, 0),
+        I("fsub", O_ST, O_STi, 0, 0), I("fsubr", O_ST, O_STi, 0, 0), I("fdiv", O_ST, O_STi, 0, 0), I("fdivr", O_ST, O_STi, 0, 0),
+    }, {
+        I("fld", O_STi, 0, 0, 0), I("fxch", O_STi, 0, 0, 0), T(K_RM, d9_2), BAD,
+        T(K_RM, d9_4), T(K_RM, d9_5), T(K_RM, d9_6), T(K_RM, d9_7),
+    }, {
+        I("fcmovb", O_ST, O_STi, 0, 0), I("fcmove", O_ST, O_STi, 0, 0),
+        I("fcmovbe", O_ST, O_STi, 0, 0), I("fcmovu", O_ST, O_STi, 0, 0), BAD, T(K_RM, da_5), BAD, BAD,
+    }, {
+        I("fcmovnb", O_ST, O_STi, 0, 0), I("fcmovne", O_ST, O_STi, 0, 0),
+        I("fcmovnbe", O_ST, O_STi, 0, 0), I("fcmovnu", O_ST, O_STi, 0, 0),
+        T(K_RM, db_4), I("fucomi", O_ST, O_STi, 0, 0), I("fcomi", O_ST, O_STi, 0, 0), BAD,
+    }, {
+        // The AT&T names of fsub and fdiv are swapped with a register destination
+        I("fadd", O_STi, O_ST, 0, 0), I("fmul", O_STi, O_ST, 0, 0), BAD, BAD,
+        I("fsub", O_STi, O_ST, 0, 0), I("fsubr", O_STi, O_ST, 0, 0), I("fdiv", O_STi, O_ST, 0, 0), I("fdivr", O_STi, O_ST, 0, 0),
+    }, {
+        I("ffree", O_STi, 0, 0, 0), BAD, I("fst", O_STi, 0, 0, 0), I("fstp", O_STi, 0, 0, 0),
+        I("fucom", O_STi, 0, 0, 0), I("fucomp", O_STi, 0, 0, 0), BAD, BAD,
+    }, {
+        I("faddp", O_STi, O_ST, 0, 0), I("fmulp", O_STi, O_ST, 0, 0), BAD, T(K_RM, de_3),
+        I("fsubp", O_STi, O_ST, 0, 0), I("fsubrp", O_STi, O_ST, 0, 0), I("fdivp", O_STi, O_ST, 0, 0), I("fdivrp", O_STi, O_ST, 0, 0),
+    }, {
+        I("ffreep", O_STi, 0, 0, 0), BAD, BAD, BAD, T(K_RM, df_4), I("fucomip", O_ST, O_STi, 0, 0), I("fcomip", O_ST, O_STi, 0, 0), BAD,
+    },
+};
+
+// 0F map
+
+static const Opcode grp6[8] = {
+    I("sldt", O_Ev, 0, 0, 0), I("str", O_Ev, 0, 0, 0), I("lldt", O_Ew, 0, 0, 0), I("ltr", O_Ew, 0, 0, 0),
+    I("verr", O_Ew, 0, 0, 0), I("verw", O_Ew, 0, 0, 0), BAD, BAD,
+};
+
+static const Opcode grp7_mem[8] = {
+    I("sgdt", O_M, 0, 0, 0), I("sidt", O_M, 0, 0, 0), I("lgdt", O_M, 0, 0, 0), I("lidt", O_M, 0, 0, 0),
+    I("smsw", O_Ew, 0, 0, 0), BAD, I("lmsw", O_Ew, 0, 0, 0), I("invlpg", O_M, 0, 0, 0),
+};
+static const Opcode grp7_0[8] = {
+    BAD, I("vmcall", 0, 0, 0, 0), I("vmlaunch", 0, 0, 0, 0), I("vmresume", 0, 0, 0, 0),
+    I("vmxoff", 0, 0, 0, 0), I("pconfig", 0, 0, 0, 0), BAD, BAD,
+};
+static const Opcode grp7_1[8] = {
+    I("monitor", 0, 0, 0, 0), I("mwait", 0, 0, 0, 0), I("clac", 0, 0, 0, 0), I("stac", 0, 0, 0, 0),
+    BAD, BAD, BAD, I("encls", 0, 0, 0, 0),
+};
+static const Opcode grp7_2[8] = {
+    I("xgetbv", 0, 0, 0, 0), I("xsetbv", 0, 0, 0, 0), BAD, BAD,
+    I("vmfunc", 0, 0, 0, 0), I("xend", 0, 0, 0, 0), I("xtest", 0, 0, 0, 0), I("enclu", 0, 0, 0, 0),
+};
+static const Opcode grp7_5[8] = {
+    BAD, BAD, BAD, BAD, BAD, BAD, I("rdpkru", 0, 0, 0, 0), I("wrpkru", 0, 0, 0, 0),
+};
+static const Opcode grp7_7[8] = {
+    I("swapgs", 0, 0, 0, 0), I("rdtscp", 0, 0, 0, 0), I("monitorx", 0, 0, 0, 0), I("mwaitx", 0, 0, 0, 0),
+    I("clzero", 0, 0, 0, 0), I("rdpru", 0, 0, 0, 0), BAD, BAD,
+};
+static const Opcode grp7_reg[8] = {
+    T(K_RM, grp7_0), T(K_RM, grp7_1), T(K_RM, grp7_2), BAD,
+    I("smsw", O_Ev, 0, 0, 0), T(K_RM, grp7_5), I("lmsw", O_Ew, 0, 0, 0), T(K_RM, grp7_7),
+};
+static const Opcode grp7[2] = { T(K_GROUP, grp7_mem), T(K_GROUP, grp7_reg) };
+
+static const Opcode prefetch_amd[8] = {
+    I("prefetch", O_M, 0, 0, 0), I("prefetchw", O_M, 0, 0, 0), I("prefetchwt1", O_M, 0, 0, 0), I("prefetch", O_M, 0, 0, 0),
+    I("prefetch", O_M, 0, 0, 0), I("prefetch", O_M, 0, 0, 0), I("prefetch", O_M, 0, 0, 0), I("prefetch", O_M, 0, 0, 0),
+};
+
+static const Opcode movups[4] = {
+    I("movups", O_Vx, O_Wx, 0, F_V), I("movupd", O_Vx, O_Wx, 0, F_V),
+    I("movss", O_VX, O_WX, 0, F_V), I("movsd", O_VX, O_WX, 0, F_V),
+};
+static const Opcode movss_reg[4] = {
+    I("movups", O_Vx, O_Wx, 0, F_V), I("movupd", O_Vx, O_Wx, 0, F_V),
+    I("movss", O_VX, O_UX, 0, F_V | F_NDS), I("movsd", O_VX, O_UX, 0, F_V | F_NDS),
+};
+static const Opcode movups_store[4] = {
+    I("movups", O_Wx, O_Vx, 0, F_V), I("movupd", O_Wx, O_Vx, 0, F_V),
+    I("movss", O_WX, O_VX, 0, F_V), I("movsd", O_WX, O_VX, 0, F_V),
+};
+static const Opcode movss_store_reg[4] = {
+    I("movups", O_Wx, O_Vx, 0, F_V), I("movupd", O_Wx, O_Vx, 0, F_V),
+    I("movss", O_UX, O_VX, 0, F_V | F_NDS), I("movsd", O_UX, O_VX, 0, F_V | F_NDS),
+};
+static const Opcode op0f10[2] = { T(K_PREFIX, movups), T(K_PREFIX, movss_reg) };
+static const Opcode op0f11[2] = { T(K_PREFIX, movups_store), T(K_PREFIX, movss_store_reg) };
+
+static const Opcode movlps[4] = {
+    I("movlps", O_VX, O_M, 0, F_V | F_NDS), I("movlpd", O_VX, O_M, 0, F_V | F_NDS),
+    I("movsldup", O_Vx, O_Wx, 0, F_V), I("movddup", O_Vx, O_Wx, 0, F_V),
+};
+static const Opcode movhlps[4] = {
+    I("movhlps", O_VX, O_UX, 0, F_V | F_NDS), BAD,
+    I("movsldup", O_Vx, O_Wx, 0, F_V), I("movddup", O_Vx, O_Wx, 0, F_V),
+};
+static const Opcode op0f12[2] = { T(K_PREFIX, movlps), T(K_PREFIX, movhlps) };
+static const Opcode movlps_store[4] = { I("movlps", O_M, O_VX, 0, F_V), I("movlpd", O_M, O_VX, 0, F_V), BAD, BAD };
+static const Opcode unpcklps[4] = SSE2("unpckl", F_NDS);
+static const Opcode unpckhps[4] = SSE2("unpckh", F_NDS);
+static const Opcode movhps[4] = {
+    I("movhps", O_VX, O_M, 0, F_V | F_NDS), I("movhpd", O_VX, O_M, 0, F_V | F_NDS),
+    I("movshdup", O_Vx, O_Wx, 0, F_V), BAD,
+};
+static const Opcode movlhps[4] = {
+    I("movlhps", O_VX, O_UX, 0, F_V | F_NDS), BAD, I("movshdup", O_Vx, O_Wx, 0, F_V), BAD,
+};
+static const Opcode op0f16[2] = { T(K_PREFIX, movhps), T(K_PREFIX, movlhps) };
+static const Opcode movhps_store[4] = { I("movhps", O_M, O_VX, 0, F_V), I("movhpd", O_M, O_VX, 0, F_V), BAD, BAD };
+
+static const Opcode grp16_mem[8] = {
+    I("prefetchnta", O_M, 0, 0, 0), I("prefetcht0", O_M, 0, 0, 0),
+    I("prefetcht1", O_M, 0, 0, 0), I("prefetcht2", O_M, 0, 0, 0),
+    I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S),
+};
+static const Opcode grp16[2] = { T(K_GROUP, grp16_mem), I("nop", O_Ev, 0, 0, F_S) };
+
+static const Opcode endbr[8] = {
+    I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), I("endbr64", 0, 0, 0, 0), I("endbr32", 0, 0, 0, 0),
+    I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S),
+};
+static const Opcode rdssp[8] = {
+    BAD, I("rdsspd|rdsspq", O_Ry, 0, 0, F_WNAME), BAD, BAD, BAD, BAD, BAD, T(K_RM, endbr),
+};
+static const Opcode nop1e_f3[2] = { I("nop", O_Ev, 0, 0, F_S), T(K_GROUP, rdssp) };
+static const Opcode nop1e[4] = {
+    I("nop", O_Ev, 0, 0, F_S | F_OPSIZE), I("nop", O_Ev, 0, 0, F_S | F_OPSIZE),
+    T(K_MOD, nop1e_f3), I("nop", O_Ev, 0, 0, F_S | F_OPSIZE),
+};
+
+static const Opcode movaps[4] = SSE2("mova", 0);
+static const Opcode movaps_store[4] = {
+    I("movaps", O_Wx, O_Vx, 0, F_V), I("movapd", O_Wx, O_Vx, 0, F_V), BAD, BAD,
+};
+static const Opcode cvtpi2ps[4] = {
+    I("cvtpi2ps", O_VX, O_Qq, 0, 0), I("cvtpi2pd", O_VX, O_Qq, 0, 0),
+    I("cvtsi2ss", O_VX, O_Ey, 0, F_V | F_NDS | F_SM), I("cvtsi2sd", O_VX, O_Ey, 0, F_V | F_NDS | F_SM),
+};
+static const Opcode movntps[4] = {
+    I("movntps", O_M, O_Vx, 0, F_V), I("movntpd", O_M, O_Vx, 0, F_V), BAD, BAD,
+};
+static const Opcode cvttps2pi[4] = {
+    I("cvttps2pi", O_Pq, O_WX, 0, 0), I("cvttpd2pi", O_Pq, O_WX, 0, 0),
+    I("cvttss2si", O_Gy, O_WX, 0, F_V), I("cvttsd2si", O_Gy, O_WX, 0, F_V),
+};
+static const Opcode cvtps2pi[4] = {
+    I("cvtps2pi", O_Pq, O_WX, 0, 0), I("cvtpd2pi", O_Pq, O_WX, 0, 0),
+    I("cvtss2si", O_Gy, O_WX, 0, F_V), I("cvtsd2si", O_Gy, O_WX, 0, F_V),
+};
+static const Opcode ucomiss[4] = {
+    I("ucomiss", O_VX, O_WX, 0, F_V), I("ucomisd", O_VX, O_WX, 0, F_V), BAD, BAD,
+};
+static const Opcode comiss[4] = {
+    I("comiss", O_VX, O_WX, 0, F_V), I("comisd", O_VX, O_WX, 0, F_V), BAD, BAD,
+};
+
+static const Opcode movmskps[4] = {
+    I("movmskps", O_Gd, O_Ux, 0, F_V), I("movmskpd", O_Gd, O_Ux, 0, F_V), BAD, BAD,
+};
+static const Opcode sqrtps[4] = SSE4("sqrt", 0);
+static const Opcode rsqrtps[4] = {
+    I("rsqrtps", O_Vx, O_Wx, 0, F_V), BAD, I("rsqrtss", O_VX, O_WX, 0, F_V | F_NDS), BAD,
+};
+static const Opcode rcpps[4] = {
+    I("rcpps", O_Vx, O_Wx, 0, F_V), BAD, I("rcpss", O_VX, O_WX, 0, F_V | F_NDS), BAD,
+};
+static const Opcode andps[4] = SSE2("and", F_NDS);
+static const Opcode andnps[4] = SSE2("andn", F_NDS);
+static const Opcode orps[4] = SSE2("or", F_NDS);
+static const Opcode xorps[4] = SSE2("xor", F_NDS);
+static const Opcode addps[4] = SSE4("add", F_NDS);
+static const Opcode mulps[4] = SSE4("mul", F_NDS);
+static const Opcode cvtps2pd[4] = {
+    I("cvtps2pd", O_Vx, O_Wh, 0, F_V), I("cvtpd2ps", O_VX, O_Wx, 0, F_V | F_XY),
+    I("cvtss2sd", O_VX, O_WX, 0, F_V | F_NDS), I("cvtsd2ss", O_VX, O_WX, 0, F_V | F_NDS),
+};
+static const Opcode cvtdq2ps[4] = {
+    I("cvtdq2ps", O_Vx, O_Wx, 0, F_V), I("cvtps2dq", O_Vx, O_Wx, 0, F_V),
+    I("cvttps2dq", O_Vx, O_Wx, 0, F_V), BAD,
+};
+static const Opcode subps[4] = SSE4("sub", F_NDS);
+static const Opcode minps[4] = SSE4("min", F_NDS);
+static const Opcode divps[4] = SSE4("div", F_NDS);
+static const Opcode maxps[4] = SSE4("max", F_NDS);
+
+static const Opcode movd[4] = {
+    I("movd|movq", O_Pq, O_Ey, 0, F_WNAME), I("movd|movq", O_VX, O_Ey, 0, F_V | F_WNAME), BAD, BAD,
+};
+static const Opcode movq_load[4] = {
+    I("movq", O_Pq, O_Qq, 0, 0), I("movdqa", O_Vx, O_Wx, 0, F_V), I("movdqu", O_Vx, O_Wx, 0, F_V), BAD,
+};
+static const Opcode pshufw[4] = {
+    I("pshufw", O_Pq, O_Qq, O_Ib, 0), I("pshufd", O_Vx, O_Wx, O_Ib, F_V),
+    I("pshufhw", O_Vx, O_Wx, O_Ib, F_V), I("pshuflw", O_Vx, O_Wx, O_Ib, F_V),
+};
+static const Opcode grp12[8] = {
+    BAD, BAD, I("psrlw", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), BAD,
+    I("psraw", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), BAD, I("psllw", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), BAD,
+};
+static const Opcode grp13[8] = {
+    BAD, BAD, I("psrld", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), BAD,
+    I("psrad", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), BAD, I("pslld", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), BAD,
+};
+static const Opcode grp14[8] = {
+    BAD, BAD, I("psrlq", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), I("psrldq", O_Ux, O_Ib, 0, F_P66 | F_V | F_NDD),
+    BAD, BAD, I("psllq", O_Nq, O_Ib, 0, F_MMX | F_V | F_NDD), I("pslldq", O_Ux, O_Ib, 0, F_P66 | F_V | F_NDD),
+};
+static const Opcode vzeroupper[2] = { I("vzeroupper", 0, 0, 0, F_VO), I("vzeroall", 0, 0, 0, F_VO) };
+static const Opcode emms[2] = { I("emms", 0, 0, 0, 0), T(K_L, vzeroupper) };
+static const Opcode haddps[4] = {
+    BAD, I("haddpd", O_Vx, O_Wx, 0, F_V | F_NDS), BAD, I("haddps", O_Vx, O_Wx, 0, F_V | F_NDS),
+};
+static const Opcode hsubps[4] = {
+    BAD, I("hsubpd", O_Vx, O_Wx, 0, F_V | F_NDS), BAD, I("hsubps", O_Vx, O_Wx, 0, F_V | F_NDS),
+};
+static const Opcode movd_store[4] = {
+    I("movd|movq", O_Ey, O_Pq, 0, F_WNAME), I("movd|movq", O_Ey, O_VX, 0, F_V | F_WNAME),
+    I("movq", O_VX, O_WX, 0, F_V), BAD,
+};
+static const Opcode movq_store[4] = {
+    I("movq", O_Qq, O_Pq, 0, 0), I("movdqa", O_Wx, O_Vx, 0, F_V), I("movdqu", O_Wx, O_Vx, 0, F_V), BAD,
+};
+
+static const Opcode grp15_mem[8] = {
+    I("fxsave|fxsave64", O_M, 0, 0, F_WNAME), I("fxrstor|fxrstor64", O_M, 0, 0, F_WNAME),
+    I("ldmxcsr", O_M, 0, 0, F_V), I("stmxcsr", O_M, 0, 0, F_V),
+    I("xsave|xsave64", O_M, 0, 0, F_WNAME), I("xrstor|xrstor64", O_M, 0, 0, F_WNAME),
+    I("xsaveopt|xsaveopt64", O_M, 0, 0, F_WNAME), I("clflush", O_M, 0, 0, 0),
+};
+static const Opcode grp15_mem_66[8] = {
+    BAD, BAD, BAD, BAD, BAD, BAD, I("clwb", O_M, 0, 0, 0), I("clflushopt", O_M, 0, 0, 0),
+};
+static const Opcode grp15_reg[8] = {
+    BAD, BAD, BAD, BAD, BAD, I("lfence", 0, 0, 0, 0), I("mfence", 0, 0, 0, 0), I("sfence", 0, 0, 0, 0),
+};
+static const Opcode grp15_reg_f3[8] = {
+    I("rdfsbase", O_Ry, 0, 0, 0), I("rdgsbase", O_Ry, 0, 0, 0),
+    I("wrfsbase", O_Ry, 0, 0, 0), I("wrgsbase", O_Ry, 0, 0, 0),
+    I("ptwrite", O_Ey, 0, 0, 0), I("incsspd|incsspq", O_Ry, 0, 0, F_WNAME), I("umonitor", O_Rq, 0, 0, 0), BAD,
+};
+static const Opcode grp15_pmem[4] = {
+    T(K_GROUP, grp15_mem), T(K_GROUP, grp15_mem_66), BAD, BAD,
+};
+static const Opcode grp15_preg[4] = {
+    T(K_GROUP, grp15_reg), BAD, T(K_GROUP, grp15_reg_f3), BAD,
+};
+static const Opcode grp15[2] = { T(K_PREFIX, grp15_pmem), T(K_PREFIX, grp15_preg) };
+
+static const Opcode popcnt[4] = { BAD, BAD, I("popcnt", O_Gv, O_Ev, 0, 0), BAD };
+static const Opcode grp8[8] = {
+    BAD, BAD, BAD, BAD,
+    I("bt", O_Ev, O_Ib, 0, F_S), I("bts", O_Ev, O_Ib, 0, F_S), I("btr", O_Ev, O_Ib, 0, F_S), I("btc", O_Ev, O_Ib, 0, F_S),
+};
+static const Opcode bsf[4] = {
+    I("bsf", O_Gv, O_Ev, 0, F_OPSIZE), I("bsf", O_Gv, O_Ev, 0, F_OPSIZE),
+    I("tzcnt", O_Gv, O_Ev, 0, 0), I("bsf", O_Gv, O_Ev, 0, F_OPSIZE),
+};
+static const Opcode bsr[4] = {
+    I("bsr", O_Gv, O_Ev, 0, F_OPSIZE), I("bsr", O_Gv, O_Ev, 0, F_OPSIZE),
+    I("lzcnt", O_Gv, O_Ev, 0, 0), I("bsr", O_Gv, O_Ev, 0, F_OPSIZE),
+};
+
+static const Opcode cmpps[4] = {
+    I("cmpps", O_Vx, O_Wx, O_Ib, F_V | F_NDS | F_CMP), I("cmppd", O_Vx, O_Wx, O_Ib, F_V | F_NDS | F_CMP),
+    I("cmpss", O_VX, O_WX, O_Ib, F_V | F_NDS | F_CMP), I("cmpsd", O_VX, O_WX, O_Ib, F_V | F_NDS | F_CMP),
+};
+static const Opcode movnti[4] = { I("movnti", O_M, O_Gy, 0, 0), BAD, BAD, BAD };
+static const Opcode pinsrw[4] = {
+    I("pinsrw", O_Pq, O_Ed, O_Ib, 0), I("pinsrw", O_VX, O_Ed, O_Ib, F_V | F_NDS), BAD, BAD,
+};
+static const Opcode pextrw[4] = {
+    I("pextrw", O_Gd, O_Nq, O_Ib, 0), I("pextrw", O_Gd, O_UX, O_Ib, F_V), BAD, BAD,
+};
+static const Opcode shufps[4] = {
+    I("shufps", O_Vx, O_Wx, O_Ib, F_V | F_NDS), I("shufpd", O_Vx, O_Wx, O_Ib, F_V | F_NDS), BAD, BAD,
+};
+
+static const Opcode grp9_mem[8] = {
+    BAD, I("cmpxchg8b|cmpxchg16b", O_M, 0, 0, F_WNAME), BAD,
+    I("xrstors|xrstors64", O_M, 0, 0, F_WNAME), I("xsavec|xsavec64", O_M, 0, 0, F_WNAME),
+    I("xsaves|xsaves64", O_M, 0, 0, F_WNAME), I("vmptrld", O_M, 0, 0, 0), I("vmptrst", O_M, 0, 0, 0),
+};
+static const Opcode rdseed[4] = {
+    I("rdseed", O_Ev, 0, 0, F_OPSIZE), I("rdseed", O_Ev, 0, 0, F_OPSIZE), I("rdpid", O_Rq, 0, 0, 0), BAD,
+};
+static const Opcode grp9_reg[8] = {
+    BAD, BAD, BAD, BAD, BAD, BAD, I("rdrand", O_Ev, 0, 0, 0), T(K_PREFIX, rdseed),
+};
+static const Opcode grp9[2] = { T(K_GROUP, grp9_mem), T(K_GROUP, grp9_reg) };
+
+static const Opcode addsubps[4] = {
+    BAD, I("addsubpd", O_Vx, O_Wx, 0, F_V | F_NDS), BAD, I("addsubps", O_Vx, O_Wx, 0, F_V | F_NDS),
+};
+static const Opcode movq_d6[4] = {
+    BAD, I("movq", O_WX, O_VX, 0, F_V), I("movq2dq", O_VX, O_Nq, 0, 0), I("movdq2q", O_Pq, O_UX, 0, 0),
+};
+static const Opcode pmovmskb[4] = {
+    I("pmovmskb", O_Gd, O_Nq, 0, 0), I("pmovmskb", O_Gd, O_Ux, 0, F_V), BAD, BAD,
+};
+static const Opcode cvttpd2dq[4] = {
+    BAD, I("cvttpd2dq", O_VX, O_Wx, 0, F_V | F_XY),
+    I("cvtdq2pd", O_Vx, O_Wh, 0, F_V), I("cvtpd2dq", O_VX, O_Wx, 0, F_V | F_XY),
+};
+static const Opcode movntq[4] = {
+    I("movntq", O_M, O_Pq, 0, 0), I("movntdq", O_M, O_Vx, 0, F_V), BAD, BAD,
+};
+static const Opcode lddqu[4] = { BAD, BAD, BAD, I("lddqu", O_Vx, O_M, 0, F_V) };
+static const Opcode maskmovq[4] = {
+    I("maskmovq", O_Pq, O_Nq, 0, 0), I("maskmovdqu", O_VX, O_UX, 0, F_V), BAD, BAD,
+};
+
+// Integer operations on MMX registers, or xmm ones with 66
+#define MMX(name) I(name, O_Pq, O_Qq, 0, F_MMX | F_V | F_NDS)
+#define MMX66(name) I(name, O_Vx, O_Wx, 0, F_P66 | F_V | F_NDS)
+
+static const Opcode kunpck_np[2] = {
+    I("kunpckwd", O_Kr, O_Kv, O_Ku, F_VO), I("kunpckdq", O_Kr, O_Kv, O_Ku, F_VO),
+};
+static const Opcode kunpck[4] = { T(K_W, kunpck_np), I("kunpckbw", O_Kr, O_Kv, O_Ku, F_VO), BAD, BAD };
+
+// VEX forms of 0F 41 to 4B and 90 to 99 work on mask registers, their
+// names end with the size given by the prefix and W, see mask_suffix
+static const Opcode cmov_kmask[16] = {
+    BAD, I("kand", O_Kr, O_Kv, O_Ku, F_VO | F_KSIZE), I("kandn", O_Kr, O_Kv, O_Ku, F_VO | F_KSIZE), BAD,
+    I("knot", O_Kr, O_Ku, 0, F_VO | F_KSIZE), I("kor", O_Kr, O_Kv, O_Ku, F_VO | F_KSIZE),
+    I("kxnor", O_Kr, O_Kv, O_Ku, F_VO | F_KSIZE), I("kxor", O_Kr, O_Kv, O_Ku, F_VO | F_KSIZE),
+    BAD, BAD, I("kadd", O_Kr, O_Kv, O_Ku, F_VO | F_KSIZE), T(K_PREFIX, kunpck),
+    BAD, BAD, BAD, BAD,
+};
+static const Opcode set_kmask[16] = {
+    I("kmov", O_Kr, O_Km, 0, F_VO | F_KSIZE), I("kmov", O_M, O_Kr, 0, F_VO | F_KSIZE),
+    I("kmov", O_Kr, O_Ry, 0, F_VO | F_KSIZE), I("kmov", O_Gy, O_Ku, 0, F_VO | F_KSIZE),
+    BAD, BAD, BAD, BAD,
+    I("kortest", O_Kr, O_Ku, 0, F_VO | F_KSIZE), I("ktest", O_Kr, O_Ku, 0, F_VO | F_KSIZE),
+    BAD, BAD, BAD, BAD, BAD, BAD,
+};
+
+#define MMXS(name) I(name, O_Pq, O_QX, 0, F_MMX | F_V | F_NDS)
+
+static const Opcode two_byte[256] = {
+    [0x00] = T(K_GROUP, grp6), T(K_MOD, grp7),
+    I("lar", O_Gv, O_Ew, 0, 0), I("lsl", O_Gv, O_Ew, 0, 0),
+    [0x05] = I("syscall", 0, 0, 0, 0), I("clts", 0, 0, 0, 0), I("sysretl|sysretq", 0, 0, 0, F_WNAME),
+    I("invd", 0, 0, 0, 0), I("wbinvd", 0, 0, 0, 0),
+    [0x0b] = I("ud2", 0, 0, 0, 0),
+    [0x0d] = T(K_GROUP, prefetch_amd), I("femms", 0, 0, 0, 0),
+    [0x10] = T(K_MOD, op0f10), T(K_MOD, op0f11), T(K_MOD, op0f12), T(K_PREFIX, movlps_store),
+    T(K_PREFIX, unpcklps), T(K_PREFIX, unpckhps), T(K_MOD, op0f16), T(K_PREFIX, movhps_store),
+    T(K_MOD, grp16), I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S),
+    I("nop", O_Ev, 0, 0, F_S), I("nop", O_Ev, 0, 0, F_S), T(K_PREFIX, nop1e), I("nop", O_Ev, 0, 0, F_S),
+    [0x20] = I("mov", O_Rq, O_Cq, 0, 0), I("mov", O_Rq, O_Dq, 0, 0),
+    I("mov", O_Cq, O_Rq, 0, 0), I("mov", O_Dq, O_Rq, 0, 0),
+    [0x28] = T(K_PREFIX, movaps), T(K_PREFIX, movaps_store), T(K_PREFIX, cvtpi2ps), T(K_PREFIX, movntps),
+    T(K_PREFIX, cvttps2pi), T(K_PREFIX, cvtps2pi), T(K_PREFIX, ucomiss), T(K_PREFIX, comiss),
+    [0x30] = I("wrmsr", 0, 0, 0, 0), I("rdtsc", 0, 0, 0, 0), I("rdmsr", 0, 0, 0, 0), I("rdpmc", 0, 0, 0, 0),
+    I("sysenter", 0, 0, 0, 0), I("sysexitl|sysexitq", 0, 0, 0, F_WNAME),
+    [0x37] = I("getsec", 0, 0, 0, 0),
+    [0x40] = CC16("cmov", O_Gv, O_Ev, 0),
+    [0x50] = T(K_PREFIX, movmskps), T(K_PREFIX, sqrtps), T(K_PREFIX, rsqrtps), T(K_PREFIX, rcpps),
+    T(K_PREFIX, andps), T(K_PREFIX, andnps), T(K_PREFIX, orps), T(K_PREFIX, xorps),
+    T(K_PREFIX, addps), T(K_PREFIX, mulps), T(K_PREFIX, cvtps2pd), T(K_PREFIX, cvtdq2ps),
+    T(K_PREFIX, subps), T(K_PREFIX, minps), T(K_PREFIX, divps), T(K_PREFIX, maxps),
+    [0x60] = MMX("punpcklbw"), MMX("punpcklwd"), MMX("punpckldq"), MMX("packsswb"),
+    MMX("pcmpgtb"), MMX("pcmpgtw"), MMX("pcmpgtd"), MMX("packuswb"),
+    MMX("punpckhbw"), MMX("punpckhwd"), MMX("punpckhdq"), MMX("packssdw"),
+    MMX66("punpcklqdq"), MMX66("punpckhqdq"), T(K_PREFIX, movd), T(K_PREFIX, movq_load),
+    [0x70] = T(K_PREFIX, pshufw), T(K_GROUP, grp12), T(K_GROUP, grp13), T(K_GROUP, grp14),
+    MMX("pcmpeqb"), MMX("pcmpeqw"), MMX("pcmpeqd"), T(K_VEX, emms),
+    I("vmread", O_Ey, O_Gy, 0, F_F64), I("vmwrite", O_Gy, O_Ey, 0, F_F64),
+    [0x7c] = T(K_PREFIX, haddps), T(K_PREFIX, hsubps), T(K_PREFIX, movd_store), T(K_PREFIX, movq_store),
+    [0x80] = CC16("j", O_Jz, 0, BRANCH),
+    [0x90] = CC16("set", O_Eb, 0, 0),
+    [0xa0] = I("push", O_FS, 0, 0, F_D64), I("pop", O_FS, 0, 0, F_D64), I("cpuid", 0, 0, 0, 0),
+    I("bt", O_Ev, O_Gv, 0, F_S), I("shld", O_Ev, O_Gv, O_Ib, F_S), I("shld", O_Ev, O_Gv, O_CL, F_S),
+    [0xa8] = I("push", O_GS, 0, 0, F_D64), I("pop", O_GS, 0, 0, F_D64), I("rsm", 0, 0, 0, 0),
+    I("bts", O_Ev, O_Gv, 0, F_S), I("shrd", O_Ev, O_Gv, O_Ib, F_S), I("shrd", O_Ev, O_Gv, O_CL, F_S),
+    T(K_MOD, grp15), I("imul", O_Gv, O_Ev, 0, F_S),
+    [0xb0] = I("cmpxchg", O_Eb, O_Gb, 0, F_S), I("cmpxchg", O_Ev, O_Gv, 0, F_S),
+    I("lss", O_Gv, O_M, 0, 0), I("btr", O_Ev, O_Gv, 0, F_S),
+    I("lfs", O_Gv, O_M, 0, 0), I("lgs", O_Gv, O_M, 0, 0),
+    I("movzb", O_Gv, O_Eb, 0, F_SG), I("movzw", O_Gv, O_Ew, 0, F_SG),
+    T(K_PREFIX, popcnt), I("ud1", O_Gv, O_Ev, 0, 0), T(K_GROUP, grp8), I("btc", O_Ev, O_Gv, 0, F_S),
+    T(K_PREFIX, bsf), T(K_PREFIX, bsr), I("movsb", O_Gv, O_Eb, 0, F_SG), I("movsw", O_Gv, O_Ew, 0, F_SG),
+    [0xc0] = I("xadd", O_Eb, O_Gb, 0, F_S), I("xadd", O_Ev, O_Gv, 0, F_S),
+    T(K_PREFIX, cmpps), T(K_PREFIX, movnti), T(K_PREFIX, pinsrw), T(K_PREFIX, pextrw),
+    T(K_PREFIX, shufps), T(K_MOD, grp9),
+    R8("bswap", O_Zy, 0, 0),
+    [0xd0] = T(K_PREFIX, addsubps), MMXS("psrlw"), MMXS("psrld"), MMXS("psrlq"),
+    MMX("paddq"), MMX("pmullw"), T(K_PREFIX, movq_d6), T(K_PREFIX, pmovmskb),
+    MMX("psubusb"), MMX("psubusw"), MMX("pminub"), MMX("pand"),
+    MMX("paddusb"), MMX("paddusw"), MMX("pmaxub"), MMX("pandn"),
+    [0xe0] = MMX("pavgb"), MMXS("psraw"), MMXS("psrad"), MMX("pavgw"),
+    MMX("pmulhuw"), MMX("pmulhw"), T(K_PREFIX, cvttpd2dq), T(K_PREFIX, movntq),
+    MMX("psubsb"), MMX("psubsw"), MMX("pminsw"), MMX("por"),
+    MMX("paddsb"), MMX("paddsw"), MMX("pmaxsw"), MMX("pxor"),
+    [0xf0] = T(K_PREFIX, lddqu), MMXS("psllw"), MMXS("pslld"), MMXS("psllq"),
+    MMX("pmuludq"), MMX("pmaddwd"), MMX("psadbw"), T(K_PREFIX, maskmovq),
+    MMX("psubb"), MMX("psubw"), MMX("psubd"), MMX("psubq"),
+    MMX("paddb"), MMX("paddw"), MMX("paddd"), I("ud0", O_Gv, O_Ev, 0, 0),
+};
+
+// 0F38 map
+
+#define P66(name, a, b, flags) I(name, a, b, 0, F_P66 | flags)
+#define VO3(name, a, b, c, flags) I(name, a, b, c, F_VO | F_P66 | flags)
+
+// Fused multiply adds, packed then scalar, each with the three orders
+#define FMA(name) \
+    VO3(name "ps|" name "pd", O_Vx, O_Hx, O_Wx, F_WNAME), VO3(name "ss|" name "sd", O_VX, O_HX, O_WX, F_WNAME)
+#define FMA_ORDER(n) \
+    VO3("vfmaddsub" n "ps|vfmaddsub" n "pd", O_Vx, O_Hx, O_Wx, F_WNAME), \
+    VO3("vfmsubadd" n "ps|vfmsubadd" n "pd", O_Vx, O_Hx, O_Wx, F_WNAME), \
+    FMA("vfmadd" n), FMA("vfmsub" n), FMA("vfnmadd" n), FMA("vfnmsub" n)
+
+static const Opcode movbe_load[4] = {
+    I("movbe", O_Gv, O_M, 0, F_NP), I("movbe", O_Gv, O_M, 0, F_OPSIZE), BAD, I("crc32", O_Gy, O_Eb, 0, F_SM),
+};
+static const Opcode movbe_store[4] = {
+    I("movbe", O_M, O_Gv, 0, F_NP), I("movbe", O_M, O_Gv, 0, F_OPSIZE), BAD, I("crc32", O_Gy, O_Ev, 0, F_SM),
+};
+static const Opcode grp17[8] = {
+    BAD, I("blsr", O_By, O_Ey, 0, F_VO), I("blsmsk", O_By, O_Ey, 0, F_VO), I("blsi", O_By, O_Ey, 0, F_VO),
+    BAD, BAD, BAD, BAD,
+};
+static const Opcode bzhi[4] = {
+    I("bzhi", O_Gy, O_Ey, O_By, F_VO), BAD, I("pext", O_Gy, O_By, O_Ey, F_VO), I("pdep", O_Gy, O_By, O_Ey, F_VO),
+};
+static const Opcode mulx[4] = {
+    BAD, I("adcx", O_Gy, O_Ey, 0, 0), I("adox", O_Gy, O_Ey, 0, 0), I("mulx", O_Gy, O_By, O_Ey, F_VO),
+};
+static const Opcode bextr[4] = {
+    I("bextr", O_Gy, O_Ey, O_By, F_VO), I("shlx", O_Gy, O_Ey, O_By, F_VO),
+    I("sarx", O_Gy, O_Ey, O_By, F_VO), I("shrx", O_Gy, O_Ey, O_By, F_VO),
+};
+
+static const Opcode three_byte_38[256] = {
+    [0x00] = MMX("pshufb"), MMX("phaddw"), MMX("phaddd"), MMX("phaddsw"),
+    MMX("pmaddubsw"), MMX("phsubw"), MMX("phsubd"), MMX("phsubsw"),
+    MMX("psignb"), MMX("psignw"), MMX("psignd"), MMX("pmulhrsw"),
+    VO3("vpermilps", O_Vx, O_Hx, O_Wx, 0), VO3("vpermilpd", O_Vx, O_Hx, O_Wx, 0),
+    VO3("vtestps", O_Vx, O_Wx, 0, 0), VO3("vtestpd", O_Vx, O_Wx, 0, 0),
+    [0x10] = I("pblendvb", O_Vx, O_Wx, O_XMM0, F_P66),
+    [0x13] = VO3("vcvtph2ps", O_Vx, O_Wh, 0, 0),
+    I("blendvps", O_Vx, O_Wx, O_XMM0, F_P66), I("blendvpd", O_Vx, O_Wx, O_XMM0, F_P66),
+    VO3("vpermps", O_Vx, O_Hx, O_Wx, 0), P66("ptest", O_Vx, O_Wx, F_V),
+    VO3("vbroadcastss", O_Vx, O_WX, 0, 0), VO3("vbroadcastsd", O_Vx, O_WX, 0, 0),
+    VO3("vbroadcastf128", O_Vx, O_M, 0, 0),
+    [0x1c] = I("pabsb", O_Pq, O_Qq, 0, F_MMX | F_V), I("pabsw", O_Pq, O_Qq, 0, F_MMX | F_V),
+    I("pabsd", O_Pq, O_Qq, 0, F_MMX | F_V),
+    [0x20] = P66("pmovsxbw", O_Vx, O_Wh, F_V), P66("pmovsxbd", O_Vx, O_WX, F_V),
+    P66("pmovsxbq", O_Vx, O_WX, F_V), P66("pmovsxwd", O_Vx, O_Wh, F_V),
+    P66("pmovsxwq", O_Vx, O_WX, F_V), P66("pmovsxdq", O_Vx, O_Wh, F_V),
+    [0x28] = MMX66("pmuldq"), MMX66("pcmpeqq"), P66("movntdqa", O_Vx, O_M, F_V), MMX66("packusdw"),
+    VO3("vmaskmovps", O_Vx, O_Hx, O_M, 0), VO3("vmaskmovpd", O_Vx, O_Hx, O_M, 0),
+    VO3("vmaskmovps", O_M, O_Hx, O_Vx, 0), VO3("vmaskmovpd", O_M, O_Hx, O_Vx, 0),
+    [0x30] = P66("pmovzxbw", O_Vx, O_Wh, F_V), P66("pmovzxbd", O_Vx, O_WX, F_V),
+    P66("pmovzxbq", O_Vx, O_WX, F_V), P66("pmovzxwd", O_Vx, O_Wh, F_V),
+    P66("pmovzxwq", O_Vx, O_WX, F_V), P66("pmovzxdq", O_Vx, O_Wh, F_V),
+    VO3("vpermd", O_Vx, O_Hx, O_Wx, 0), MMX66("pcmpgtq"),
+    MMX66("pminsb"), MMX66("pminsd"), MMX66("pminuw"), MMX66("pminud"),
+    MMX66("pmaxsb"), MMX66("pmaxsd"), MMX66("pmaxuw"), MMX66("pmaxud"),
+    [0x40] = MMX66("pmulld"), P66("phminposuw", O_VX, O_WX, F_V),
+    [0x45] = VO3("vpsrlvd|vpsrlvq", O_Vx, O_Hx, O_Wx, F_WNAME), VO3("vpsravd", O_Vx, O_Hx, O_Wx, 0),
+    VO3("vpsllvd|vpsllvq", O_Vx, O_Hx, O_Wx, F_WNAME),
+    [0x58] = VO3("vpbroadcastd", O_Vx, O_WX, 0, 0), VO3("vpbroadcastq", O_Vx, O_WX, 0, 0),
+    VO3("vbroadcasti128", O_Vx, O_M, 0, 0),
+    [0x78] = VO3("vpbroadcastb", O_Vx, O_WX, 0, 0), VO3("vpbroadcastw", O_Vx, O_WX, 0, 0),
+    [0x8c] = VO3("vpmaskmovd|vpmaskmovq", O_Vx, O_Hx, O_M, F_WNAME),
+    [0x8e] = VO3("vpmaskmovd|vpmaskmovq", O_M, O_Hx, O_Vx, F_WNAME),
+    [0x96] = FMA_ORDER("132"),
+    [0xa6] = FMA_ORDER("213"),
+    [0xb6] = FMA_ORDER("231"),
+    [0xc8] = I("sha1nexte", O_Vx, O_Wx, 0, F_NP), I("sha1msg1", O_Vx, O_Wx, 0, F_NP),
+    I("sha1msg2", O_Vx, O_Wx, 0, F_NP), I("sha256rnds2", O_Vx, O_Wx, O_XMM0, F_NP),
+    I("sha256msg1", O_Vx, O_Wx, 0, F_NP), I("sha256msg2", O_Vx, O_Wx, 0, F_NP),
+    [0xcf] = MMX66("gf2p8mulb"),
+    [0xdb] = P66("aesimc", O_Vx, O_Wx, F_V), MMX66("aesenc"), MMX66("aesenclast"),
+    MMX66("aesdec"), MMX66("aesdeclast"),
+    [0xf0] = T(K_PREFIX, movbe_load), T(K_PREFIX, movbe_store),
+    I("andn", O_Gy, O_By, O_Ey, F_VO | F_NP), T(K_GROUP, grp17),
+    [0xf5] = T(K_PREFIX, bzhi), T(K_PREFIX, mulx), T(K_PREFIX, bextr),
+};
+
+// 0F3A map
+
+#define P66I(name, a, b, flags) I(name, a, b, O_Ib, F_P66 | flags)
+
+static const Opcode rorx[4] = { BAD, BAD, BAD, I("rorx", O_Gy, O_Ey, O_Ib, F_VO) };
+
+// AMD multiply-adds of four operands, the fourth register in the immediate
+#define FMA4(name) I4(name, O_Vx, O_Hx, O_Wx, O_Lx, F_VO | F_P66 | F_W4)
+
+static const Opcode three_byte_3a[256] = {
+    [0x00] = VO3("vpermq", O_Vx, O_Wx, O_Ib, 0), VO3("vpermpd", O_Vx, O_Wx, O_Ib, 0),
+    I4("vpblendd", O_Vx, O_Hx, O_Wx, O_Ib, F_VO | F_P66),
+    [0x04] = VO3("vpermilps", O_Vx, O_Wx, O_Ib, 0), VO3("vpermilpd", O_Vx, O_Wx, O_Ib, 0),
+    I4("vperm2f128", O_Vx, O_Hx, O_Wx, O_Ib, F_VO | F_P66),
+    [0x08] = P66I("roundps", O_Vx, O_Wx, F_V), P66I("roundpd", O_Vx, O_Wx, F_V),
+    P66I("roundss", O_VX, O_WX, F_V | F_NDS), P66I("roundsd", O_VX, O_WX, F_V | F_NDS),
+    P66I("blendps", O_Vx, O_Wx, F_V | F_NDS), P66I("blendpd", O_Vx, O_Wx, F_V | F_NDS),
+    P66I("pblendw", O_Vx, O_Wx, F_V | F_NDS), I("palignr", O_Pq, O_Qq, O_Ib, F_MMX | F_V | F_NDS),
+    [0x14] = P66I("pextrb", O_Ed, O_VX, F_V), P66I("pextrw", O_Ed, O_VX, F_V),
+    P66I("pextrd|pextrq", O_Ey, O_VX, F_V | F_WNAME), P66I("extractps", O_Ed, O_VX, F_V),
+    I4("vinsertf128", O_Vx, O_Hx, O_WX, O_Ib, F_VO | F_P66), VO3("vextractf128", O_WX, O_Vx, O_Ib, 0),
+    [0x1d] = VO3("vcvtps2ph", O_Wh, O_Vx, O_Ib, 0),
+    [0x20] = P66I("pinsrb", O_VX, O_Ed, F_V | F_NDS), P66I("insertps", O_VX, O_WX, F_V | F_NDS),
+    P66I("pinsrd|pinsrq", O_VX, O_Ey, F_V | F_NDS | F_WNAME),
+    [0x38] = I4("vinserti128", O_Vx, O_Hx, O_WX, O_Ib, F_VO | F_P66), VO3("vextracti128", O_WX, O_Vx, O_Ib, 0),
+    [0x40] = P66I("dpps", O_Vx, O_Wx, F_V | F_NDS), P66I("dppd", O_Vx, O_Wx, F_V | F_NDS),
+    P66I("mpsadbw", O_Vx, O_Wx, F_V | F_NDS),
+    [0x44] = P66I("pclmulqdq", O_Vx, O_Wx, F_V | F_NDS | F_PCLMUL),
+    [0x46] = I4("vperm2i128", O_Vx, O_Hx, O_Wx, O_Ib, F_VO | F_P66),
+    [0x4a] = I4("vblendvps", O_Vx, O_Hx, O_Wx, O_Lx, F_VO | F_P66),
+    I4("vblendvpd", O_Vx, O_Hx, O_Wx, O_Lx, F_VO | F_P66),
+    I4("vpblendvb", O_Vx, O_Hx, O_Wx, O_Lx, F_VO | F_P66),
+    [0x5c] = FMA4("vfmaddsubps"), FMA4("vfmaddsubpd"), FMA4("vfmsubaddps"), FMA4("vfmsubaddpd"),
+    [0x60] = P66I("pcmpestrm", O_VX, O_WX, F_V), P66I("pcmpestri", O_VX, O_WX, F_V),
+    P66I("pcmpistrm", O_VX, O_WX, F_V), P66I("pcmpistri", O_VX, O_WX, F_V),
+    [0x68] = FMA4("vfmaddps"), FMA4("vfmaddpd"), FMA4("vfmaddss"), FMA4("vfmaddsd"),
+    FMA4("vfmsubps"), FMA4("vfmsubpd"), FMA4("vfmsubss"), FMA4("vfmsubsd"),
+    [0x78] = FMA4("vfnmaddps"), FMA4("vfnmaddpd"), FMA4("vfnmaddss"), FMA4("vfnmaddsd"),
+    FMA4("vfnmsubps"), FMA4("vfnmsubpd"), FMA4("vfnmsubss"), FMA4("vfnmsubsd"),
+    [0xcc] = I("sha1rnds4", O_Vx, O_Wx, O_Ib, F_NP),
+    [0xce] = P66I("gf2p8affineqb", O_Vx, O_Wx, F_V | F_NDS), P66I("gf2p8affineinvqb", O_Vx, O_Wx, F_V | F_NDS),
+    [0xdf] = P66I("aeskeygenassist", O_Vx, O_Wx, F_V),
+    [0xf0] = T(K_PREFIX, rorx),
+};
+
+// EVEX maps. Instructions missing from them are looked up in the VEX ones,
+// with the same names and operands.
+
+// Vector operation of 66 with its W variants
+#define EW(names) E(names, O_Vx, O_Hx, O_Wx, F_VO | F_P66 | F_WNAME, T_FULL)
+// Comparison into a mask register
+#define EK(names, flags) E(names, O_Kr, O_Hx, O_Wx, F_VO | F_P66 | flags, T_FULL)
+#define EKI(names, flags) E4(names, O_Kr, O_Hx, O_Wx, O_Ib, F_VO | F_P66 | F_WNAME | flags, T_FULL)
+
+static const Opcode evex_movdqu_load[4] = {
+    BAD, E("vmovdqa32|vmovdqa64", O_Vx, O_Wx, 0, F_VO | F_WNAME, T_FULL),
+    E("vmovdqu32|vmovdqu64", O_Vx, O_Wx, 0, F_VO | F_WNAME, T_FULL),
+    E("vmovdqu8|vmovdqu16", O_Vx, O_Wx, 0, F_VO | F_WNAME, T_FULL),
+};
+static const Opcode evex_movdqu_store[4] = {
+    BAD, E("vmovdqa32|vmovdqa64", O_Wx, O_Vx, 0, F_VO | F_WNAME, T_FULL),
+    E("vmovdqu32|vmovdqu64", O_Wx, O_Vx, 0, F_VO | F_WNAME, T_FULL),
+    E("vmovdqu8|vmovdqu16", O_Wx, O_Vx, 0, F_VO | F_WNAME, T_FULL),
+};
+static const Opcode evex_grp13[8] = {
+    E("vprord|vprorq", O_Hx, O_Wx, O_Ib, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vprold|vprolq", O_Hx, O_Wx, O_Ib, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vpsrld", O_Hx, O_Wx, O_Ib, F_VO | F_P66, T_FULL), BAD,
+    E("vpsrad|vpsraq", O_Hx, O_Wx, O_Ib, F_VO | F_P66 | F_WNAME, T_FULL), BAD,
+    E("vpslld", O_Hx, O_Wx, O_Ib, F_VO | F_P66, T_FULL), BAD,
+};
+static const Opcode evex_cmpps[4] = {
+    E4("cmpps", O_Kr, O_Hx, O_Wx, O_Ib, F_V | F_CMP, T_FULL), E4("cmppd", O_Kr, O_Hx, O_Wx, O_Ib, F_V | F_CMP, T_FULL),
+    E4("cmpss", O_Kr, O_HX, O_WX, O_Ib, F_V | F_CMP, T_FULL), E4("cmpsd", O_Kr, O_HX, O_WX, O_Ib, F_V | F_CMP, T_FULL),
+};
+
+static const Opcode evex_0f[256] = {
+    [0x64] = EK("vpcmpgtb", 0), EK("vpcmpgtw", 0), EK("vpcmpgtd", 0),
+    [0x6f] = T(K_PREFIX, evex_movdqu_load),
+    [0x72] = T(K_GROUP, evex_grp13),
+    [0x74] = EK("vpcmpeqb", 0), EK("vpcmpeqw", 0), EK("vpcmpeqd", 0),
+    [0x7f] = T(K_PREFIX, evex_movdqu_store),
+    [0xc2] = T(K_PREFIX, evex_cmpps),
+    [0xdb] = EW("vpandd|vpandq"), [0xdf] = EW("vpandnd|vpandnq"),
+    [0xeb] = EW("vpord|vporq"), [0xef] = EW("vpxord|vpxorq"),
+};
+
+static const Opcode evex_test[4] = {
+    BAD, E("vptestmb|vptestmw", O_Kr, O_Hx, O_Wx, F_VO | F_WNAME, T_FULL),
+    E("vptestnmb|vptestnmw", O_Kr, O_Hx, O_Wx, F_VO | F_WNAME, T_FULL), BAD,
+};
+static const Opcode evex_testd[4] = {
+    BAD, E("vptestmd|vptestmq", O_Kr, O_Hx, O_Wx, F_VO | F_WNAME, T_FULL),
+    E("vptestnmd|vptestnmq", O_Kr, O_Hx, O_Wx, F_VO | F_WNAME, T_FULL), BAD,
+};
+static const Opcode evex_pmuldq[4] = {
+    BAD, E("vpmuldq", O_Vx, O_Hx, O_Wx, F_VO, T_FULL), E("vpmovm2b|vpmovm2w", O_Vx, O_Ku, 0, F_VO | F_WNAME, T_FULL), BAD,
+};
+static const Opcode evex_pcmpeqq[4] = {
+    BAD, E("vpcmpeqq", O_Kr, O_Hx, O_Wx, F_VO, T_FULL), E("vpmovb2m|vpmovw2m", O_Kr, O_Ux, 0, F_VO | F_WNAME, T_FULL), BAD,
+};
+static const Opcode evex_pminsb[4] = {
+    BAD, E("vpminsb", O_Vx, O_Hx, O_Wx, F_VO, T_FULL), E("vpmovm2d|vpmovm2q", O_Vx, O_Ku, 0, F_VO | F_WNAME, T_FULL), BAD,
+};
+static const Opcode evex_pminsd[4] = {
+    BAD, E("vpminsd|vpminsq", O_Vx, O_Hx, O_Wx, F_VO | F_WNAME, T_FULL),
+    E("vpmovd2m|vpmovq2m", O_Kr, O_Ux, 0, F_VO | F_WNAME, T_FULL), BAD,
+};
+
+static const Opcode evex_0f38[256] = {
+    [0x16] = EW("vpermps|vpermpd"),
+    [0x1a] = E("vbroadcastf32x4|vbroadcastf64x2", O_Vx, O_M, 0, F_VO | F_P66 | F_WNAME, T_16),
+    E("vbroadcastf32x8|vbroadcastf64x4", O_Vx, O_M, 0, F_VO | F_P66 | F_WNAME, T_32),
+    [0x1f] = E("vpabsq", O_Vx, O_Wx, 0, F_VO | F_P66, T_FULL),
+    [0x21] = E("vpmovsxbd", O_Vx, O_WX, 0, F_VO | F_P66, T_QUARTER),
+    E("vpmovsxbq", O_Vx, O_WX, 0, F_VO | F_P66, T_EIGHTH),
+    [0x24] = E("vpmovsxwq", O_Vx, O_WX, 0, F_VO | F_P66, T_QUARTER),
+    [0x26] = T(K_PREFIX, evex_test), T(K_PREFIX, evex_testd),
+    T(K_PREFIX, evex_pmuldq), T(K_PREFIX, evex_pcmpeqq),
+    [0x31] = E("vpmovzxbd", O_Vx, O_WX, 0, F_VO | F_P66, T_QUARTER),
+    E("vpmovzxbq", O_Vx, O_WX, 0, F_VO | F_P66, T_EIGHTH),
+    [0x34] = E("vpmovzxwq", O_Vx, O_WX, 0, F_VO | F_P66, T_QUARTER),
+    [0x36] = EW("vpermd|vpermq"), EK("vpcmpgtq", 0),
+    T(K_PREFIX, evex_pminsb), T(K_PREFIX, evex_pminsd),
+    [0x3b] = EW("vpminud|vpminuq"), [0x3d] = EW("vpmaxsd|vpmaxsq"), [0x3f] = EW("vpmaxud|vpmaxuq"),
+    [0x40] = EW("vpmulld|vpmullq"), [0x44] = E("vplzcntd|vplzcntq", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    [0x50] = E("vpdpbusd", O_Vx, O_Hx, O_Wx, F_VO | F_P66, T_FULL), E("vpdpbusds", O_Vx, O_Hx, O_Wx, F_VO | F_P66, T_FULL),
+    E("vpdpwssd", O_Vx, O_Hx, O_Wx, F_VO | F_P66, T_FULL), E("vpdpwssds", O_Vx, O_Hx, O_Wx, F_VO | F_P66, T_FULL),
+    E("vpopcntb|vpopcntw", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vpopcntd|vpopcntq", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    [0x59] = E("vbroadcasti32x2|vpbroadcastq", O_Vx, O_WX, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vbroadcasti32x4|vbroadcasti64x2", O_Vx, O_M, 0, F_VO | F_P66 | F_WNAME, T_16),
+    E("vbroadcasti32x8|vbroadcasti64x4", O_Vx, O_M, 0, F_VO | F_P66 | F_WNAME, T_32),
+    [0x62] = E("vpexpandb|vpexpandw", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vpcompressb|vpcompressw", O_Wx, O_Vx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    EW("vpblendmd|vpblendmq"), EW("vblendmps|vblendmpd"), EW("vpblendmb|vpblendmw"),
+    [0x75] = EW("vpermi2b|vpermi2w"), EW("vpermi2d|vpermi2q"), EW("vpermi2ps|vpermi2pd"),
+    E("vpbroadcastb", O_Vx, O_WX, 0, F_VO | F_P66, T_BYTE), E("vpbroadcastw", O_Vx, O_WX, 0, F_VO | F_P66, T_WORD),
+    E("vpbroadcastb", O_Vx, O_Ry, 0, F_VO | F_P66, T_FULL), E("vpbroadcastw", O_Vx, O_Ry, 0, F_VO | F_P66, T_FULL),
+    E("vpbroadcastd|vpbroadcastq", O_Vx, O_Ry, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    EW("vpermt2b|vpermt2w"), EW("vpermt2d|vpermt2q"), EW("vpermt2ps|vpermt2pd"),
+    [0x88] = E("vexpandps|vexpandpd", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vpexpandd|vpexpandq", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vcompressps|vcompresspd", O_Wx, O_Vx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    E("vpcompressd|vpcompressq", O_Wx, O_Vx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+    [0x8d] = EW("vpermb|vpermw"),
+    [0xb4] = E("vpmadd52luq", O_Vx, O_Hx, O_Wx, F_VO | F_P66, T_FULL),
+    E("vpmadd52huq", O_Vx, O_Hx, O_Wx, F_VO | F_P66, T_FULL),
+    [0xc4] = E("vpconflictd|vpconflictq", O_Vx, O_Wx, 0, F_VO | F_P66 | F_WNAME, T_FULL),
+};
+
+static const Opcode evex_0f3a[256] = {
+    [0x03] = E4("valignd|valignq", O_Vx, O_Hx, O_Wx, O_Ib, F_VO | F_P66 | F_WNAME, T_FULL),
+    [0x08] = E("vrndscaleps", O_Vx, O_Wx, O_Ib, F_VO | F_P66, T_FULL),
+    E("vrndscalepd", O_Vx, O_Wx, O_Ib, F_VO | F_P66, T_FULL),
+    E4("vrndscaless", O_VX, O_HX, O_WX, O_Ib, F_VO | F_P66, T_FULL),
+    E4("vrndscalesd", O_VX, O_HX, O_WX, O_Ib, F_VO | F_P66, T_FULL),
+    [0x18] = E4("vinsertf32x4|vinsertf64x2", O_Vx, O_Hx, O_WX, O_Ib, F_VO | F_P66 | F_WNAME, T_16),
+    E("vextractf32x4|vextractf64x2", O_WX, O_Vx, O_Ib, F_VO | F_P66 | F_WNAME, T_16),
+    E4("vinsertf32x8|vinsertf64x4", O_Vx, O_Hx, O_Wh, O_Ib, F_VO | F_P66 | F_WNAME, T_32),
+    E("vextractf32x8|vextractf64x4", O_Wh, O_Vx, O_Ib, F_VO | F_P66 | F_WNAME, T_32),
+    [0x1e] = EKI("vpcmpud|vpcmpuq", F_ICMP), EKI("vpcmpd|vpcmpq", F_ICMP),
+    [0x25] = E4("vpternlogd|vpternlogq", O_Vx, O_Hx, O_Wx, O_Ib, F_VO | F_P66 | F_WNAME, T_FULL),
+    [0x38] = E4("vinserti32x4|vinserti64x2", O_Vx, O_Hx, O_WX, O_Ib, F_VO | F_P66 | F_WNAME, T_16),
+    E("vextracti32x4|vextracti64x2", O_WX, O_Vx, O_Ib, F_VO | F_P66 | F_WNAME, T_16),
+    E4("vinserti32x8|vinserti64x4", O_Vx, O_Hx, O_Wh, O_Ib, F_VO | F_P66 | F_WNAME, T_32),
+    E("vextracti32x8|vextracti64x4", O_Wh, O_Vx, O_Ib, F_VO | F_P66 | F_WNAME, T_32),
+    [0x3e] = EKI("vpcmpub|vpcmpuw", F_ICMP), EKI("vpcmpb|vpcmpw", F_ICMP),
+    [0x42] = E4("vdbpsadbw", O_Vx, O_Hx, O_Wx, O_Ib, F_VO | F_P66, T_FULL),
+};
+
+// AMD XOP maps 8 and 9, introduced by 8F where it is not pop. Only the
+// rotations are decoded.
+static const Opcode xop_8[256] = {
+    [0xc0] = I("vprotb", O_Vx, O_Wx, O_Ib, F_VO | F_NP), I("vprotw", O_Vx, O_Wx, O_Ib, F_VO | F_NP),
+    I("vprotd", O_Vx, O_Wx, O_Ib, F_VO | F_NP), I("vprotq", O_Vx, O_Wx, O_Ib, F_VO | F_NP),
+};
+static const Opcode xop_9[256] = {
+    [0x90] = I("vprotb", O_Vx, O_Wx, O_Hx, F_VO | F_NP | F_W4), I("vprotw", O_Vx, O_Wx, O_Hx, F_VO | F_NP | F_W4),
+    I("vprotd", O_Vx, O_Wx, O_Hx, F_VO | F_NP | F_W4), I("vprotq", O_Vx, O_Wx, O_Hx, F_VO | F_NP | F_W4),
+};
+
+// Names of the prefixes printed before a mnemonic, REX ones by their low bits
+#define P_DATA16   16
+#define P_ADDR32   17
+#define P_LOCK     18
+#define P_REP      19
+#define P_REPZ     20
+#define P_REPNZ    21
+#define P_BND      22
+#define P_NOTRACK  23
+#define P_ES       24 // Then cs, ss, ds, fs and gs
+#define P_XACQUIRE 30
+#define P_XRELEASE 31
+
+static const char *prefix_names[] = {
+    "rex", "rex.B", "rex.X", "rex.XB", "rex.R", "rex.RB", "rex.RX", "rex.RXB",
+    "rex.W", "rex.WB", "rex.WX", "rex.WXB", "rex.WR", "rex.WRB", "rex.WRX", "rex.WRXB",
+    "data16", "addr32", "lock", "rep", "repz", "repnz", "bnd", "notrack",
+    "es", "cs", "ss", "ds", "fs", "gs", "xacquire", "xrelease",
+};
+
+#define REX_B 0x1
+#define REX_X 0x2
+#define REX_R 0x4
+#define REX_W 0x8
+#define REX   0x40
+
+#define SEG_ES 0
+#define SEG_DS 3
+#define SEG_FS 4
+#define SEG_GS 5
+
+// Decoding state of one instruction
+typedef struct {
+    const uint8_t *start;
+    const uint8_t *p;
+    const uint8_t *end;
+    int error;
+    uint32_t flags;      // Of the entry decoded
+    // Prefixes, by position from start for the last of each kind, -1 if absent
+    int last_66, last_67, last_rep, last_segment, rex_at;
+    uint8_t rep, segment;
+    uint8_t opcode, map;
+    uint8_t lock;
+    uint8_t opcode_end;  // Length up to the opcode, 0 before it is read
+    uint8_t fwait;       // Prefix of an x87 instruction
+    uint8_t rel16;       // Branch of 16 bits
+    uint8_t vvvv_used;   // Must be 1111 otherwise
+    uint8_t used_66, used_67, used_rep, used_segment;
+    uint8_t mandatory_66;
+    uint8_t rex, rex_used; // REX bits, also set from VEX and EVEX
+    uint8_t w;
+    // VEX and EVEX
+    uint8_t vex, vvvv, l, pp;
+    uint8_t evex_r, evex_v, evex_x; // Fifth bits of register numbers
+    uint8_t evex_b, evex_z, evex_aaa;
+    uint8_t tuple;       // Of the entry decoded
+    uint8_t disp8;       // Displacement of 8 bits, scaled by EVEX
+    uint8_t broadcast;
+    uint8_t xmm;         // MMX operands are xmm ones
+    // ModRM
+    uint8_t mod, reg, rm;
+    X86_operand mem;     // Memory operand of ModRM
+    uint8_t size;        // Of the operands sized by the instruction, 0 until known
+    uint8_t esize;       // Of the ModRM operand
+    uint8_t bsize;       // 1 if a byte operand was decoded
+    uint8_t sized;       // A register gives the operand size
+    uint8_t has_memory;
+    int8_t relative;     // Index of the operand holding a relative target, -1 if none
+} Decoder;
+
+// Decoder before the first byte, copied rather than cleared with memset that
+// compilers turn into a slow rep stos
+static const Decoder fresh_decoder = {
+    .last_66 = -1, .last_67 = -1, .last_rep = -1, .last_segment = -1, .rex_at = -1, .relative = -1,
+};
+
+static uint8_t next_byte(Decoder *d) {
+    if (d->p >= d->end) {
+        d->error = 1;
+        return 0;
+    }
+    return *d->p++;
+}
+
+static int64_t next_signed(Decoder *d, int size) {
+    uint64_t value = 0;
+
+    if (d->end - d->p < size) {
+        d->error = 1;
+        d->p = d->end;
+        return 0;
+    }
+    for (int i = 0; i < size; i++)
+        value |= (uint64_t)d->p[i] << (8 * i);
+    d->p += size;
+    if (size < 8 && (value >> (8 * size - 1)) & 1)
+        value |= ~0ULL << (8 * size);
+    return (int64_t)value;
+}
+
+static void use_rex(Decoder *d, uint8_t bit) {
+    if (d->rex & bit)
+        d->rex_used |= bit | REX;
+}
+
+// Operand size of v operands, counting the prefixes that chose it as used
+// Size of ins and outs, that W does not change
+static uint8_t z_size(Decoder *d) {
+    if (d->last_66 >= 0 && !d->mandatory_66) {
+        d->used_66 = 1;
+        return 2;
+    }
+    return 4;
+}
+
+static uint8_t operand_size(Decoder *d) {
+    if (d->flags & F_F64)
+        return 8;
+    if (d->flags & F_D64) {
+        if (d->last_66 >= 0 && !d->mandatory_66) {
+            d->used_66 = 1;
+            return 2;
+        }
+        return 8;
+    }
+    if (d->w) {
+        use_rex(d, REX_W);
+        return 8;
+    }
+    if (d->last_66 >= 0 && !d->mandatory_66) {
+        d->used_66 = 1;
+        return 2;
+    }
+    return 4;
+}
+
+static uint8_t y_size(Decoder *d) {
+    if (d->flags & F_F64)
+        return 8;
+    if (d->w) {
+        use_rex(d, REX_W);
+        return 8;
+    }
+    return 4;
+}
+
+static int vector_class(Decoder *d) {
+    return d->l == 0 ? X86_XMM : d->l == 1 ? X86_YMM : X86_ZMM;
+}
+
+static void set_gpr(Decoder *d, X86_operand *op, int number, int size) {
+    op->kind = X86_REG;
+    op->reg = number;
+    switch (size) {
+        case 1:
+            // REX alone only changes ah, ch, dh and bh
+            op->regclass = d->rex ? X86_GPR8_REX : X86_GPR8;
+            if (d->rex && (number & 4))
+                d->rex_used |= REX;
+            break;
+        case 2: op->regclass = X86_GPR16; break;
+        case 4: op->regclass = X86_GPR32; break;
+        default: op->regclass = X86_GPR64;
+    }
+}
+
+static void set_reg(X86_operand *op, int regclass, int number) {
+    op->kind = X86_REG;
+    op->regclass = regclass;
+    op->reg = number;
+}
+
+// Read ModRM with its SIB and displacement
+// Read ModRM and the SIB and displacement it has, unless registers_only
+static void read_modrm(Decoder *d, int registers_only) {
+    uint8_t modrm = next_byte(d);
+    X86_operand *m = &d->mem;
+
+    d->mod = registers_only ? 3 : modrm >> 6;
+    d->reg = (modrm >> 3) & 7;
+    d->rm = modrm & 7;
+    if (d->mod == 3)
+        return;
+
+    int addr32 = d->last_67 >= 0;
+    int disp_size = d->mod == 1 ? 1 : d->mod == 2 ? 4 : 0;
+
+    m->kind = X86_MEM;
+    m->regclass = m->index_class = addr32 ? X86_GPR32 : X86_GPR64;
+    m->reg = m->index = m->segment = X86_NONE;
+    m->scale = 1;
+    if (d->rm == 4) {
+        uint8_t sib = next_byte(d);
+        int base = sib & 7, index = ((sib >> 3) & 7) | (d->rex & REX_X ? 8 : 0);
+
+        use_rex(d, REX_X);
+        m->scale = 1 << (sib >> 6);
+        if (base == 5 && d->mod == 0)
+            disp_size = 4;
+        else {
+            use_rex(d, REX_B);
+            m->reg = base | (d->rex & REX_B ? 8 : 0);
+        }
+        if (index != 4)
+            m->index = index;
+        else if (m->scale != 1 || (m->reg != X86_NONE && base != 4))
+            m->flags |= X86_RIZ;
+        else if (m->reg == X86_NONE)
+            m->flags |= X86_ABSOLUTE;
+    } else if (d->rm == 5 && d->mod == 0) {
+        use_rex(d, REX_B); // Ignored
+        m->regclass = addr32 ? X86_EIP : X86_RIP;
+        m->reg = 0;
+        disp_size = 4;
+    } else {
+        use_rex(d, REX_B);
+        m->reg = d->rm | (d->rex & REX_B ? 8 : 0);
+    }
+    if (disp_size) {
+        m->flags |= X86_DISP;
+        m->value = next_signed(d, disp_size);
+    }
+    d->disp8 = disp_size == 1;
+    if (addr32 && m->flags & X86_ABSOLUTE)
+        m->value = (uint32_t)m->value;
+}
+
+static void set_memory(Decoder *d, X86_operand *op) {
+    *op = d->mem;
+    if (d->segment == 0x64 || d->segment == 0x65) {
+        op->segment = d->segment == 0x64 ? SEG_FS : SEG_GS;
+        d->used_segment = 1;
+    }
+    if (d->last_67 >= 0)
+        d->used_67 = 1;
+    d->has_memory = 1;
+}
+
+// Register of ModRM rm or memory. Returns -1 for a memory operand where
+// only a register is valid.
+static int rm_operand(Decoder *d, X86_operand *op, int regclass, int allow_memory) {
+    if (d->mod != 3) {
+        if (!allow_memory)
+            return -1;
+        set_memory(d, op);
+        return 0;
+    }
+    if (regclass == X86_MMX || regclass == X86_MASK) {
+        set_reg(op, regclass, d->rm);
+        return 0;
+    }
+    use_rex(d, REX_B);
+    set_reg(op, regclass, d->rm | (d->rex & REX_B ? 8 : 0) | (d->evex_x && regclass >= X86_XMM ? 16 : 0));
+    return 0;
+}
+
+static int gpr_rm(Decoder *d, X86_operand *op, int size, int allow_memory) {
+    if (d->mod != 3) {
+        if (!allow_memory)
+            return -1;
+        set_memory(d, op);
+        d->esize = size;
+        return 0;
+    }
+    use_rex(d, REX_B);
+    set_gpr(d, op, d->rm | (d->rex & REX_B ? 8 : 0), size);
+    d->esize = size;
+    return 0;
+}
+
+static void gpr_reg(Decoder *d, X86_operand *op, int size) {
+    use_rex(d, REX_R);
+    set_gpr(d, op, d->reg | (d->rex & REX_R ? 8 : 0), size);
+}
+
+static void string_operand(Decoder *d, X86_operand *op, int base, int segment) {
+    op->kind = X86_MEM;
+    op->flags = X86_STRING;
+    op->regclass = d->last_67 >= 0 ? X86_GPR32 : X86_GPR64;
+    op->reg = base;
+    op->index = X86_NONE;
+    op->scale = 1;
+    op->segment = segment;
+    // Overrides by es, cs, ss or ds are ignored in 64 bits mode
+    if (segment == SEG_DS && d->segment) {
+        if (d->segment == 0x64 || d->segment == 0x65)
+            op->segment = d->segment == 0x64 ? SEG_FS : SEG_GS;
+        d->used_segment = 1;
+    }
+    if (d->last_67 >= 0)
+        d->used_67 = 1;
+}
+
+static void immediate(X86_operand *op, int64_t value, int size) {
+    op->kind = X86_IMM;
+    op->size = size;
+    op->value = size == 8 ? value : (int64_t)(value & ((1ULL << (8 * size)) - 1));
+}
+
+// Decode the operand of specifier spec. Returns -1 if the encoding is invalid.
+static int operand_of(Decoder *d, int spec, X86_operand *op) {
+    int size;
+
+    if (d->xmm) {
+        if (spec == O_Pq)
+            spec = O_Vx;
+        else if (spec == O_Qq)
+            spec = O_Wx;
+        else if (spec == O_Nq)
+            spec = O_Ux;
+        else if (spec == O_QX)
+            spec = O_WX;
+    } else if (spec == O_QX)
+        spec = O_Qq;
+
+    switch (spec) {
+        case O_Eb:
+            d->sized = d->sized || d->mod == 3;
+            return gpr_rm(d, op, 1, 1);
+        case O_Ew:
+            d->sized = d->sized || d->mod == 3;
+            return gpr_rm(d, op, 2, 1);
+        case O_Ed:
+            return gpr_rm(d, op, 4, 1);
+        case O_Eq:
+            return gpr_rm(d, op, 8, 1);
+        case O_Ev:
+        case O_Ev64:
+            d->sized = d->sized || d->mod == 3;
+            return gpr_rm(d, op, operand_size(d), 1);
+        case O_Ey:
+            return gpr_rm(d, op, y_size(d), 1);
+        case O_Es:
+            d->sized = 1;
+            return gpr_rm(d, op, d->mod == 3 ? operand_size(d) : 2, 1);
+        case O_M:
+            if (d->mod == 3)
+                return -1;
+            set_memory(d, op);
+            return 0;
+        case O_Rq:
+            return gpr_rm(d, op, 8, 0);
+        case O_Ry:
+            return gpr_rm(d, op, y_size(d), 0);
+        case O_Gb:
+            d->sized = 1;
+            d->bsize = 1;
+            gpr_reg(d, op, 1);
+            return 0;
+        case O_Gw:
+            d->sized = 1;
+            gpr_reg(d, op, 2);
+            return 0;
+        case O_Gd:
+            gpr_reg(d, op, 4);
+            return 0;
+        case O_Gv:
+            d->sized = 1;
+            gpr_reg(d, op, operand_size(d));
+            return 0;
+        case O_Gy:
+            gpr_reg(d, op, y_size(d));
+            return 0;
+        case O_Gq:
+            gpr_reg(d, op, 8);
+            return 0;
+        case O_Sw:
+            set_reg(op, X86_SEG, d->reg);
+            return 0;
+        case O_Cq:
+        case O_Dq:
+            use_rex(d, REX_R);
+            set_reg(op, spec == O_Cq ? X86_CR : X86_DR, d->reg | (d->rex & REX_R ? 8 : 0));
+            return 0;
+        case O_Zb:
+        case O_Zv:
+        case O_Zv64:
+        case O_Zy:
+            size = spec == O_Zb ? 1 : spec == O_Zy ? y_size(d) : operand_size(d);
+            d->sized = spec != O_Zy;
+            use_rex(d, REX_B);
+            set_gpr(d, op, (d->opcode & 7) | (d->rex & REX_B ? 8 : 0), size);
+            return 0;
+        case O_AL:
+            d->sized = 1;
+            d->bsize = 1;
+            set_gpr(d, op, 0, 1);
+            return 0;
+        case O_CL:
+            set_gpr(d, op, 1, 1);
+            return 0;
+        case O_AX:
+            set_reg(op, X86_GPR16, 0);
+            return 0;
+        case O_DX:
+            set_reg(op, X86_GPR16, 2);
+            op->flags |= X86_PORT;
+            return 0;
+        case O_rAX:
+            d->sized = 1;
+            set_gpr(d, op, 0, operand_size(d));
+            return 0;
+        case O_eAX:
+            d->sized = 1;
+            d->esize = z_size(d);
+            set_gpr(d, op, 0, d->esize);
+            return 0;
+        case O_FS:
+            set_reg(op, X86_SEG, SEG_FS);
+            return 0;
+        case O_GS:
+            set_reg(op, X86_SEG, SEG_GS);
+            return 0;
+        case O_XMM0:
+            set_reg(op, X86_XMM, 0);
+            return 0;
+        case O_ST:
+            set_reg(op, X86_ST, 0);
+            op->flags |= X86_ST_ALONE;
+            return 0;
+        case O_STi:
+            set_reg(op, X86_ST, d->rm);
+            return 0;
+        case O_Ib:
+            immediate(op, next_byte(d), 1);
+            return 0;
+        case O_Ibs:
+            size = operand_size(d);
+            immediate(op, next_signed(d, 1), size);
+            return 0;
+        case O_Iw:
+            immediate(op, next_signed(d, 2), 2);
+            return 0;
+        case O_Iz:
+            size = operand_size(d);
+            immediate(op, next_signed(d, size == 2 ? 2 : 4), size);
+            return 0;
+        case O_Iv:
+            size = operand_size(d);
+            immediate(op, next_signed(d, size), size);
+            return 0;
+        case O_Jb:
+        case O_Jz:
+            op->kind = X86_TARGET;
+            if (spec == O_Jz && d->last_66 >= 0 && !d->w) {
+                // Offset of 16 bits, as AMD processors have it
+                d->used_66 = d->rel16 = 1;
+                op->value = next_signed(d, 2);
+                return 0;
+            }
+            op->value = next_signed(d, spec == O_Jb ? 1 : 4);
+            return 0;
+        case O_Ob:
+        case O_Ov:
+            if (spec == O_Ob)
+                d->bsize = 1;
+            op->kind = X86_MEM;
+            op->flags = X86_ABSOLUTE | X86_DISP;
+            op->reg = op->index = op->segment = X86_NONE;
+            op->scale = 1;
+            // 67 is still shown, as objdump does
+            op->value = next_signed(d, d->last_67 >= 0 ? 4 : 8);
+            if (d->last_67 >= 0)
+                op->value = (uint32_t)op->value;
+            if (d->segment == 0x64 || d->segment == 0x65) {
+                op->segment = d->segment == 0x64 ? SEG_FS : SEG_GS;
+                d->used_segment = 1;
+            }
+            return 0;
+        case O_Xb:
+        case O_Xv:
+        case O_Xz:
+            if (spec == O_Xb)
+                d->bsize = 1;
+            else if (spec == O_Xz)
+                d->esize = z_size(d);
+            else
+                operand_size(d);
+            string_operand(d, op, 6, SEG_DS);
+            return 0;
+        case O_Yb:
+        case O_Yv:
+        case O_Yz:
+            if (spec == O_Yb)
+                d->bsize = 1;
+            else if (spec == O_Yz)
+                d->esize = z_size(d);
+            else
+                operand_size(d);
+            string_operand(d, op, 7, SEG_ES);
+            return 0;
+        case O_XLAT:
+            string_operand(d, op, 3, SEG_DS);
+            return 0;
+        case O_Pq:
+            set_reg(op, X86_MMX, d->reg);
+            return 0;
+        case O_Qq:
+            return rm_operand(d, op, X86_MMX, 1);
+        case O_Nq:
+            return rm_operand(d, op, X86_MMX, 0);
+        case O_Vx:
+        case O_VX:
+        case O_Vh:
+            use_rex(d, REX_R);
+            set_reg(op, spec == O_Vx ? vector_class(d) : spec == O_Vh && d->l == 2 ? X86_YMM : X86_XMM,
+                    d->reg | (d->rex & REX_R ? 8 : 0) | d->evex_r);
+            return 0;
+        case O_Wx:
+            return rm_operand(d, op, vector_class(d), 1);
+        case O_WX:
+            return rm_operand(d, op, X86_XMM, 1);
+        case O_Wh:
+            return rm_operand(d, op, d->l == 2 ? X86_YMM : X86_XMM, 1);
+        case O_Ux:
+            return rm_operand(d, op, vector_class(d), 0);
+        case O_UX:
+            return rm_operand(d, op, X86_XMM, 0);
+        case O_Hx:
+            d->vvvv_used = 1;
+            set_reg(op, vector_class(d), d->vvvv | d->evex_v);
+            return 0;
+        case O_HX:
+            d->vvvv_used = 1;
+            set_reg(op, X86_XMM, d->vvvv | d->evex_v);
+            return 0;
+        case O_Lx:
+            set_reg(op, vector_class(d), next_byte(d) >> 4);
+            return 0;
+        case O_By:
+            d->vvvv_used = 1;
+            set_gpr(d, op, d->vvvv, y_size(d));
+            return 0;
+        case O_Kr:
+            set_reg(op, X86_MASK, d->reg);
+            return 0;
+        case O_Km:
+            return rm_operand(d, op, X86_MASK, 1);
+        case O_Kv:
+            d->vvvv_used = 1;
+            set_reg(op, X86_MASK, d->vvvv & 7);
+            return 0;
+        case O_Ku:
+            return rm_operand(d, op, X86_MASK, 0);
+    }
+    return -1;
+}
+
+// EVEX memory operand: 8 bits displacements are multiplied by the size of
+// the operand, or of the element broadcast
+static void evex_memory(Decoder *d, int spec, X86_operand *op) {
+    int length = 16 << d->l, element = d->w ? 8 : 4, n;
+
+    switch (d->tuple) {
+        case T_BYTE:    n = 1; break;
+        case T_WORD:    n = 2; break;
+        case T_QUARTER: n = length / 4; break;
+        case T_EIGHTH:  n = length / 8; break;
+        case T_16:      n = 16; break;
+        case T_32:      n = 32; break;
+        default:
+            if (d->evex_b) {
+                n = element;
+                d->broadcast = length / element;
+            } else if (spec == O_Wh) {
+                n = length / 2;
+            } else if (spec == O_Wx || spec == O_Qq || spec == O_QX || spec == O_M) {
+                n = length;
+            } else {
+                n = spec == O_Ed ? 4 : spec == O_Eq ? 8 : element;
+            }
+    }
+    if (d->disp8)
+        op->value *= n;
+}
+
+static int decode_operand(Decoder *d, int spec, X86_operand *op) {
+    if (operand_of(d, spec, op) < 0)
+        return -1;
+    if (d->vex == 4 && op->kind == X86_MEM && !(op->flags & X86_STRING))
+        evex_memory(d, spec, op);
+    return 0;
+}
+
+// Whether spec is encoded in ModRM
+static int uses_modrm(int spec) {
+    switch (spec) {
+        case O_NONE: case O_Zb: case O_Zv: case O_Zv64: case O_Zy:
+        case O_AL: case O_CL: case O_AX: case O_DX: case O_rAX: case O_eAX:
+        case O_FS: case O_GS: case O_XMM0: case O_ST:
+        case O_Ib: case O_Ibs: case O_Iw: case O_Iz: case O_Iv: case O_Jb: case O_Jz:
+        case O_Ob: case O_Ov: case O_Xb: case O_Xv: case O_Xz: case O_Yb: case O_Yv: case O_Yz:
+        case O_XLAT: case O_Hx: case O_HX: case O_Lx: case O_By: case O_Kv:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Whether the entry, or one of the entries it selects without ModRM, has one
+static int needs_modrm(const Opcode *e, int map) {
+    if (map >= 2)
+        return 1;
+    switch (e->kind) {
+        case K_PREFIX:
+            return needs_modrm(&e->sub[0], map) || needs_modrm(&e->sub[1], map)
+                || needs_modrm(&e->sub[2], map) || needs_modrm(&e->sub[3], map);
+        case K_W:
+        case K_L:
+        case K_VEX:
+            return needs_modrm(&e->sub[0], map) || needs_modrm(&e->sub[1], map);
+        case K_INSN:
+            for (int i = 0; i < 4 && e->op[i]; i++)
+                if (uses_modrm(e->op[i]))
+                    return 1;
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Slot of a K_PREFIX table
+static int prefix_slot(Decoder *d) {
+    if (d->vex)
+        return d->pp;
+    if (d->last_rep >= 0) {
+        d->used_rep = 1;
+        return d->rep == 0xf3 ? 2 : 3;
+    }
+    if (d->last_66 >= 0) {
+        d->used_66 = d->mandatory_66 = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static const char *vex_predicates[32] = {
+    "eq", "lt", "le", "unord", "neq", "nlt", "nle", "ord",
+    "eq_uq", "nge", "ngt", "false", "neq_oq", "ge", "gt", "true",
+    "eq_os", "lt_oq", "le_oq", "unord_s", "neq_us", "nlt_uq", "nle_uq", "ord_s",
+    "eq_us", "nge_uq", "ngt_uq", "false_os", "neq_os", "ge_oq", "gt_oq", "true_us",
+};
+
+static const char *integer_predicates[8] = { "eq", "lt", "le", "false", "neq", "nlt", "nle", "true" };
+
+static const char *pclmul_predicates[] = { "lqlq", "hqlq", "lqhq", "hqhq" };
+
+// Pick the variant of a name holding several split by '|'
+static void select_name(X86_insn *insn, const char *name, int variant) {
+    const char *end;
+
+    while (variant > 0 && (end = strchr(name, '|')) != NULL) {
+        name = end + 1;
+        variant--;
+    }
+    end = strchr(name, '|');
+    insn->name = name;
+    insn->name_length = end ? (size_t)(end - name) : strlen(name);
+}
+
+static char size_suffix(int size) {
+    return size == 1 ? 'b' : size == 2 ? 'w' : size == 4 ? 'l' : 'q';
+}
+
+static char mask_suffix(Decoder *d) {
+    if (d->pp == 0)
+        return d->w ? 'q' : 'w';
+    if (d->pp == 1)
+        return d->w ? 'd' : 'b';
+    return d->w ? 'q' : 'd';
+}
+
+static void unused_prefixes(Decoder *d, X86_insn *insn, int prefix_length);
+
+static int is_prefix(uint8_t b) {
+    return b == 0x66 || b == 0x67 || b == 0xf0 || b == 0xf2 || b == 0xf3 || b == 0x26 || b == 0x2e
+        || b == 0x36 || b == 0x3e || b == 0x64 || b == 0x65 || (b & 0xf0) == 0x40 || b == 0x9b;
+}
+
+// Whether the fwait at p is a prefix of an x87 instruction rather than alone
+static int x87_follows(Decoder *d) {
+    for (const uint8_t *p = d->p + 1; p < d->end; p++)
+        if (!is_prefix(*p))
+            return *p >= 0xd8 && *p <= 0xdf;
+    return 0;
+}
+
+// Prefixes ending an instruction without opcode, as objdump splits them when
+// a REX is not last
+static int decode_prefixes(Decoder *d, X86_insn *insn, uint64_t address, int length) {
+    // Only the operands decoded are cleared
+    memset(insn, 0, offsetof(X86_insn, operand));
+    insn->address = address;
+    insn->length = length;
+    insn->name = "";
+    d->used_66 = d->used_67 = d->used_rep = d->used_segment = 0;
+    d->rex_used = 0;
+    d->flags = 0;
+    unused_prefixes(d, insn, d->rex_at + 1);
+    return length;
+}
+
+// Invalid instruction, of the bytes up to its opcode with the prefixes shown
+// unless VEX, EVEX or XOP replaced them, or of one byte when it is truncated
+static int decode_bad(Decoder *d, X86_insn *insn, uint64_t address) {
+    if (d->opcode_end && !d->error)
+        decode_prefixes(d, insn, address, d->opcode_end);
+    else
+        memset(insn, 0, sizeof(X86_insn)), insn->address = address, insn->length = 1;
+    if (d->vex)
+        insn->prefix_count = 0;
+    insn->flags = X86_BAD;
+    insn->name = "(bad)";
+    insn->name_length = 5;
+    return insn->length;
+}
+
+// Invalid VEX, EVEX or XOP map: the prefixes and the escape byte
+static int decode_escape(Decoder *d, X86_insn *insn, uint64_t address) {
+    d->vex = 0;
+    d->opcode_end = d->rex_at + 2;
+    return decode_bad(d, insn, address);
+}
+
+// Invalid instruction of the bytes read so far
+static int decode_invalid(Decoder *d, X86_insn *insn, uint64_t address) {
+    if (!d->error)
+        d->opcode_end = d->p - d->start;
+    return decode_bad(d, insn, address);
+}
+
+// Whether the instruction accepts a lock prefix
+static int lockable(Decoder *d) {
+    uint8_t op = d->opcode;
+
+    if (d->map == 1)
+        return op == 0xab || op == 0xb3 || op == 0xbb || (op == 0xba && d->reg >= 5)
+            || op == 0xb0 || op == 0xb1 || op == 0xc0 || op == 0xc1 || (op == 0xc7 && d->reg == 1);
+    if (d->map != 0)
+        return 0;
+    if (op < 0x38)
+        return (op & 7) < 2;
+    if (op >= 0x80 && op <= 0x83)
+        return d->reg != 7;
+    if (op == 0xf6 || op == 0xf7)
+        return d->reg == 2 || d->reg == 3;
+    if (op == 0xfe || op == 0xff)
+        return d->reg < 2;
+    return op == 0x86 || op == 0x87;
+}
+
+// Whether the F2 or F3 prefix b is a hint of lock elision: on a locked
+// instruction or xchg of memory, or F3 on a store of mov
+static int elision(Decoder *d, uint8_t b) {
+    if (!d->has_memory || d->vex)
+        return 0;
+    if (d->lock)
+        return lockable(d);
+    if (d->map != 0)
+        return 0;
+    return d->opcode == 0x86 || d->opcode == 0x87
+        || (b == 0xf3 && (d->opcode == 0x88 || d->opcode == 0x89 || d->opcode == 0xc6 || d->opcode == 0xc7));
+}
+
+// Prefix names printed before the mnemonic: those that did not change the
+// meaning of the instruction, as objdump shows them
+static void unused_prefixes(Decoder *d, X86_insn *insn, int prefix_length) {
+    for (int i = 0; i < prefix_length; i++) {
+        uint8_t b = d->start[i];
+        int name;
+
+        switch (b) {
+            case 0x66:
+                if (i == d->last_66 && d->used_66)
+                    continue;
+                name = P_DATA16;
+                break;
+            case 0x67:
+                if (i == d->last_67 && d->used_67)
+                    continue;
+                name = P_ADDR32;
+                break;
+            case 0x9b:
+                continue;
+            case 0xf0:
+                name = P_LOCK;
+                break;
+            case 0xf2:
+            case 0xf3:
+                if (i == d->last_rep && d->used_rep)
+                    continue;
+                if (elision(d, b))
+                    name = b == 0xf2 ? P_XACQUIRE : P_XRELEASE;
+                else if (b == 0xf3)
+                    name = d->flags & F_REP ? P_REP : P_REPZ;
+                else if ((d->flags & (F_JUMP | F_CALL | F_RET)) && !(d->opcode >= 0xe0 && d->opcode <= 0xe3)
+                         && d->opcode != 0xca && d->opcode != 0xcb && d->opcode != 0xcf)
+                    name = P_BND;
+                else
+                    name = P_REPNZ;
+                break;
+            case 0x26: case 0x2e: case 0x36: case 0x3e: case 0x64: case 0x65:
+                if (i == d->last_segment && d->used_segment)
+                    continue;
+                if (b == 0x3e && (d->flags & F_IND))
+                    name = P_NOTRACK;
+                else
+                    name = P_ES + (b == 0x26 ? 0 : b == 0x2e ? 1 : b == 0x36 ? 2 : b == 0x3e ? 3 : b == 0x64 ? 4 : 5);
+                break;
+            default:
+                // REX, printed unless each of its bits was used
+                if (i == d->rex_at && !d->vex && (d->rex_used | REX) == (b | REX) && d->rex_used)
+                    continue;
+                name = b & 0xf;
+        }
+        insn->prefixes[insn->prefix_count++] = name;
+    }
+}
+
+// Waiting forms of the x87 control instructions, fwait and fn*
+static const char *waiting_names[] = {
+    "fstenv", "fstcw", "fsave", "fstsw", "fclex", "finit", "feni(8087 only)", "fdisi(8087 only)", "fsetpm(287 only)",
+};
+
+// Decode the instruction at code, of address, reading at most size bytes.
+// Returns its length, invalid instructions are flagged X86_BAD.
+int x86_decode(const uint8_t *code, uint64_t size, uint64_t address, X86_insn *insn) {
+    Decoder d;
+    const Opcode *e;
+    Opcode x87;
+    uint8_t ops[4] = { 0 };
+    uint32_t flags = 0;
+    int map = 0, prefix_length;
+    uint8_t b;
+
+    d = fresh_decoder;
+    d.start = d.p = code;
+    d.end = code + (size < X86_MAX_LENGTH ? size : X86_MAX_LENGTH);
+
+    // Legacy prefixes, then REX right before the opcode
+    for (;;) {
+        if (d.p >= d.end)
+            return decode_bad(&d, insn, address);
+        b = *d.p;
+        int at = d.p - code;
+
+        if (b == 0x66)
+            d.last_66 = at;
+        else if (b == 0x67)
+            d.last_67 = at;
+        else if (b == 0xf2 || b == 0xf3) {
+            d.last_rep = at;
+            d.rep = b;
+        } else if (b == 0x26 || b == 0x2e || b == 0x36 || b == 0x3e || b == 0x64 || b == 0x65) {
+            d.last_segment = at;
+            d.segment = b;
+        } else if (b == 0x9b && x87_follows(&d)) {
+            d.fwait = 1;
+        } else if (b == 0xf0) {
+            d.lock = 1;
+        } else if ((b & 0xf0) != 0x40)
+            break;
+        d.p++;
+        if ((b & 0xf0) == 0x40 && d.p < d.end && is_prefix(*d.p)) {
+            d.rex_at = at;
+            return decode_prefixes(&d, insn, address, d.p - code);
+        }
+    }
+    prefix_length = d.p - code;
+    d.rex_at = prefix_length - 1;
+    if (prefix_length > 0 && (code[d.rex_at] & 0xf0) == 0x40)
+        d.rex = code[d.rex_at];
+    d.w = (d.rex & REX_W) != 0;
+
+    b = next_byte(&d);
+    if (b == 0x0f) {
+        b = next_byte(&d);
+        if (b == 0x38) {
+            map = 2;
+            b = next_byte(&d);
+            e = &three_byte_38[b];
+        } else if (b == 0x3a) {
+            map = 3;
+            b = next_byte(&d);
+            e = &three_byte_3a[b];
+        } else {
+            map = 1;
+            e = &two_byte[b];
+        }
+    } else if (b == 0xc4 || b == 0xc5) {
+        uint8_t b1 = next_byte(&d), b2;
+
+        if (b == 0xc5) {
+            d.vex = 2;
+            b2 = b1;
+            map = 1;
+            d.rex = REX | (b1 & 0x80 ? 0 : REX_R);
+        } else {
+            d.vex = 3;
+            b2 = next_byte(&d);
+            map = b1 & 0x1f;
+            d.rex = REX | (b1 & 0x80 ? 0 : REX_R) | (b1 & 0x40 ? 0 : REX_X) | (b1 & 0x20 ? 0 : REX_B)
+                  | (b2 & 0x80 ? REX_W : 0);
+        }
+        d.w = (b2 & 0x80) && d.vex == 3;
+        d.vvvv = (~b2 >> 3) & 0xf;
+        d.l = (b2 >> 2) & 1;
+        d.pp = b2 & 3;
+        if (map < 1 || map > 3)
+            return decode_escape(&d, insn, address);
+        b = next_byte(&d);
+        if (d.last_66 >= 0 || d.last_rep >= 0)
+            return decode_invalid(&d, insn, address);
+        e = map == 1 ? &two_byte[b] : map == 2 ? &three_byte_38[b] : &three_byte_3a[b];
+        if (map == 1 && (b & 0xf0) == 0x40)
+            e = &cmov_kmask[b & 0xf];
+        else if (map == 1 && (b & 0xf0) == 0x90)
+            e = &set_kmask[b & 0xf];
+    } else if (b == 0x8f && d.rex == 0 && d.p < d.end && (*d.p & 0x1f) >= 8) {
+        uint8_t b1 = next_byte(&d), b2 = next_byte(&d);
+
+        d.vex = 3;
+        map = b1 & 0x1f;
+        d.rex = REX | (b1 & 0x80 ? 0 : REX_R) | (b1 & 0x40 ? 0 : REX_X) | (b1 & 0x20 ? 0 : REX_B)
+              | (b2 & 0x80 ? REX_W : 0);
+        d.w = b2 >> 7;
+        d.vvvv = (~b2 >> 3) & 0xf;
+        d.l = (b2 >> 2) & 1;
+        d.pp = b2 & 3;
+        if (map > 10)
+            return decode_escape(&d, insn, address);
+        b = next_byte(&d);
+        // Map 10 has no rotation
+        if (d.last_66 >= 0 || d.last_rep >= 0 || map == 10)
+            return decode_invalid(&d, insn, address);
+        e = map == 8 ? &xop_8[b] : &xop_9[b];
+    } else if (b == 0x62) {
+        uint8_t p0 = next_byte(&d), p1, p2, rex = d.rex;
+
+        map = p0 & 7;
+        if (map == 0 || map == 4 || map == 7 || (p0 & 8))
+            return decode_escape(&d, insn, address);
+        p1 = next_byte(&d);
+        if (!(p1 & 4)) {
+            d.p--;
+            return decode_invalid(&d, insn, address);
+        }
+        p2 = next_byte(&d);
+        d.vex = 4;
+        d.rex = REX | (p0 & 0x80 ? 0 : REX_R) | (p0 & 0x40 ? 0 : REX_X) | (p0 & 0x20 ? 0 : REX_B)
+              | (p1 & 0x80 ? REX_W : 0);
+        d.evex_r = p0 & 0x10 ? 0 : 16;
+        d.evex_x = !(p0 & 0x40);
+        d.w = p1 >> 7;
+        d.vvvv = (~p1 >> 3) & 0xf;
+        d.pp = p1 & 3;
+        d.evex_v = p2 & 8 ? 0 : 16;
+        d.evex_z = p2 >> 7;
+        d.l = (p2 >> 5) & 3;
+        d.evex_b = (p2 >> 4) & 1;
+        d.evex_aaa = p2 & 7;
+        b = next_byte(&d);
+        // Maps 5 and 6 of half precision are not decoded
+        if (rex || d.last_66 >= 0 || d.last_rep >= 0 || map > 3 || d.l == 3)
+            return decode_invalid(&d, insn, address);
+        e = map == 1 ? &evex_0f[b] : map == 2 ? &evex_0f38[b] : &evex_0f3a[b];
+        if (e->name == NULL && e->kind == K_INSN)
+            e = map == 1 ? &two_byte[b] : map == 2 ? &three_byte_38[b] : &three_byte_3a[b];
+    } else {
+        e = &one_byte[b];
+        // xchg with r8 rather than nop
+        if (b == 0x90 && (d.rex & REX_B))
+            e = &one_byte[0x91];
+    }
+    d.opcode = b;
+    d.map = map;
+    // 3DNow! is not decoded, objdump shows the 0F of unknown ones alone
+    if (d.error || (map == 1 && b == 0x0f && !d.vex))
+        return decode_bad(&d, insn, address);
+    d.opcode_end = d.p - code;
+
+    if (needs_modrm(e, map)) {
+        // Moves of control and debug registers ignore mod
+        read_modrm(&d, map == 1 && (b & 0xfc) == 0x20);
+        if (d.error)
+            return decode_bad(&d, insn, address);
+    }
+    // Rounding controls of EVEX register forms are not decoded
+    if (d.vex == 4 && d.evex_b && d.mod == 3)
+        return decode_bad(&d, insn, address);
+
+    // Walk the sub-tables down to the instruction
+    while (e->kind != K_INSN) {
+        if (e->op[0])
+            memcpy(ops, e->op, 4);
+        flags |= e->flags;
+        switch (e->kind) {
+            case K_GROUP:  e = &e->sub[d.reg]; break;
+            case K_MOD:    e = &e->sub[d.mod == 3]; break;
+            case K_W:      e = &e->sub[d.w]; break;
+            case K_L:
+                if (d.l > 1)
+                    return decode_bad(&d, insn, address);
+                e = &e->sub[d.l];
+                break;
+            case K_VEX:    e = &e->sub[d.vex != 0]; break;
+            case K_PREFIX: e = &e->sub[prefix_slot(&d)]; break;
+            case K_RM:
+                if (d.mod != 3)
+                    return decode_bad(&d, insn, address);
+                e = &e->sub[d.rm];
+                break;
+            case K_X87:
+                d.opcode_end++; // objdump counts ModRM in invalid ones
+                if (d.mod == 3) {
+                    e = &x87_register[b - 0xd8][d.reg];
+                } else {
+                    // objdump shows the operand of invalid ones
+                    memset(&x87, 0, sizeof(Opcode));
+                    x87.name = x87_memory[b - 0xd8][d.reg];
+                    if (x87.name == NULL)
+                        x87.name = "(bad)", x87.flags = F_BAD;
+                    x87.op[0] = O_M;
+                    e = &x87;
+                }
+                break;
+        }
+    }
+    if (e->name == NULL)
+        return decode_bad(&d, insn, address);
+    if (e->op[0] || !ops[0])
+        memcpy(ops, e->op, 4);
+    flags |= e->flags;
+    d.flags = flags;
+    d.tuple = e->tuple;
+
+    // Encodings and mandatory prefixes
+    if (d.vex && !(flags & (F_V | F_VO)))
+        return decode_bad(&d, insn, address);
+    if (!d.vex && (flags & F_VO))
+        return decode_bad(&d, insn, address);
+    if (flags & F_OPSIZE) {
+        if (d.mandatory_66)
+            d.mandatory_66 = d.used_66 = 0;
+        else if (d.used_rep)
+            d.used_rep = 0;
+    }
+    if (flags & F_P66) {
+        if (d.vex ? d.pp != 1 : d.last_66 < 0)
+            return decode_bad(&d, insn, address);
+        d.used_66 = d.mandatory_66 = 1;
+    }
+    if (flags & F_NP) {
+        if (d.vex ? d.pp != 0 : d.last_66 >= 0 || d.last_rep >= 0)
+            return decode_bad(&d, insn, address);
+    }
+    if (flags & F_MMX) {
+        if (d.vex && d.pp != 1)
+            return decode_bad(&d, insn, address);
+        if (d.vex || d.last_66 >= 0) {
+            d.xmm = 1;
+            d.used_66 = d.mandatory_66 = !d.vex;
+        }
+    }
+
+    // Only the operands decoded are cleared
+    memset(insn, 0, offsetof(X86_insn, operand));
+    insn->address = address;
+    insn->vex = d.vex;
+    insn->w = d.w;
+    if (d.vex == 4) {
+        insn->mask = d.evex_aaa;
+        insn->zeroing = d.evex_z;
+    }
+
+    // Operands, with VEX.vvvv inserted as a source or the destination
+    uint8_t specs[X86_MAX_OPERANDS];
+    int count = 0;
+    for (int i = 0; i < 4 && ops[i]; i++) {
+        if (d.vex && (flags & F_NDD) && i == 0)
+            specs[count++] = O_Hx;
+        specs[count++] = ops[i];
+        if (d.vex && (flags & F_NDS) && i == 0)
+            specs[count++] = ops[0] == O_VX || ops[0] == O_UX || ops[0] == O_WX ? O_HX : O_Hx;
+    }
+    if ((flags & F_W4) && d.w) {
+        uint8_t spec = specs[count - 1];
+        specs[count - 1] = specs[count - 2];
+        specs[count - 2] = spec;
+    }
+    for (int i = 0; i < count; i++) {
+        memset(&insn->operand[i], 0, sizeof(X86_operand));
+        if (decode_operand(&d, specs[i], &insn->operand[i]) < 0)
+            return decode_bad(&d, insn, address);
+        if (insn->operand[i].kind == X86_TARGET)
+            d.relative = i;
+    }
+    insn->operand_count = count;
+    insn->broadcast = d.broadcast;
+    if (d.error || (d.vex && !d.vvvv_used && (d.vvvv || d.evex_v)))
+        return decode_bad(&d, insn, address);
+    insn->length = d.p - code;
+
+    // Targets, relative to the next instruction
+    if (d.relative >= 0) {
+        X86_operand *op = &insn->operand[d.relative];
+        op->value = insn->target = address + insn->length + op->value;
+        if (d.rel16) {
+            op->value = insn->target = (uint16_t)insn->target;
+            if (!(flags & F_COND))
+                insn->suffix = 'w';
+        }
+    }
+    if (d.has_memory && (d.mem.regclass == X86_RIP || d.mem.regclass == X86_EIP)) {
+        insn->flags |= X86_RIPREL;
+        insn->target = address + insn->length + d.mem.value;
+        if (d.mem.regclass == X86_EIP)
+            insn->target = (uint32_t)insn->target;
+    }
+
+    // Mnemonic
+    if (flags & F_SIZES) {
+        int size = operand_size(&d);
+        select_name(insn, e->name, size == 2 ? 0 : size == 4 ? 1 : 2);
+    } else if (flags & F_WNAME) {
+        use_rex(&d, REX_W);
+        select_name(insn, e->name, d.w);
+    } else if (flags & F_ANAME) {
+        select_name(insn, e->name, d.last_67 >= 0);
+    } else {
+        select_name(insn, e->name, 0);
+    }
+    if (d.vex && (flags & F_V))
+        insn->vprefix = 'v';
+
+    int osize = d.esize ? d.esize : d.bsize ? 1 : 0;
+    if (flags & (F_S | F_S64 | F_SM)) {
+        if (osize == 0)
+            osize = operand_size(&d);
+        if ((flags & F_SM) ? d.has_memory : !d.sized && !((flags & F_S64) && osize == 8))
+            insn->suffix = size_suffix(osize);
+    } else if (flags & F_SG) {
+        insn->suffix = size_suffix(operand_size(&d));
+    } else if (flags & F_KSIZE) {
+        insn->suffix = mask_suffix(&d);
+    } else if ((flags & F_XY) && d.has_memory) {
+        insn->suffix = d.l ? 'y' : 'x';
+    }
+
+    // Immediates folded into the name
+    if ((flags & (F_CMP | F_ICMP | F_PCLMUL)) && count > 0 && insn->operand[count - 1].kind == X86_IMM) {
+        uint64_t imm = insn->operand[count - 1].value;
+
+        if ((flags & F_CMP) && imm < (d.vex ? 32u : 8u)) {
+            insn->predicate = vex_predicates[imm];
+            insn->predicate_at = 3;
+            insn->operand_count--;
+        } else if ((flags & F_ICMP) && imm < 8) {
+            // vpcmpub becomes vpcmp<predicate>ub
+            insn->predicate = integer_predicates[imm];
+            insn->predicate_at = 5;
+            insn->operand_count--;
+        } else if ((flags & F_PCLMUL) && (imm & ~0x11) == 0) {
+            // pclmulqdq becomes pclmul<predicate>dq
+            insn->predicate = pclmul_predicates[(imm & 1) | (imm >> 3)];
+            insn->predicate_at = 6;
+            insn->name = "pclmuldq";
+            insn->name_length = 8;
+            insn->operand_count--;
+        }
+    }
+
+    // Branches
+    if (flags & F_CALL)
+        insn->flags |= X86_CALL;
+    if (flags & F_JUMP)
+        insn->flags |= X86_JUMP;
+    if (flags & F_COND)
+        insn->flags |= X86_COND;
+    if (flags & F_RET)
+        insn->flags |= X86_RET;
+    if (flags & F_NOREV)
+        insn->flags |= X86_INTEL_ORDER;
+    if (flags & F_BAD)
+        insn->flags |= X86_BAD;
+    if (flags & F_IND) {
+        insn->flags |= X86_INDIRECT;
+        insn->operand[0].flags |= X86_STAR;
+    }
+    if ((flags & F_COND) && map == 0 && b >= 0xe0 && b <= 0xe3 && d.last_67 >= 0) {
+        // jrcxz and loop on ecx
+        if (b == 0xe3) {
+            insn->name = "jecxz";
+            insn->name_length = 5;
+        } else {
+            insn->suffix = 'l';
+        }
+        d.used_67 = 1;
+    }
+    // Branch hints
+    if ((flags & F_COND) && (d.segment == 0x2e || d.segment == 0x3e)) {
+        insn->predicate = d.segment == 0x2e ? ",pn" : ",pt";
+        insn->predicate_at = insn->name_length;
+        d.used_segment = 1;
+    }
+    if (d.fwait && insn->name[0] == 'f' && insn->name[1] == 'n') {
+        for (size_t i = 0; i < sizeof(waiting_names) / sizeof(*waiting_names); i++) {
+            const char *name = waiting_names[i];
+
+            if (strlen(name) + 1 == insn->name_length && !memcmp(name + 1, insn->name + 2, insn->name_length - 2)) {
+                insn->name = name;
+                insn->name_length--;
+            }
+        }
+    }
+
+    unused_prefixes(&d, insn, prefix_length);
+    return insn->length;
+}
+
+// Whether spec is ModRM rm when it is a memory operand
+static int is_rm_memory(int spec) {
+    switch (spec) {
+        case O_Eb: case O_Ew: case O_Ed: case O_Eq: case O_Ev: case O_Ey: case O_Ev64: case O_Es: case O_M:
+        case O_Qq: case O_QX: case O_Wx: case O_WX: case O_Wh: case O_Km:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Forms of ModRM an entry is valid with, and whether one of its operands is
+// then in memory
+#define SCAN_MEMORY_FORM   0x1
+#define SCAN_REGISTER_FORM 0x2
+#define SCAN_IN_MEMORY     0x4
+
+// Bytes of immediate and of relative offset the operands of an entry take,
+// and its SCAN_* forms, 0 for those left to x86_decode
+static int scan_operands(const uint8_t *ops, uint32_t flags, int short_size, int rex_w, int has_66, int has_67,
+                         int *immediate, int *relative) {
+    int osize = flags & F_F64 ? 8 : flags & F_D64 ? (short_size ? 2 : 8) : rex_w ? 8 : short_size ? 2 : 4;
+    int forms = SCAN_MEMORY_FORM | SCAN_REGISTER_FORM;
+
+    *immediate = *relative = 0;
+    for (int i = 0; i < 4 && ops[i]; i++) {
+        switch (ops[i]) {
+            case O_Ib: case O_Ibs: *immediate += 1; break;
+            case O_Iw:             *immediate += 2; break;
+            case O_Iz:             *immediate += osize == 2 ? 2 : 4; break;
+            case O_Iv:             *immediate += osize; break;
+            case O_Ob: case O_Ov:  *immediate += has_67 ? 4 : 8; break;
+            case O_Jb:             *relative = 1; break;
+            case O_Jz:             *relative = has_66 && !rex_w ? 2 : 4; break;
+            case O_Rq: case O_Ry: case O_Nq: case O_Ux: case O_UX: case O_Ku:
+                forms &= ~SCAN_MEMORY_FORM;
+                break;
+            case O_M:
+                forms = (forms & ~SCAN_REGISTER_FORM) | SCAN_IN_MEMORY;
+                break;
+            case O_Lx:
+                return 0;
+            default:
+                if (is_rm_memory(ops[i]))
+                    forms |= SCAN_IN_MEMORY;
+        }
+    }
+    return forms & (SCAN_MEMORY_FORM | SCAN_REGISTER_FORM) ? forms : 0;
+}
+
+static uint8_t scan_flags(uint32_t flags) {
+    return (flags & F_CALL ? X86_CALL : 0) | (flags & F_JUMP ? X86_JUMP : 0) | (flags & F_COND ? X86_COND : 0)
+         | (flags & F_RET ? X86_RET : 0) | (flags & F_IND ? X86_INDIRECT : 0)
+         | (flags & F_NOREV ? X86_INTEL_ORDER : 0);
+}
+
+// What an opcode of the one or two byte map needs for x86_scan: the length
+// its instructions agree on, those of a group being told by ModRM reg
+typedef struct {
+    uint8_t regs;           // ModRM reg values summarized, none if the tables are walked
+    uint8_t modrm;          // 0xff if there is a ModRM, to mask its length with
+    uint8_t forms;          // SCAN_*
+    uint8_t tail[2][2];     // Immediate and relative bytes, by 66 and REX.W
+    uint8_t relative[2][2];
+    uint8_t flags[8];       // X86_*, by ModRM reg
+} Scan_entry;
+
+#define SCAN_66    1
+#define SCAN_67    2
+#define SCAN_REX   3
+#define SCAN_REP   4
+#define SCAN_OTHER 5 // Segment or lock
+#define SCAN_SLOW  6 // fwait, that may prefix an x87 instruction
+
+// Classes of the bytes that may come before the opcode in scan_fast
+#define SCAN_C_OPCODE 0
+#define SCAN_C_LEAD   1 // Segment, lock or rep, only as the first byte
+#define SCAN_C_66     2
+#define SCAN_C_REX    3
+#define SCAN_C_REX_W  4
+#define SCAN_C_ESCAPE 5
+
+// Layout of the instruction those classes give: offset of the opcode, and
+// its map and prefixes
+#define SCAN_AT  0x07
+#define SCAN_MAP 0x08 // Two byte map
+#define SCAN_O66 0x10
+#define SCAN_W   0x20
+
+// Bytes a ModRM takes with its SIB and displacement, and whether it is
+// RIP-relative
+#define SCAN_LENGTH 0x0f
+#define SCAN_RIP    0x10
+
+static Scan_entry scan_entries[2][256];
+static uint8_t scan_prefixes[256];
+static uint8_t scan_classes[256];
+static uint8_t scan_layouts[1 << 12]; // By the SCAN_C_* of the first four bytes
+static uint8_t scan_modrm[8][256];    // By the low bits of the byte after ModRM, the SIB base, and ModRM
+static pthread_once_t scan_once = PTHREAD_ONCE_INIT;
+
+// Lengths of the instruction of operands ops and flags in entry, or 0 if
+// they depend on more than 66 and REX.W
+static int scan_lengths(Scan_entry *entry, const uint8_t *ops, uint32_t flags) {
+    int immediate, relative, immediate_67;
+
+    for (int has_66 = 0; has_66 < 2; has_66++) {
+        for (int rex_w = 0; rex_w < 2; rex_w++) {
+            entry->forms = scan_operands(ops, flags, has_66, rex_w, has_66, 0, &immediate, &relative);
+            if (entry->forms == 0
+                || scan_operands(ops, flags, has_66, rex_w, has_66, 1, &immediate_67, &relative) != entry->forms
+                || immediate_67 != immediate)
+                return 0;
+            entry->tail[has_66][rex_w] = immediate + relative;
+            entry->relative[has_66][rex_w] = relative;
+        }
+    }
+    return 1;
+}
+
+// Summarize the instructions the opcode at top stands for in e, the first
+// that can be and those of its group that agree with it
+static void scan_summarize(Scan_entry *e, const Opcode *top, int map) {
+    int count = top->kind == K_GROUP ? 8 : 1;
+
+    if (top->kind != K_INSN && top->kind != K_GROUP)
+        return;
+    for (int reg = 0; reg < count; reg++) {
+        const Opcode *leaf = top->kind == K_GROUP ? &top->sub[reg] : top;
+        const uint8_t *ops = leaf->op[0] || !top->op[0] ? leaf->op : top->op;
+        uint32_t flags = (top == leaf ? 0 : top->flags) | leaf->flags;
+        Scan_entry entry = { 0, needs_modrm(top, map) ? 0xff : 0, 0, { { 0 } }, { { 0 } }, { 0 } };
+
+        if (leaf->kind != K_INSN || leaf->name == NULL || (flags & (F_VO | F_BAD | F_P66 | F_NP | F_MMX))
+            || !scan_lengths(&entry, ops, flags))
+            continue;
+        if (e->regs == 0)
+            *e = entry;
+        else if (entry.forms != e->forms || memcmp(entry.tail, e->tail, sizeof(e->tail)) != 0
+                 || memcmp(entry.relative, e->relative, sizeof(e->relative)) != 0)
+            continue;
+        e->regs |= count == 1 ? 0xff : 1 << reg;
+        memset(count == 1 ? e->flags : &e->flags[reg], scan_flags(flags), count == 1 ? 8 : 1);
+    }
+}
+
+static void scan_init(void) {
+    static const uint8_t others[] = { 0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65, 0xf0 };
+
+    for (unsigned i = 0; i < sizeof(others); i++)
+        scan_prefixes[others[i]] = SCAN_OTHER;
+    for (int b = 0x40; b < 0x50; b++)
+        scan_prefixes[b] = SCAN_REX;
+    scan_prefixes[0x66] = SCAN_66;
+    scan_prefixes[0x67] = SCAN_67;
+    scan_prefixes[0xf2] = scan_prefixes[0xf3] = SCAN_REP;
+    scan_prefixes[0x9b] = SCAN_SLOW;
+
+    for (int b = 0; b < 256; b++) {
+        scan_classes[b] = scan_prefixes[b] == SCAN_REP || scan_prefixes[b] == SCAN_OTHER ? SCAN_C_LEAD
+                        : b == 0x66 ? SCAN_C_66 : b == 0x0f ? SCAN_C_ESCAPE
+                        : scan_prefixes[b] == SCAN_REX ? (b & REX_W ? SCAN_C_REX_W : SCAN_C_REX) : SCAN_C_OPCODE;
+    }
+
+    // At most a lead byte, 66, REX and the escape, in that order
+    for (int key = 0; key < 1 << 12; key++) {
+        int c[4] = { key & 7, key >> 3 & 7, key >> 6 & 7, key >> 9 & 7 };
+        int at = c[0] == SCAN_C_LEAD, layout = 0;
+
+        if (c[at] == SCAN_C_66) {
+            layout |= SCAN_O66;
+            at++;
+        }
+        if (c[at] == SCAN_C_REX_W)
+            layout |= SCAN_W;
+        at += c[at] == SCAN_C_REX || c[at] == SCAN_C_REX_W;
+        if (c[at] == SCAN_C_ESCAPE) {
+            layout |= SCAN_MAP;
+            at++;
+        }
+        scan_layouts[key] = layout | at;
+    }
+
+    // Under mod 0, rm 5 is RIP-relative and a SIB base of 5 takes a
+    // displacement
+    for (int base = 0; base < 8; base++) {
+        for (int m = 0; m < 256; m++) {
+            int mod = m >> 6, rm = m & 7;
+
+            if (mod == 3)
+                scan_modrm[base][m] = 1;
+            else
+                scan_modrm[base][m] = 1 + (rm == 4) + (mod == 1 ? 1 : mod == 2 ? 4 : 0)
+                                    + (mod == 0 && rm == 5 ? 4 | SCAN_RIP : 0)
+                                    + (mod == 0 && rm == 4 && base == 5 ? 4 : 0);
+        }
+    }
+
+    // Not the opcodes the prefix loop or the escapes take. 90 and 91, that
+    // REX.B makes of it, have the same summary.
+    for (int b = 0; b < 256; b++) {
+        if (!scan_prefixes[b] && b != 0x0f && b != 0xc4 && b != 0xc5 && b != 0x62 && b != 0x8f)
+            scan_summarize(&scan_entries[0][b], &one_byte[b], 0);
+        if (b != 0x0f && b != 0x38 && b != 0x3a && (b & 0xfc) != 0x20)
+            scan_summarize(&scan_entries[1][b], &two_byte[b], 1);
+    }
+}
+
+// What x86_scan cannot tell alone is decoded in full
+static int scan_decode(const uint8_t *code, uint64_t size, uint64_t address, X86_brief *brief) {
+    X86_insn insn;
+
+    x86_decode(code, size, address, &insn);
+    brief->target = insn.target;
+    brief->flags = insn.flags;
+    brief->length = insn.length;
+    return insn.length;
+}
+
+// x86_scan of the usual forms, an opcode of the one or two byte map after at
+// most a segment, lock or rep prefix, 66 and REX. The length of an
+// instruction is needed to find the next one, so it is made of as few
+// dependent steps as can be: the classes of the first four bytes give the
+// layout in one lookup, the opcode its entry, and ModRM with the SIB base the
+// bytes they take in another. Needs X86_MAX_LENGTH bytes at code; returns 0
+// for other forms.
+static int scan_fast(const uint8_t *code, uint64_t address, X86_brief *brief) {
+    uint64_t word = (uint64_t)code[0] | (uint64_t)code[1] << 8 | (uint64_t)code[2] << 16 | (uint64_t)code[3] << 24
+                  | (uint64_t)code[4] << 32 | (uint64_t)code[5] << 40 | (uint64_t)code[6] << 48
+                  | (uint64_t)code[7] << 56;
+    int layout = scan_layouts[scan_classes[code[0]] | scan_classes[code[1]] << 3 | scan_classes[code[2]] << 6
+                              | scan_classes[code[3]] << 9];
+    int at = layout & SCAN_AT, has_66 = (layout & SCAN_O66) != 0, rex_w = (layout & SCAN_W) != 0;
+    const Scan_entry *e = &scan_entries[(layout & SCAN_MAP) != 0][word >> 8 * at & 0xff];
+    int modrm = word >> 8 * (at + 1) & 0xff, reg = (modrm >> 3) & 7, relative, length;
+    int form = e->modrm && modrm < 0xc0 ? SCAN_MEMORY_FORM : SCAN_REGISTER_FORM;
+
+    if (!(e->regs >> reg & 1) || !(e->forms & form))
+        return 0;
+
+    modrm = scan_modrm[word >> 8 * (at + 2) & 7][modrm] & e->modrm;
+    relative = e->relative[has_66][rex_w];
+    length = at + 1 + (modrm & SCAN_LENGTH) + e->tail[has_66][rex_w];
+    brief->length = length;
+    brief->flags = e->flags[reg];
+    brief->target = 0;
+    if (relative) {
+        const uint8_t *p = code + length - relative;
+        int64_t offset = relative == 1 ? (int8_t)p[0] : relative == 2 ? (int16_t)(p[0] | p[1] << 8)
+                       : (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+
+        brief->target = address + length + offset;
+        if (relative == 2)
+            brief->target = (uint16_t)brief->target;
+    } else if ((modrm & SCAN_RIP) && (e->forms & SCAN_IN_MEMORY)) {
+        const uint8_t *p = code + at + 2;
+
+        brief->flags |= X86_RIPREL;
+        brief->target = address + length
+                      + (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    }
+    return length;
+}
+
+// x86_scan of the forms scan_fast leaves: opcodes without a summary are
+// walked through the tables, and VEX, EVEX, XOP, x87, invalid and truncated
+// ones, rare in code, go through x86_decode
+static int scan_walk(const uint8_t *code, uint64_t size, uint64_t address, X86_brief *brief) {
+    const uint8_t *p = code, *end = code + (size < X86_MAX_LENGTH ? size : X86_MAX_LENGTH);
+    const uint8_t *disp_at = NULL;
+    const Opcode *e;
+    const Scan_entry *summary = NULL;
+    uint8_t ops[4] = { 0 };
+    uint32_t flags = 0;
+    int has_66 = 0, has_67 = 0, mandatory_66 = 0, rex = 0, rep = 0, map = 0;
+    int mod = 3, reg = 0, rm = 0, disp_size = 0, rip = 0, memory = 0;
+    int immediate_size = 0, relative_size = 0, forms;
+    uint8_t b;
+
+    // Legacy prefixes, then REX right before the opcode
+    for (;; p++) {
+        if (p >= end)
+            return scan_decode(code, size, address, brief);
+        b = *p;
+        if (scan_prefixes[b] == 0)
+            break;
+        if (scan_prefixes[b] == SCAN_SLOW || (scan_prefixes[b] == SCAN_REX && p + 1 < end && scan_prefixes[p[1]]))
+            return scan_decode(code, size, address, brief);
+        has_66 |= b == 0x66;
+        has_67 |= b == 0x67;
+        if (scan_prefixes[b] == SCAN_REP)
+            rep = b;
+        else if (scan_prefixes[b] == SCAN_REX)
+            rex = b;
+    }
+    p++;
+    if (b == 0x0f) {
+        if (p + 1 >= end)
+            return scan_decode(code, size, address, brief);
+        b = *p++;
+        if (b == 0x38) {
+            map = 2;
+            b = *p++;
+            e = &three_byte_38[b];
+        } else if (b == 0x3a) {
+            map = 3;
+            b = *p++;
+            e = &three_byte_3a[b];
+        } else if (b != 0x0f) {
+            map = 1;
+            e = &two_byte[b];
+            summary = &scan_entries[1][b];
+        } else {
+            return scan_decode(code, size, address, brief);
+        }
+    } else if (b == 0xc4 || b == 0xc5 || b == 0x62 || (b == 0x8f && rex == 0 && p < end && (*p & 0x1f) >= 8)) {
+        return scan_decode(code, size, address, brief);
+    } else {
+        e = &one_byte[b];
+        summary = &scan_entries[0][b];
+        if (b == 0x90 && (rex & REX_B))
+            e = &one_byte[0x91];
+    }
+    if (summary != NULL && summary->regs == 0)
+        summary = NULL;
+
+    if (summary != NULL ? summary->modrm : needs_modrm(e, map)) {
+        if (p >= end)
+            return scan_decode(code, size, address, brief);
+        uint8_t modrm = *p++;
+
+        mod = map == 1 && (b & 0xfc) == 0x20 ? 3 : modrm >> 6;
+        reg = (modrm >> 3) & 7;
+        rm = modrm & 7;
+        if (mod != 3) {
+            disp_size = mod == 1 ? 1 : mod == 2 ? 4 : 0;
+            if (rm == 4) {
+                if (p >= end)
+                    return scan_decode(code, size, address, brief);
+                if ((*p++ & 7) == 5 && mod == 0)
+                    disp_size = 4;
+            } else if (rm == 5 && mod == 0) {
+                disp_size = 4;
+                rip = 1;
+            }
+            disp_at = p;
+            p += disp_size;
+        }
+    }
+
+    if (summary != NULL && (summary->regs >> reg & 1)
+        && (summary->forms & (mod != 3 ? SCAN_MEMORY_FORM : SCAN_REGISTER_FORM))) {
+        int rex_w = (rex & REX_W) != 0;
+
+        p += summary->tail[has_66][rex_w];
+        relative_size = summary->relative[has_66][rex_w];
+        memory = mod != 3 && (summary->forms & SCAN_IN_MEMORY);
+        flags = summary->flags[reg];
+    } else {
+        while (e->kind != K_INSN) {
+            if (e->op[0])
+                memcpy(ops, e->op, 4);
+            flags |= e->flags;
+            switch (e->kind) {
+                case K_GROUP:  e = &e->sub[reg]; break;
+                case K_MOD:    e = &e->sub[mod == 3]; break;
+                case K_W:      e = &e->sub[(rex & REX_W) != 0]; break;
+                case K_L:
+                case K_VEX:    e = &e->sub[0]; break;
+                case K_PREFIX:
+                    mandatory_66 = !rep && has_66;
+                    e = &e->sub[rep ? (rep == 0xf3 ? 2 : 3) : has_66];
+                    break;
+                case K_RM:
+                    if (mod != 3)
+                        return scan_decode(code, size, address, brief);
+                    e = &e->sub[rm];
+                    break;
+                default:
+                    return scan_decode(code, size, address, brief);
+            }
+        }
+        if (e->op[0] || !ops[0])
+            memcpy(ops, e->op, 4);
+        flags |= e->flags;
+        if (e->name == NULL || (flags & (F_VO | F_BAD)) || ((flags & F_P66) && !has_66)
+            || ((flags & F_NP) && (has_66 || rep)))
+            return scan_decode(code, size, address, brief);
+        if (flags & F_OPSIZE)
+            mandatory_66 = 0;
+        if (flags & (F_P66 | F_MMX))
+            mandatory_66 |= has_66;
+        forms = scan_operands(ops, flags, has_66 && !mandatory_66, (rex & REX_W) != 0, has_66, has_67,
+                              &immediate_size, &relative_size);
+        if (!(forms & (mod != 3 ? SCAN_MEMORY_FORM : SCAN_REGISTER_FORM)))
+            return scan_decode(code, size, address, brief);
+        memory = mod != 3 && (forms & SCAN_IN_MEMORY);
+        p += immediate_size + relative_size;
+        flags = scan_flags(flags);
+    }
+    if (p > end)
+        return scan_decode(code, size, address, brief);
+
+    brief->length = p - code;
+    brief->target = 0;
+    brief->flags = flags;
+    if (relative_size) {
+        const uint8_t *at = p - relative_size;
+        int64_t offset = relative_size == 1 ? (int8_t)at[0] : relative_size == 2 ? (int16_t)(at[0] | at[1] << 8)
+                       : (int32_t)((uint32_t)at[0] | (uint32_t)at[1] << 8 | (uint32_t)at[2] << 16 | (uint32_t)at[3] << 24);
+
+        brief->target = address + brief->length + offset;
+        if (relative_size == 2)
+            brief->target = (uint16_t)brief->target;
+    }
+    if (rip && memory) {
+        int32_t offset = (int32_t)((uint32_t)disp_at[0] | (uint32_t)disp_at[1] << 8 | (uint32_t)disp_at[2] << 16
+                                   | (uint32_t)disp_at[3] << 24);
+
+        brief->flags |= X86_RIPREL;
+        brief->target = address + brief->length + offset;
+        if (has_67)
+            brief->target = (uint32_t)brief->target;
+    }
+    return brief->length;
+}
+
+// Length, flags and target of the instruction at code, the same as
+// x86_decode gives, without building its operands, name or prefixes, for
+// scans of whole sections. The tables are summarized on the first call.
+int x86_scan(const uint8_t *code, uint64_t size, uint64_t address, X86_brief *brief) {
+    int length;
+
+    pthread_once(&scan_once, scan_init);
+    if (size >= X86_MAX_LENGTH && (length = scan_fast(code, address, brief)) > 0)
+        return length;
+    return scan_walk(code, size, address, brief);
+}
+
+static const char *gpr8[8] = { "al", "cl", "dl", "bl", "ah", "ch", "dh", "bh" };
+static const char *gpr8_rex[16] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+};
+static const char *gpr16[16] = {
+    "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w",
+};
+static const char *gpr32[16] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+};
+static const char *gpr64[16] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+};
+static const char *segments[8] = { "es", "cs", "ss", "ds", "fs", "gs", "?", "?" };
+
+static char *put_str(char *text, const char *s) {
+    while (*s)
+        *text++ = *s++;
+    return text;
+}
+
+static char *put_hex(char *text, uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    char buf[16];
+    int n = 0;
+
+    do {
+        buf[n++] = digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+    while (n)
+        *text++ = buf[--n];
+    return text;
+}
+
+static char *put_number(char *text, const char *prefix, unsigned value) {
+    char buf[4];
+    int n = 0;
+
+    text = put_str(text, prefix);
+    do {
+        buf[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n)
+        *text++ = buf[--n];
+    return text;
+}
+
+static char *put_register(char *text, int regclass, int reg) {
+    *text++ = '%';
+    switch (regclass) {
+        case X86_GPR8:     return put_str(text, gpr8[reg & 7]);
+        case X86_GPR8_REX: return put_str(text, gpr8_rex[reg & 15]);
+        case X86_GPR16:    return put_str(text, gpr16[reg & 15]);
+        case X86_GPR32:    return put_str(text, gpr32[reg & 15]);
+        case X86_GPR64:    return put_str(text, gpr64[reg & 15]);
+        case X86_SEG:      return put_str(text, segments[reg & 7]);
+        case X86_CR:       return put_number(text, "cr", reg);
+        case X86_DR:       return put_number(text, "db", reg);
+        case X86_MMX:      return put_number(text, "mm", reg);
+        case X86_XMM:      return put_number(text, "xmm", reg);
+        case X86_YMM:      return put_number(text, "ymm", reg);
+        case X86_ZMM:      return put_number(text, "zmm", reg);
+        case X86_MASK:     return put_number(text, "k", reg);
+        case X86_RIP:      return put_str(text, "rip");
+        case X86_EIP:      return put_str(text, "eip");
+    }
+    return text;
+}
+
+static char *put_operand(char *text, const X86_operand *op) {
+    if (op->flags & X86_STAR)
+        *text++ = '*';
+    if (op->flags & X86_PORT)
+        return put_str(text, "(%dx)");
+    switch (op->kind) {
+        case X86_REG:
+            if (op->regclass == X86_ST) {
+                text = put_str(text, "%st");
+                if (!(op->flags & X86_ST_ALONE)) {
+                    *text++ = '(';
+                    *text++ = '0' + op->reg;
+                    *text++ = ')';
+                }
+                return text;
+            }
+            return put_register(text, op->regclass, op->reg);
+        case X86_IMM:
+            text = put_str(text, "$0x");
+            return put_hex(text, op->value);
+        case X86_TARGET:
+            return put_hex(text, op->value);
+    }
+
+    // Memory
+    if (op->segment != X86_NONE) {
+        text = put_register(text, X86_SEG, op->segment);
+        *text++ = ':';
+    }
+    if (op->flags & X86_ABSOLUTE) {
+        text = put_str(text, "0x");
+        return put_hex(text, op->value);
+    }
+    if (op->flags & X86_DISP) {
+        if (op->value < 0) {
+            text = put_str(text, "-0x");
+            text = put_hex(text, -(uint64_t)op->value);
+        } else {
+            text = put_str(text, "0x");
+            text = put_hex(text, op->value);
+        }
+    }
+    *text++ = '(';
+    if (op->reg != X86_NONE)
+        text = put_register(text, op->regclass, op->reg);
+    if (op->index != X86_NONE || (op->flags & X86_RIZ)) {
+        *text++ = ',';
+        if (op->flags & X86_RIZ)
+            text = put_str(text, op->index_class == X86_GPR32 ? "%eiz" : "%riz");
+        else
+            text = put_register(text, op->index_class, op->index);
+        *text++ = ',';
+        *text++ = '0' + op->scale;
+    }
+    *text++ = ')';
+    return text;
+}
+
+// Write the AT&T text of insn to text, at least 160 bytes. Returns its length.
+int x86_format(const X86_insn *insn, char *text) {
+    char *start = text;
+
+    for (int i = 0; i < insn->prefix_count; i++) {
+        text = put_str(text, prefix_names[insn->prefixes[i]]);
+        if (i + 1 < insn->prefix_count || insn->name_length)
+            *text++ = ' ';
+    }
+    if (insn->vprefix)
+        *text++ = insn->vprefix;
+    if (insn->predicate) {
+        memcpy(text, insn->name, insn->predicate_at);
+        text = put_str(text + insn->predicate_at, insn->predicate);
+        memcpy(text, insn->name + insn->predicate_at, insn->name_length - insn->predicate_at);
+        text += insn->name_length - insn->predicate_at;
+    } else {
+        memcpy(text, insn->name, insn->name_length);
+        text += insn->name_length;
+    }
+    if (insn->suffix)
+        *text++ = insn->suffix;
+
+    if (insn->operand_count > 0) {
+        // Mnemonics are padded to 6 characters, prefixes included
+        while (text - start < 6)
+            *text++ = ' ';
+        *text++ = ' ';
+
+        int reverse = !(insn->flags & X86_INTEL_ORDER);
+        for (int i = 0; i < insn->operand_count; i++) {
+            int n = reverse ? insn->operand_count - 1 - i : i;
+
+            if (i > 0)
+                *text++ = ',';
+            text = put_operand(text, &insn->operand[n]);
+            if (insn->broadcast && insn->operand[n].kind == X86_MEM)
+                text = put_number(text, "{1to", insn->broadcast), *text++ = '}';
+        }
+        if (insn->mask)
+            text = put_number(text, "{%k", insn->mask), *text++ = '}';
+        if (insn->zeroing)
+            text = put_str(text, "{z}");
+    }
+    *text = 0;
+    return text - start;
+}
+
+// Symbols of the code, sorted by section then address
+
+#define R_X86_64_GLOB_DAT  6
+#define R_X86_64_JUMP_SLOT 7
+
+#define STT_GNU_IFUNC 10
+
+typedef struct {
+    uint64_t address;
+    uint64_t size;
+    const char *name;  // In the string tables of the image
+    uint32_t section;  // For relocatable files, whose addresses are per section
+    uint32_t order;    // Preference among the symbols of an address, lower first
+    uint8_t plt;       // Entry of the PLT, printed name@plt
+} Code_symbol;
+
+typedef struct Code_symbols {
+    Code_symbol *symbols;
+    uint64_t count;
+    uint64_t capacity;
+} Code_symbols;
+
+static void add_symbol(Code_symbols *code, uint64_t address, uint64_t size, const char *name,
+                       uint32_t section, uint32_t order, int plt) {
+    if (code->count == code->capacity) {
+        code->capacity = code->capacity ? 2 * code->capacity : 256;
+        code->symbols = realloc(code->symbols, code->capacity * sizeof(Code_symbol));
+        if (code->symbols == NULL) {
+            perror("alfur");
+            exit(1);
+        }
+    }
+    code->symbols[code->count++] = (Code_symbol){ address, size, name, section, order, plt };
+}
+
+static int compare_code_symbols(const void *a, const void *b) {
+    const Code_symbol *x = a, *y = b;
+
+    if (x->section != y->section)
+        return x->section < y->section ? -1 : 1;
+    if (x->address != y->address)
+        return x->address < y->address ? -1 : 1;
+    if (x->order != y->order)
+        return x->order < y->order ? -1 : 1;
+    return 0;
+}
+
+// Rank of a symbol among those of its address, like objdump picks them:
+// functions, then global, then weak ones, in the order of the table
+static uint32_t symbol_order(Elf64_Sym *sym, uint64_t number) {
+    uint8_t type = ELF64_ST_TYPE(sym->st_info), bind = ELF64_ST_BIND(sym->st_info);
+    uint32_t rank = (type != STT_FUNC && type != STT_GNU_IFUNC) << 2
+                  | (bind == STB_LOCAL) << 1 | (bind != STB_GLOBAL);
+
+    return rank << 28 | (number & 0xfffffff);
+}
+
+// Name the PLT entries of section after the symbols of the GOT slots they
+// jump through
+static void add_plt_symbols(Elf64_data *file, Code_symbols *code, Elf64_Shdr *plt, const uint8_t *data) {
+    uint64_t entry = plt->sh_entsize ? plt->sh_entsize : 16;
+    X86_insn insn;
+
+    for (uint64_t at = 0; at < plt->sh_size; at += insn.length) {
+        x86_decode(data + at, plt->sh_size - at, plt->sh_addr + at, &insn);
+        if ((insn.flags & (X86_JUMP | X86_INDIRECT | X86_RIPREL)) != (X86_JUMP | X86_INDIRECT | X86_RIPREL))
+            continue;
+
+        Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+        for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+            if (section->sh_type != SHT_RELA || section->sh_link >= file->elf_head->e_shnum)
+                continue;
+
+            uint64_t count;
+            Elf64_Rela *rela = elf_table(file, section, ELF_T_RELA, &count);
+            if (rela == NULL)
+                continue;
+            for (uint64_t j = 0; j < count; j++) {
+                uint32_t type = ELF64_R_TYPE(rela[j].r_info);
+                if (rela[j].r_offset != insn.target || ELF64_R_SYM(rela[j].r_info) == 0
+                    || (type != R_X86_64_JUMP_SLOT && type != R_X86_64_GLOB_DAT))
+                    continue;
+
+                Elf64_Sym *symbols;
+                char *names;
+                uint64_t names_size;
+                uint64_t symbol_count = elf_symbols(file, get_section(file, section->sh_link), &symbols, &names,
+                                                    &names_size);
+                if (ELF64_R_SYM(rela[j].r_info) < symbol_count)
+                    add_symbol(code, plt->sh_addr + at / entry * entry, entry,
+                               elf_string(names, names_size, symbols[ELF64_R_SYM(rela[j].r_info)].st_name),
+                               0, 1u << 31, 1);
+                break;
+            }
+        }
+    }
+}
+
+// Symbols of the file, from SYMTAB or else DYNSYM, the PLT entries and the
+// starts of the executable sections
+static Code_symbols *code_symbols(Elf64_data *file) {
+    int relocatable = file->elf_head->e_type == ET_REL;
+    int type = SHT_DYNSYM;
+    Code_symbols *code;
+    Elf64_Shdr *section;
+
+    if (file->code != NULL)
+        return file->code;
+    if ((code = calloc(1, sizeof(Code_symbols))) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+
+    section = (Elf64_Shdr*)file->elf_shead;
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        if (section->sh_type == SHT_SYMTAB) {
+            type = SHT_SYMTAB;
+            break;
+        }
+    }
+
+    section = (Elf64_Shdr*)file->elf_shead;
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        if (section->sh_type != (uint32_t)type)
+            continue;
+
+        Elf64_Sym *s;
+        char *names;
+        uint64_t names_size;
+        uint64_t count = elf_symbols(file, section, &s, &names, &names_size);
+
+        for (uint64_t j = 0; j < count; j++, s++) {
+            uint8_t sym_type = ELF64_ST_TYPE(s->st_info);
+            const char *name = elf_string(names, names_size, s->st_name);
+
+            if (s->st_shndx == SHN_UNDEF || s->st_shndx >= SHN_LORESERVE || name[0] == 0)
+                continue;
+            if (sym_type != STT_NOTYPE && sym_type != STT_OBJECT && sym_type != STT_FUNC
+                && sym_type != STT_GNU_IFUNC)
+                continue;
+            add_symbol(code, s->st_value, s->st_size, name, relocatable ? s->st_shndx : 0,
+                       symbol_order(s, j), 0);
+        }
+    }
+
+    section = (Elf64_Shdr*)file->elf_shead;
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        if (!(section->sh_flags & SHF_EXECINSTR) || section->sh_type != SHT_PROGBITS)
+            continue;
+
+        const char *name = elf_section_name(file, section);
+        const uint8_t *data;
+        if (!relocatable && strncmp(name, ".plt", 4) == 0
+            && (data = (const uint8_t*)elf_section_data(file, section)) != NULL)
+            add_plt_symbols(file, code, section, data);
+        add_symbol(code, relocatable ? 0 : section->sh_addr, 0, name, relocatable ? i : 0, ~0u, 0);
+    }
+
+    qsort(code->symbols, code->count, sizeof(Code_symbol), compare_code_symbols);
+
+    // Keep the first symbol of each address
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < code->count; i++) {
+        Code_symbol *symbol = &code->symbols[i];
+
+        if (kept > 0 && code->symbols[kept - 1].section == symbol->section
+            && code->symbols[kept - 1].address == symbol->address)
+            continue;
+        code->symbols[kept++] = *symbol;
+    }
+    code->count = kept;
+
+    file->code = code;
+    return code;
+}
+
+// Index of the last symbol at or before address in section, -1 if none
+static int64_t find_code_symbol(Code_symbols *code, uint32_t section, uint64_t address) {
+    uint64_t lo = 0, hi = code->count;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        Code_symbol *symbol = &code->symbols[mid];
+
+        if (symbol->section < section || (symbol->section == section && symbol->address <= address))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 || code->symbols[lo - 1].section != section)
+        return -1;
+    return lo - 1;
+}
+
+static void out_symbol(Elf64_data *file, Code_symbol *symbol, int demangle) {
+    out_str(file->out, demangle ? demangle_symbol(file, symbol->name) : symbol->name);
+    if (symbol->plt)
+        out_str(file->out, "@plt");
+}
+
+// " <symbol+0xoffset>" of address
+static void out_location(Elf64_data *file, Code_symbols *code, uint32_t section, uint64_t address,
+                         int demangle) {
+    int64_t i = find_code_symbol(code, section, address);
+
+    if (i < 0)
+        return;
+    out_str(file->out, " <");
+    out_symbol(file, &code->symbols[i], demangle);
+    if (address != code->symbols[i].address) {
+        out_str(file->out, "+0x");
+        out_hex(file->out, address - code->symbols[i].address, 0, 0);
+    }
+    out_char(file->out, '>');
+}
+
+static int symbol_named(Elf64_data *file, Code_symbol *symbol, const char *name) {
+    return !symbol->plt && (strcmp(symbol->name, name) == 0
+        || (file->demangled != NULL && strcmp(demangle_symbol(file, symbol->name), name) == 0));
+}
+
+int disasm_has_symbol(Elf64_data *file, const char *symbol) {
+    Code_symbols *code = code_symbols(file);
+
+    for (uint64_t i = 0; i < code->count; i++)
+        if (symbol_named(file, &code->symbols[i], symbol))
+            return 1;
+    return 0;
+}
+
+void disasm_release(Elf64_data *file) {
+    if (file->code == NULL)
+        return;
+    free(file->code->symbols);
+    free(file->code);
+    file->code = NULL;
+}
+
+// Zeros are skipped like objdump does: runs of 8 or more, by multiples of
+// 4 unless they reach the end of the symbol, and runs of less than 3 ending it
+static uint64_t zero_run(const uint8_t *data, uint64_t at, uint64_t stop) {
+    uint64_t n = 0;
+
+    while (at + n < stop && data[at + n] == 0)
+        n++;
+    if (n >= 8 || (at + n == stop && n < 3 && n > 0))
+        return at + n == stop ? n : n & ~3ULL;
+    return 0;
+}
+
+static void out_address(Output *out, uint64_t address, int width) {
+    out_hex(out, address, width, 0);
+    out_str(out, ":\t");
+}
+
+static void out_bytes(Output *out, const uint8_t *bytes, int n) {
+    for (int i = 0; i < n; i++) {
+        out_hex(out, bytes[i], 2, OUT_ZERO);
+        out_char(out, ' ');
+    }
+}
+
+// End, section relative, of the code of symbol i, where the next one starts
+static uint64_t symbol_stop(Code_symbols *code, int64_t i, uint32_t key, uint64_t base, uint64_t size) {
+    if ((uint64_t)(i + 1) < code->count && code->symbols[i + 1].section == key
+        && code->symbols[i + 1].address < base + size)
+        return code->symbols[i + 1].address - base;
+    return size;
+}
+
+// Disassemble the instructions of [start, stop), section relative, with
+// the symbols of the section from symbol
+static void disasm_range(Elf64_data *file, Code_symbols *code, Elf64_Shdr *section, uint32_t key,
+                         const uint8_t *data, uint64_t start, uint64_t stop, int width, int demangle) {
+    Output *out = file->out;
+    uint64_t base = file->elf_head->e_type == ET_REL ? 0 : section->sh_addr;
+    X86_insn insn;
+    char text[256];
+
+    for (uint64_t at = start; at < stop; at += insn.length) {
+        uint64_t zeros = zero_run(data, at, stop);
+        if (zeros) {
+            out_str(out, "\t...\n");
+            at += zeros;
+            insn.length = 0;
+            continue;
+        }
+
+        x86_decode(data + at, stop - at, base + at, &insn);
+        x86_format(&insn, text);
+
+        int shown = insn.length < 7 ? insn.length : 7;
+        out_address(out, base + at, width);
+        out_bytes(out, data + at, shown);
+        for (int i = shown; i < 7; i++)
+            out_str(out, "   ");
+        out_char(out, '\t');
+        out_str(out, text);
+
+        if (insn.flags & X86_RIPREL) {
+            out_str(out, "        # ");
+            out_hex(out, insn.target, 0, 0);
+            out_location(file, code, key, insn.target, demangle);
+        } else if (insn.operand_count > 0 && insn.operand[0].kind == X86_TARGET) {
+            out_location(file, code, key, insn.target, demangle);
+        }
+        out_char(out, '\n');
+
+        // The bytes beyond the first 7 continue on lines of 7
+        for (int i = 7; i < insn.length; i += 7) {
+            out_address(out, base + at + i, width);
+            out_bytes(out, data + at + i, insn.length - i < 7 ? insn.length - i : 7);
+            out_char(out, '\n');
+        }
+    }
+}
+
+void disasm_section(Elf64_data *file, Elf64_Shdr *section, const char *symbol, int demangle) {
+    Output *out = file->out;
+    int relocatable = file->elf_head->e_type == ET_REL;
+    uint32_t key = relocatable ? section - (Elf64_Shdr*)file->elf_shead : 0;
+    uint64_t base = relocatable ? 0 : section->sh_addr;
+    Code_symbols *code;
+    const uint8_t *data;
+
+    if (file->elf_head->e_machine != EM_X86_64) {
+        fprintf(stderr, "Only x86-64 code can be disassembled\n");
+        return;
+    }
+    code = code_symbols(file);
+
+    // Addresses are as wide as the end of the section needs, by 4 digits
+    int zeros = 0;
+    for (uint64_t end = base + section->sh_size; zeros < 16 && !(end >> (60 - 4 * zeros) & 0xf); zeros++)
+        ;
+    int width = 16 - ((zeros - 1) & ~3);
+
+    if (symbol == NULL) {
+        out_str(out, "\n= Disassembly of '");
+        out_str(out, elf_section_name(file, section));
+        out_str(out, "' =\n");
+    }
+    if ((data = (const uint8_t*)elf_section_data(file, section)) == NULL) {
+        fprintf(stderr, "Section %s has no data in the file\n", elf_section_name(file, section));
+        return;
+    }
+
+    // Each symbol up to the next one
+    int64_t i = find_code_symbol(code, key, base);
+    for (uint64_t at = 0; at < section->sh_size;) {
+        uint64_t stop = section->sh_size;
+        Code_symbol *current = NULL;
+
+        if (i >= 0 && (uint64_t)i < code->count && code->symbols[i].section == key
+            && code->symbols[i].address <= base + at)
+            current = &code->symbols[i];
+        stop = symbol_stop(code, i, key, base, stop);
+
+        if (symbol == NULL || (current != NULL && symbol_named(file, current, symbol))) {
+            if (current != NULL) {
+                out_char(out, '\n');
+                out_hex(out, base + at, 16, OUT_ZERO);
+                out_str(out, " <");
+                out_symbol(file, current, demangle);
+                out_str(out, ">:\n");
+            }
+            disasm_range(file, code, section, key, data, at, stop, width, demangle);
+        }
+        at = stop;
+        i++;
+    }
+}
+
+// List the indirect calls and jumps of the executable sections. The code is
+// walked with x86_scan, split at symbols and zeros as disasm_section does,
+// and only the branches found are decoded in full.
+void disasm_indirect(Elf64_data *file, const char *elf_path, int demangle) {
+    Output *out = file->out;
+    int relocatable = file->elf_head->e_type == ET_REL;
+    uint64_t calls = 0, jumps = 0;
+    Code_symbols *code;
+    Elf64_Shdr *section;
+
+    out_printf(out, "== Indirect branches of %s ==\n\n", elf_path);
+    if (file->elf_head->e_machine != EM_X86_64) {
+        out_str(out, "Only x86-64 code can be decoded\n\n");
+        return;
+    }
+    code = code_symbols(file);
+
+    section = (Elf64_Shdr*)file->elf_shead;
+    for (int n = 0; n < file->elf_head->e_shnum; n++, section++) {
+        uint32_t key = relocatable ? n : 0;
+        uint64_t base = relocatable ? 0 : section->sh_addr;
+        const uint8_t *data;
+
+        if (!(section->sh_flags & SHF_EXECINSTR) || section->sh_type != SHT_PROGBITS
+            || (data = (const uint8_t*)elf_section_data(file, section)) == NULL)
+            continue;
+
+        int64_t i = find_code_symbol(code, key, base);
+        for (uint64_t start = 0, stop; start < section->sh_size; start = stop, i++) {
+            X86_brief brief;
+
+            stop = symbol_stop(code, i, key, base, section->sh_size);
+            for (uint64_t at = start; at < stop; at += brief.length) {
+                uint64_t zeros = zero_run(data, at, stop);
+                if (zeros) {
+                    at += zeros;
+                    brief.length = 0;
+                    continue;
+                }
+
+                x86_scan(data + at, stop - at, base + at, &brief);
+                if (!(brief.flags & X86_INDIRECT))
+                    continue;
+
+                X86_insn insn;
+                char text[256];
+
+                x86_decode(data + at, stop - at, base + at, &insn);
+                x86_format(&insn, text);
+                out_hex(out, base + at, 0, 0);
+                out_location(file, code, key, base + at, demangle);
+                out_char(out, '\t');
+                out_str(out, text);
+                if (insn.flags & X86_RIPREL) {
+                    out_str(out, "        # ");
+                    out_hex(out, insn.target, 0, 0);
+                    out_location(file, code, key, insn.target, demangle);
+                }
+                out_char(out, '\n');
+                if (brief.flags & X86_CALL)
+                    calls++;
+                else
+                    jumps++;
+            }
+        }
+    }
+    out_printf(out, "%s%lu indirect calls, %lu indirect jumps\n\n", calls + jumps ? "\n" : "", calls, jumps);
+}
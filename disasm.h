@@ -0,0 +1,118 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// -d: x86-64 disassembly of the executable sections, in the AT&T syntax of
+// objdump -d.
+//
+// Instructions are decoded by walking static tables: the opcode picks an
+// entry of the one byte, 0F, 0F38 or 0F3A map, which may select a sub-table
+// by the reg field of ModRM, the mandatory prefix, register or memory forms,
+// the rm field, the W bit or VEX.L before reaching the instruction and its
+// operand specifiers. Decoding fills a caller's X86_insn and allocates
+// nothing, formatting writes to a caller's buffer.
+
+#define X86_MAX_LENGTH 15
+#define X86_MAX_OPERANDS 5
+
+// Kinds of operands
+#define X86_REG    1
+#define X86_MEM    2
+#define X86_IMM    3
+#define X86_TARGET 4 // Relative branch, value is the target address
+
+// Register classes
+#define X86_GPR8     1 // al cl dl bl ah ch dh bh
+#define X86_GPR8_REX 2 // al ... spl bpl sil dil r8b ... r15b
+#define X86_GPR16    3
+#define X86_GPR32    4
+#define X86_GPR64    5
+#define X86_SEG      6
+#define X86_CR       7
+#define X86_DR       8
+#define X86_MMX      9
+#define X86_XMM      10
+#define X86_YMM      11
+#define X86_ZMM      12
+#define X86_MASK     13
+#define X86_ST       14 // %st(n), %st for number 0 when alone
+#define X86_RIP      15 // Memory bases only
+#define X86_EIP      16
+
+#define X86_NONE 0xff // No base or index
+
+// Operand flags
+#define X86_SIZED    0x1  // Register whose size gives the operand size
+#define X86_DISP     0x2  // Memory operand with a displacement
+#define X86_ABSOLUTE 0x4  // Memory operand without base nor index
+#define X86_RIZ      0x8  // SIB without index, printed as %riz
+#define X86_STRING   0x10 // String operand, segment always printed
+#define X86_ST_ALONE 0x20 // %st rather than %st(0)
+#define X86_PORT     0x40 // (%dx) of in and out
+#define X86_STAR     0x80 // Target of an indirect branch, printed with *
+
+typedef struct {
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t regclass; // For X86_REG, and of the base for X86_MEM
+    uint8_t reg;      // X86_REG number, or X86_MEM base
+    uint8_t index;
+    uint8_t index_class;
+    uint8_t scale;    // 1, 2, 4 or 8
+    uint8_t segment;  // Segment override printed, X86_NONE if none
+    uint8_t size;     // Bytes of an immediate
+    int64_t value;    // Immediate, displacement or target
+} X86_operand;
+
+// Instruction flags
+#define X86_BAD      0x1
+#define X86_CALL     0x2
+#define X86_JUMP     0x4  // Conditional or not
+#define X86_COND     0x8
+#define X86_RET      0x10
+#define X86_INDIRECT 0x20 // Call or jump through a register or memory
+#define X86_RIPREL   0x40 // Memory operand relative to RIP, target is its address
+#define X86_INTEL_ORDER 0x80 // Operands printed in Intel order, as enter has them
+
+typedef struct {
+    uint64_t address;
+    uint64_t target;      // Of direct branches and RIP relative operands
+    const char *name;     // Not terminated, name_length long
+    uint32_t flags;
+    uint8_t name_length;
+    uint8_t length;
+    char vprefix;         // v of VEX forms, 0 if none
+    char suffix;          // Size suffix of the mnemonic, 0 if none
+    uint8_t operand_count;
+    uint8_t prefix_count;
+    uint8_t prefixes[X86_MAX_LENGTH]; // Unused prefixes printed before the mnemonic
+    const char *predicate; // Comparison folded into the mnemonic after its first letters
+    uint8_t predicate_at;
+    uint8_t vex;          // 0, 2 or 3 for VEX, 4 for EVEX
+    uint8_t mask;         // EVEX opmask register
+    uint8_t zeroing;
+    uint8_t broadcast;    // Elements of an EVEX broadcast, 0 if none
+    uint8_t w;            // REX.W, VEX.W or EVEX.W
+    X86_operand operand[X86_MAX_OPERANDS]; // In Intel order
+} X86_insn;
+
+// What scans of whole sections need of an instruction, see x86_scan
+typedef struct {
+    uint64_t target;      // As in X86_insn
+    uint32_t flags;
+    uint8_t length;
+} X86_brief;
+
+int x86_decode(const uint8_t *code, uint64_t size, uint64_t address, X86_insn *insn);
+int x86_scan(const uint8_t *code, uint64_t size, uint64_t address, X86_brief *brief);
+int x86_format(const X86_insn *insn, char *text);
+
+void disasm_section(Elf64_data *file, Elf64_Shdr *section, const char *symbol, int demangle);
+void disasm_indirect(Elf64_data *file, const char *elf_path, int demangle);
+int disasm_has_symbol(Elf64_data *file, const char *symbol);
+void disasm_release(Elf64_data *file);
+
+#endif
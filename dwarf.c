@@ -0,0 +1,961 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dwarf.h"
+#include "elf.h"
+#include "output.h"
+#include "reader.h"
+#include "symindex.h"
+#include "zsection.h"
+
+// Forms of attribute values
+#define DW_FORM_addr           0x01
+#define DW_FORM_block2         0x03
+#define DW_FORM_block4         0x04
+#define DW_FORM_data2          0x05
+#define DW_FORM_data4          0x06
+#define DW_FORM_data8          0x07
+#define DW_FORM_string         0x08
+#define DW_FORM_block          0x09
+#define DW_FORM_block1         0x0a
+#define DW_FORM_data1          0x0b
+#define DW_FORM_flag           0x0c
+#define DW_FORM_sdata          0x0d
+#define DW_FORM_strp           0x0e
+#define DW_FORM_udata          0x0f
+#define DW_FORM_ref_addr       0x10
+#define DW_FORM_ref1           0x11
+#define DW_FORM_ref2           0x12
+#define DW_FORM_ref4           0x13
+#define DW_FORM_ref8           0x14
+#define DW_FORM_ref_udata      0x15
+#define DW_FORM_indirect       0x16
+#define DW_FORM_sec_offset     0x17
+#define DW_FORM_exprloc        0x18
+#define DW_FORM_flag_present   0x19
+#define DW_FORM_strx           0x1a
+#define DW_FORM_addrx          0x1b
+#define DW_FORM_ref_sup4       0x1c
+#define DW_FORM_strp_sup       0x1d
+#define DW_FORM_data16         0x1e
+#define DW_FORM_line_strp      0x1f
+#define DW_FORM_ref_sig8       0x20
+#define DW_FORM_implicit_const 0x21
+#define DW_FORM_loclistx       0x22
+#define DW_FORM_rnglistx       0x23
+#define DW_FORM_ref_sup8       0x24
+#define DW_FORM_strx1          0x25
+#define DW_FORM_strx2          0x26
+#define DW_FORM_strx3          0x27
+#define DW_FORM_strx4          0x28
+#define DW_FORM_addrx1         0x29
+#define DW_FORM_addrx2         0x2a
+#define DW_FORM_addrx3         0x2b
+#define DW_FORM_addrx4         0x2c
+#define DW_FORM_GNU_addr_index 0x1f01
+#define DW_FORM_GNU_str_index  0x1f02
+#define DW_FORM_GNU_ref_alt    0x1f20
+#define DW_FORM_GNU_strp_alt   0x1f21
+
+// Attributes of the unit entry
+#define DW_AT_stmt_list 0x10
+#define DW_AT_comp_dir  0x1b
+
+// Unit types of DWARF 5
+#define DW_UT_skeleton      0x04
+#define DW_UT_split_compile 0x05
+#define DW_UT_type          0x02
+#define DW_UT_split_type    0x06
+
+// Standard opcodes of line programs
+#define DW_LNS_copy               1
+#define DW_LNS_advance_pc         2
+#define DW_LNS_advance_line       3
+#define DW_LNS_set_file           4
+#define DW_LNS_const_add_pc       8
+#define DW_LNS_fixed_advance_pc   9
+
+// Extended opcodes
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address  2
+#define DW_LNE_define_file  3
+
+// Content types of the directory and file entries of DWARF 5
+#define DW_LNCT_path            1
+#define DW_LNCT_directory_index 2
+
+int dwarf_has(Dwarf_cursor *c, uint64_t n) {
+    if (c->error || (uint64_t)(c->end - c->p) < n) {
+        c->error = 1;
+        c->p = c->end;
+        return 0;
+    }
+    return 1;
+}
+
+uint64_t dwarf_u8(Dwarf_cursor *c) {
+    return dwarf_has(c, 1) ? *c->p++ : 0;
+}
+
+uint64_t dwarf_u16(Dwarf_cursor *c) {
+    uint16_t v;
+
+    if (!dwarf_has(c, 2))
+        return 0;
+    memcpy(&v, c->p, 2);
+    c->p += 2;
+    return c->file->reader->half(v);
+}
+
+uint64_t dwarf_u32(Dwarf_cursor *c) {
+    uint32_t v;
+
+    if (!dwarf_has(c, 4))
+        return 0;
+    memcpy(&v, c->p, 4);
+    c->p += 4;
+    return c->file->reader->word(v);
+}
+
+uint64_t dwarf_u64(Dwarf_cursor *c) {
+    uint64_t v;
+
+    if (!dwarf_has(c, 8))
+        return 0;
+    memcpy(&v, c->p, 8);
+    c->p += 8;
+    return c->file->reader->xword(v);
+}
+
+// Value of size bytes, an offset or an address
+uint64_t dwarf_sized(Dwarf_cursor *c, int size) {
+    switch (size) {
+        case 1:  return dwarf_u8(c);
+        case 2:  return dwarf_u16(c);
+        case 4:  return dwarf_u32(c);
+        case 8:  return dwarf_u64(c);
+        default:
+            c->error = 1;
+            return 0;
+    }
+}
+
+uint64_t dwarf_uleb(Dwarf_cursor *c) {
+    uint64_t value = 0;
+    int shift = 0;
+
+    while (dwarf_has(c, 1)) {
+        uint8_t b = *c->p++;
+
+        if (shift < 64)
+            value |= (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+        if (!(b & 0x80))
+            break;
+    }
+    return value;
+}
+
+int64_t dwarf_sleb(Dwarf_cursor *c) {
+    uint64_t value = 0;
+    int shift = 0;
+    uint8_t b = 0;
+
+    while (dwarf_has(c, 1)) {
+        b = *c->p++;
+        if (shift < 64)
+            value |= (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+        if (!(b & 0x80))
+            break;
+    }
+    if (shift < 64 && (b & 0x40))
+        value |= ~0ULL << shift;
+    return value;
+}
+
+// Terminated string in the bytes, NULL if it is not
+const char *dwarf_string(Dwarf_cursor *c) {
+    const uint8_t *s = c->p;
+    const uint8_t *nul = c->error ? NULL : memchr(s, 0, c->end - s);
+
+    if (nul == NULL) {
+        c->error = 1;
+        c->p = c->end;
+        return NULL;
+    }
+    c->p = nul + 1;
+    return (const char*)s;
+}
+
+void dwarf_skip(Dwarf_cursor *c, uint64_t n) {
+    if (dwarf_has(c, n))
+        c->p += n;
+}
+
+// Length of a unit, 32 bits or 64 with an escape. Sets offset_size and the
+// end of the unit. Returns -1 if it overflows the section.
+int dwarf_unit_length(Dwarf_cursor *c, int *offset_size, const uint8_t **unit_end) {
+    uint64_t length = dwarf_u32(c);
+
+    *offset_size = 4;
+    if (length == 0xffffffff) {
+        length = dwarf_u64(c);
+        *offset_size = 8;
+    }
+    if (c->error || length > (uint64_t)(c->end - c->p))
+        return -1;
+    *unit_end = c->p + length;
+    return 0;
+}
+
+// String of .debug_str or .debug_line_str at offset, NULL if out of it
+static const char *section_string(const uint8_t *strings, uint64_t size, uint64_t offset) {
+    if (strings == NULL || offset >= size || memchr(strings + offset, 0, size - offset) == NULL)
+        return NULL;
+    return (const char*)strings + offset;
+}
+
+// Skip or read the value of form, returning strings of the forms that have
+// them in string and other values in value
+static void read_form(Line_table *table, Dwarf_cursor *c, uint64_t form, int offset_size, int address_size,
+                      int version, uint64_t *value, const char **string) {
+    *value = 0;
+    if (string != NULL)
+        *string = NULL;
+
+    switch (form) {
+        case DW_FORM_flag_present:
+        case DW_FORM_implicit_const:
+            break;
+        case DW_FORM_addr:
+            *value = dwarf_sized(c, address_size);
+            break;
+        case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag: case DW_FORM_strx1: case DW_FORM_addrx1:
+            *value = dwarf_u8(c);
+            break;
+        case DW_FORM_data2: case DW_FORM_ref2: case DW_FORM_strx2: case DW_FORM_addrx2:
+            *value = dwarf_u16(c);
+            break;
+        case DW_FORM_strx3: case DW_FORM_addrx3:
+            dwarf_skip(c, 3);
+            break;
+        case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4: case DW_FORM_strx4: case DW_FORM_addrx4:
+            *value = dwarf_u32(c);
+            break;
+        case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8: case DW_FORM_ref_sup8:
+            *value = dwarf_u64(c);
+            break;
+        case DW_FORM_data16:
+            dwarf_skip(c, 16);
+            break;
+        case DW_FORM_sdata:
+            *value = dwarf_sleb(c);
+            break;
+        case DW_FORM_udata: case DW_FORM_ref_udata: case DW_FORM_strx: case DW_FORM_addrx:
+        case DW_FORM_loclistx: case DW_FORM_rnglistx: case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+            *value = dwarf_uleb(c);
+            break;
+        case DW_FORM_string:
+            if (string != NULL)
+                *string = dwarf_string(c);
+            else
+                dwarf_string(c);
+            break;
+        case DW_FORM_strp:
+            *value = dwarf_sized(c, offset_size);
+            if (string != NULL)
+                *string = section_string(table->str, table->str_size, *value);
+            break;
+        case DW_FORM_line_strp:
+            *value = dwarf_sized(c, offset_size);
+            if (string != NULL)
+                *string = section_string(table->line_str, table->line_str_size, *value);
+            break;
+        case DW_FORM_ref_addr:
+            *value = dwarf_sized(c, version == 2 ? address_size : offset_size);
+            break;
+        case DW_FORM_sec_offset: case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+            *value = dwarf_sized(c, offset_size);
+            break;
+        case DW_FORM_block1:
+            dwarf_skip(c, dwarf_u8(c));
+            break;
+        case DW_FORM_block2:
+            dwarf_skip(c, dwarf_u16(c));
+            break;
+        case DW_FORM_block4:
+            dwarf_skip(c, dwarf_u32(c));
+            break;
+        case DW_FORM_block: case DW_FORM_exprloc:
+            dwarf_skip(c, dwarf_uleb(c));
+            break;
+        case DW_FORM_indirect:
+            read_form(table, c, dwarf_uleb(c), offset_size, address_size, version, value, string);
+            break;
+        default:
+            c->error = 1;
+    }
+}
+
+// Contents of the section named name, or of its .zdebug variant
+static const uint8_t *debug_section(Elf64_data *file, const char *name, uint64_t *size) {
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+
+    *size = 0;
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        const char *s = elf_section_name(file, section);
+
+        if (section->sh_type == SHT_NOBITS)
+            continue;
+        if (strcmp(s, name) == 0 || (strncmp(s, ".zdebug", 7) == 0 && strcmp(s + 7, name + 6) == 0))
+            return (const uint8_t*)zsection_contents(file, section, size);
+    }
+
+    return NULL;
+}
+
+static void *grow(void *data, uint64_t *capacity, uint64_t needed, size_t unit) {
+    uint64_t size = *capacity ? *capacity : 64;
+
+    while (size < needed)
+        size *= 2;
+    if (size == *capacity)
+        return data;
+    if ((data = realloc(data, size * unit)) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    *capacity = size;
+    return data;
+}
+
+static uint64_t add_unit(Line_table *table, uint64_t info, uint64_t program) {
+    table->units = grow(table->units, &table->unit_capacity, table->unit_count + 1, sizeof(Line_unit));
+    memset(&table->units[table->unit_count], 0, sizeof(Line_unit));
+    table->units[table->unit_count].info = info;
+    table->units[table->unit_count].program = program;
+    return table->unit_count++;
+}
+
+static void add_range(Line_table *table, uint64_t start, uint64_t end, uint64_t unit) {
+    if (end <= start)
+        return;
+    table->ranges = grow(table->ranges, &table->range_capacity, table->range_count + 1, sizeof(Line_range));
+    table->ranges[table->range_count++] = (Line_range){ start, end, unit };
+}
+
+static int compare_ranges(const void *a, const void *b) {
+    const Line_range *x = a, *y = b;
+
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    return x->end < y->end ? -1 : x->end > y->end;
+}
+
+// Address ranges of the units from .debug_aranges, one unit per set
+static void read_aranges(Line_table *table, const uint8_t *data, uint64_t size) {
+    Dwarf_cursor c = { table->file, data, data + size, 0 };
+
+    while (c.p < c.end && !c.error) {
+        const uint8_t *set = c.p, *set_end;
+        int offset_size;
+
+        if (dwarf_unit_length(&c, &offset_size, &set_end) < 0)
+            break;
+
+        uint64_t version = dwarf_u16(&c);
+        uint64_t info = dwarf_sized(&c, offset_size);
+        int address_size = dwarf_u8(&c);
+        int segment_size = dwarf_u8(&c);
+
+        if (c.error || version != 2 || (address_size != 4 && address_size != 8) || segment_size != 0) {
+            c.p = set_end;
+            continue;
+        }
+
+        // Tuples are aligned on their size from the start of the set
+        uint64_t tuple = 2 * address_size;
+        uint64_t at = c.p - set;
+        dwarf_skip(&c, (tuple - at % tuple) % tuple);
+
+        uint64_t unit = add_unit(table, info, LINE_NONE);
+        Dwarf_cursor tuples = { table->file, c.p, set_end, 0 };
+
+        while (!tuples.error && tuples.p < tuples.end) {
+            uint64_t start = dwarf_sized(&tuples, address_size);
+            uint64_t length = dwarf_sized(&tuples, address_size);
+
+            if (start == 0 && length == 0)
+                break;
+            if (!tuples.error && start != 0)
+                add_range(table, start, start + length, unit);
+        }
+        c.p = set_end;
+    }
+}
+
+// Sections of the line tables and the ranges of .debug_aranges. Returns -1
+// if the file has no .debug_line.
+int lines_open(Line_table *table, Elf64_data *file) {
+    const uint8_t *aranges;
+    uint64_t aranges_size;
+
+    memset(table, 0, sizeof(Line_table));
+    table->file = file;
+    if ((table->line = debug_section(file, ".debug_line", &table->line_size)) == NULL)
+        return -1;
+    table->info = debug_section(file, ".debug_info", &table->info_size);
+    table->abbrev = debug_section(file, ".debug_abbrev", &table->abbrev_size);
+    table->str = debug_section(file, ".debug_str", &table->str_size);
+    table->line_str = debug_section(file, ".debug_line_str", &table->line_str_size);
+
+    if ((aranges = debug_section(file, ".debug_aranges", &aranges_size)) != NULL)
+        read_aranges(table, aranges, aranges_size);
+    if (table->range_count > 0)
+        qsort(table->ranges, table->range_count, sizeof(Line_range), compare_ranges);
+    return 0;
+}
+
+void lines_close(Line_table *table) {
+    for (uint64_t i = 0; i < table->unit_count; i++) {
+        free(table->units[i].rows);
+        free(table->units[i].files);
+    }
+    free(table->units);
+    free(table->ranges);
+}
+
+// Find the entry of code in the abbreviations at offset
+static int find_abbrev(Line_table *table, uint64_t offset, uint64_t code, Dwarf_cursor *abbrev) {
+    Dwarf_cursor c = { table->file, table->abbrev, table->abbrev + table->abbrev_size, 0 };
+
+    if (table->abbrev == NULL || offset >= table->abbrev_size)
+        return -1;
+    c.p += offset;
+
+    while (!c.error) {
+        uint64_t entry = dwarf_uleb(&c);
+
+        if (entry == 0 || c.error)
+            return -1;
+        dwarf_uleb(&c); // Tag
+        dwarf_u8(&c);   // Children
+        if (entry == code) {
+            *abbrev = c;
+            return 0;
+        }
+        // Attribute specifications, up to a null one
+        for (;;) {
+            uint64_t name = dwarf_uleb(&c), form = dwarf_uleb(&c);
+
+            if (form == DW_FORM_implicit_const)
+                dwarf_sleb(&c);
+            if ((name == 0 && form == 0) || c.error)
+                break;
+        }
+    }
+
+    return -1;
+}
+
+// Line program and compilation directory of a unit, from its first entry
+static void read_unit_entry(Line_table *table, Line_unit *unit) {
+    Dwarf_cursor c = { table->file, table->info, table->info + table->info_size, 0 };
+    const uint8_t *unit_end;
+    int offset_size, address_size;
+    uint64_t abbrev_offset;
+
+    if (table->info == NULL || unit->info >= table->info_size)
+        return;
+    c.p += unit->info;
+    if (dwarf_unit_length(&c, &offset_size, &unit_end) < 0)
+        return;
+    c.end = unit_end;
+
+    int version = dwarf_u16(&c);
+    if (version >= 5) {
+        int type = dwarf_u8(&c);
+
+        address_size = dwarf_u8(&c);
+        abbrev_offset = dwarf_sized(&c, offset_size);
+        if (type == DW_UT_skeleton || type == DW_UT_split_compile)
+            dwarf_skip(&c, 8);
+        else if (type == DW_UT_type || type == DW_UT_split_type)
+            dwarf_skip(&c, 8 + offset_size);
+    } else {
+        abbrev_offset = dwarf_sized(&c, offset_size);
+        address_size = dwarf_u8(&c);
+    }
+
+    Dwarf_cursor abbrev;
+    uint64_t code = dwarf_uleb(&c);
+
+    if (c.error || version < 2 || version > 5 || find_abbrev(table, abbrev_offset, code, &abbrev) < 0)
+        return;
+
+    for (;;) {
+        uint64_t name = dwarf_uleb(&abbrev), form = dwarf_uleb(&abbrev);
+        uint64_t value;
+        const char *string;
+
+        if (form == DW_FORM_implicit_const)
+            dwarf_sleb(&abbrev);
+        if ((name == 0 && form == 0) || abbrev.error)
+            break;
+
+        read_form(table, &c, form, offset_size, address_size, version, &value, &string);
+        if (c.error)
+            break;
+        if (name == DW_AT_stmt_list)
+            unit->program = value;
+        else if (name == DW_AT_comp_dir)
+            unit->comp_dir = string;
+    }
+}
+
+// Directories or files of a DWARF 5 line program header, as described by its
+// entry formats. Directories are given in dirs and returned in files when
+// dirs is NULL.
+static Line_file *read_entries(Line_table *table, Dwarf_cursor *c, int offset_size, int address_size,
+                               Line_file *dirs, uint64_t dir_count, uint64_t *count) {
+    uint64_t formats[2 * 16];
+    int format_count = dwarf_u8(c);
+    Line_file *entries;
+
+    if (format_count > 16) {
+        c->error = 1;
+        return NULL;
+    }
+    for (int i = 0; i < format_count; i++) {
+        formats[2 * i] = dwarf_uleb(c);
+        formats[2 * i + 1] = dwarf_uleb(c);
+    }
+
+    *count = dwarf_uleb(c);
+    if (c->error || *count > (uint64_t)(c->end - c->p)) {
+        c->error = 1;
+        return NULL;
+    }
+    if ((entries = calloc(*count ? *count : 1, sizeof(Line_file))) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+
+    for (uint64_t i = 0; i < *count && !c->error; i++) {
+        for (int j = 0; j < format_count; j++) {
+            uint64_t value;
+            const char *string;
+
+            read_form(table, c, formats[2 * j + 1], offset_size, address_size, 5, &value, &string);
+            if (formats[2 * j] == DW_LNCT_path)
+                entries[i].name = string;
+            else if (formats[2 * j] == DW_LNCT_directory_index && dirs != NULL && value < dir_count)
+                entries[i].dir = dirs[value].name;
+        }
+        if (entries[i].name == NULL)
+            entries[i].name = "??";
+    }
+
+    return entries;
+}
+
+// File entries of a line program header before DWARF 5, up to an empty name
+static Line_file *read_files(Dwarf_cursor *c, const char **dirs, uint64_t dir_count, const char *comp_dir,
+                             uint64_t *count) {
+    Line_file *files = NULL;
+    uint64_t capacity = 0;
+
+    *count = 0;
+    for (;;) {
+        const char *name = dwarf_string(c);
+
+        if (name == NULL || *name == 0)
+            break;
+
+        uint64_t dir = dwarf_uleb(c);
+        dwarf_uleb(c); // Modification time
+        dwarf_uleb(c); // Size
+        files = grow(files, &capacity, *count + 1, sizeof(Line_file));
+        files[*count].name = name;
+        files[*count].dir = dir == 0 ? comp_dir : dir <= dir_count ? dirs[dir - 1] : NULL;
+        (*count)++;
+    }
+
+    return files;
+}
+
+static int compare_rows(const void *a, const void *b) {
+    const Line_row *x = a, *y = b;
+
+    if (x->address != y->address)
+        return x->address < y->address ? -1 : 1;
+    // The end of a sequence first, a sequence starting there wins
+    if ((x->file == LINE_END) != (y->file == LINE_END))
+        return x->file == LINE_END ? -1 : 1;
+    return 0;
+}
+
+typedef struct {
+    Line_row *rows;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t sequence;   // First row of the current sequence
+} Row_buffer;
+
+static void add_row(Row_buffer *buffer, uint64_t address, uint32_t file, uint32_t line) {
+    buffer->rows = grow(buffer->rows, &buffer->capacity, buffer->count + 1, sizeof(Line_row));
+    buffer->rows[buffer->count++] = (Line_row){ address, file, line };
+}
+
+// Run the line program of a unit into its rows. Sequences of code the linker
+// discarded, left at address 0, are dropped. When ranges is set, the range of
+// each sequence is added for the unit.
+static void decode_unit(Line_table *table, uint64_t index, int ranges) {
+    Line_unit *unit = &table->units[index];
+    Dwarf_cursor c = { table->file, table->line, table->line + table->line_size, 0 };
+    const uint8_t *unit_end;
+    int offset_size, address_size = table->file->elf_head->e_ident[EI_CLASS] == ELFCLASS32 ? 4 : 8;
+    int discard_zero = table->file->elf_head->e_type != ET_REL;
+
+    unit->state = -1;
+    if (unit->info != LINE_NONE && unit->program == LINE_NONE)
+        read_unit_entry(table, unit);
+    if (unit->program == LINE_NONE || unit->program >= table->line_size)
+        return;
+    c.p += unit->program;
+    if (dwarf_unit_length(&c, &offset_size, &unit_end) < 0)
+        return;
+    c.end = unit_end;
+
+    unit->version = dwarf_u16(&c);
+    if (unit->version < 2 || unit->version > 5)
+        return;
+    if (unit->version >= 5) {
+        address_size = dwarf_u8(&c);
+        dwarf_u8(&c); // Segment selector size
+    }
+
+    uint64_t header_length = dwarf_sized(&c, offset_size);
+    if (c.error || header_length > (uint64_t)(c.end - c.p))
+        return;
+    const uint8_t *program = c.p + header_length;
+    uint64_t min_length = dwarf_u8(&c);
+    if (unit->version >= 4)
+        dwarf_u8(&c); // Operations per instruction, VLIW only
+    dwarf_u8(&c); // Default of is_stmt, every row is kept
+    int line_base = (int8_t)dwarf_u8(&c);
+    int line_range = dwarf_u8(&c);
+    int opcode_base = dwarf_u8(&c);
+    uint8_t lengths[256] = { 0 };
+
+    for (int i = 1; i < opcode_base; i++)
+        lengths[i] = dwarf_u8(&c);
+    if (c.error || line_range == 0)
+        return;
+
+    if (unit->version >= 5) {
+        uint64_t dir_count, file_count;
+        Line_file *dirs = read_entries(table, &c, offset_size, address_size, NULL, 0, &dir_count);
+
+        if (dirs != NULL) {
+            unit->files = read_entries(table, &c, offset_size, address_size, dirs, dir_count, &file_count);
+            unit->file_count = file_count;
+            // The names of the files point to the directories, not their entries
+            free(dirs);
+        }
+    } else {
+        const char **dirs = NULL;
+        uint64_t dir_count = 0, capacity = 0, file_count;
+        const char *dir;
+
+        while ((dir = dwarf_string(&c)) != NULL && *dir != 0) {
+            dirs = grow(dirs, &capacity, dir_count + 1, sizeof(char*));
+            dirs[dir_count++] = dir;
+        }
+        unit->files = read_files(&c, dirs, dir_count, unit->comp_dir, &file_count);
+        unit->file_count = file_count;
+        free(dirs);
+    }
+    if (c.error)
+        return;
+
+    // The state machine, one sequence after another
+    Row_buffer buffer = { 0 };
+    uint64_t address = 0;
+    uint32_t file = 1, line = 1;
+
+    c.p = program;
+    while (c.p < c.end && !c.error) {
+        int opcode = dwarf_u8(&c);
+
+        if (opcode >= opcode_base) {
+            int adjusted = opcode - opcode_base;
+
+            address += (adjusted / line_range) * min_length;
+            line += line_base + adjusted % line_range;
+            add_row(&buffer, address, file, line);
+            continue;
+        }
+
+        switch (opcode) {
+            case 0: {
+                uint64_t length = dwarf_uleb(&c);
+                const uint8_t *next = c.p + length;
+
+                if (length == 0 || length > (uint64_t)(c.end - c.p)) {
+                    c.error = 1;
+                    break;
+                }
+                switch (dwarf_u8(&c)) {
+                    case DW_LNE_end_sequence: {
+                        uint64_t first = buffer.sequence;
+
+                        add_row(&buffer, address, LINE_END, 0);
+                        if (discard_zero && buffer.rows[first].address == 0) {
+                            buffer.count = first;
+                        } else if (ranges) {
+                            add_range(table, buffer.rows[first].address, address, index);
+                        }
+                        buffer.sequence = buffer.count;
+                        address = 0;
+                        file = line = 1;
+                        break;
+                    }
+                    case DW_LNE_set_address:
+                        address = dwarf_sized(&c, length - 1);
+                        break;
+                }
+                c.p = next;
+                break;
+            }
+            case DW_LNS_copy:
+                add_row(&buffer, address, file, line);
+                break;
+            case DW_LNS_advance_pc:
+                address += dwarf_uleb(&c) * min_length;
+                break;
+            case DW_LNS_advance_line:
+                line += dwarf_sleb(&c);
+                break;
+            case DW_LNS_set_file:
+                file = dwarf_uleb(&c);
+                break;
+            case DW_LNS_const_add_pc:
+                address += ((255 - opcode_base) / line_range) * min_length;
+                break;
+            case DW_LNS_fixed_advance_pc:
+                address += dwarf_u16(&c);
+                break;
+            default:
+                // Operands of the others, column, ISA and the ones unknown
+                for (int i = 0; i < lengths[opcode]; i++)
+                    dwarf_uleb(&c);
+        }
+    }
+    // A sequence without its end is dropped
+    buffer.count = buffer.sequence;
+
+    // Sorted by address, keeping the last row of each address
+    if (buffer.count > 0)
+        qsort(buffer.rows, buffer.count, sizeof(Line_row), compare_rows);
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < buffer.count; i++) {
+        if (kept > 0 && buffer.rows[kept - 1].address == buffer.rows[i].address)
+            kept--;
+        buffer.rows[kept++] = buffer.rows[i];
+    }
+
+    unit->rows = buffer.rows;
+    unit->row_count = kept;
+    unit->state = 1;
+}
+
+static int compare_programs(const void *a, const void *b) {
+    const Line_unit *const *x = a, *const *y = b;
+
+    return (*x)->program < (*y)->program ? -1 : (*x)->program > (*y)->program;
+}
+
+// Decode the line programs no range led to, adding the ranges of their
+// sequences. Done once, for addresses .debug_aranges does not cover.
+static void scan_programs(Line_table *table) {
+    uint64_t known = table->unit_count;
+    Line_unit **units = malloc((known ? known : 1) * sizeof(Line_unit*));
+    Dwarf_cursor c = { table->file, table->line, table->line + table->line_size, 0 };
+
+    if (units == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    table->scanned = 1;
+
+    for (uint64_t i = 0; i < known; i++) {
+        if (table->units[i].info != LINE_NONE && table->units[i].program == LINE_NONE)
+            read_unit_entry(table, &table->units[i]);
+        units[i] = &table->units[i];
+    }
+    qsort(units, known, sizeof(Line_unit*), compare_programs);
+
+    while (c.p < c.end && !c.error) {
+        uint64_t offset = c.p - table->line;
+        const uint8_t *unit_end;
+        int offset_size;
+        Line_unit key = { .program = offset }, *key_pointer = &key;
+
+        if (dwarf_unit_length(&c, &offset_size, &unit_end) < 0)
+            break;
+        c.p = unit_end;
+        if (bsearch(&key_pointer, units, known, sizeof(Line_unit*), compare_programs) == NULL)
+            decode_unit(table, add_unit(table, LINE_NONE, offset), 1);
+    }
+
+    free(units);
+    if (table->range_count > 0)
+        qsort(table->ranges, table->range_count, sizeof(Line_range), compare_ranges);
+}
+
+// Range holding address, NULL if none
+static Line_range *find_range(Line_table *table, uint64_t address) {
+    uint64_t low = 0, high = table->range_count;
+
+    // First range starting after address
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+
+        if (table->ranges[mid].start <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    // Ranges rarely overlap, a few before are tried for those that do
+    for (uint64_t i = low; i > 0 && low - i < 16; i--)
+        if (address < table->ranges[i - 1].end)
+            return &table->ranges[i - 1];
+    return NULL;
+}
+
+// Row of the line of address, and its unit. Returns -1 if no line table
+// covers it.
+int lines_find(Line_table *table, uint64_t address, Line_unit **unit, Line_row **row) {
+    Line_range *range = find_range(table, address);
+
+    if (range == NULL && !table->scanned) {
+        scan_programs(table);
+        range = find_range(table, address);
+    }
+    if (range == NULL)
+        return -1;
+
+    *unit = &table->units[range->unit];
+    if ((*unit)->state == 0)
+        decode_unit(table, range->unit, 0);
+    if ((*unit)->state < 0)
+        return -1;
+
+    // Last row at or before address
+    uint64_t low = 0, high = (*unit)->row_count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+
+        if ((*unit)->rows[mid].address <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0 || (*unit)->rows[low - 1].file == LINE_END)
+        return -1;
+    *row = &(*unit)->rows[low - 1];
+    return 0;
+}
+
+static void print_file(Output *out, Line_unit *unit, uint32_t index) {
+    // Files are numbered from 1 before DWARF 5, from 0 since
+    uint64_t i = unit->version >= 5 ? index : (uint64_t)index - 1;
+    Line_file *file;
+
+    if (i >= unit->file_count) {
+        out_str(out, "??");
+        return;
+    }
+    file = &unit->files[i];
+    if (file->name[0] != '/' && file->dir != NULL) {
+        // Include directories of older versions are relative to the unit's
+        if (file->dir[0] != '/' && unit->comp_dir != NULL && file->dir != unit->comp_dir) {
+            out_str(out, unit->comp_dir);
+            out_char(out, '/');
+        }
+        out_str(out, file->dir);
+        out_char(out, '/');
+    }
+    out_str(out, file->name);
+}
+
+// Print "addr symbol+offset file:line" for one address token. symbols may
+// be NULL.
+void print_line(Output *out, Sym_index *symbols, Line_table *lines, const char *token) {
+    char *end;
+    uint64_t addr = strtoull(token, &end, 16);
+    Line_unit *unit;
+    Line_row *row;
+    int64_t i;
+
+    if (*end != 0) {
+        out_str(out, token);
+        out_str(out, " ?? ??:0\n");
+        return;
+    }
+
+    out_str(out, "0x");
+    out_hex(out, addr, 0, 0);
+    out_char(out, ' ');
+
+    if (symbols != NULL && (i = symindex_find(symbols, addr)) >= 0) {
+        out_str(out, symbols->name[i]);
+        if (addr != symbols->start[i]) {
+            out_str(out, "+0x");
+            out_hex(out, addr - symbols->start[i], 0, 0);
+        }
+    } else {
+        out_str(out, "??");
+    }
+    out_char(out, ' ');
+
+    if (lines_find(lines, addr, &unit, &row) < 0) {
+        out_str(out, "??:0\n");
+        return;
+    }
+    print_file(out, unit, row->file);
+    out_char(out, ':');
+    out_udec(out, row->line, 0, 0);
+    out_char(out, '\n');
+}
+
+typedef struct {
+    Elf64_data *file;
+    Line_table lines;
+    Sym_index symbols;
+    int has_symbols;
+} Addr2line;
+
+static void print_token(char *token, void *arg) {
+    Addr2line *query = arg;
+
+    print_line(query->file->out, query->has_symbols ? &query->symbols : NULL, &query->lines, token);
+}
+
+// Print the symbol and line of each address read from fd, one per line
+void addr2line(Elf64_data *file, int fd) {
+    Addr2line query = { file };
+
+    if (lines_open(&query.lines, file) < 0)
+        fprintf(stderr, "No .debug_line section, lines are unknown\n");
+    query.has_symbols = symindex_build(&query.symbols, file) == 0;
+
+    read_addresses(fd, print_token, &query);
+
+    if (query.has_symbols)
+        symindex_free(&query.symbols);
+    lines_close(&query.lines);
+}
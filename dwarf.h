@@ -0,0 +1,93 @@
+#ifndef DWARF_H
+#define DWARF_H
+
+#include <stdint.h>
+
+#include "elf.h"
+#include "output.h"
+#include "symindex.h"
+
+// DWARF line tables of .debug_line, versions 2 to 5, for --addr2line.
+//
+// The line program of a compilation unit is run once into a table of rows
+// sorted by address, each the address, file and line of the code from there
+// to the next row. Units are decoded when an address first falls into them:
+// .debug_aranges gives the address ranges of each unit, and the first entry
+// of the unit in .debug_info its line program. Without them, or for an
+// address they do not cover, every line program is decoded once and its
+// sequences give the ranges.
+
+// Bytes of a section being read, in the byte order of the file. A read past
+// the end sets error, returns 0 and leaves the cursor at the end.
+typedef struct {
+    Elf64_data *file;
+    const uint8_t *p;
+    const uint8_t *end;
+    int error;
+} Dwarf_cursor;
+
+int dwarf_has(Dwarf_cursor *c, uint64_t n);
+uint64_t dwarf_u8(Dwarf_cursor *c);
+uint64_t dwarf_u16(Dwarf_cursor *c);
+uint64_t dwarf_u32(Dwarf_cursor *c);
+uint64_t dwarf_u64(Dwarf_cursor *c);
+uint64_t dwarf_sized(Dwarf_cursor *c, int size);
+uint64_t dwarf_uleb(Dwarf_cursor *c);
+int64_t dwarf_sleb(Dwarf_cursor *c);
+const char *dwarf_string(Dwarf_cursor *c);
+void dwarf_skip(Dwarf_cursor *c, uint64_t n);
+int dwarf_unit_length(Dwarf_cursor *c, int *offset_size, const uint8_t **unit_end);
+
+typedef struct {
+    uint64_t address;
+    uint32_t file;     // File register, LINE_END after the end of a sequence
+    uint32_t line;
+} Line_row;
+
+#define LINE_END 0xffffffff
+
+typedef struct {
+    const char *dir;   // NULL if none
+    const char *name;
+} Line_file;
+
+typedef struct {
+    uint64_t info;     // Offset of the unit in .debug_info, LINE_NONE if unknown
+    uint64_t program;  // Offset of its line program, LINE_NONE until known
+    const char *comp_dir;
+    int state;         // 0 until decoded, 1 once decoded, -1 if it cannot be
+    uint16_t version;
+    Line_row *rows;
+    uint64_t row_count;
+    Line_file *files;
+    uint32_t file_count;
+} Line_unit;
+
+#define LINE_NONE UINT64_MAX
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t unit;
+} Line_range;
+
+typedef struct {
+    Elf64_data *file;
+    const uint8_t *line, *info, *abbrev, *str, *line_str;
+    uint64_t line_size, info_size, abbrev_size, str_size, line_str_size;
+    Line_unit *units;
+    uint64_t unit_count;
+    uint64_t unit_capacity;
+    Line_range *ranges; // Sorted by start
+    uint64_t range_count;
+    uint64_t range_capacity;
+    int scanned;        // Every line program was decoded
+} Line_table;
+
+int lines_open(Line_table *table, Elf64_data *file);
+int lines_find(Line_table *table, uint64_t address, Line_unit **unit, Line_row **row);
+void lines_close(Line_table *table);
+void print_line(Output *out, Sym_index *symbols, Line_table *lines, const char *token);
+void addr2line(Elf64_data *file, int fd);
+
+#endif
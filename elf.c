@@ -1,10 +1,448 @@
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "elf.h"
+#include "note.h"
+#include "reader.h"
+#include "reloc.h"
+#include "zsection.h"
+
+static char empty_table[1];
+
+// Block of memory owned by a file, tagged with the table it holds if any
+typedef struct Elf_alloc {
+    struct Elf_alloc *next;
+    uint64_t offset; // Of the table in the file
+    uint64_t size;
+    int kind;        // ELF_T_*, -1 for plain allocations
+    int padding;     // Aligns data for the Elf64 tables it holds
+    char data[];
+} Elf_alloc;
+
+static Elf_alloc *alloc_block(Elf64_data *file, uint64_t size, uint64_t offset, int kind) {
+    if (size > SIZE_MAX - sizeof(Elf_alloc))
+        return NULL;
+
+    Elf_alloc *block = malloc(sizeof(Elf_alloc) + size);
+    if (block == NULL)
+        return NULL;
+    block->offset = offset;
+    block->size = size;
+    block->kind = kind;
+    block->next = file->allocs;
+    file->allocs = block;
+    return block;
+}
+
+// Memory released with the file, NULL if it cannot be allocated
+void *elf_alloc(Elf64_data *file, uint64_t size) {
+    Elf_alloc *block = alloc_block(file, size, 0, -1);
+    return block == NULL ? NULL : block->data;
+}
+
+void elf_release(Elf64_data *file) {
+    while (file->allocs != NULL) {
+        Elf_alloc *next = file->allocs->next;
+        free(file->allocs);
+        file->allocs = next;
+    }
+}
+
+// Whether entries at p can be used in place rather than converted
+static int is_aligned(const char *p) {
+    return ((uintptr_t)p & 7) == 0;
+}
+
+// Fetch n entries of stride bytes at offset, converted to entries of size
+// bytes by convert unless they can be used in place
+static char *fetch_table(Elf64_data *file, uint64_t offset, uint64_t n, uint64_t stride,
+                         uint64_t size, Elf_convert convert) {
+    if (n == 0)
+        return empty_table;
+
+    char *raw = elf_fetch(file, offset, n * stride);
+    if (raw == NULL || (n * stride) / n != stride)
+        return NULL;
+    if (file->reader->native && stride == size && is_aligned(raw))
+        return raw;
+
+    char *table = elf_alloc(file, n * size);
+    if (table != NULL)
+        convert(table, raw, n, stride);
+    return table;
+}
+
+// Fetch the headers of a freshly opened image. Returns -1 if they do not fit
+// in the file or the class or byte order are not supported.
+int elf_init(Elf64_data *file) {
+    const Elf_reader *reader;
+    char *raw;
+
+    file->elf_size = file->source.size;
+    file->allocs = NULL;
+    if ((raw = elf_fetch(file, 0, EI_NIDENT)) == NULL
+        || (reader = reader_select((uint8_t*)raw)) == NULL
+        || (raw = elf_fetch(file, 0, reader->ehdr_size)) == NULL)
+        return -1;
+    file->reader = reader;
+
+    if (reader->native && is_aligned(raw)) {
+        file->elf_head = (Elf64_Ehdr*)raw;
+    } else {
+        if ((file->elf_head = elf_alloc(file, sizeof(Elf64_Ehdr))) == NULL)
+            return -1;
+        reader->ehdr(file->elf_head, raw);
+    }
+
+    Elf64_Ehdr *head = file->elf_head;
+    if ((head->e_phnum && head->e_phentsize < reader->phdr_size)
+        || (head->e_shnum && head->e_shentsize < reader->shdr_size))
+        return -1;
+
+    file->elf_phead = fetch_table(file, head->e_phoff, head->e_phnum, head->e_phentsize,
+                                  sizeof(Elf64_Phdr), reader->phdrs);
+    file->elf_shead = fetch_table(file, head->e_shoff, head->e_shnum, head->e_shentsize,
+                                  sizeof(Elf64_Shdr), reader->shdrs);
+    if (file->elf_phead == NULL || file->elf_shead == NULL)
+        return -1;
+
+    // The header of the table is only kept when the table can be read
+    file->shstr_table_header = NULL;
+    file->shstr_table = empty_table;
+    file->shstr_size = sizeof(empty_table);
+    if (head->e_shstrndx < head->e_shnum) {
+        Elf64_Shdr *header = get_section(file, head->e_shstrndx);
+        char *table = elf_section_data(file, header);
+        if (table != NULL && header->sh_size > 0) {
+            file->shstr_table_header = header;
+            file->shstr_table = table;
+            file->shstr_size = header->sh_size;
+        }
+    }
+
+    return 0;
+}
+
+// Pointer to size bytes at offset in the file, or NULL when out of it
+char *elf_fetch(Elf64_data *file, uint64_t offset, uint64_t size) {
+    return source_fetch(&file->source, offset, size);
+}
+
+// Contents of a section, NULL if it has none in the file
+char *elf_section_data(Elf64_data *file, Elf64_Shdr *section) {
+    if (section->sh_type == SHT_NOBITS)
+        return NULL;
+    return elf_fetch(file, section->sh_offset, section->sh_size);
+}
+
+// Entries of a symbol, relocation or dynamic section as Elf64_Sym,
+// Elf64_Rel, Elf64_Rela or Elf64_Dyn. Tables of other classes or byte orders are converted once and
+// kept until elf_release. Returns NULL if the section cannot be read.
+void *elf_table(Elf64_data *file, Elf64_Shdr *section, int kind, uint64_t *count) {
+    const Elf_reader *reader = file->reader;
+    uint64_t stride = section->sh_entsize;
+    uint64_t entry_size, size;
+    Elf_convert convert;
+
+    switch (kind) {
+        case ELF_T_SYM:
+            size = reader->sym_size; entry_size = sizeof(Elf64_Sym); convert = reader->syms;
+            break;
+        case ELF_T_REL:
+            size = reader->rel_size; entry_size = sizeof(Elf64_Rel); convert = reader->rels;
+            break;
+        case ELF_T_RELA:
+            size = reader->rela_size; entry_size = sizeof(Elf64_Rela); convert = reader->relas;
+            break;
+        case ELF_T_DYN:
+            size = reader->dyn_size; entry_size = sizeof(Elf64_Dyn); convert = reader->dyns;
+            break;
+        default:
+            return NULL;
+    }
+
+    *count = 0;
+    if (stride < size)
+        return NULL;
+
+    uint64_t raw_size;
+    char *raw = zsection_contents(file, section, &raw_size);
+    if (raw == NULL)
+        return NULL;
+    *count = raw_size / stride;
+    if (reader->native && stride == entry_size && is_aligned(raw))
+        return raw;
+
+    char *table = elf_table_find(file, section->sh_offset, kind, &raw_size);
+    if (table != NULL)
+        return table;
+
+    if ((table = elf_table_alloc(file, *count * entry_size, section->sh_offset, kind)) == NULL) {
+        *count = 0;
+        return NULL;
+    }
+    convert(table, raw, *count, stride);
+    return table;
+}
+
+// Memory for a table derived from the one at offset, converted or
+// decompressed, found again by elf_table_find. NULL if it cannot be allocated.
+void *elf_table_alloc(Elf64_data *file, uint64_t size, uint64_t offset, int kind) {
+    Elf_alloc *block = alloc_block(file, size, offset, kind);
+    return block == NULL ? NULL : block->data;
+}
+
+void *elf_table_find(Elf64_data *file, uint64_t offset, int kind, uint64_t *size) {
+    for (Elf_alloc *block = file->allocs; block != NULL; block = block->next) {
+        if (block->kind == kind && block->offset == offset) {
+            *size = block->size;
+            return block->data;
+        }
+    }
+    return NULL;
+}
+
+// Entries of the dynamic section, up to DT_NULL, found with PT_DYNAMIC like
+// the loader does, or with the section headers when there is no such segment.
+// NULL if the file has none.
+Elf64_Dyn *elf_dynamic(Elf64_data *file, uint64_t *count) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    Elf64_Shdr dynamic = { .sh_type = SHT_NULL };
+    Elf64_Dyn *entries;
+
+    *count = 0;
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        if (segment->p_type == PT_DYNAMIC) {
+            dynamic.sh_type = SHT_DYNAMIC;
+            dynamic.sh_offset = segment->p_offset;
+            dynamic.sh_size = segment->p_filesz;
+            dynamic.sh_entsize = file->reader->dyn_size;
+            break;
+        }
+    }
+    for (int i = 0; dynamic.sh_type == SHT_NULL && i < file->elf_head->e_shnum; i++) {
+        if (get_section(file, i)->sh_type == SHT_DYNAMIC) {
+            dynamic = *get_section(file, i);
+            dynamic.sh_entsize = file->reader->dyn_size;
+        }
+    }
+    if (dynamic.sh_type == SHT_NULL
+        || (entries = elf_table(file, &dynamic, ELF_T_DYN, count)) == NULL)
+        return NULL;
+
+    for (uint64_t i = 0; i < *count; i++) {
+        if (entries[i].d_tag == DT_NULL) {
+            *count = i;
+            break;
+        }
+    }
+    return entries;
+}
+
+// Fetch the entries of a symbol table section and its string table, names
+// being looked up with elf_string against names_size. Returns the number of
+// symbols, 0 if the table cannot be read.
+uint64_t elf_symbols(Elf64_data *file, Elf64_Shdr *section, Elf64_Sym **symbols, char **names,
+                     uint64_t *names_size) {
+    uint64_t count;
+
+    *names = empty_table;
+    *names_size = sizeof(empty_table);
+    if ((*symbols = elf_table(file, section, ELF_T_SYM, &count)) == NULL)
+        return 0;
+
+    if (section->sh_link < file->elf_head->e_shnum) {
+        uint64_t size;
+        char *table = zsection_contents(file, get_section(file, section->sh_link), &size);
+        if (table != NULL) {
+            *names = table;
+            *names_size = size;
+        }
+    }
+
+    return count;
+}
+
+Elf64_Shdr *get_section(Elf64_data *data, uint64_t index) {
+    return (Elf64_Shdr*)data->elf_shead + index;
+}
+
+// Walk size bytes of notes at offset, aligned on align bytes. Returns -1 if
+// they are out of the file.
+int note_begin(Note_iter *iter, Elf64_data *file, uint64_t offset, uint64_t size, uint64_t align) {
+    const char *data = elf_fetch(file, offset, size);
+
+    memset(iter, 0, sizeof(Note_iter));
+    if (data == NULL)
+        return -1;
+
+    iter->file = file;
+    iter->next = data;
+    iter->end = data + size;
+    iter->align = align == 8 ? 8 : 4;
+    return 0;
+}
+
+// Next note. Returns 0 at the end, or at a note overflowing the others.
+int note_next(Note_iter *iter, Elf_note *note) {
+    Elf64_Nhdr nhdr;
+
+    if (iter->end - iter->next < (long)sizeof(Elf64_Nhdr))
+        return 0;
+
+    memcpy(&nhdr, iter->next, sizeof(Elf64_Nhdr));
+    note->namesz = iter->file->reader->word(nhdr.n_namesz);
+    note->descsz = iter->file->reader->word(nhdr.n_descsz);
+    note->type = iter->file->reader->word(nhdr.n_type);
+
+    // The description and the next note are aligned from the header
+    uint64_t align = iter->align;
+    uint64_t desc_at = (sizeof(Elf64_Nhdr) + (uint64_t)note->namesz + align - 1) & ~(align - 1);
+    uint64_t next_at = (desc_at + note->descsz + align - 1) & ~(align - 1);
+    uint64_t left = iter->end - iter->next;
+
+    // The padding of the last description may be missing
+    if (desc_at + note->descsz > left)
+        return 0;
+
+    note->name = iter->next + sizeof(Elf64_Nhdr);
+    note->desc = (const uint8_t*)iter->next + desc_at;
+    iter->next = next_at > left ? iter->end : iter->next + next_at;
+    return 1;
+}
+
+// Whether the note belongs to owner. Go pads its name with zeros.
+int note_is(const Elf_note *note, const char *owner) {
+    size_t len = strlen(owner);
+
+    return strnlen(note->name, note->namesz) == len && memcmp(note->name, owner, len) == 0;
+}
+
+// Walk a RELR section, setting entries to its number of words. Returns -1 if
+// it cannot be read.
+int relr_begin(Relr_iter *iter, Elf64_data *file, Elf64_Shdr *section, uint64_t *entries) {
+    uint64_t size;
+    const char *data = zsection_contents(file, section, &size);
+
+    memset(iter, 0, sizeof(Relr_iter));
+    *entries = 0;
+    if (data == NULL)
+        return -1;
+
+    iter->file = file;
+    iter->entry_size = section->sh_entsize == 4 || section->sh_entsize == 8 ? section->sh_entsize
+                     : file->elf_head->e_ident[EI_CLASS] == ELFCLASS32 ? 4 : 8;
+    *entries = size / iter->entry_size;
+    iter->next = data;
+    iter->end = data + *entries * iter->entry_size;
+    return 0;
+}
+
+// Next relocated address. Returns 0 at the end of the table.
+int relr_next(Relr_iter *iter, uint64_t *address) {
+    const Elf_reader *reader = iter->file->reader;
+
+    for (;;) {
+        if (iter->bitmap != 0) {
+            while (!(iter->bitmap & 1)) {
+                iter->bitmap >>= 1;
+                iter->address += iter->entry_size;
+            }
+            *address = iter->address;
+            iter->bitmap >>= 1;
+            iter->address += iter->entry_size;
+            return 1;
+        }
+
+        if (iter->next == iter->end)
+            return 0;
+
+        uint64_t word;
+        if (iter->entry_size == 8) {
+            memcpy(&word, iter->next, 8);
+            word = reader->xword(word);
+        } else {
+            uint32_t half;
+            memcpy(&half, iter->next, 4);
+            word = reader->word(half);
+        }
+        iter->next += iter->entry_size;
+
+        if (!(word & 1)) {
+            *address = word;
+            iter->base = word + iter->entry_size;
+            return 1;
+        }
+
+        // Bit n stands for the word n - 1 after base
+        iter->bitmap = word >> 1;
+        iter->address = iter->base;
+        iter->base += (iter->entry_size * 8 - 1) * iter->entry_size;
+    }
+}
+
+// Relative relocation type implied by RELR entries, 0 when unknown
+uint32_t relr_type(uint16_t machine) {
+    switch (machine) {
+        case EM_X86_64:    return 8;    // R_X86_64_RELATIVE
+        case EM_X86:       return 8;    // R_386_RELATIVE
+        case EM_ARM64:     return 1027; // R_AARCH64_RELATIVE
+        case EM_ARM:       return 23;   // R_ARM_RELATIVE
+        case EM_RISCV:     return 3;    // R_RISCV_RELATIVE
+        case EM_POWERPC:
+        case EM_POWERPC64: return 22;   // R_PPC_RELATIVE, R_PPC64_RELATIVE
+        case EM_S390:      return 12;   // R_390_RELATIVE
+        default:           return 0;
+    }
+}
+
+// Look for the GNU build-id note in size bytes of notes at offset
+static uint32_t find_build_id(Elf64_data *file, uint64_t offset, uint64_t size,
+                              uint64_t align, const uint8_t **id) {
+    Note_iter iter;
+    Elf_note note;
+
+    if (note_begin(&iter, file, offset, size, align) < 0)
+        return 0;
+
+    while (note_next(&iter, &note)) {
+        if (note.type == NT_GNU_BUILD_ID && note_is(&note, "GNU")) {
+            *id = note.desc;
+            return note.descsz;
+        }
+    }
+
+    return 0;
+}
+
+// Returns the length of the GNU build-id and points id to it, or 0 when there
+// is none
+uint32_t elf_build_id(Elf64_data *file, const uint8_t **id) {
+    uint32_t len;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+        if (section->sh_type == SHT_NOTE
+            && (len = find_build_id(file, section->sh_offset, section->sh_size,
+                                    section->sh_addralign, id)))
+            return len;
+    }
+
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        if (segment->p_type == PT_NOTE
+            && (len = find_build_id(file, segment->p_offset, segment->p_filesz,
+                                    segment->p_align, id)))
+            return len;
+    }
+
+    return 0;
+}
 
 const char *get_class(uint8_t e_class) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     switch (e_class) {
@@ -19,7 +457,7 @@ const char *get_class(uint8_t e_class) {
 }
 
 const char *get_osabi(uint8_t e_osabi) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     switch (e_osabi) {
@@ -52,7 +490,7 @@ const char *get_osabi(uint8_t e_osabi) {
 }
 
 const char *get_etype(uint16_t e_type) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     if ((e_type >= ET_LOOS) && (e_type) <= ET_HIOS) {
@@ -79,8 +517,9 @@ const char *get_etype(uint16_t e_type) {
 }
 
 const char *get_machine(uint16_t e_machine) {
-    static char s[16];
-    memset(s, 0, 16);
+    // "Unknown (0xffff)"
+    static _Thread_local char s[24];
+    memset(s, 0, sizeof(s));
 
     switch (e_machine) {
         case EM_NONE:         return "No specific instruction set";
@@ -154,14 +593,14 @@ const char *get_machine(uint16_t e_machine) {
         case EM_LOONGARCH:    return "LoongArch";
 
         default:
-            snprintf(s, 16, "Unknown (%#x)", e_machine);
+            snprintf(s, sizeof(s), "Unknown (%#x)", e_machine);
             return s;
 
     }
 }
 
 const char *get_ptype(uint32_t p_type) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     if ((p_type >= PT_LOOS) && (p_type <= PT_HIOS)) {
@@ -203,20 +642,93 @@ const char *get_ptype(uint32_t p_type) {
     }
 }
 
-const char *get_interp(Elf64_Phdr *elf_phead, char* elf_image) {
-    static char s[1024] = "INTERP: ";
-    s[8] = 0;
-    strcpy(s + 8, elf_image + elf_phead->p_offset);
+const char *get_interp(const char *interp, uint64_t size) {
+    static _Thread_local char s[1024] = "INTERP: ";
+    if (size > sizeof(s) - 9)
+        size = sizeof(s) - 9;
+    memset(s + 8, 0, sizeof(s) - 8);
+    if (interp != NULL)
+        strncpy(s + 8, interp, size);
     return s;
 }
 
+const char *get_dtag(int64_t d_tag) {
+    static _Thread_local char s[24];
+
+    switch (d_tag) {
+        case DT_NULL:            return "NULL";
+        case DT_NEEDED:          return "NEEDED";
+        case DT_PLTRELSZ:        return "PLTRELSZ";
+        case DT_PLTGOT:          return "PLTGOT";
+        case DT_HASH:            return "HASH";
+        case DT_STRTAB:          return "STRTAB";
+        case DT_SYMTAB:          return "SYMTAB";
+        case DT_RELA:            return "RELA";
+        case DT_RELASZ:          return "RELASZ";
+        case DT_RELAENT:         return "RELAENT";
+        case DT_STRSZ:           return "STRSZ";
+        case DT_SYMENT:          return "SYMENT";
+        case DT_INIT:            return "INIT";
+        case DT_FINI:            return "FINI";
+        case DT_SONAME:          return "SONAME";
+        case DT_RPATH:           return "RPATH";
+        case DT_SYMBOLIC:        return "SYMBOLIC";
+        case DT_REL:             return "REL";
+        case DT_RELSZ:           return "RELSZ";
+        case DT_RELENT:          return "RELENT";
+        case DT_PLTREL:          return "PLTREL";
+        case DT_DEBUG:           return "DEBUG";
+        case DT_TEXTREL:         return "TEXTREL";
+        case DT_JMPREL:          return "JMPREL";
+        case DT_BIND_NOW:        return "BIND_NOW";
+        case DT_INIT_ARRAY:      return "INIT_ARRAY";
+        case DT_FINI_ARRAY:      return "FINI_ARRAY";
+        case DT_INIT_ARRAYSZ:    return "INIT_ARRAYSZ";
+        case DT_FINI_ARRAYSZ:    return "FINI_ARRAYSZ";
+        case DT_RUNPATH:         return "RUNPATH";
+        case DT_FLAGS:           return "FLAGS";
+        case DT_PREINIT_ARRAY:   return "PREINIT_ARRAY";
+        case DT_PREINIT_ARRAYSZ: return "PREINIT_ARRAYSZ";
+        case DT_SYMTAB_SHNDX:    return "SYMTAB_SHNDX";
+        case DT_RELRSZ:          return "RELRSZ";
+        case DT_RELR:            return "RELR";
+        case DT_RELRENT:         return "RELRENT";
+        case DT_GNU_HASH:        return "GNU_HASH";
+        case DT_TLSDESC_PLT:     return "TLSDESC_PLT";
+        case DT_TLSDESC_GOT:     return "TLSDESC_GOT";
+        case DT_CONFIG:          return "CONFIG";
+        case DT_DEPAUDIT:        return "DEPAUDIT";
+        case DT_AUDIT:           return "AUDIT";
+        case DT_VERSYM:          return "VERSYM";
+        case DT_RELACOUNT:       return "RELACOUNT";
+        case DT_RELCOUNT:        return "RELCOUNT";
+        case DT_FLAGS_1:         return "FLAGS_1";
+        case DT_VERDEF:          return "VERDEF";
+        case DT_VERDEFNUM:       return "VERDEFNUM";
+        case DT_VERNEED:         return "VERNEED";
+        case DT_VERNEEDNUM:      return "VERNEEDNUM";
+        case DT_AUXILIARY:       return "AUXILIARY";
+        case DT_FILTER:          return "FILTER";
+        default:
+            snprintf(s, sizeof(s), "UNK+%#lx", (uint64_t)d_tag);
+            return s;
+    }
+}
+
 const char *get_stype(uint32_t sh_type) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     if ((sh_type >= SHT_LOOS) && (sh_type <= SHT_HIOS)) {
-        snprintf(s, 16, "OS+%#x", sh_type);
-        return s;
+        switch (sh_type) {
+            case SHT_GNU_HASH:    return "GNU_HASH";
+            case SHT_GNU_VERDEF:  return "GNU_VERDEF";
+            case SHT_GNU_VERNEED: return "GNU_VERNEED";
+            case SHT_GNU_VERSYM:  return "GNU_VERSYM";
+            default:
+                snprintf(s, 16, "OS+%#x", sh_type);
+                return s;
+        }
     }
 
     if ((sh_type >= SHT_LOPROC) && (sh_type <= SHT_HIPROC)) {
@@ -247,6 +759,7 @@ const char *get_stype(uint32_t sh_type) {
         case SHT_PREINIT_ARRAY: return "PREINIT_ARRAY";
         case SHT_GROUP:         return "GROUP";
         case SHT_SYMTAB_SHNDX:  return "SYMTAB_SHNDX";
+        case SHT_RELR:          return "RELR";
 
         default:
             snprintf(s, 16, "UNK+%#x", sh_type);
@@ -255,7 +768,7 @@ const char *get_stype(uint32_t sh_type) {
 }
 
 const char *get_sflags(uint64_t sh_flags) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, ' ', 15);
 
     const struct {
@@ -296,7 +809,7 @@ const char *get_sflags(uint64_t sh_flags) {
 
 const char *get_sym_type(uint64_t st_info) {
     uint64_t type = ELF64_ST_TYPE(st_info);
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     switch (type) {
@@ -316,22 +829,23 @@ const char *get_sym_type(uint64_t st_info) {
 
 const char* get_sym_bind(uint64_t st_info) {
     uint64_t bind = ELF64_ST_BIND(st_info);
-    static char s[16];
-    memset(s, 0, 16);
+    // "UNK+" and a 64-bit decimal
+    static _Thread_local char s[32];
+    memset(s, 0, sizeof(s));
 
     switch (bind) {
         case STB_LOCAL:   return "LOCAL";
         case STB_GLOBAL:  return "GLOBAL";
         case STB_WEAK:    return "WEAK";
         default:
-            snprintf(s, 16, "UNK+%ld", bind);
+            snprintf(s, sizeof(s), "UNK+%ld", bind);
             return s;
     }
 }
 
 const char *get_sym_vis(uint64_t st_info) {
     uint64_t vis = ELF64_ST_VISIBILITY(st_info);
-    static char s[16];
+    static _Thread_local char s[16];
 
     switch (vis) {
         case STV_DEFAULT:   return "DEFAULT";
@@ -345,7 +859,7 @@ const char *get_sym_vis(uint64_t st_info) {
 }
 
 const char *get_sym_ndx(uint64_t st_shndx) {
-    static char s[16];
+    static _Thread_local char s[16];
     memset(s, 0, 16);
 
     switch (st_shndx) {
@@ -358,6 +872,14 @@ const char *get_sym_ndx(uint64_t st_shndx) {
     }
 }
 
-const char *get_string(char *table, uint32_t sh_name) {
-    return table + sh_name;
+// String at offset in a table of size bytes, "" if it does not end in it
+const char *elf_string(const char *table, uint64_t size, uint64_t offset) {
+    if (offset >= size || memchr(table + offset, 0, size - offset) == NULL)
+        return "";
+    return table + offset;
+}
+
+// Name of a section, "" when out of the section name table
+const char *elf_section_name(Elf64_data *file, const Elf64_Shdr *section) {
+    return elf_string(file->shstr_table, file->shstr_size, section->sh_name);
 }
@@ -1,5 +1,12 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stddef.h>
 #include <stdint.h>
 
+#include "output.h"
+#include "source.h"
+
 // ELF Header
 
 #define EI_NIDENT 16
@@ -21,6 +28,23 @@ typedef struct {
     uint16_t e_shstrndx;
 } Elf64_Ehdr;
 
+typedef struct {
+    uint8_t  e_ident[EI_NIDENT];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} Elf32_Ehdr;
+
 // e_ident fields and values
 
 #define EI_MAG0 0
@@ -173,6 +197,17 @@ typedef struct {
     uint64_t p_align;
 } Elf64_Phdr;
 
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} Elf32_Phdr;
+
 // Values for p_type
 #define PT_NULL         0
 #define PT_LOAD         1
@@ -217,6 +252,19 @@ typedef struct {
     uint64_t sh_entsize;
 } Elf64_Shdr;
 
+typedef struct {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint32_t sh_flags;
+    uint32_t sh_addr;
+    uint32_t sh_offset;
+    uint32_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint32_t sh_addralign;
+    uint32_t sh_entsize;
+} Elf32_Shdr;
+
 // Section indices
 #define SHN_UNDEF       0      // Undefined section
 #define SHN_LORESERVE   0xff00 // Start of reserved indices
@@ -247,9 +295,15 @@ typedef struct {
 #define SHT_PREINIT_ARRAY 16
 #define SHT_GROUP         17
 #define SHT_SYMTAB_SHNDX  18
+#define SHT_RELR          19
 #define SHT_LOOS          0x60000000
+#define SHT_GNU_HASH      0x6ffffff6
+#define SHT_GNU_VERDEF    0x6ffffffd
+#define SHT_GNU_VERNEED   0x6ffffffe
+#define SHT_GNU_VERSYM    0x6fffffff
 #define SHT_HIOS          0x6fffffff
 #define SHT_LOPROC        0x70000000
+#define SHT_X86_64_UNWIND 0x70000001
 #define SHT_HIPROC        0x7fffffff
 #define SHT_LOUSER        0x80000000
 #define SHT_HIUSER        0xffffffff
@@ -281,6 +335,15 @@ typedef struct {
     uint64_t st_size;
 } Elf64_Sym;
 
+typedef struct {
+    uint32_t st_name;
+    uint32_t st_value;
+    uint32_t st_size;
+    unsigned char st_info;
+    unsigned char st_other;
+    uint16_t st_shndx;
+} Elf32_Sym;
+
 
 // Symbol binding
 #define ELF64_ST_BIND(i)   ((i)>>4)
@@ -302,10 +365,13 @@ typedef struct {
 #define STT_COMMON  5
 #define STT_TLS     6
 #define STT_LOOS    10
+#define STT_GNU_IFUNC 10
 #define STT_HIOS    12
 #define STT_LOPROC  13
 #define STT_HIPROC  15
 
+#define STN_UNDEF 0
+
 #define ELF64_ST_INFO(b,t) (((b)<<4)+((t)&0xf))
 
 #define ELF64_ST_VISIBILITY(o) ((o)&0x3)
@@ -331,19 +397,236 @@ typedef struct {
 #define ELF64_R_TYPE(i)   ((i)&0xffffffffL)
 #define ELF64_R_INFO(s,t) (((s)<<32)+((t)&0xffffffffL))
 
+typedef struct {
+  uint32_t r_offset;
+  uint32_t r_info;
+} Elf32_Rel;
+
+typedef struct {
+  uint32_t r_offset;
+  uint32_t r_info;
+  int32_t  r_addend;
+} Elf32_Rela;
+
+#define ELF32_R_SYM(i)    ((i)>>8)
+#define ELF32_R_TYPE(i)   ((i)&0xff)
+
+
+// Dynamic section
+typedef struct {
+    int64_t  d_tag;
+    uint64_t d_val; // Or d_ptr
+} Elf64_Dyn;
+
+typedef struct {
+    int32_t  d_tag;
+    uint32_t d_val;
+} Elf32_Dyn;
+
+// Values for d_tag
+#define DT_NULL            0
+#define DT_NEEDED          1
+#define DT_PLTRELSZ        2
+#define DT_PLTGOT          3
+#define DT_HASH            4
+#define DT_STRTAB          5
+#define DT_SYMTAB          6
+#define DT_RELA            7
+#define DT_RELASZ          8
+#define DT_RELAENT         9
+#define DT_STRSZ           10
+#define DT_SYMENT          11
+#define DT_INIT            12
+#define DT_FINI            13
+#define DT_SONAME          14
+#define DT_RPATH           15
+#define DT_SYMBOLIC        16
+#define DT_REL             17
+#define DT_RELSZ           18
+#define DT_RELENT          19
+#define DT_PLTREL          20
+#define DT_DEBUG           21
+#define DT_TEXTREL         22
+#define DT_JMPREL          23
+#define DT_BIND_NOW        24
+#define DT_INIT_ARRAY      25
+#define DT_FINI_ARRAY      26
+#define DT_INIT_ARRAYSZ    27
+#define DT_FINI_ARRAYSZ    28
+#define DT_RUNPATH         29
+#define DT_FLAGS           30
+#define DT_PREINIT_ARRAY   32
+#define DT_PREINIT_ARRAYSZ 33
+#define DT_SYMTAB_SHNDX    34
+#define DT_RELRSZ          35
+#define DT_RELR            36
+#define DT_RELRENT         37
+#define DT_GNU_HASH        0x6ffffef5
+#define DT_TLSDESC_PLT     0x6ffffef6
+#define DT_TLSDESC_GOT     0x6ffffef7
+#define DT_CONFIG          0x6ffffefa
+#define DT_DEPAUDIT        0x6ffffefb
+#define DT_AUDIT           0x6ffffefc
+#define DT_VERSYM          0x6ffffff0
+#define DT_RELACOUNT       0x6ffffff9
+#define DT_RELCOUNT        0x6ffffffa
+#define DT_FLAGS_1         0x6ffffffb
+#define DT_VERDEF          0x6ffffffc
+#define DT_VERDEFNUM       0x6ffffffd
+#define DT_VERNEED         0x6ffffffe
+#define DT_VERNEEDNUM      0x6fffffff
+#define DT_AUXILIARY       0x7ffffffd
+#define DT_FILTER          0x7fffffff
+
+// Flags for DT_FLAGS_1
+#define DF_1_NODEFLIB 0x800
+
+
+// Symbol versions, the same for both classes
+typedef struct {
+    uint16_t vd_version;
+    uint16_t vd_flags;
+    uint16_t vd_ndx;
+    uint16_t vd_cnt;
+    uint32_t vd_hash;
+    uint32_t vd_aux;  // Offset of the first Elf_Verdaux, that names the version
+    uint32_t vd_next; // Offset of the next Elf_Verdef, 0 for the last one
+} Elf_Verdef;
+
+typedef struct {
+    uint32_t vda_name;
+    uint32_t vda_next;
+} Elf_Verdaux;
+
+// Entries of SHT_GNU_VERSYM, one per dynamic symbol
+#define VERSYM_VERSION 0x7fff // Index of the version, 0 for local and 1 for global
+#define VERSYM_HIDDEN  0x8000 // Not the default version of the name
+
+
+// Notes
+typedef struct {
+    uint32_t n_namesz;
+    uint32_t n_descsz;
+    uint32_t n_type;
+} Elf64_Nhdr;
+
+// Header of SHF_COMPRESSED sections
+typedef struct {
+    uint32_t ch_type;
+    uint32_t ch_reserved;
+    uint64_t ch_size;
+    uint64_t ch_addralign;
+} Elf64_Chdr;
+
+typedef struct {
+    uint32_t ch_type;
+    uint32_t ch_size;
+    uint32_t ch_addralign;
+} Elf32_Chdr;
+
+#define ELFCOMPRESS_ZLIB 1
+#define ELFCOMPRESS_ZSTD 2
+
+// Values for n_type of "GNU" notes
+#define NT_GNU_ABI_TAG         1
+#define NT_GNU_HWCAP           2
+#define NT_GNU_BUILD_ID        3
+#define NT_GNU_GOLD_VERSION    4
+#define NT_GNU_PROPERTY_TYPE_0 5
+#define NT_GNU_BUILD_ATTRIBUTE_OPEN 0x100
+#define NT_GNU_BUILD_ATTRIBUTE_FUNC 0x101
+
+// Values for n_type of other owners
+#define NT_STAPSDT                3          // "stapsdt"
+#define NT_GO_BUILD_ID            4          // "Go"
+#define NT_FDO_PACKAGING_METADATA 0xcafe1a7e // "FDO"
+
+// Values for n_type of "CORE" and "LINUX" notes of core files
+#define NT_PRSTATUS   1
+#define NT_FPREGSET   2
+#define NT_PRPSINFO   3
+#define NT_TASKSTRUCT 4
+#define NT_AUXV       6
+#define NT_X86_XSTATE 0x202
+#define NT_PRXFPREG   0x46e62b7f
+#define NT_FILE       0x46494c45
+#define NT_SIGINFO    0x53494749
+
+// Properties of NT_GNU_PROPERTY_TYPE_0 notes
+#define GNU_PROPERTY_STACK_SIZE              1
+#define GNU_PROPERTY_NO_COPY_ON_PROTECTED    2
+#define GNU_PROPERTY_1_NEEDED                0xb0008000
+#define GNU_PROPERTY_AARCH64_FEATURE_1_AND   0xc0000000
+#define GNU_PROPERTY_X86_FEATURE_1_AND       0xc0000002
+#define GNU_PROPERTY_X86_FEATURE_2_NEEDED    0xc0008001
+#define GNU_PROPERTY_X86_ISA_1_NEEDED        0xc0008002
+#define GNU_PROPERTY_X86_FEATURE_2_USED      0xc0010001
+#define GNU_PROPERTY_X86_ISA_1_USED          0xc0010002
+
+
+// General structure for manipulating ELF
+
+struct Elf_reader;
+struct Elf_alloc;
+struct Demangle_cache;
+struct Code_symbols;
+
+typedef struct {
+    Elf64_Ehdr *elf_head; // ELF Header
+    char *elf_shead; // Start of section headers, as Elf64_Shdr
+    char *elf_phead; // Start of program headers, as Elf64_Phdr
+    Elf64_Shdr* shstr_table_header;
+    char *shstr_table;
+    uint64_t shstr_size; // Bytes of shstr_table, 1 for the empty table of files without one
+    Elf_source source; // Where the bytes come from, see elf_fetch
+    size_t elf_size;
+    Output *out; // Where the dump is written
+    const struct Elf_reader *reader; // Class and byte order of the file
+    struct Elf_alloc *allocs; // Tables converted to Elf64 or decompressed, see elf_table
+    struct Demangle_cache *demangled; // Names demangled for -C, see demangle.h
+    struct Code_symbols *code; // Symbols of the disassembly, see disasm.h
+    int quiet; // Sections that cannot be decompressed are not reported on stderr
+} Elf64_data;
+
+// Kinds of tables for elf_table
+#define ELF_T_SYM  0
+#define ELF_T_REL  1
+#define ELF_T_RELA 2
+#define ELF_T_DATA 3 // Decompressed section, see zsection.h
+#define ELF_T_BAD  4 // Section that could not be decompressed
+#define ELF_T_DYN  5
+
 
 // Functions
 
+int elf_init(Elf64_data *file);
+void elf_release(Elf64_data *file);
+void *elf_alloc(Elf64_data *file, uint64_t size);
+void *elf_table(Elf64_data *file, Elf64_Shdr *section, int kind, uint64_t *count);
+void *elf_table_alloc(Elf64_data *file, uint64_t size, uint64_t offset, int kind);
+void *elf_table_find(Elf64_data *file, uint64_t offset, int kind, uint64_t *size);
+char *elf_fetch(Elf64_data *file, uint64_t offset, uint64_t size);
+char *elf_section_data(Elf64_data *file, Elf64_Shdr *section);
+Elf64_Dyn *elf_dynamic(Elf64_data *file, uint64_t *count);
+uint64_t elf_symbols(Elf64_data *file, Elf64_Shdr *section, Elf64_Sym **symbols, char **names,
+                     uint64_t *names_size);
+Elf64_Shdr *get_section(Elf64_data *data, uint64_t index);
+uint32_t elf_build_id(Elf64_data *file, const uint8_t **id);
+
 const char *get_class(uint8_t e_class);
 const char *get_osabi(uint8_t e_osabi);
 const char *get_etype(uint16_t e_type);
 const char *get_machine(uint16_t e_machine);
 const char *get_ptype(uint32_t p_type);
-const char *get_interp(Elf64_Phdr *elf_phead, char* elf_image);
+const char *get_interp(const char *interp, uint64_t size);
 const char *get_stype(uint32_t sh_type);
+const char *get_dtag(int64_t d_tag);
 const char *get_sflags(uint64_t sh_flags);
 const char *get_sym_type(uint64_t st_info);
 const char* get_sym_bind(uint64_t st_info);
 const char *get_sym_vis(uint64_t st_info);
 const char *get_sym_ndx(uint64_t st_shndx);
-const char *get_string(char *file, uint32_t sh_name);
+const char *elf_string(const char *table, uint64_t size, uint64_t offset);
+const char *elf_section_name(Elf64_data *file, const Elf64_Shdr *section);
+
+#endif
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "elf.h"
+#include "output.h"
+#include "hashtab.h"
+#include "reader.h"
+#include "zsection.h"
+
+uint32_t sysv_hash(const char *name) {
+    const uint8_t *p = (const uint8_t*)name;
+    uint32_t h = 0, g;
+
+    while (*p) {
+        h = (h << 4) + *p++;
+        if ((g = h & 0xf0000000))
+            h ^= g >> 24;
+        h &= ~g;
+    }
+    return h;
+}
+
+uint32_t gnu_hash(const char *name) {
+    const uint8_t *p = (const uint8_t*)name;
+    uint32_t h = 5381;
+
+    while (*p)
+        h = (h << 5) + h + *p++;
+    return h;
+}
+
+// Version of each symbol from the SHT_GNU_VERSYM section of DYNSYM, and the
+// names of the versions from SHT_GNU_VERDEF. The symbols are left unversioned
+// when VERSYM cannot be read.
+static void hash_versions(Dyn_hash *hash, Elf64_data *file, uint32_t dynsym) {
+    const Elf_reader *reader = file->reader;
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+    Elf64_Shdr *versym = NULL, *verdef = NULL;
+    uint32_t strtab = get_section(file, dynsym)->sh_link;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        if (section->sh_type == SHT_GNU_VERSYM && section->sh_link == dynsym)
+            versym = section;
+        else if (section->sh_type == SHT_GNU_VERDEF && section->sh_link == strtab)
+            verdef = section;
+    }
+
+    uint16_t *raw;
+    if (versym == NULL || versym->sh_size / sizeof(uint16_t) < hash->sym_num
+        || (raw = (uint16_t*)elf_section_data(file, versym)) == NULL)
+        return;
+    if (reader->native) {
+        hash->versym = raw;
+    } else {
+        if ((hash->versym = elf_alloc(file, hash->sym_num * sizeof(uint16_t))) == NULL)
+            return;
+        for (uint64_t i = 0; i < hash->sym_num; i++)
+            hash->versym[i] = reader->half(raw[i]);
+    }
+
+    char *defs = verdef != NULL ? elf_section_data(file, verdef) : NULL;
+    if (defs == NULL)
+        return;
+
+    // Two walks of the definitions, for the highest index and then the names.
+    // vd_next is followed at most once per entry that fits, in case it loops.
+    uint64_t size = verdef->sh_size, steps = size / sizeof(Elf_Verdef);
+    for (int pass = 0; pass < 2; pass++) {
+        uint64_t offset = 0;
+
+        for (uint64_t n = 0; n < steps && offset <= size - sizeof(Elf_Verdef); n++) {
+            Elf_Verdef def;
+            Elf_Verdaux aux;
+
+            memcpy(&def, defs + offset, sizeof(def));
+            uint32_t index = reader->half(def.vd_ndx) & VERSYM_VERSION;
+            uint64_t aux_offset = offset + reader->word(def.vd_aux);
+
+            if (pass == 0 && index >= hash->version_count) {
+                hash->version_count = index + 1;
+            } else if (pass == 1 && aux_offset <= size - sizeof(Elf_Verdaux)) {
+                memcpy(&aux, defs + aux_offset, sizeof(aux));
+                hash->versions[index] = elf_string(hash->names, hash->names_size,
+                                                   reader->word(aux.vda_name));
+            }
+            if (def.vd_next == 0)
+                break;
+            offset += reader->word(def.vd_next);
+        }
+
+        if (pass == 0 && (hash->versions = elf_alloc(file, hash->version_count * sizeof(char*))) == NULL) {
+            hash->version_count = 0;
+            return;
+        }
+        if (pass == 0)
+            memset(hash->versions, 0, hash->version_count * sizeof(char*));
+    }
+}
+
+// Decode the hash table in section. Returns -1 if it is malformed.
+int hash_load(Dyn_hash *hash, Elf64_data *file, Elf64_Shdr *section) {
+    memset(hash, 0, sizeof(Dyn_hash));
+
+    if (section->sh_link >= file->elf_head->e_shnum)
+        return -1;
+
+    const Elf_reader *reader = file->reader;
+    uint32_t *raw = (uint32_t*)elf_section_data(file, section);
+    uint32_t *words = raw;
+    uint64_t nwords = section->sh_size / sizeof(uint32_t);
+
+    hash->section = section;
+    Elf64_Shdr *dynsym = get_section(file, section->sh_link);
+    hash->sym_num = elf_symbols(file, dynsym, &hash->symbols, &hash->names, &hash->names_size);
+    if (words == NULL || hash->sym_num == 0)
+        return -1;
+    hash_versions(hash, file, section->sh_link);
+
+    // Swapped copy for the other byte order, the bloom filter is redone below
+    if (!reader->native) {
+        if ((words = elf_alloc(file, nwords * sizeof(uint32_t))) == NULL)
+            return -1;
+        for (uint64_t i = 0; i < nwords; i++)
+            words[i] = reader->word(raw[i]);
+    }
+
+    if (section->sh_type == SHT_GNU_HASH) {
+        if (nwords < 4)
+            return -1;
+        hash->nbuckets = words[0];
+        hash->symoffset = words[1];
+        hash->bloom_size = words[2];
+        hash->bloom_shift = words[3];
+
+        // The bloom filter is made of address sized words
+        hash->bloom_bits = file->elf_head->e_ident[EI_CLASS] == ELFCLASS64 ? 64 : 32;
+        uint64_t bloom_words = (uint64_t)hash->bloom_size * (hash->bloom_bits / 32);
+        uint64_t chain_start = 4 + bloom_words + hash->nbuckets;
+        // h1 >> bloom_shift is on 32 bits
+        if (hash->nbuckets == 0 || hash->bloom_size == 0 || chain_start > nwords
+            || hash->symoffset > hash->sym_num || hash->bloom_shift >= 32)
+            return -1;
+
+        if (reader->native) {
+            hash->bloom = (uint64_t*)(words + 4);
+        } else {
+            // Widened to 64 bits words in the host byte order
+            if ((hash->bloom = elf_alloc(file, hash->bloom_size * sizeof(uint64_t))) == NULL)
+                return -1;
+            for (uint64_t i = 0; i < hash->bloom_size; i++) {
+                uint64_t word;
+
+                if (hash->bloom_bits == 64) {
+                    memcpy(&word, raw + 4 + i * 2, sizeof(word));
+                    hash->bloom[i] = reader->xword(word);
+                } else {
+                    hash->bloom[i] = reader->word(raw[4 + i]);
+                }
+            }
+        }
+        hash->buckets = words + 4 + bloom_words;
+        hash->chain = words + chain_start;
+        // Chain entries of the symbols from symoffset on
+        if (nwords - chain_start < hash->sym_num - hash->symoffset)
+            return -1;
+    } else {
+        if (nwords < 2)
+            return -1;
+        hash->nbuckets = words[0];
+        hash->nchain = words[1];
+        if (hash->nbuckets == 0 || 2 + (uint64_t)hash->nbuckets + hash->nchain > nwords
+            || hash->nchain > hash->sym_num)
+            return -1;
+        hash->buckets = words + 2;
+        hash->chain = words + 2 + hash->nbuckets;
+    }
+
+    return 0;
+}
+
+// Load the hash table of the dynamic symbols, preferring SHT_GNU_HASH. Returns
+// -1 if there is none.
+int hash_find(Dyn_hash *hash, Elf64_data *file) {
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+    Elf64_Shdr *sysv = NULL;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        if (section->sh_type == SHT_GNU_HASH && hash_load(hash, file, section) == 0)
+            return 0;
+        if (section->sh_type == SHT_HASH)
+            sysv = section;
+    }
+
+    if (sysv != NULL && hash_load(hash, file, sysv) == 0)
+        return 0;
+
+    memset(hash, 0, sizeof(Dyn_hash));
+    return -1;
+}
+
+static Elf64_Sym *hash_symbol(Dyn_hash *hash, uint64_t index) {
+    return &hash->symbols[index];
+}
+
+static const char *symbol_name(Dyn_hash *hash, Elf64_Sym *sym) {
+    return elf_string(hash->names, hash->names_size, sym->st_name);
+}
+
+// Whether the symbol at index is the one a lookup binds to: with no version,
+// an unversioned symbol or the default version of the name; with a version,
+// a symbol of that version, which has to be the default one for "@@".
+static int version_match(Dyn_hash *hash, uint64_t index, const char *version, int only_default) {
+    if (hash->versym == NULL)
+        return version == NULL;
+
+    uint16_t entry = hash->versym[index];
+    uint16_t number = entry & VERSYM_VERSION;
+    if ((version == NULL || only_default) && (entry & VERSYM_HIDDEN))
+        return 0;
+    if (version == NULL)
+        return 1;
+    return number < hash->version_count && hash->versions[number] != NULL
+        && strcmp(version, hash->versions[number]) == 0;
+}
+
+// Whether the symbol at index is a definition of name in the version asked for
+static int symbol_match(Dyn_hash *hash, uint64_t index, const char *name, const char *version,
+                        int only_default) {
+    Elf64_Sym *sym = hash_symbol(hash, index);
+
+    return sym->st_shndx != SHN_UNDEF && strcmp(name, symbol_name(hash, sym)) == 0
+        && version_match(hash, index, version, only_default);
+}
+
+// Split a "name@version" or "name@@version" query. Returns the name alone, to
+// be freed, or NULL when the query has no version.
+static char *split_version(const char *query, const char **version, int *only_default) {
+    const char *at = strchr(query, '@');
+    char *name;
+
+    *version = NULL;
+    *only_default = 0;
+    if (at == NULL)
+        return NULL;
+    if ((name = malloc(at - query + 1)) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    memcpy(name, query, at - query);
+    name[at - query] = 0;
+    *only_default = at[1] == '@';
+    *version = at + 1 + *only_default;
+    return name;
+}
+
+static int bloom_match(Dyn_hash *hash, uint32_t h1) {
+    uint32_t bits = hash->bloom_bits;
+    uint32_t h2 = h1 >> hash->bloom_shift;
+    uint64_t word = hash->bloom[(h1 / bits) % hash->bloom_size];
+    uint64_t mask = (1ULL << (h1 % bits)) | (1ULL << (h2 % bits));
+
+    return (word & mask) == mask;
+}
+
+static int64_t gnu_lookup(Dyn_hash *hash, const char *name, const char *version, int only_default) {
+    uint32_t h1 = gnu_hash(name);
+
+    // Most names that are not there stop at the bloom filter
+    if (!bloom_match(hash, h1))
+        return -1;
+
+    uint64_t index = hash->buckets[h1 % hash->nbuckets];
+    if (index < hash->symoffset)
+        return -1;
+
+    for (; index < hash->sym_num; index++) {
+        uint32_t h = hash->chain[index - hash->symoffset];
+
+        if ((h1 | 1) == (h | 1) && symbol_match(hash, index, name, version, only_default))
+            return index;
+        // Last symbol of the bucket
+        if (h & 1)
+            break;
+    }
+
+    return -1;
+}
+
+static int64_t sysv_lookup(Dyn_hash *hash, const char *name, const char *version, int only_default) {
+    uint64_t index = hash->buckets[sysv_hash(name) % hash->nbuckets];
+    uint64_t steps = 0;
+
+    // Bounded, in case the chain loops
+    for (; index != STN_UNDEF && index < hash->nchain && steps < hash->nchain; steps++) {
+        if (symbol_match(hash, index, name, version, only_default))
+            return index;
+        index = hash->chain[index];
+    }
+
+    return -1;
+}
+
+// Index in DYNSYM of the symbol a query resolves to, or -1. The query is a
+// name, bound to its default version, or "name@version" or "name@@version".
+// Like ld.so, this only finds the symbols defined by the file.
+int64_t hash_lookup(Dyn_hash *hash, const char *query) {
+    const char *version;
+    int only_default;
+    char *name = split_version(query, &version, &only_default);
+    int64_t index = -1;
+
+    if (hash->section != NULL && hash->section->sh_type == SHT_GNU_HASH)
+        index = gnu_lookup(hash, name ? name : query, version, only_default);
+    else if (hash->section != NULL)
+        index = sysv_lookup(hash, name ? name : query, version, only_default);
+    free(name);
+    return index;
+}
+
+// Same as hash_lookup, by scanning all of DYNSYM
+int64_t linear_lookup(Dyn_hash *hash, const char *query) {
+    const char *version;
+    int only_default;
+    char *name = split_version(query, &version, &only_default);
+    int64_t index = -1;
+
+    for (uint64_t i = 1; i < hash->sym_num && index < 0; i++)
+        if (symbol_match(hash, i, name ? name : query, version, only_default))
+            index = i;
+    free(name);
+    return index;
+}
+
+// Whether the table leads to the symbol index, not just to one of the same
+// name
+static int hash_reaches(Dyn_hash *hash, uint64_t index) {
+    const char *name = symbol_name(hash, hash_symbol(hash, index));
+
+    if (hash->section->sh_type == SHT_GNU_HASH) {
+        uint32_t h1 = gnu_hash(name);
+        uint64_t i = hash->buckets[h1 % hash->nbuckets];
+
+        if (!bloom_match(hash, h1) || i < hash->symoffset || i > index)
+            return 0;
+        for (; i < index; i++)
+            if (hash->chain[i - hash->symoffset] & 1)
+                return 0;
+        return (hash->chain[index - hash->symoffset] | 1) == (h1 | 1);
+    }
+
+    uint64_t i = hash->buckets[sysv_hash(name) % hash->nbuckets];
+    for (uint64_t steps = 0; i != STN_UNDEF && i < hash->nchain && steps < hash->nchain; steps++) {
+        if (i == index)
+            return 1;
+        i = hash->chain[i];
+    }
+    return 0;
+}
+
+void display_hash(Elf64_Shdr *section, Elf64_data *file) {
+    Output *out = file->out;
+    Dyn_hash hash;
+
+    out_printf(out, "\n= Hash table '%s' =\n\n", elf_section_name(file, section));
+
+    if (hash_load(&hash, file, section) < 0) {
+        fprintf(stderr, "Hash table %s is malformed\n",
+                elf_section_name(file, section));
+        return;
+    }
+
+    out_printf(out, "  Buckets: %u\n", hash.nbuckets);
+    if (section->sh_type == SHT_GNU_HASH) {
+        out_printf(out, "  Symbols: %lu, from index %u\n", hash.sym_num - hash.symoffset, hash.symoffset);
+        out_printf(out, "  Bloom:   %u words, shift %u\n", hash.bloom_size, hash.bloom_shift);
+    } else {
+        out_printf(out, "  Symbols: %u\n", hash.nchain);
+    }
+
+    // Histogram of the bucket lengths
+    uint32_t *lengths = calloc(hash.nbuckets, sizeof(uint32_t));
+    uint32_t max_length = 0;
+    uint64_t total = 0;
+
+    if (lengths == NULL)
+        return;
+
+    for (uint32_t b = 0; b < hash.nbuckets; b++) {
+        uint64_t i = hash.buckets[b];
+
+        if (section->sh_type == SHT_GNU_HASH) {
+            if (i < hash.symoffset)
+                continue;
+            for (; i < hash.sym_num; i++) {
+                lengths[b]++;
+                if (hash.chain[i - hash.symoffset] & 1)
+                    break;
+            }
+        } else {
+            for (; i != STN_UNDEF && i < hash.nchain && lengths[b] < hash.nchain; i = hash.chain[i])
+                lengths[b]++;
+        }
+
+        if (lengths[b] > max_length)
+            max_length = lengths[b];
+        total += lengths[b];
+    }
+
+    uint64_t *counts = calloc(max_length + 1, sizeof(uint64_t));
+    if (counts != NULL) {
+        uint64_t covered = 0;
+
+        for (uint32_t b = 0; b < hash.nbuckets; b++)
+            counts[lengths[b]]++;
+
+        out_str(out, "\n  Length  Buckets     % of total  Coverage\n");
+        for (uint32_t l = 0; l <= max_length; l++) {
+            covered += counts[l] * l;
+            out_printf(out, "  %6u  %-10lu  %5.1f%%      %5.1f%%\n", l, counts[l],
+                       100.0 * counts[l] / hash.nbuckets, total ? 100.0 * covered / total : 0.0);
+        }
+        free(counts);
+    }
+
+    free(lengths);
+}
+
+static double elapsed(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Check that every symbol defined in DYNSYM can be reached through the hash
+// table, and time lookups through it against a linear scan. Returns -1 if
+// symbols are missing.
+int hash_check(Elf64_data *file) {
+    Output *out = file->out;
+    Dyn_hash hash;
+    uint64_t checked = 0, missing = 0;
+
+    if (hash_find(&hash, file) < 0) {
+        fprintf(stderr, "No usable hash table\n");
+        return -1;
+    }
+
+    out_printf(out, "Hash table '%s' (%s) for %lu dynamic symbols\n",
+               elf_section_name(file, hash.section),
+               get_stype(hash.section->sh_type), hash.sym_num);
+
+    for (uint64_t i = 1; i < hash.sym_num; i++) {
+        Elf64_Sym *sym = hash_symbol(&hash, i);
+
+        // Undefined symbols are left out of GNU hash tables
+        if (sym->st_shndx == SHN_UNDEF && hash.section->sh_type == SHT_GNU_HASH)
+            continue;
+        checked++;
+        if (!hash_reaches(&hash, i)) {
+            missing++;
+            out_printf(out, "  Not reachable: {%lu} %s\n", i, symbol_name(&hash, sym));
+        }
+    }
+    out_printf(out, "  %lu symbols checked, %lu not reachable\n", checked, missing);
+
+    if (checked == 0)
+        return missing ? -1 : 0;
+
+    // Benchmark: every checked name through the table, and as many through
+    // the linear scan as fit in about a second
+    struct timespec start;
+    uint64_t lookups = 0;
+    double hash_time, linear_time;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < 10; round++) {
+        for (uint64_t i = 1; i < hash.sym_num; i++) {
+            Elf64_Sym *sym = hash_symbol(&hash, i);
+            if (sym->st_shndx == SHN_UNDEF)
+                continue;
+            hash_lookup(&hash, symbol_name(&hash, sym));
+            lookups++;
+        }
+    }
+    hash_time = elapsed(&start) / (lookups ? lookups : 1);
+
+    lookups = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 1; i < hash.sym_num && elapsed(&start) < 1.0; i++) {
+        Elf64_Sym *sym = hash_symbol(&hash, i);
+        if (sym->st_shndx == SHN_UNDEF)
+            continue;
+        linear_lookup(&hash, symbol_name(&hash, sym));
+        lookups++;
+    }
+    linear_time = elapsed(&start) / (lookups ? lookups : 1);
+
+    out_printf(out, "  Hash lookup:   %10.1f ns\n", hash_time * 1e9);
+    out_printf(out, "  Linear lookup: %10.1f ns (%.0fx)\n", linear_time * 1e9,
+               hash_time > 0 ? linear_time / hash_time : 0.0);
+
+    return missing ? -1 : 0;
+}
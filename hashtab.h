@@ -0,0 +1,45 @@
+#ifndef HASHTAB_H
+#define HASHTAB_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Dynamic symbol hash tables, SHT_GNU_HASH and SHT_HASH
+
+typedef struct {
+    Elf64_Shdr *section; // Hash section, NULL when there is none
+    Elf64_Sym *symbols;  // DYNSYM it indexes
+    uint64_t sym_num;
+    char *names;
+    uint64_t names_size;
+
+    // Symbol versions, versym NULL when DYNSYM has none
+    uint16_t *versym;       // VERSYM entry of each symbol
+    const char **versions;  // Name of each version index, NULL if undefined
+    uint32_t version_count;
+
+    // SHT_GNU_HASH
+    uint32_t symoffset; // First symbol in the table
+    uint32_t bloom_size;
+    uint32_t bloom_shift;
+    uint32_t bloom_bits; // Of a bloom word, the size of an address
+    uint64_t *bloom;
+
+    // Both, with nchain only meaningful for SHT_HASH
+    uint32_t nbuckets;
+    uint32_t nchain;
+    uint32_t *buckets;
+    uint32_t *chain;
+} Dyn_hash;
+
+uint32_t sysv_hash(const char *name);
+uint32_t gnu_hash(const char *name);
+int hash_load(Dyn_hash *hash, Elf64_data *file, Elf64_Shdr *section);
+int hash_find(Dyn_hash *hash, Elf64_data *file);
+int64_t hash_lookup(Dyn_hash *hash, const char *name);
+int64_t linear_lookup(Dyn_hash *hash, const char *name);
+void display_hash(Elf64_Shdr *section, Elf64_data *file);
+int hash_check(Elf64_data *file);
+
+#endif
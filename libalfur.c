@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <string.h>
+
+#include "libalfur.h"
+#include "zsection.h"
+
+// Set up file once its source is open
+static int init(Elf64_data *file, int flags) {
+    const uint8_t *magic = (const uint8_t*)elf_fetch(file, 0, EI_NIDENT);
+    int status = ALFUR_OK;
+
+    file->quiet = !(flags & ALFUR_WARN);
+    if (magic == NULL || magic[EI_MAG0] != ELFMAG0 || magic[EI_MAG1] != ELFMAG1
+        || magic[EI_MAG2] != ELFMAG2 || magic[EI_MAG3] != ELFMAG3) {
+        status = ALFUR_EFORMAT;
+    } else {
+        errno = 0;
+        if (elf_init(file) < 0)
+            status = errno == ENOMEM ? ALFUR_ENOMEM : ALFUR_EFORMAT;
+    }
+
+    if (status != ALFUR_OK) {
+        elf_release(file);
+        source_close(&file->source);
+    }
+    return status;
+}
+
+// Open the ELF file at path, "-" being stdin
+int alfur_open(Elf64_data *file, const char *path, int flags) {
+    memset(file, 0, sizeof(Elf64_data));
+    if (source_open(&file->source, path, flags & ALFUR_PREAD ? SOURCE_FORCE_PREAD : 0) < 0)
+        return ALFUR_EIO;
+    return init(file, flags);
+}
+
+// Read the ELF image of size bytes at image, which must outlive file
+int alfur_open_memory(Elf64_data *file, const void *image, size_t size, int flags) {
+    memset(file, 0, sizeof(Elf64_data));
+    source_open_memory(&file->source, image, size);
+    return init(file, flags);
+}
+
+// Release what file holds, views included
+int alfur_close(Elf64_data *file) {
+    elf_release(file);
+    return source_close(&file->source) < 0 ? ALFUR_EIO : ALFUR_OK;
+}
+
+const char *alfur_strerror(int error) {
+    switch (error) {
+        case ALFUR_OK:      return "Success";
+        case ALFUR_EIO:     return "Cannot read the file";
+        case ALFUR_EFORMAT: return "Not a valid ELF file";
+        case ALFUR_ENOMEM:  return "Out of memory";
+        case ALFUR_ERANGE:  return "Out of range";
+        case ALFUR_ETYPE:   return "Wrong section type";
+        case ALFUR_ENOENT:  return "No such section";
+        case ALFUR_EDATA:   return "Section cannot be decompressed";
+        default:            return "Unknown error";
+    }
+}
+
+const Elf64_Ehdr *alfur_header(Elf64_data *file) {
+    return file->elf_head;
+}
+
+int alfur_section(Elf64_data *file, uint64_t index, const Elf64_Shdr **section) {
+    if (index >= file->elf_head->e_shnum)
+        return ALFUR_ERANGE;
+    *section = get_section(file, index);
+    return ALFUR_OK;
+}
+
+int alfur_segment(Elf64_data *file, uint64_t index, const Elf64_Phdr **segment) {
+    if (index >= file->elf_head->e_phnum)
+        return ALFUR_ERANGE;
+    *segment = (const Elf64_Phdr*)file->elf_phead + index;
+    return ALFUR_OK;
+}
+
+const char *alfur_section_name(Elf64_data *file, const Elf64_Shdr *section) {
+    return elf_section_name(file, section);
+}
+
+// Index of the first section called name
+int alfur_find_section(Elf64_data *file, const char *name, uint64_t *index) {
+    for (uint64_t i = 0; i < file->elf_head->e_shnum; i++) {
+        if (strcmp(alfur_section_name(file, get_section(file, i)), name) == 0) {
+            *index = i;
+            return ALFUR_OK;
+        }
+    }
+    return ALFUR_ENOENT;
+}
+
+// Contents of a section, decompressed if needed. SHT_NOBITS sections have
+// none: data is NULL and size 0.
+int alfur_section_data(Elf64_data *file, uint64_t index, const char **data, uint64_t *size) {
+    Elf64_Shdr *section;
+
+    *data = NULL;
+    *size = 0;
+    if (index >= file->elf_head->e_shnum)
+        return ALFUR_ERANGE;
+    section = get_section(file, index);
+    if (section->sh_type == SHT_NOBITS)
+        return ALFUR_OK;
+
+    if ((*data = zsection_contents(file, section, size)) != NULL)
+        return ALFUR_OK;
+    if (zsection_compressed(file, section) && elf_section_data(file, section) != NULL)
+        return ALFUR_EDATA;
+    return ALFUR_ERANGE;
+}
+
+int alfur_sections(Alfur_iter *iter, Elf64_data *file) {
+    iter->file = file;
+    iter->next = 0;
+    iter->count = file->elf_head->e_shnum;
+    return ALFUR_OK;
+}
+
+int alfur_next_section(Alfur_iter *iter, uint64_t *index, const Elf64_Shdr **section) {
+    if (iter->next == iter->count)
+        return 0;
+    *index = iter->next++;
+    *section = get_section(iter->file, *index);
+    return 1;
+}
+
+int alfur_segments(Alfur_iter *iter, Elf64_data *file) {
+    iter->file = file;
+    iter->next = 0;
+    iter->count = file->elf_head->e_phnum;
+    return ALFUR_OK;
+}
+
+int alfur_next_segment(Alfur_iter *iter, uint64_t *index, const Elf64_Phdr **segment) {
+    if (iter->next == iter->count)
+        return 0;
+    *index = iter->next++;
+    *segment = (const Elf64_Phdr*)iter->file->elf_phead + *index;
+    return 1;
+}
+
+// Entries of a section of type kind for elf_table
+static const void *section_table(Elf64_data *file, uint64_t index, int kind, uint64_t *count) {
+    const void *table = elf_table(file, get_section(file, index), kind, count);
+
+    if (table == NULL)
+        *count = 0;
+    return table;
+}
+
+int alfur_symbols(Alfur_symbol_iter *iter, Elf64_data *file, uint64_t section) {
+    Elf64_Shdr *header;
+
+    memset(iter, 0, sizeof(Alfur_symbol_iter));
+    if (section >= file->elf_head->e_shnum)
+        return ALFUR_ERANGE;
+    header = get_section(file, section);
+    if (header->sh_type != SHT_SYMTAB && header->sh_type != SHT_DYNSYM)
+        return ALFUR_ETYPE;
+
+    if ((iter->symbols = section_table(file, section, ELF_T_SYM, &iter->count)) == NULL)
+        return ALFUR_ERANGE;
+    if (header->sh_link < file->elf_head->e_shnum)
+        iter->names = zsection_contents(file, get_section(file, header->sh_link), &iter->names_size);
+    if (iter->names == NULL)
+        iter->names_size = 0;
+    return ALFUR_OK;
+}
+
+int alfur_next_symbol(Alfur_symbol_iter *iter, Alfur_symbol *symbol) {
+    if (iter->next == iter->count)
+        return 0;
+    symbol->index = iter->next;
+    symbol->sym = &iter->symbols[iter->next++];
+    symbol->name = elf_string(iter->names, iter->names_size, symbol->sym->st_name);
+    return 1;
+}
+
+int alfur_relocs(Alfur_reloc_iter *iter, Elf64_data *file, uint64_t section) {
+    Elf64_Shdr *header;
+    uint64_t entries;
+
+    memset(iter, 0, sizeof(Alfur_reloc_iter));
+    if (section >= file->elf_head->e_shnum)
+        return ALFUR_ERANGE;
+    header = get_section(file, section);
+    iter->kind = header->sh_type;
+
+    switch (header->sh_type) {
+        case SHT_REL:
+            iter->rels = section_table(file, section, ELF_T_REL, &iter->count);
+            return iter->rels == NULL ? ALFUR_ERANGE : ALFUR_OK;
+        case SHT_RELA:
+            iter->relas = section_table(file, section, ELF_T_RELA, &iter->count);
+            return iter->relas == NULL ? ALFUR_ERANGE : ALFUR_OK;
+        case SHT_RELR:
+            iter->relative = relr_type(file->elf_head->e_machine);
+            if (relr_begin(&iter->relr, file, header, &entries) < 0)
+                return zsection_compressed(file, header) ? ALFUR_EDATA : ALFUR_ERANGE;
+            return ALFUR_OK;
+        default:
+            return ALFUR_ETYPE;
+    }
+}
+
+int alfur_next_reloc(Alfur_reloc_iter *iter, Alfur_reloc *reloc) {
+    memset(reloc, 0, sizeof(Alfur_reloc));
+
+    if (iter->kind == SHT_RELR) {
+        if (iter->relr.file == NULL || !relr_next(&iter->relr, &reloc->offset))
+            return 0;
+        reloc->type = iter->relative;
+        return 1;
+    }
+
+    if (iter->next == iter->count)
+        return 0;
+    if (iter->kind == SHT_RELA) {
+        const Elf64_Rela *rela = &iter->relas[iter->next++];
+        reloc->offset = rela->r_offset;
+        reloc->type = ELF64_R_TYPE(rela->r_info);
+        reloc->symbol = ELF64_R_SYM(rela->r_info);
+        reloc->addend = rela->r_addend;
+        reloc->has_addend = 1;
+    } else {
+        const Elf64_Rel *rel = &iter->rels[iter->next++];
+        reloc->offset = rel->r_offset;
+        reloc->type = ELF64_R_TYPE(rel->r_info);
+        reloc->symbol = ELF64_R_SYM(rel->r_info);
+    }
+    return 1;
+}
+
+int alfur_name(int kind, uint64_t value, char *buffer, size_t size) {
+    const char *name;
+    size_t len;
+
+    switch (kind) {
+        case ALFUR_NAME_CLASS:    name = get_class(value); break;
+        case ALFUR_NAME_OSABI:    name = get_osabi(value); break;
+        case ALFUR_NAME_ETYPE:    name = get_etype(value); break;
+        case ALFUR_NAME_MACHINE:  name = get_machine(value); break;
+        case ALFUR_NAME_PTYPE:    name = get_ptype(value); break;
+        case ALFUR_NAME_STYPE:    name = get_stype(value); break;
+        case ALFUR_NAME_SFLAGS:   name = get_sflags(value); break;
+        case ALFUR_NAME_DTAG:     name = get_dtag(value); break;
+        case ALFUR_NAME_SYM_TYPE: name = get_sym_type(value); break;
+        case ALFUR_NAME_SYM_BIND: name = get_sym_bind(value); break;
+        case ALFUR_NAME_SYM_VIS:  name = get_sym_vis(value); break;
+        case ALFUR_NAME_SYM_NDX:  name = get_sym_ndx(value); break;
+        default:                  return ALFUR_ERANGE;
+    }
+
+    if (size == 0)
+        return 0;
+    len = strlen(name);
+    if (len > size - 1)
+        len = size - 1;
+    memcpy(buffer, name, len);
+    buffer[len] = '\0';
+    return len;
+}
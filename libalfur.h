@@ -0,0 +1,120 @@
+#ifndef LIBALFUR_H
+#define LIBALFUR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "elf.h"
+#include "reloc.h"
+
+// The parser of alfur as a library, libalfur.a and libalfur.so.
+//
+// Functions return ALFUR_OK or a negative ALFUR_E* code and neither exit nor
+// print, unless asked to with ALFUR_WARN. Images are independent: any number
+// of them are read at once by as many threads, each image by one thread at a
+// time since tables converted or decompressed on demand are kept in it.
+//
+// Views are pointers into the image, with no copy when the file is mapped and
+// of the host class and byte order; files of another class or byte order have
+// their headers and tables converted once to the Elf64 form. Views stay valid
+// until alfur_close. Iterators allocate nothing and are walked with
+// alfur_next_*, which return 1 with an entry and 0 at the end.
+
+#define ALFUR_OK        0
+#define ALFUR_EIO      -1 // Cannot open or read the file, errno tells why
+#define ALFUR_EFORMAT  -2 // Not an ELF file, or one with unreadable headers
+#define ALFUR_ENOMEM   -3
+#define ALFUR_ERANGE   -4 // Index out of the table, or table out of the file
+#define ALFUR_ETYPE    -5 // Section of another type than asked
+#define ALFUR_ENOENT   -6 // No section of that name
+#define ALFUR_EDATA    -7 // Section that cannot be decompressed
+
+// Flags for alfur_open
+#define ALFUR_PREAD 0x1 // Read with pread instead of mapping the file
+#define ALFUR_WARN  0x2 // Tell on stderr why a section cannot be decompressed
+
+int alfur_open(Elf64_data *file, const char *path, int flags);
+int alfur_open_memory(Elf64_data *file, const void *image, size_t size, int flags);
+int alfur_close(Elf64_data *file);
+const char *alfur_strerror(int error);
+
+// Headers
+const Elf64_Ehdr *alfur_header(Elf64_data *file);
+int alfur_section(Elf64_data *file, uint64_t index, const Elf64_Shdr **section);
+int alfur_segment(Elf64_data *file, uint64_t index, const Elf64_Phdr **segment);
+int alfur_find_section(Elf64_data *file, const char *name, uint64_t *index);
+const char *alfur_section_name(Elf64_data *file, const Elf64_Shdr *section);
+int alfur_section_data(Elf64_data *file, uint64_t index, const char **data, uint64_t *size);
+
+typedef struct {
+    Elf64_data *file;
+    uint64_t next;
+    uint64_t count;
+} Alfur_iter;
+
+int alfur_sections(Alfur_iter *iter, Elf64_data *file);
+int alfur_next_section(Alfur_iter *iter, uint64_t *index, const Elf64_Shdr **section);
+int alfur_segments(Alfur_iter *iter, Elf64_data *file);
+int alfur_next_segment(Alfur_iter *iter, uint64_t *index, const Elf64_Phdr **segment);
+
+// Symbols of a SHT_SYMTAB or SHT_DYNSYM section
+typedef struct {
+    uint64_t index;
+    const Elf64_Sym *sym;
+    const char *name;   // "" when out of the string table
+} Alfur_symbol;
+
+typedef struct {
+    const Elf64_Sym *symbols;
+    uint64_t next;
+    uint64_t count;
+    const char *names;
+    uint64_t names_size;
+} Alfur_symbol_iter;
+
+int alfur_symbols(Alfur_symbol_iter *iter, Elf64_data *file, uint64_t section);
+int alfur_next_symbol(Alfur_symbol_iter *iter, Alfur_symbol *symbol);
+
+// Relocations of a SHT_REL, SHT_RELA or SHT_RELR section, in one form. RELR
+// entries are expanded to the relative relocations they stand for, with the
+// relative type of the machine and no symbol.
+typedef struct {
+    uint64_t offset;
+    uint32_t type;
+    uint32_t symbol;
+    int64_t addend;
+    int has_addend;     // RELA; the addend of REL and RELR is in the image
+} Alfur_reloc;
+
+typedef struct {
+    uint32_t kind;      // sh_type of the section
+    uint32_t relative;  // Type of RELR entries
+    const Elf64_Rel *rels;
+    const Elf64_Rela *relas;
+    uint64_t next;
+    uint64_t count;
+    Relr_iter relr;
+} Alfur_reloc_iter;
+
+int alfur_relocs(Alfur_reloc_iter *iter, Elf64_data *file, uint64_t section);
+int alfur_next_reloc(Alfur_reloc_iter *iter, Alfur_reloc *reloc);
+
+// Names of header values, as the get_* functions of elf.h give them, copied
+// to buffer so they outlive the next call. Returns the length of the name,
+// truncated to size - 1 bytes, or ALFUR_ERANGE for an unknown kind.
+#define ALFUR_NAME_CLASS    0
+#define ALFUR_NAME_OSABI    1
+#define ALFUR_NAME_ETYPE    2
+#define ALFUR_NAME_MACHINE  3
+#define ALFUR_NAME_PTYPE    4
+#define ALFUR_NAME_STYPE    5
+#define ALFUR_NAME_SFLAGS   6
+#define ALFUR_NAME_DTAG     7
+#define ALFUR_NAME_SYM_TYPE 8
+#define ALFUR_NAME_SYM_BIND 9
+#define ALFUR_NAME_SYM_VIS  10
+#define ALFUR_NAME_SYM_NDX  11
+
+int alfur_name(int kind, uint64_t value, char *buffer, size_t size);
+
+#endif
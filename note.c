@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "elf.h"
+#include "note.h"
+#include "output.h"
+#include "reader.h"
+
+static int is_core_owner(Elf64_data *file, const Elf_note *note) {
+    return file->elf_head->e_type == ET_CORE && (note_is(note, "CORE") || note_is(note, "LINUX"));
+}
+
+static const char *get_note_type(Elf64_data *file, const Elf_note *note) {
+    static _Thread_local char s[32];
+
+    if (note_is(note, "GNU")) {
+        switch (note->type) {
+            case NT_GNU_ABI_TAG:              return "NT_GNU_ABI_TAG";
+            case NT_GNU_HWCAP:                return "NT_GNU_HWCAP";
+            case NT_GNU_BUILD_ID:             return "NT_GNU_BUILD_ID";
+            case NT_GNU_GOLD_VERSION:         return "NT_GNU_GOLD_VERSION";
+            case NT_GNU_PROPERTY_TYPE_0:      return "NT_GNU_PROPERTY_TYPE_0";
+        }
+    } else if (note->namesz >= 2 && memcmp(note->name, "GA", 2) == 0) {
+        // Annobin attributes, the name holds the attribute
+        switch (note->type) {
+            case NT_GNU_BUILD_ATTRIBUTE_OPEN: return "NT_GNU_BUILD_ATTRIBUTE_OPEN";
+            case NT_GNU_BUILD_ATTRIBUTE_FUNC: return "NT_GNU_BUILD_ATTRIBUTE_FUNC";
+        }
+    } else if (note_is(note, "stapsdt") && note->type == NT_STAPSDT) {
+        return "NT_STAPSDT";
+    } else if (note_is(note, "Go") && note->type == NT_GO_BUILD_ID) {
+        return "NT_GO_BUILD_ID";
+    } else if (note_is(note, "FDO") && note->type == NT_FDO_PACKAGING_METADATA) {
+        return "NT_FDO_PACKAGING_METADATA";
+    } else if (is_core_owner(file, note)) {
+        switch (note->type) {
+            case NT_PRSTATUS:                 return "NT_PRSTATUS";
+            case NT_FPREGSET:                 return "NT_FPREGSET";
+            case NT_PRPSINFO:                 return "NT_PRPSINFO";
+            case NT_TASKSTRUCT:               return "NT_TASKSTRUCT";
+            case NT_AUXV:                     return "NT_AUXV";
+            case NT_X86_XSTATE:               return "NT_X86_XSTATE";
+            case NT_PRXFPREG:                 return "NT_PRXFPREG";
+            case NT_FILE:                     return "NT_FILE";
+            case NT_SIGINFO:                  return "NT_SIGINFO";
+        }
+    }
+
+    snprintf(s, sizeof(s), "UNK+%#x", note->type);
+    return s;
+}
+
+static const char *get_auxv_type(uint64_t type) {
+    static _Thread_local char s[24];
+
+    switch (type) {
+        case 2:  return "AT_EXECFD";
+        case 3:  return "AT_PHDR";
+        case 4:  return "AT_PHENT";
+        case 5:  return "AT_PHNUM";
+        case 6:  return "AT_PAGESZ";
+        case 7:  return "AT_BASE";
+        case 8:  return "AT_FLAGS";
+        case 9:  return "AT_ENTRY";
+        case 11: return "AT_UID";
+        case 12: return "AT_EUID";
+        case 13: return "AT_GID";
+        case 14: return "AT_EGID";
+        case 15: return "AT_PLATFORM";
+        case 16: return "AT_HWCAP";
+        case 17: return "AT_CLKTCK";
+        case 23: return "AT_SECURE";
+        case 24: return "AT_BASE_PLATFORM";
+        case 25: return "AT_RANDOM";
+        case 26: return "AT_HWCAP2";
+        case 27: return "AT_RSEQ_FEATURE_SIZE";
+        case 28: return "AT_RSEQ_ALIGN";
+        case 31: return "AT_EXECFN";
+        case 32: return "AT_SYSINFO";
+        case 33: return "AT_SYSINFO_EHDR";
+        case 51: return "AT_MINSIGSTKSZ";
+        default:
+            snprintf(s, sizeof(s), "UNK+%#lx", type);
+            return s;
+    }
+}
+
+static const char *abi_tag_os[] = { "Linux", "Hurd", "Solaris", "FreeBSD", "NetBSD", "Syllable", "NaCl" };
+
+static const char *x86_feature_1[] = { "IBT", "SHSTK", "LAM_U48", "LAM_U57" };
+static const char *x86_feature_2[] = {
+    "x86", "x87", "MMX", "XMM", "YMM", "ZMM", "FXSR", "XSAVE", "XSAVEOPT", "XSAVEC", "TMM", "MASK"
+};
+static const char *x86_isa_1[] = { "x86-64-baseline", "x86-64-v2", "x86-64-v3", "x86-64-v4" };
+static const char *aarch64_feature_1[] = { "BTI", "PAC", "GCS" };
+static const char *property_1_needed[] = { "indirect external access" };
+
+// Descriptions are only 4 bytes aligned, values are copied out of them
+static uint32_t desc_word(Elf64_data *file, const uint8_t *p) {
+    uint32_t value;
+
+    memcpy(&value, p, 4);
+    return file->reader->word(value);
+}
+
+static uint64_t desc_address(Elf64_data *file, const uint8_t *p, int size) {
+    uint64_t value;
+
+    if (size == 4)
+        return desc_word(file, p);
+    memcpy(&value, p, 8);
+    return file->reader->xword(value);
+}
+
+static void display_data(Output *out, const uint8_t *data, uint64_t size) {
+    out_str(out, "    Data:");
+    for (uint64_t i = 0; i < size; i++) {
+        out_char(out, ' ');
+        out_hex(out, data[i], 2, OUT_ZERO);
+    }
+    out_char(out, '\n');
+}
+
+// Text of at most size bytes, up to its terminator
+static void display_text(Output *out, const char *title, const uint8_t *text, uint64_t size) {
+    out_str(out, "    ");
+    out_str(out, title);
+    out_str(out, ": ");
+    out_strn(out, (const char*)text, strnlen((const char*)text, size));
+    out_char(out, '\n');
+}
+
+static void display_bits(Output *out, const char *title, uint32_t bits, const char **names, int count) {
+    out_str(out, "    ");
+    out_str(out, title);
+    out_str(out, ":");
+    if (bits == 0)
+        out_str(out, " <None>");
+    for (int i = 0; i < 32; i++) {
+        if (!(bits & (1u << i)))
+            continue;
+        out_str(out, i > 0 && (bits & ((1u << i) - 1)) ? ", " : " ");
+        if (i < count)
+            out_str(out, names[i]);
+        else
+            out_printf(out, "<unknown: %x>", 1u << i);
+    }
+    out_char(out, '\n');
+}
+
+// Properties of NT_GNU_PROPERTY_TYPE_0, each aligned on the size of an address
+static void display_properties(Output *out, Elf64_data *file, const Elf_note *note, int address_size) {
+    const uint8_t *p = note->desc, *end = note->desc + note->descsz;
+    uint16_t machine = file->elf_head->e_machine;
+    int x86 = machine == EM_X86 || machine == EM_X86_64;
+
+    while (end - p >= 8) {
+        uint32_t type = desc_word(file, p);
+        uint32_t size = desc_word(file, p + 4);
+        const uint8_t *data = p + 8;
+
+        if (size > (uint64_t)(end - data)) {
+            out_str(out, "    <corrupt property>\n");
+            return;
+        }
+
+        uint32_t bits = size >= 4 ? desc_word(file, data) : 0;
+
+        if (type == GNU_PROPERTY_STACK_SIZE && size == (uint32_t)address_size) {
+            out_str(out, "    Stack size: 0x");
+            out_hex(out, desc_address(file, data, address_size), 0, 0);
+            out_char(out, '\n');
+        } else if (type == GNU_PROPERTY_NO_COPY_ON_PROTECTED && size == 0) {
+            out_str(out, "    No copy on protected\n");
+        } else if (type == GNU_PROPERTY_1_NEEDED && size == 4) {
+            display_bits(out, "1_needed", bits, property_1_needed, 1);
+        } else if (x86 && type == GNU_PROPERTY_X86_FEATURE_1_AND && size == 4) {
+            display_bits(out, "x86 feature", bits, x86_feature_1, 4);
+        } else if (x86 && type == GNU_PROPERTY_X86_ISA_1_NEEDED && size == 4) {
+            display_bits(out, "x86 ISA needed", bits, x86_isa_1, 4);
+        } else if (x86 && type == GNU_PROPERTY_X86_ISA_1_USED && size == 4) {
+            display_bits(out, "x86 ISA used", bits, x86_isa_1, 4);
+        } else if (x86 && type == GNU_PROPERTY_X86_FEATURE_2_NEEDED && size == 4) {
+            display_bits(out, "x86 feature needed", bits, x86_feature_2, 12);
+        } else if (x86 && type == GNU_PROPERTY_X86_FEATURE_2_USED && size == 4) {
+            display_bits(out, "x86 feature used", bits, x86_feature_2, 12);
+        } else if (machine == EM_ARM64 && type == GNU_PROPERTY_AARCH64_FEATURE_1_AND && size == 4) {
+            display_bits(out, "AArch64 feature", bits, aarch64_feature_1, 3);
+        } else {
+            out_printf(out, "    Property %#x\n", type);
+            display_data(out, data, size);
+        }
+
+        uint64_t padded = ((uint64_t)size + address_size - 1) & ~(uint64_t)(address_size - 1);
+        if (padded > (uint64_t)(end - data))
+            break;
+        p = data + padded;
+    }
+}
+
+// Location, base and semaphore addresses, then the provider, name and
+// arguments of a SystemTap probe
+static void display_stapsdt(Output *out, Elf64_data *file, const Elf_note *note, int address_size) {
+    static const char *titles[] = { "Provider", "Name", "Arguments" };
+    static const char *addresses[] = { "Location", "Base", "Semaphore" };
+    const uint8_t *text = note->desc + 3 * address_size;
+    const uint8_t *end = note->desc + note->descsz;
+
+    if (note->descsz < 3u * address_size)
+        return;
+
+    for (int i = 0; i < 3 && text < end; i++) {
+        size_t len = strnlen((const char*)text, end - text);
+
+        if (i == 2) {
+            out_str(out, "    ");
+            for (int j = 0; j < 3; j++) {
+                out_str(out, j ? ", " : "");
+                out_str(out, addresses[j]);
+                out_str(out, ": 0x");
+                out_hex(out, desc_address(file, note->desc + j * address_size, address_size), 0, 0);
+            }
+            out_char(out, '\n');
+        }
+        display_text(out, titles[i], text, len);
+        text += len + 1;
+    }
+}
+
+// Mapped files of a core: count and page size, count ranges of addresses and
+// the file offset in pages, then count names
+static void display_mapped_files(Output *out, Elf64_data *file, const Elf_note *note, int address_size) {
+    const uint8_t *p = note->desc, *end = note->desc + note->descsz;
+
+    if (note->descsz < 2u * address_size)
+        return;
+
+    uint64_t count = desc_address(file, p, address_size);
+    uint64_t page_size = desc_address(file, p + address_size, address_size);
+
+    p += 2 * address_size;
+    if (count > (uint64_t)(end - p) / (3 * address_size))
+        return;
+
+    const uint8_t *names = p + count * 3 * address_size;
+
+    out_str(out, "    Page size: 0x");
+    out_hex(out, page_size, 0, 0);
+    out_str(out, "\n    Start              End                Page offset\n");
+    for (uint64_t i = 0; i < count && names < end; i++, p += 3 * address_size) {
+        size_t len = strnlen((const char*)names, end - names);
+
+        out_str(out, "    0x");
+        out_hex(out, desc_address(file, p, address_size), 16, OUT_ZERO);
+        out_str(out, " 0x");
+        out_hex(out, desc_address(file, p + address_size, address_size), 16, OUT_ZERO);
+        out_str(out, " 0x");
+        out_hex(out, desc_address(file, p + 2 * address_size, address_size), 16, OUT_ZERO);
+        out_str(out, "\n        ");
+        out_strn(out, (const char*)names, len);
+        out_char(out, '\n');
+        names += len + 1;
+    }
+}
+
+static void display_auxv(Output *out, Elf64_data *file, const Elf_note *note, int address_size) {
+    for (uint64_t at = 0; at + 2 * address_size <= note->descsz; at += 2 * address_size) {
+        uint64_t type = desc_address(file, note->desc + at, address_size);
+
+        if (type == 0)
+            break;
+        out_str(out, "    ");
+        out_pad_str(out, get_auxv_type(type), 20, OUT_LEFT);
+        out_str(out, " 0x");
+        out_hex(out, desc_address(file, note->desc + at + address_size, address_size), 0, 0);
+        out_char(out, '\n');
+    }
+}
+
+// Process state of a core file, in the Linux layouts of 32 and 64 bits
+static void display_core(Output *out, Elf64_data *file, const Elf_note *note, int address_size) {
+    uint16_t signal;
+
+    switch (note->type) {
+        case NT_PRSTATUS:
+            // Signal information, current signal, pending and held signals
+            if (note->descsz < 16u + 2 * address_size + 4)
+                return;
+            memcpy(&signal, note->desc + 12, 2);
+            out_printf(out, "    Signal: %u, PID: %d\n", file->reader->half(signal),
+                       (int32_t)desc_word(file, note->desc + 16 + 2 * address_size));
+            break;
+        case NT_PRPSINFO: {
+            // Process identifiers follow the flags, then the name and arguments
+            int pid_at = address_size == 8 ? 24 : 12;
+            int name_at = address_size == 8 ? 40 : 28;
+
+            if (note->descsz != (address_size == 8 ? 136u : 124u))
+                return;
+            out_printf(out, "    PID: %d\n", (int32_t)desc_word(file, note->desc + pid_at));
+            display_text(out, "Command", note->desc + name_at, 16);
+            display_text(out, "Arguments", note->desc + name_at + 16, 80);
+            break;
+        }
+        case NT_SIGINFO:
+            if (note->descsz < 12)
+                return;
+            out_printf(out, "    Signal: %d, errno: %d, code: %d\n", (int32_t)desc_word(file, note->desc),
+                       (int32_t)desc_word(file, note->desc + 4), (int32_t)desc_word(file, note->desc + 8));
+            break;
+        case NT_AUXV:
+            display_auxv(out, file, note, address_size);
+            break;
+        case NT_FILE:
+            display_mapped_files(out, file, note, address_size);
+            break;
+    }
+}
+
+static void display_description(Output *out, Elf64_data *file, const Elf_note *note) {
+    int address_size = file->elf_head->e_ident[EI_CLASS] == ELFCLASS32 ? 4 : 8;
+
+    if (is_core_owner(file, note)) {
+        // Registers are left out
+        display_core(out, file, note, address_size);
+    } else if (note_is(note, "GNU") && note->type == NT_GNU_BUILD_ID) {
+        out_str(out, "    Build ID: ");
+        for (uint32_t i = 0; i < note->descsz; i++)
+            out_hex(out, note->desc[i], 2, OUT_ZERO);
+        out_char(out, '\n');
+    } else if (note_is(note, "GNU") && note->type == NT_GNU_ABI_TAG && note->descsz >= 16) {
+        uint32_t os = desc_word(file, note->desc);
+
+        out_str(out, "    OS: ");
+        if (os < sizeof(abi_tag_os) / sizeof(*abi_tag_os))
+            out_str(out, abi_tag_os[os]);
+        else
+            out_printf(out, "%u", os);
+        out_printf(out, ", ABI: %u.%u.%u\n", desc_word(file, note->desc + 4),
+                   desc_word(file, note->desc + 8), desc_word(file, note->desc + 12));
+    } else if (note_is(note, "GNU") && note->type == NT_GNU_GOLD_VERSION) {
+        display_text(out, "Version", note->desc, note->descsz);
+    } else if (note_is(note, "GNU") && note->type == NT_GNU_PROPERTY_TYPE_0) {
+        display_properties(out, file, note, address_size);
+    } else if (note_is(note, "stapsdt") && note->type == NT_STAPSDT) {
+        display_stapsdt(out, file, note, address_size);
+    } else if (note_is(note, "Go") && note->type == NT_GO_BUILD_ID) {
+        display_text(out, "Build ID", note->desc, note->descsz);
+    } else if (note_is(note, "FDO") && note->type == NT_FDO_PACKAGING_METADATA) {
+        display_text(out, "Packaging metadata", note->desc, note->descsz);
+    } else if (note->descsz > 0) {
+        display_data(out, note->desc, note->descsz);
+    }
+}
+
+// Decode size bytes of notes at offset, from a section or a segment
+void display_notes(Elf64_data *file, uint64_t offset, uint64_t size, uint64_t align) {
+    Output *out = file->out;
+    Note_iter iter;
+    Elf_note note;
+
+    if (note_begin(&iter, file, offset, size, align) < 0) {
+        fprintf(stderr, "Notes are out of the file\n");
+        return;
+    }
+
+    out_str(out, "Owner                Size        Type\n");
+    while (note_next(&iter, &note)) {
+        size_t len = strnlen(note.name, note.namesz);
+
+        // Annobin names hold binary attributes after "GA"
+        for (size_t i = 0; i < len; i++)
+            out_char(out, note.name[i] >= ' ' && note.name[i] < 0x7f ? note.name[i] : '.');
+        for (size_t i = len; i < 20; i++)
+            out_char(out, ' ');
+        out_str(out, " 0x");
+        out_hex(out, note.descsz, 8, OUT_ZERO);
+        out_str(out, "  ");
+        out_str(out, get_note_type(file, &note));
+        out_char(out, '\n');
+        display_description(out, file, &note);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef NOTE_H
+#define NOTE_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Notes of SHT_NOTE sections and PT_NOTE segments.
+//
+// A note is a header of three words, the owner name and the description,
+// each padded to the alignment of the section or segment: 4 bytes, or 8 for
+// GNU properties. The descriptions known are decoded: build-ids, ABI tags,
+// GNU properties, SystemTap probes, packaging metadata and the process state
+// of core files.
+
+typedef struct {
+    const char *name;    // Owner, namesz bytes with its terminator
+    uint32_t namesz;
+    uint32_t type;
+    const uint8_t *desc;
+    uint32_t descsz;
+} Elf_note;
+
+typedef struct {
+    Elf64_data *file;
+    const char *next;    // Header of the next note
+    const char *end;
+    uint64_t align;      // 4 or 8
+} Note_iter;
+
+int note_begin(Note_iter *iter, Elf64_data *file, uint64_t offset, uint64_t size, uint64_t align);
+int note_next(Note_iter *iter, Elf_note *note);
+int note_is(const Elf_note *note, const char *owner);
+
+void display_notes(Elf64_data *file, uint64_t offset, uint64_t size, uint64_t align);
+
+#endif
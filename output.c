@@ -0,0 +1,203 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "output.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+void out_open_fd(Output *out, int fd) {
+    memset(out, 0, sizeof(Output));
+    out->fd = fd;
+    out->size = OUT_BUFFER_SIZE;
+    out->buf = malloc(out->size);
+    if (out->buf == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+}
+
+void out_open_memory(Output *out) {
+    memset(out, 0, sizeof(Output));
+    out->fd = -1;
+}
+
+// Flush and release out. Returns -1, after telling why, when a write failed.
+int out_close(Output *out) {
+    out_flush(out);
+    free(out->buf);
+    out->buf = NULL;
+    out->len = out->size = 0;
+
+    if (out->error) {
+        fprintf(stderr, "alfur: cannot write the output: %s\n", strerror(out->error));
+        return -1;
+    }
+    return 0;
+}
+
+int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+void out_flush(Output *out) {
+    if (out->fd < 0 || out->len == 0)
+        return;
+
+    if (!out->error && write_all(out->fd, out->buf, out->len) < 0)
+        out->error = errno;
+    out->len = 0;
+}
+
+// Make room for n more bytes
+static void out_reserve(Output *out, size_t n) {
+    if (out->len + n <= out->size)
+        return;
+
+    if (out->fd >= 0) {
+        out_flush(out);
+        if (n <= out->size)
+            return;
+    }
+
+    size_t size = out->size ? out->size : 4096;
+    while (size < out->len + n)
+        size *= 2;
+
+    if ((out->buf = realloc(out->buf, size)) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    out->size = size;
+}
+
+void out_char(Output *out, char c) {
+    if (out->len == out->size)
+        out_reserve(out, 1);
+    out->buf[out->len++] = c;
+}
+
+void out_strn(Output *out, const char *s, size_t n) {
+    // Big chunks skip the buffer altogether
+    if (out->fd >= 0 && n >= out->size) {
+        out_flush(out);
+        if (!out->error && write_all(out->fd, s, n) < 0)
+            out->error = errno;
+        return;
+    }
+
+    out_reserve(out, n);
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+}
+
+void out_str(Output *out, const char *s) {
+    out_strn(out, s, strlen(s));
+}
+
+static void out_padding(Output *out, int n) {
+    if (n <= 0)
+        return;
+    out_reserve(out, n);
+    memset(out->buf + out->len, ' ', n);
+    out->len += n;
+}
+
+// Write digits (the n last bytes of tmp) padded to width
+static void out_digits(Output *out, const char *digits, int n, int width, int flags) {
+    int pad = width - n;
+
+    out_reserve(out, (pad > 0 ? width : n));
+    if (pad > 0 && !(flags & OUT_LEFT)) {
+        memset(out->buf + out->len, flags & OUT_ZERO ? '0' : ' ', pad);
+        out->len += pad;
+    }
+    memcpy(out->buf + out->len, digits, n);
+    out->len += n;
+    if (pad > 0 && (flags & OUT_LEFT))
+        out_padding(out, pad);
+}
+
+void out_pad_str(Output *out, const char *s, int width, int flags) {
+    int n = strlen(s);
+
+    if (!(flags & OUT_LEFT))
+        out_padding(out, width - n);
+    out_strn(out, s, n);
+    if (flags & OUT_LEFT)
+        out_padding(out, width - n);
+}
+
+void out_hex(Output *out, uint64_t value, int width, int flags) {
+    char tmp[16];
+    int n = 0;
+
+    do {
+        tmp[15 - n++] = hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+
+    out_digits(out, tmp + 16 - n, n, width, flags);
+}
+
+void out_udec(Output *out, uint64_t value, int width, int flags) {
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[19 - n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    out_digits(out, tmp + 20 - n, n, width, flags);
+}
+
+void out_dec(Output *out, int64_t value, int width, int flags) {
+    char tmp[21];
+    uint64_t v = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    int n = 0;
+
+    do {
+        tmp[20 - n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    if (value < 0)
+        tmp[20 - n++] = '-';
+
+    out_digits(out, tmp + 21 - n, n, width, flags & ~OUT_ZERO);
+}
+
+void out_printf(Output *out, const char *format, ...) {
+    va_list ap;
+    int n;
+
+    out_reserve(out, 256);
+    va_start(ap, format);
+    n = vsnprintf(out->buf + out->len, out->size - out->len, format, ap);
+    va_end(ap);
+
+    if (n < 0)
+        return;
+
+    if ((size_t)n >= out->size - out->len) {
+        out_reserve(out, n + 1);
+        va_start(ap, format);
+        vsnprintf(out->buf + out->len, out->size - out->len, format, ap);
+        va_end(ap);
+    }
+    out->len += n;
+}
@@ -0,0 +1,39 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buffered output, written with write(2) in bulk instead of going through
+// stdio for each field
+
+#define OUT_BUFFER_SIZE (1 << 20)
+
+// Formatting flags
+#define OUT_LEFT 0x1 // Left justify, like "%-8s"
+#define OUT_ZERO 0x2 // Pad with zeros, like "%08x"
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t size;
+    int fd;    // Flushed to fd when full, or grown in memory when -1
+    int error; // errno of the write that failed, further output is dropped
+} Output;
+
+void out_open_fd(Output *out, int fd);
+void out_open_memory(Output *out);
+int out_close(Output *out);
+void out_flush(Output *out);
+int write_all(int fd, const char *buf, size_t len);
+
+void out_char(Output *out, char c);
+void out_strn(Output *out, const char *s, size_t n);
+void out_str(Output *out, const char *s);
+void out_pad_str(Output *out, const char *s, int width, int flags);
+void out_hex(Output *out, uint64_t value, int width, int flags);
+void out_dec(Output *out, int64_t value, int width, int flags);
+void out_udec(Output *out, uint64_t value, int width, int flags);
+void out_printf(Output *out, const char *format, ...);
+
+#endif
@@ -0,0 +1,79 @@
+#include <string.h>
+
+#include "elf.h"
+#include "reader.h"
+
+static uint16_t swap16(uint16_t v) {
+    return (uint16_t)((v >> 8) | (v << 8));
+}
+
+static uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static uint64_t swap64(uint64_t v) {
+    return ((uint64_t)swap32((uint32_t)v) << 32) | swap32((uint32_t)(v >> 32));
+}
+
+// Host byte order
+#define H(v) (v)
+#define W(v) (v)
+#define X(v) (v)
+#define R_NATIVE 1
+
+#define R_NAME(x) x##_32
+#define R_CLASS 32
+#include "reader_template.h"
+#undef R_NAME
+#undef R_CLASS
+
+#define R_NAME(x) x##_64
+#define R_CLASS 64
+#include "reader_template.h"
+#undef R_NAME
+#undef R_CLASS
+
+#undef H
+#undef W
+#undef X
+#undef R_NATIVE
+
+// Opposite byte order
+#define H(v) swap16(v)
+#define W(v) swap32(v)
+#define X(v) swap64(v)
+#define R_NATIVE 0
+
+#define R_NAME(x) x##_32_swap
+#define R_CLASS 32
+#include "reader_template.h"
+#undef R_NAME
+#undef R_CLASS
+
+#define R_NAME(x) x##_64_swap
+#define R_CLASS 64
+#include "reader_template.h"
+#undef R_NAME
+#undef R_CLASS
+
+#undef H
+#undef W
+#undef X
+#undef R_NATIVE
+
+// Reader for the class and byte order of e_ident, NULL if they are unknown
+const Elf_reader *reader_select(const uint8_t *e_ident) {
+    const uint16_t probe = 1;
+    int host_msb = *(const uint8_t*)&probe == 0;
+    int swap;
+
+    if (e_ident[EI_DATA] != ELFDATA2LSB && e_ident[EI_DATA] != ELFDATA2MSB)
+        return NULL;
+    swap = (e_ident[EI_DATA] == ELFDATA2MSB) != host_msb;
+
+    switch (e_ident[EI_CLASS]) {
+        case ELFCLASS32: return swap ? &reader_32_swap : &reader_32;
+        case ELFCLASS64: return swap ? &reader_64_swap : &reader_64;
+        default:         return NULL;
+    }
+}
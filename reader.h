@@ -0,0 +1,38 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Converts the structures of one ELF class and byte order to the native
+// Elf64 ones. The reader is selected once when a file is opened; native
+// 64-bit files are used in place and never go through it.
+
+// Converts n entries stride bytes apart at src to native Elf64 ones at dst
+typedef void (*Elf_convert)(void *dst, const char *src, uint64_t n, uint64_t stride);
+
+typedef struct Elf_reader {
+    int native; // 64-bit in the host byte order, tables can be used as is
+    uint8_t ehdr_size;
+    uint8_t phdr_size;
+    uint8_t shdr_size;
+    uint8_t sym_size;
+    uint8_t rel_size;
+    uint8_t rela_size;
+    uint8_t dyn_size;
+    void (*ehdr)(Elf64_Ehdr *dst, const char *src);
+    Elf_convert phdrs;
+    Elf_convert shdrs;
+    Elf_convert syms;
+    Elf_convert rels;
+    Elf_convert relas;
+    Elf_convert dyns;
+    uint16_t (*half)(uint16_t v);
+    uint32_t (*word)(uint32_t v);
+    uint64_t (*xword)(uint64_t v);
+} Elf_reader;
+
+const Elf_reader *reader_select(const uint8_t *e_ident);
+
+#endif
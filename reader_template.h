@@ -0,0 +1,196 @@
+// Body of an Elf_reader, included by reader.c once per class and byte order
+// with R_NAME, R_CLASS and the H/W/X (half, word, xword) accessors defined.
+// Entries are copied out before being read, src being wherever the file put
+// them, aligned or not.
+
+#if R_CLASS == 32
+#define R_EHDR Elf32_Ehdr
+#define R_PHDR Elf32_Phdr
+#define R_SHDR Elf32_Shdr
+#define R_SYM  Elf32_Sym
+#define R_REL  Elf32_Rel
+#define R_RELA Elf32_Rela
+#define R_DYN  Elf32_Dyn
+#define A(v)   W(v)
+#else
+#define R_EHDR Elf64_Ehdr
+#define R_PHDR Elf64_Phdr
+#define R_SHDR Elf64_Shdr
+#define R_SYM  Elf64_Sym
+#define R_REL  Elf64_Rel
+#define R_RELA Elf64_Rela
+#define R_DYN  Elf64_Dyn
+#define A(v)   X(v)
+#endif
+
+static void R_NAME(ehdr)(Elf64_Ehdr *d, const char *src) {
+    R_EHDR entry;
+    const R_EHDR *s = &entry;
+
+    memcpy(&entry, src, sizeof(R_EHDR));
+
+    memcpy(d->e_ident, s->e_ident, EI_NIDENT);
+    d->e_type = H(s->e_type);
+    d->e_machine = H(s->e_machine);
+    d->e_version = W(s->e_version);
+    d->e_entry = A(s->e_entry);
+    d->e_phoff = A(s->e_phoff);
+    d->e_shoff = A(s->e_shoff);
+    d->e_flags = W(s->e_flags);
+    d->e_ehsize = H(s->e_ehsize);
+    d->e_phentsize = H(s->e_phentsize);
+    d->e_phnum = H(s->e_phnum);
+    d->e_shentsize = H(s->e_shentsize);
+    d->e_shnum = H(s->e_shnum);
+    d->e_shstrndx = H(s->e_shstrndx);
+}
+
+static void R_NAME(phdrs)(void *dst, const char *src, uint64_t n, uint64_t stride) {
+    Elf64_Phdr *d = dst;
+
+    for (uint64_t i = 0; i < n; i++, d++, src += stride) {
+        R_PHDR entry;
+        const R_PHDR *s = &entry;
+
+        memcpy(&entry, src, sizeof(R_PHDR));
+
+        d->p_type = W(s->p_type);
+        d->p_flags = W(s->p_flags);
+        d->p_offset = A(s->p_offset);
+        d->p_vaddr = A(s->p_vaddr);
+        d->p_paddr = A(s->p_paddr);
+        d->p_filesz = A(s->p_filesz);
+        d->p_memsz = A(s->p_memsz);
+        d->p_align = A(s->p_align);
+    }
+}
+
+static void R_NAME(shdrs)(void *dst, const char *src, uint64_t n, uint64_t stride) {
+    Elf64_Shdr *d = dst;
+
+    for (uint64_t i = 0; i < n; i++, d++, src += stride) {
+        R_SHDR entry;
+        const R_SHDR *s = &entry;
+
+        memcpy(&entry, src, sizeof(R_SHDR));
+
+        d->sh_name = W(s->sh_name);
+        d->sh_type = W(s->sh_type);
+        d->sh_flags = A(s->sh_flags);
+        d->sh_addr = A(s->sh_addr);
+        d->sh_offset = A(s->sh_offset);
+        d->sh_size = A(s->sh_size);
+        d->sh_link = W(s->sh_link);
+        d->sh_info = W(s->sh_info);
+        d->sh_addralign = A(s->sh_addralign);
+        d->sh_entsize = A(s->sh_entsize);
+    }
+}
+
+static void R_NAME(syms)(void *dst, const char *src, uint64_t n, uint64_t stride) {
+    Elf64_Sym *d = dst;
+
+    for (uint64_t i = 0; i < n; i++, d++, src += stride) {
+        R_SYM entry;
+        const R_SYM *s = &entry;
+
+        memcpy(&entry, src, sizeof(R_SYM));
+
+        d->st_name = W(s->st_name);
+        d->st_info = s->st_info;
+        d->st_other = s->st_other;
+        d->st_shndx = H(s->st_shndx);
+        d->st_value = A(s->st_value);
+        d->st_size = A(s->st_size);
+    }
+}
+
+static void R_NAME(rels)(void *dst, const char *src, uint64_t n, uint64_t stride) {
+    Elf64_Rel *d = dst;
+
+    for (uint64_t i = 0; i < n; i++, d++, src += stride) {
+        R_REL entry;
+        const R_REL *s = &entry;
+
+        memcpy(&entry, src, sizeof(R_REL));
+
+        d->r_offset = A(s->r_offset);
+#if R_CLASS == 32
+        d->r_info = ELF64_R_INFO((uint64_t)ELF32_R_SYM(W(s->r_info)), ELF32_R_TYPE(W(s->r_info)));
+#else
+        d->r_info = X(s->r_info);
+#endif
+    }
+}
+
+static void R_NAME(relas)(void *dst, const char *src, uint64_t n, uint64_t stride) {
+    Elf64_Rela *d = dst;
+
+    for (uint64_t i = 0; i < n; i++, d++, src += stride) {
+        R_RELA entry;
+        const R_RELA *s = &entry;
+
+        memcpy(&entry, src, sizeof(R_RELA));
+
+        d->r_offset = A(s->r_offset);
+#if R_CLASS == 32
+        d->r_info = ELF64_R_INFO((uint64_t)ELF32_R_SYM(W(s->r_info)), ELF32_R_TYPE(W(s->r_info)));
+        d->r_addend = (int32_t)W((uint32_t)s->r_addend);
+#else
+        d->r_info = X(s->r_info);
+        d->r_addend = (int64_t)X((uint64_t)s->r_addend);
+#endif
+    }
+}
+
+static void R_NAME(dyns)(void *dst, const char *src, uint64_t n, uint64_t stride) {
+    Elf64_Dyn *d = dst;
+
+    for (uint64_t i = 0; i < n; i++, d++, src += stride) {
+        R_DYN entry;
+        const R_DYN *s = &entry;
+
+        memcpy(&entry, src, sizeof(R_DYN));
+
+#if R_CLASS == 32
+        d->d_tag = (int32_t)W((uint32_t)s->d_tag);
+#else
+        d->d_tag = (int64_t)X((uint64_t)s->d_tag);
+#endif
+        d->d_val = A(s->d_val);
+    }
+}
+
+static uint16_t R_NAME(half)(uint16_t v) { return H(v); }
+static uint32_t R_NAME(word)(uint32_t v) { return W(v); }
+static uint64_t R_NAME(xword)(uint64_t v) { return X(v); }
+
+static const Elf_reader R_NAME(reader) = {
+    .native = R_CLASS == 64 && R_NATIVE,
+    .ehdr_size = sizeof(R_EHDR),
+    .phdr_size = sizeof(R_PHDR),
+    .shdr_size = sizeof(R_SHDR),
+    .sym_size = sizeof(R_SYM),
+    .rel_size = sizeof(R_REL),
+    .rela_size = sizeof(R_RELA),
+    .dyn_size = sizeof(R_DYN),
+    .ehdr = R_NAME(ehdr),
+    .phdrs = R_NAME(phdrs),
+    .shdrs = R_NAME(shdrs),
+    .syms = R_NAME(syms),
+    .rels = R_NAME(rels),
+    .relas = R_NAME(relas),
+    .dyns = R_NAME(dyns),
+    .half = R_NAME(half),
+    .word = R_NAME(word),
+    .xword = R_NAME(xword),
+};
+
+#undef R_EHDR
+#undef R_PHDR
+#undef R_SHDR
+#undef R_SYM
+#undef R_REL
+#undef R_RELA
+#undef R_DYN
+#undef A
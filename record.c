@@ -0,0 +1,323 @@
+#include <string.h>
+
+#include "elf.h"
+#include "output.h"
+#include "record.h"
+
+// NDJSON
+
+static void json_str(Output *out, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    const char *start = s;
+
+    out_char(out, '"');
+    for (; *s; s++) {
+        unsigned char c = *s;
+
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\')
+            continue;
+        out_strn(out, start, s - start);
+        start = s + 1;
+        switch (c) {
+            case '"':  out_str(out, "\\\""); break;
+            case '\\': out_str(out, "\\\\"); break;
+            case '\n': out_str(out, "\\n"); break;
+            case '\t': out_str(out, "\\t"); break;
+            default:
+                out_str(out, "\\u00");
+                out_char(out, hex[c >> 4]);
+                out_char(out, hex[c & 0xf]);
+        }
+    }
+    out_strn(out, start, s - start);
+    out_char(out, '"');
+}
+
+static void json_key(Output *out, const char *key) {
+    out_str(out, ",\"");
+    out_str(out, key);
+    out_str(out, "\":");
+}
+
+static void json_key_str(Output *out, const char *key, const char *value) {
+    json_key(out, key);
+    json_str(out, value);
+}
+
+static void json_key_u(Output *out, const char *key, uint64_t value) {
+    json_key(out, key);
+    out_udec(out, value, 0, 0);
+}
+
+static void json_start(Output *out, const char *record, const char *path) {
+    out_str(out, "{\"record\":\"");
+    out_str(out, record);
+    out_char(out, '"');
+    json_key_str(out, "file", path);
+}
+
+static void json_end(Output *out) {
+    out_str(out, "}\n");
+}
+
+static void ndjson_file(Output *out, const char *path) {
+    json_start(out, "file", path);
+    json_end(out);
+}
+
+static void ndjson_header(Output *out, const char *path, Elf64_Ehdr *head) {
+    json_start(out, "header", path);
+    json_key_str(out, "class", get_class(head->e_ident[EI_CLASS]));
+    json_key_str(out, "data", head->e_ident[EI_DATA] == ELFDATA2MSB ? "MSB" : "LSB");
+    json_key_str(out, "osabi", get_osabi(head->e_ident[EI_OSABI]));
+    json_key_u(out, "abi_version", head->e_ident[EI_ABIVERSION]);
+    json_key_str(out, "type", get_etype(head->e_type));
+    json_key_str(out, "machine", get_machine(head->e_machine));
+    json_key_u(out, "version", head->e_version);
+    json_key_u(out, "entry", head->e_entry);
+    json_key_u(out, "phoff", head->e_phoff);
+    json_key_u(out, "shoff", head->e_shoff);
+    json_key_u(out, "flags", head->e_flags);
+    json_key_u(out, "ehsize", head->e_ehsize);
+    json_key_u(out, "phentsize", head->e_phentsize);
+    json_key_u(out, "phnum", head->e_phnum);
+    json_key_u(out, "shentsize", head->e_shentsize);
+    json_key_u(out, "shnum", head->e_shnum);
+    json_key_u(out, "shstrndx", head->e_shstrndx);
+    json_end(out);
+}
+
+static void ndjson_segment(Output *out, const char *path, uint64_t index, Elf64_Phdr *segment) {
+    json_start(out, "segment", path);
+    json_key_u(out, "index", index);
+    json_key_str(out, "type", get_ptype(segment->p_type));
+    json_key_u(out, "flags", segment->p_flags);
+    json_key_u(out, "offset", segment->p_offset);
+    json_key_u(out, "vaddr", segment->p_vaddr);
+    json_key_u(out, "paddr", segment->p_paddr);
+    json_key_u(out, "filesz", segment->p_filesz);
+    json_key_u(out, "memsz", segment->p_memsz);
+    json_key_u(out, "align", segment->p_align);
+    json_end(out);
+}
+
+static void ndjson_section(Output *out, const char *path, uint64_t index, Elf64_Shdr *section,
+                           const char *name) {
+    json_start(out, "section", path);
+    json_key_u(out, "index", index);
+    json_key_str(out, "name", name);
+    json_key_str(out, "type", get_stype(section->sh_type));
+    json_key_u(out, "flags", section->sh_flags);
+    json_key_u(out, "addr", section->sh_addr);
+    json_key_u(out, "offset", section->sh_offset);
+    json_key_u(out, "size", section->sh_size);
+    json_key_u(out, "link", section->sh_link);
+    json_key_u(out, "info", section->sh_info);
+    json_key_u(out, "addralign", section->sh_addralign);
+    json_key_u(out, "entsize", section->sh_entsize);
+    json_end(out);
+}
+
+static void ndjson_symbol(Output *out, const char *path, uint64_t table, uint64_t index,
+                          Elf64_Sym *sym, const char *name) {
+    json_start(out, "symbol", path);
+    json_key_u(out, "table", table);
+    json_key_u(out, "index", index);
+    json_key_str(out, "name", name);
+    json_key_u(out, "value", sym->st_value);
+    json_key_u(out, "size", sym->st_size);
+    json_key_str(out, "type", get_sym_type(sym->st_info));
+    json_key_str(out, "bind", get_sym_bind(sym->st_info));
+    json_key_str(out, "visibility", get_sym_vis(sym->st_other));
+    json_key_u(out, "shndx", sym->st_shndx);
+    json_end(out);
+}
+
+static void ndjson_reloc(Output *out, const char *path, uint64_t table, uint64_t index,
+                         Elf64_Rela *rel, int has_addend, const char *symbol) {
+    json_start(out, "relocation", path);
+    json_key_u(out, "table", table);
+    json_key_u(out, "index", index);
+    json_key_u(out, "offset", rel->r_offset);
+    json_key_u(out, "type", ELF64_R_TYPE(rel->r_info));
+    json_key_u(out, "sym", ELF64_R_SYM(rel->r_info));
+    json_key_str(out, "symbol", symbol);
+    if (has_addend) {
+        json_key(out, "addend");
+        out_dec(out, rel->r_addend, 0, 0);
+    }
+    json_end(out);
+}
+
+const Record_format record_ndjson = {
+    .file = ndjson_file,
+    .header = ndjson_header,
+    .segment = ndjson_segment,
+    .section = ndjson_section,
+    .symbol = ndjson_symbol,
+    .reloc = ndjson_reloc,
+};
+
+// Binary records
+
+static void put8(Output *out, uint8_t v) {
+    out_char(out, (char)v);
+}
+
+static void put16(Output *out, uint16_t v) {
+    char b[2] = { (char)v, (char)(v >> 8) };
+    out_strn(out, b, 2);
+}
+
+static void put32(Output *out, uint32_t v) {
+    char b[4];
+
+    for (int i = 0; i < 4; i++, v >>= 8)
+        b[i] = (char)v;
+    out_strn(out, b, 4);
+}
+
+static void put64(Output *out, uint64_t v) {
+    char b[8];
+
+    for (int i = 0; i < 8; i++, v >>= 8)
+        b[i] = (char)v;
+    out_strn(out, b, 8);
+}
+
+// Start a record of fixed bytes of fields followed by string, if not NULL.
+// Returns the padding to write after it with bin_end.
+static uint32_t bin_start(Output *out, uint16_t kind, uint32_t fixed, const char *string,
+                          size_t *length) {
+    uint32_t size = 8 + fixed;
+
+    if (string != NULL) {
+        *length = strlen(string);
+        size += 4 + *length;
+    }
+    uint32_t padded = (size + 7) & ~7u;
+
+    put16(out, kind);
+    put16(out, 0);
+    put32(out, padded);
+    return padded - size;
+}
+
+static void bin_end(Output *out, const char *string, size_t length, uint32_t padding) {
+    static const char zeros[8];
+
+    if (string != NULL) {
+        put32(out, length);
+        out_strn(out, string, length);
+    }
+    out_strn(out, zeros, padding);
+}
+
+static void bin_file(Output *out, const char *path) {
+    size_t length;
+    uint32_t padding = bin_start(out, REC_FILE, 4, path, &length);
+
+    put32(out, REC_VERSION);
+    bin_end(out, path, length, padding);
+}
+
+static void bin_header(Output *out, const char *path, Elf64_Ehdr *head) {
+    uint32_t padding = bin_start(out, REC_HEADER, 64, NULL, NULL);
+
+    out_strn(out, (const char*)head->e_ident, EI_NIDENT);
+    put16(out, head->e_type);
+    put16(out, head->e_machine);
+    put32(out, head->e_version);
+    put64(out, head->e_entry);
+    put64(out, head->e_phoff);
+    put64(out, head->e_shoff);
+    put32(out, head->e_flags);
+    put16(out, head->e_ehsize);
+    put16(out, head->e_phentsize);
+    put16(out, head->e_phnum);
+    put16(out, head->e_shentsize);
+    put16(out, head->e_shnum);
+    put16(out, head->e_shstrndx);
+    bin_end(out, NULL, 0, padding);
+}
+
+static void bin_segment(Output *out, const char *path, uint64_t index, Elf64_Phdr *segment) {
+    uint32_t padding = bin_start(out, REC_SEGMENT, 64, NULL, NULL);
+
+    put32(out, index);
+    put32(out, segment->p_type);
+    put32(out, segment->p_flags);
+    put32(out, 0);
+    put64(out, segment->p_offset);
+    put64(out, segment->p_vaddr);
+    put64(out, segment->p_paddr);
+    put64(out, segment->p_filesz);
+    put64(out, segment->p_memsz);
+    put64(out, segment->p_align);
+    bin_end(out, NULL, 0, padding);
+}
+
+static void bin_section(Output *out, const char *path, uint64_t index, Elf64_Shdr *section,
+                        const char *name) {
+    size_t length;
+    uint32_t padding = bin_start(out, REC_SECTION, 64, name, &length);
+
+    put32(out, index);
+    put32(out, section->sh_type);
+    put64(out, section->sh_flags);
+    put64(out, section->sh_addr);
+    put64(out, section->sh_offset);
+    put64(out, section->sh_size);
+    put32(out, section->sh_link);
+    put32(out, section->sh_info);
+    put64(out, section->sh_addralign);
+    put64(out, section->sh_entsize);
+    bin_end(out, name, length, padding);
+}
+
+static void bin_symbol(Output *out, const char *path, uint64_t table, uint64_t index,
+                       Elf64_Sym *sym, const char *name) {
+    size_t length;
+    uint32_t padding = bin_start(out, REC_SYMBOL, 28, name, &length);
+
+    put32(out, table);
+    put32(out, index);
+    put64(out, sym->st_value);
+    put64(out, sym->st_size);
+    put8(out, sym->st_info);
+    put8(out, sym->st_other);
+    put16(out, sym->st_shndx);
+    bin_end(out, name, length, padding);
+}
+
+static void bin_reloc(Output *out, const char *path, uint64_t table, uint64_t index,
+                      Elf64_Rela *rel, int has_addend, const char *symbol) {
+    size_t length;
+    uint32_t padding = bin_start(out, REC_RELOC, 36, symbol, &length);
+
+    put32(out, table);
+    put32(out, index);
+    put64(out, rel->r_offset);
+    put64(out, rel->r_info);
+    put64(out, has_addend ? (uint64_t)rel->r_addend : 0);
+    put32(out, has_addend);
+    bin_end(out, symbol, length, padding);
+}
+
+const Record_format record_bin = {
+    .file = bin_file,
+    .header = bin_header,
+    .segment = bin_segment,
+    .section = bin_section,
+    .symbol = bin_symbol,
+    .reloc = bin_reloc,
+};
+
+// Format named by --format, NULL if there is none by that name
+const Record_format *record_format(const char *name) {
+    if (strcmp(name, "ndjson") == 0)
+        return &record_ndjson;
+    if (strcmp(name, "bin") == 0)
+        return &record_bin;
+    return NULL;
+}
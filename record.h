@@ -0,0 +1,71 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+
+#include "elf.h"
+#include "output.h"
+
+// Machine readable dumps: one record per file, header, segment, section,
+// symbol and relocation, written as soon as it is decoded.
+//
+// --format=ndjson writes one JSON object per line, with the kind of record in
+// "record" and the file it comes from in "file". Strings are written byte for
+// byte, those of 0x80 and up escaped as \u0080 to \u00ff, so that names which
+// are not UTF-8 still give valid JSON and can be read back exactly.
+//
+// --format=bin writes little-endian records aligned on 8 bytes, each starting
+// with a u16 kind, a u16 zero and a u32 size of the whole record, padding
+// included. Fixed size fields come first, in the order of the Elf64
+// structures, then the string of the record if any as a u32 length and its
+// bytes. Records until the next REC_FILE belong to the same file.
+//
+//   REC_FILE    u32 version, string path
+//   REC_HEADER  ident[16], u16 type, u16 machine, u32 version, u64 entry,
+//               u64 phoff, u64 shoff, u32 flags, u16 ehsize, u16 phentsize,
+//               u16 phnum, u16 shentsize, u16 shnum, u16 shstrndx
+//   REC_SEGMENT u32 index, u32 type, u32 flags, u32 zero, u64 offset,
+//               u64 vaddr, u64 paddr, u64 filesz, u64 memsz, u64 align
+//   REC_SECTION u32 index, u32 type, u64 flags, u64 addr, u64 offset,
+//               u64 size, u32 link, u32 info, u64 addralign, u64 entsize,
+//               string name
+//   REC_SYMBOL  u32 table, u32 index, u64 value, u64 size, u8 info, u8 other,
+//               u16 shndx, string name
+//   REC_RELOC   u32 table, u32 index, u64 offset, u64 info, i64 addend,
+//               u32 has addend, string symbol
+//
+// RELR tables give one relocation record per address they relocate, indexed
+// in that order, of the relative type of the machine with symbol 0 and no
+// addend.
+//
+// ELF32 and big-endian files are written with their values widened to the
+// Elf64 host form, see reader.h.
+
+#define REC_VERSION 1
+
+// Record kinds of --format=bin
+#define REC_FILE    1
+#define REC_HEADER  2
+#define REC_SEGMENT 3
+#define REC_SECTION 4
+#define REC_SYMBOL  5
+#define REC_RELOC   6
+
+typedef struct {
+    void (*file)(Output *out, const char *path);
+    void (*header)(Output *out, const char *path, Elf64_Ehdr *head);
+    void (*segment)(Output *out, const char *path, uint64_t index, Elf64_Phdr *segment);
+    void (*section)(Output *out, const char *path, uint64_t index, Elf64_Shdr *section,
+                    const char *name);
+    void (*symbol)(Output *out, const char *path, uint64_t table, uint64_t index,
+                   Elf64_Sym *sym, const char *name);
+    void (*reloc)(Output *out, const char *path, uint64_t table, uint64_t index,
+                  Elf64_Rela *rel, int has_addend, const char *symbol);
+} Record_format;
+
+extern const Record_format record_ndjson;
+extern const Record_format record_bin;
+
+const Record_format *record_format(const char *name);
+
+#endif
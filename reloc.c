@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "output.h"
+#include "reloc.h"
+
+// Kinds of relocation tables in the summary
+#define KIND_REL  1
+#define KIND_RELA 2
+#define KIND_RELR 3
+
+static const char *kind_names[] = { "", "REL", "RELA", "RELR" };
+
+// Allocated section covering an address range, to find relocation targets
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint32_t index;
+} Target;
+
+// Relocations of one kind and type applied to one section. Keys are built by
+// summary_key and never 0, which marks empty slots.
+typedef struct {
+    uint64_t key;
+    uint64_t count;
+} Summary_slot;
+
+typedef struct {
+    Summary_slot *slots;
+    uint64_t size; // Power of 2
+    uint64_t used;
+    Target *targets;
+    uint64_t target_count;
+} Summary;
+
+static uint64_t summary_key(int kind, uint32_t type, uint64_t section) {
+    return (uint64_t)kind << 62 | section << 32 | type;
+}
+
+static uint64_t hash_key(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static int summary_grow(Summary *summary) {
+    uint64_t size = summary->size ? summary->size * 2 : 1024;
+    Summary_slot *slots = calloc(size, sizeof(Summary_slot));
+
+    if (slots == NULL)
+        return -1;
+    for (uint64_t i = 0; i < summary->size; i++) {
+        Summary_slot *old = &summary->slots[i];
+        if (old->key == 0)
+            continue;
+        uint64_t j = hash_key(old->key) & (size - 1);
+        while (slots[j].key != 0)
+            j = (j + 1) & (size - 1);
+        slots[j] = *old;
+    }
+    free(summary->slots);
+    summary->slots = slots;
+    summary->size = size;
+    return 0;
+}
+
+static int summary_add(Summary *summary, uint64_t key) {
+    if (summary->used * 2 >= summary->size && summary_grow(summary) < 0)
+        return -1;
+
+    uint64_t i = hash_key(key) & (summary->size - 1);
+    while (summary->slots[i].key != key && summary->slots[i].key != 0)
+        i = (i + 1) & (summary->size - 1);
+    if (summary->slots[i].key == 0) {
+        summary->slots[i].key = key;
+        summary->used++;
+    }
+    summary->slots[i].count++;
+    return 0;
+}
+
+static int compare_targets(const void *a, const void *b) {
+    const Target *x = a, *y = b;
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+// Allocated sections by address. TLS sections without contents are left out,
+// they overlap the ones that follow.
+static int build_targets(Summary *summary, Elf64_data *file) {
+    summary->targets = malloc((file->elf_head->e_shnum + 1) * sizeof(Target));
+    if (summary->targets == NULL)
+        return -1;
+
+    for (int i = 1; i < file->elf_head->e_shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+
+        if (!(section->sh_flags & SHF_ALLOC) || section->sh_size == 0
+            || (section->sh_type == SHT_NOBITS && (section->sh_flags & SHF_TLS)))
+            continue;
+        Target *target = &summary->targets[summary->target_count++];
+        target->start = section->sh_addr;
+        target->end = section->sh_addr + section->sh_size;
+        target->index = i;
+    }
+    qsort(summary->targets, summary->target_count, sizeof(Target), compare_targets);
+    return 0;
+}
+
+// Index + 1 of the section holding address, 0 if none does
+static uint64_t find_target(Summary *summary, uint64_t address) {
+    uint64_t low = 0, high = summary->target_count;
+
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (summary->targets[mid].start <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low > 0 && address < summary->targets[low - 1].end)
+        return summary->targets[low - 1].index + 1;
+    return 0;
+}
+
+// Section relocated by a table: the one of sh_info in relocatable files,
+// else 0 to look it up by address
+static uint64_t table_target(Elf64_data *file, Elf64_Shdr *section) {
+    if (file->elf_head->e_type == ET_REL && section->sh_info > 0
+        && section->sh_info < file->elf_head->e_shnum)
+        return section->sh_info + 1;
+    return 0;
+}
+
+// Add the relocations of a table to the summary. Returns the number of
+// relocations, which is the number of entries but for RELR.
+static uint64_t summarize_table(Summary *summary, Elf64_data *file, Elf64_Shdr *section,
+                                int kind, uint64_t *entries) {
+    uint64_t fixed = table_target(file, section);
+    uint64_t relocations = 0;
+
+    *entries = 0;
+    if (kind == KIND_RELR) {
+        uint32_t type = relr_type(file->elf_head->e_machine);
+        Relr_iter iter;
+        uint64_t address;
+
+        if (relr_begin(&iter, file, section, entries) < 0)
+            return 0;
+        while (relr_next(&iter, &address)) {
+            summary_add(summary, summary_key(kind, type, fixed ? fixed : find_target(summary, address)));
+            relocations++;
+        }
+        return relocations;
+    }
+
+    if (section->sh_entsize == 0)
+        return 0;
+
+    if (kind == KIND_RELA) {
+        Elf64_Rela *rela = elf_table(file, section, ELF_T_RELA, entries);
+        for (uint64_t i = 0; rela != NULL && i < *entries; i++, rela++) {
+            uint64_t target = fixed ? fixed : find_target(summary, rela->r_offset);
+            summary_add(summary, summary_key(kind, ELF64_R_TYPE(rela->r_info), target));
+        }
+    } else {
+        Elf64_Rel *rel = elf_table(file, section, ELF_T_REL, entries);
+        for (uint64_t i = 0; rel != NULL && i < *entries; i++, rel++) {
+            uint64_t target = fixed ? fixed : find_target(summary, rel->r_offset);
+            summary_add(summary, summary_key(kind, ELF64_R_TYPE(rel->r_info), target));
+        }
+    }
+    return *entries;
+}
+
+static int compare_slots(const void *a, const void *b) {
+    const Summary_slot *x = a, *y = b;
+
+    if (x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int table_kind(uint32_t type) {
+    switch (type) {
+        case SHT_REL:  return KIND_REL;
+        case SHT_RELA: return KIND_RELA;
+        case SHT_RELR: return KIND_RELR;
+        default:       return 0;
+    }
+}
+
+// Relocations of every REL, RELA and RELR table, per table, then by kind,
+// type and section they apply to, most frequent first
+void display_reloc_summary(Elf64_data *file, const char *elf_path) {
+    Output *out = file->out;
+    Summary summary = { 0 };
+    uint64_t total_entries = 0, total_relocations = 0, total_bytes = 0;
+
+    out_printf(out, "== Relocation summary of %s ==\n\n", elf_path);
+
+    if (build_targets(&summary, file) < 0) {
+        fprintf(stderr, "Failed indexing %s\n", elf_path);
+        return;
+    }
+
+    out_str(out, "Table                    Kind      Entries  Relocations        Bytes\n");
+    for (int i = 0; i < file->elf_head->e_shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+        int kind = table_kind(section->sh_type);
+        uint64_t entries, relocations;
+
+        if (kind == 0)
+            continue;
+        relocations = summarize_table(&summary, file, section, kind, &entries);
+        out_printf(out, "%-24s %-4s %12lu %12lu %12lu\n",
+                   elf_section_name(file, section), kind_names[kind],
+                   entries, relocations, section->sh_size);
+        total_entries += entries;
+        total_relocations += relocations;
+        total_bytes += section->sh_size;
+    }
+    out_printf(out, "%-24s %-4s %12lu %12lu %12lu\n", "Total", "", total_entries,
+               total_relocations, total_bytes);
+
+    // Used slots first, then by count
+    Summary_slot *slots = summary.slots;
+    uint64_t n = 0;
+    for (uint64_t i = 0; i < summary.size; i++)
+        if (slots[i].key != 0)
+            slots[n++] = slots[i];
+    qsort(slots, n, sizeof(Summary_slot), compare_slots);
+
+    if (n > 0)
+        out_str(out, "\n Relocations Kind        Type  Section\n");
+    for (uint64_t i = 0; i < n; i++) {
+        int kind = slots[i].key >> 62;
+        uint64_t target = (slots[i].key >> 32) & 0x3fffffff;
+
+        out_printf(out, "%12lu %-4s %11lu  %s\n", slots[i].count, kind_names[kind],
+                   slots[i].key & 0xffffffff,
+                   target ? elf_section_name(file, get_section(file, target - 1))
+                          : "[none]");
+    }
+
+    free(summary.slots);
+    free(summary.targets);
+}
@@ -0,0 +1,31 @@
+#ifndef RELOC_H
+#define RELOC_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// SHT_RELR tables and the relocation summary of --reloc-summary.
+//
+// A RELR table packs relative relocations as a list of words: an even word
+// is the address of a relocation, and the next odd words are bitmaps of the
+// following words to relocate, 63 (or 31) per bitmap, bit 0 aside. The
+// addresses are expanded one by one while the table is walked.
+
+typedef struct {
+    Elf64_data *file;
+    const char *next;     // Next entry of the table
+    const char *end;
+    uint64_t entry_size;  // 8 or 4
+    uint64_t base;        // Address of the word of bit 1 of the next bitmap
+    uint64_t bitmap;      // Bits left of the current bitmap, shifted to bit 0
+    uint64_t address;     // Address of the word of bit 0 of bitmap
+} Relr_iter;
+
+int relr_begin(Relr_iter *iter, Elf64_data *file, Elf64_Shdr *section, uint64_t *entries);
+int relr_next(Relr_iter *iter, uint64_t *address);
+uint32_t relr_type(uint16_t machine);
+
+void display_reloc_summary(Elf64_data *file, const char *elf_path);
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "output.h"
+#include "segmap.h"
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint32_t index;
+} Interval;
+
+static int compare_intervals(const void *a, const void *b) {
+    const Interval *x = a, *y = b;
+
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+    return 0;
+}
+
+// .tbss takes room in the TLS segment only, not in the ones around it
+static int is_tbss(Elf64_Shdr *section) {
+    return section->sh_type == SHT_NOBITS && (section->sh_flags & SHF_TLS);
+}
+
+static int in_segment(Interval *section, Elf64_Shdr *header, Elf64_Phdr *segment) {
+    uint64_t end = segment->p_vaddr + segment->p_memsz;
+
+    // The TLS template holds TLS sections only
+    if ((segment->p_type == PT_TLS) != ((header->sh_flags & SHF_TLS) != 0)
+        && (segment->p_type == PT_TLS || is_tbss(header)))
+        return 0;
+    if (section->start < segment->p_vaddr || section->end > end)
+        return 0;
+    // Empty sections at the very end belong to the next segment
+    if (section->end == section->start && section->start == end)
+        return 0;
+
+    // Sections with contents must also be in its part of the file
+    if (header->sh_type == SHT_NOBITS)
+        return 1;
+    uint64_t offset = header->sh_offset - segment->p_offset;
+    return header->sh_offset >= segment->p_offset && offset <= segment->p_filesz
+        && header->sh_size <= segment->p_filesz - offset
+        && (header->sh_size > 0 || offset < segment->p_filesz);
+}
+
+// First interval of the n sorted ones starting at or after addr
+static uint64_t lower_bound(Interval *intervals, uint64_t n, uint64_t addr) {
+    uint64_t low = 0, high = n;
+
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (intervals[mid].start < addr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static int append(uint32_t **array, uint64_t *count, uint64_t *size, uint32_t value) {
+    if (*count == *size) {
+        uint64_t new_size = *size ? *size * 2 : 64;
+        uint32_t *grown = realloc(*array, new_size * sizeof(uint32_t));
+
+        if (grown == NULL)
+            return -1;
+        *array = grown;
+        *size = new_size;
+    }
+    (*array)[(*count)++] = value;
+    return 0;
+}
+
+// Flag the allocated sections that are not whole in a PT_LOAD, sweeping the
+// sorted sections and loads together
+static int check_loads(Seg_map *map, Elf64_data *file, Interval *sections, uint64_t n) {
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    Interval *loads = malloc((file->elf_head->e_phnum + 1) * sizeof(Interval));
+    uint64_t load_num = 0, straddling_size = 0, outside_size = 0;
+
+    if (loads == NULL)
+        return -1;
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++)
+        if (segment->p_type == PT_LOAD && segment->p_memsz > 0)
+            loads[load_num++] = (Interval){ segment->p_vaddr, segment->p_vaddr + segment->p_memsz, i };
+    qsort(loads, load_num, sizeof(Interval), compare_intervals);
+
+    // Objects have no segments at all, there is nothing to check
+    uint64_t current = 0;
+    int status = 0;
+    for (uint64_t i = 0; i < n && load_num > 0 && status == 0; i++) {
+        Interval *section = &sections[i];
+        uint64_t end = section->end > section->start ? section->end : section->start + 1;
+        int found = 0; // 1 when whole in a load, -1 when partly
+
+        if (is_tbss(get_section(file, section->index)))
+            continue;
+        while (current < load_num && loads[current].end <= section->start)
+            current++;
+
+        for (uint64_t j = current; j < load_num && loads[j].start < end; j++) {
+            if (section->start >= loads[j].start && section->end <= loads[j].end) {
+                found = 1;
+                break;
+            }
+            if (section->start < loads[j].end)
+                found = -1;
+        }
+
+        if (found == -1)
+            status = append(&map->straddling, &map->straddling_count, &straddling_size, section->index);
+        else if (found == 0)
+            status = append(&map->outside, &map->outside_count, &outside_size, section->index);
+    }
+
+    free(loads);
+    return status;
+}
+
+int segmap_build(Seg_map *map, Elf64_data *file) {
+    uint16_t phnum = file->elf_head->e_phnum;
+    Interval *sections = malloc((file->elf_head->e_shnum + 1) * sizeof(Interval));
+    uint64_t n = 0, count = 0, size = 0;
+
+    memset(map, 0, sizeof(Seg_map));
+    map->first = malloc((phnum + 1) * sizeof(uint64_t));
+    if (sections == NULL || map->first == NULL) {
+        free(sections);
+        segmap_free(map);
+        return -1;
+    }
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+        if (section->sh_flags & SHF_ALLOC)
+            sections[n++] = (Interval){ section->sh_addr, section->sh_addr + section->sh_size, i };
+    }
+    qsort(sections, n, sizeof(Interval), compare_intervals);
+
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    for (int i = 0; i < phnum; i++, segment++) {
+        uint64_t end = segment->p_vaddr + segment->p_memsz;
+
+        map->first[i] = count;
+        if (segment->p_memsz == 0)
+            continue;
+        // Only the sections starting in the segment can be in it
+        for (uint64_t j = lower_bound(sections, n, segment->p_vaddr); j < n && sections[j].start < end; j++) {
+            if (in_segment(&sections[j], get_section(file, sections[j].index), segment)
+                && append(&map->sections, &count, &size, sections[j].index) < 0) {
+                free(sections);
+                segmap_free(map);
+                return -1;
+            }
+        }
+    }
+    map->first[phnum] = count;
+
+    int status = check_loads(map, file, sections, n);
+    free(sections);
+    if (status < 0)
+        segmap_free(map);
+    return status;
+}
+
+void segmap_free(Seg_map *map) {
+    free(map->sections);
+    free(map->first);
+    free(map->straddling);
+    free(map->outside);
+    memset(map, 0, sizeof(Seg_map));
+}
+
+static void display_names(Elf64_data *file, uint32_t *sections, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        out_char(file->out, ' ');
+        out_str(file->out, elf_section_name(file, get_section(file, sections[i])));
+    }
+    out_char(file->out, '\n');
+}
+
+void display_segmap(Elf64_data *file) {
+    Output *out = file->out;
+    Seg_map map;
+
+    if (file->elf_head->e_phnum == 0 || file->elf_head->e_shnum == 0)
+        return;
+    if (segmap_build(&map, file) < 0) {
+        fprintf(stderr, "Failed mapping the sections to segments\n");
+        return;
+    }
+
+    out_str(out, "\n== Segment to sections mapping ==\n\n");
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    for (int i = 0; i < file->elf_head->e_phnum; i++, segment++) {
+        out_str(out, "  [");
+        out_dec(out, i, 2, 0);
+        out_str(out, "] ");
+        out_pad_str(out, get_ptype(segment->p_type), 12, OUT_LEFT);
+        display_names(file, map.sections + map.first[i], map.first[i + 1] - map.first[i]);
+    }
+
+    if (map.straddling_count > 0) {
+        out_str(out, "\n  Straddling a LOAD segment:");
+        display_names(file, map.straddling, map.straddling_count);
+    }
+    if (map.outside_count > 0) {
+        out_str(out, "\n  Outside of any LOAD segment:");
+        display_names(file, map.outside, map.outside_count);
+    }
+
+    segmap_free(&map);
+}
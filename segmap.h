@@ -0,0 +1,25 @@
+#ifndef SEGMAP_H
+#define SEGMAP_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Sections of each segment, found by sorting the sections by address once and
+// searching each segment's range in them, so objects with many sections do not
+// pay for every segment and section pair.
+
+typedef struct {
+    uint32_t *sections;   // Section indices grouped by segment, by address
+    uint64_t *first;      // Start of each segment in sections, phnum + 1 of them
+    uint32_t *straddling; // Allocated sections partly in a PT_LOAD
+    uint64_t straddling_count;
+    uint32_t *outside;    // Allocated sections in no PT_LOAD at all
+    uint64_t outside_count;
+} Seg_map;
+
+int segmap_build(Seg_map *map, Elf64_data *file);
+void segmap_free(Seg_map *map);
+void display_segmap(Elf64_data *file);
+
+#endif
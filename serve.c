@@ -0,0 +1,526 @@
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "buildid.h"
+#include "dwarf.h"
+#include "elf.h"
+#include "libalfur.h"
+#include "output.h"
+#include "serve.h"
+#include "symindex.h"
+
+// An image of the cache, with what answering takes
+typedef struct Serve_image {
+    char *path;
+    uint64_t dev, ino, size;  // Of the file when it was opened
+    int64_t mtime_sec, mtime_nsec;
+    const uint8_t *build_id;
+    uint32_t build_id_len;
+    Elf64_data file;
+    Sym_index symbols;
+    int has_symbols;
+    Line_table lines;
+    pthread_mutex_t lock;     // Held while answering, the indexes keep state
+    int users;                // Requests holding it, it is released at 0
+    int cached;               // Still in the cache
+    struct Serve_image *prev, *next;  // Most recently used first
+    struct Serve_image *bucket_next;
+    struct Serve_image *id_next;      // In the buckets by build-id
+} Serve_image;
+
+// The build-id index of --cache, walked without the lock by the requests
+// holding it
+typedef struct {
+    Buildid_map map;
+    int users;                // Requests walking it, plus the cache while current
+} Serve_ids;
+
+static struct {
+    Serve_image *buckets[SERVE_BUCKETS];
+    Serve_image *id_buckets[SERVE_BUCKETS];
+    Serve_image *head, *tail;
+    uint32_t count;
+    const char *cache_dir;
+    Serve_ids *ids;           // NULL until read, or without an index
+    pthread_mutex_t lock;
+} images = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint32_t hash_path(const char *path) {
+    uint32_t hash = 2166136261U;
+
+    while (*path)
+        hash = (hash ^ (uint8_t)*path++) * 16777619U;
+    return hash;
+}
+
+static uint32_t hash_id(const uint8_t *id, uint32_t len) {
+    uint32_t hash = 2166136261U;
+
+    while (len-- > 0)
+        hash = (hash ^ *id++) * 16777619U;
+    return hash;
+}
+
+static int same_file(Serve_image *image, struct stat *st) {
+    return image->dev == (uint64_t)st->st_dev && image->ino == (uint64_t)st->st_ino
+        && image->size == (uint64_t)st->st_size && image->mtime_sec == st->st_mtim.tv_sec
+        && image->mtime_nsec == st->st_mtim.tv_nsec;
+}
+
+// Open path and build what answering takes. Returns NULL, with errno set, if
+// it cannot be opened or is not an ELF file.
+static Serve_image *load_image(const char *path, struct stat *st) {
+    Serve_image *image = calloc(1, sizeof(Serve_image));
+    int status;
+
+    if (image == NULL || (image->path = strdup(path)) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    if ((status = alfur_open(&image->file, path, ALFUR_WARN)) < 0) {
+        free(image->path);
+        free(image);
+        if (status != ALFUR_EIO)
+            errno = status == ALFUR_ENOMEM ? ENOMEM : ENOEXEC;
+        return NULL;
+    }
+
+    image->dev = st->st_dev;
+    image->ino = st->st_ino;
+    image->size = st->st_size;
+    image->mtime_sec = st->st_mtim.tv_sec;
+    image->mtime_nsec = st->st_mtim.tv_nsec;
+    image->build_id_len = elf_build_id(&image->file, &image->build_id);
+    image->has_symbols = symindex_build(&image->symbols, &image->file) == 0;
+    lines_open(&image->lines, &image->file);
+    pthread_mutex_init(&image->lock, NULL);
+    return image;
+}
+
+static void release_image(Serve_image *image) {
+    if (image->has_symbols)
+        symindex_free(&image->symbols);
+    lines_close(&image->lines);
+    alfur_close(&image->file);
+    pthread_mutex_destroy(&image->lock);
+    free(image->path);
+    free(image);
+}
+
+// Take image out of the cache, with the lock held. It is released now or by
+// its last user.
+static void uncache(Serve_image *image) {
+    Serve_image **link = &images.buckets[hash_path(image->path) % SERVE_BUCKETS];
+
+    while (*link != image)
+        link = &(*link)->bucket_next;
+    *link = image->bucket_next;
+    if (image->build_id_len > 0) {
+        link = &images.id_buckets[hash_id(image->build_id, image->build_id_len) % SERVE_BUCKETS];
+        while (*link != image)
+            link = &(*link)->id_next;
+        *link = image->id_next;
+    }
+    if (image->prev != NULL)
+        image->prev->next = image->next;
+    else
+        images.head = image->next;
+    if (image->next != NULL)
+        image->next->prev = image->prev;
+    else
+        images.tail = image->prev;
+    image->cached = 0;
+    images.count--;
+    if (image->users == 0)
+        release_image(image);
+}
+
+// Move image to the front of the cache, with the lock held
+static void touch(Serve_image *image) {
+    if (images.head == image)
+        return;
+    image->prev->next = image->next;
+    if (image->next != NULL)
+        image->next->prev = image->prev;
+    else
+        images.tail = image->prev;
+    image->prev = NULL;
+    image->next = images.head;
+    images.head->prev = image;
+    images.head = image;
+}
+
+// Add a loaded image, or give the one another thread added meanwhile, and
+// evict the least recently used ones beyond SERVE_IMAGES. With the lock held.
+static Serve_image *cache_image(Serve_image *image) {
+    Serve_image **bucket = &images.buckets[hash_path(image->path) % SERVE_BUCKETS];
+
+    for (Serve_image *other = *bucket; other != NULL; other = other->bucket_next) {
+        if (strcmp(other->path, image->path) == 0 && other->ino == image->ino && other->dev == image->dev
+            && other->mtime_sec == image->mtime_sec && other->mtime_nsec == image->mtime_nsec) {
+            release_image(image);
+            touch(other);
+            return other;
+        }
+    }
+
+    image->bucket_next = *bucket;
+    *bucket = image;
+    if (image->build_id_len > 0) {
+        bucket = &images.id_buckets[hash_id(image->build_id, image->build_id_len) % SERVE_BUCKETS];
+        image->id_next = *bucket;
+        *bucket = image;
+    }
+    image->next = images.head;
+    if (images.head != NULL)
+        images.head->prev = image;
+    images.head = image;
+    if (images.tail == NULL)
+        images.tail = image;
+    image->cached = 1;
+    images.count++;
+
+    for (Serve_image *victim = images.tail; victim != NULL && images.count > SERVE_IMAGES; ) {
+        Serve_image *prev = victim->prev;
+
+        if (victim != image)
+            uncache(victim);
+        victim = prev;
+    }
+    return image;
+}
+
+// Image of path, opened unless the cache has it as it is now. Returns NULL,
+// with errno set, if it cannot be opened.
+static Serve_image *image_of_path(const char *path) {
+    Serve_image *image;
+    struct stat st;
+
+    if (stat(path, &st) < 0)
+        return NULL;
+
+    pthread_mutex_lock(&images.lock);
+    for (image = images.buckets[hash_path(path) % SERVE_BUCKETS]; image != NULL; image = image->bucket_next) {
+        if (strcmp(image->path, path) != 0)
+            continue;
+        if (same_file(image, &st)) {
+            touch(image);
+            image->users++;
+            pthread_mutex_unlock(&images.lock);
+            return image;
+        }
+        uncache(image); // Changed since
+        break;
+    }
+    pthread_mutex_unlock(&images.lock);
+
+    // Loaded without the lock, other requests go on meanwhile
+    if ((image = load_image(path, &st)) == NULL)
+        return NULL;
+    pthread_mutex_lock(&images.lock);
+    image = cache_image(image);
+    image->users++;
+    pthread_mutex_unlock(&images.lock);
+    return image;
+}
+
+// Drop a reference to a build-id index, unmapping it with the last one
+static void put_ids(Serve_ids *ids) {
+    int last;
+
+    pthread_mutex_lock(&images.lock);
+    last = --ids->users == 0;
+    pthread_mutex_unlock(&images.lock);
+    if (last) {
+        buildid_close(&ids->map);
+        free(ids);
+    }
+}
+
+// Whether the build-id index was replaced since ids was mapped
+static int index_changed(Serve_ids *ids) {
+    char path[4096];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s", images.cache_dir, BUILDID_FILE);
+    if (stat(path, &st) < 0)
+        return ids != NULL;
+    return ids == NULL || (uint64_t)st.st_ino != ids->map.ino || st.st_mtim.tv_sec != ids->map.mtime_sec
+        || st.st_mtim.tv_nsec != ids->map.mtime_nsec;
+}
+
+// The current build-id index, mapped again if it was replaced. The reference
+// returned, if any, is dropped with put_ids.
+static Serve_ids *get_ids(void) {
+    Serve_ids *ids, *fresh, *old;
+
+    pthread_mutex_lock(&images.lock);
+    if ((ids = images.ids) != NULL)
+        ids->users++;
+    pthread_mutex_unlock(&images.lock);
+
+    // Checked and mapped without the lock, other requests go on meanwhile
+    if (!index_changed(ids))
+        return ids;
+    if ((fresh = malloc(sizeof(Serve_ids))) == NULL) {
+        perror("alfur");
+        exit(1);
+    }
+    if (buildid_open(&fresh->map, images.cache_dir) < 0) {
+        free(fresh);
+        fresh = NULL;
+    } else {
+        fresh->users = 2;
+    }
+
+    pthread_mutex_lock(&images.lock);
+    old = images.ids;
+    images.ids = fresh;
+    pthread_mutex_unlock(&images.lock);
+    if (old != NULL)
+        put_ids(old);
+    if (ids != NULL)
+        put_ids(ids);
+    return fresh;
+}
+
+// Image with a build-id: one of the cache, or the first unchanged file the
+// index of --cache has for it
+static Serve_image *image_of_build_id(const uint8_t *id, uint32_t len, const char **error) {
+    char path[4096];
+    Buildid_iter iter;
+    Serve_ids *ids;
+    const char *file;
+    int changed, found = 0;
+
+    pthread_mutex_lock(&images.lock);
+    for (Serve_image *image = images.id_buckets[hash_id(id, len) % SERVE_BUCKETS]; image != NULL;
+         image = image->id_next) {
+        if (image->build_id_len == len && memcmp(image->build_id, id, len) == 0) {
+            touch(image);
+            image->users++;
+            pthread_mutex_unlock(&images.lock);
+            return image;
+        }
+    }
+    pthread_mutex_unlock(&images.lock);
+
+    if (images.cache_dir == NULL) {
+        *error = "no build-id index, --cache was not given";
+        return NULL;
+    }
+    if ((ids = get_ids()) != NULL) {
+        buildid_begin(&iter, &ids->map, id, len);
+        while ((file = buildid_next(&iter, &changed)) != NULL) {
+            if (!changed) {
+                snprintf(path, sizeof(path), "%s", file);
+                found = 1;
+                break;
+            }
+        }
+        put_ids(ids);
+    }
+
+    if (!found) {
+        *error = "no indexed file with this build-id";
+        return NULL;
+    }
+    Serve_image *image = image_of_path(path);
+    if (image == NULL)
+        *error = strerror(errno);
+    return image;
+}
+
+static void put_image(Serve_image *image) {
+    pthread_mutex_lock(&images.lock);
+    if (--image->users == 0 && !image->cached)
+        release_image(image);
+    pthread_mutex_unlock(&images.lock);
+}
+
+static int parse_hex(const char *hex, uint8_t *id, int max) {
+    int len = 0;
+
+    for (; hex[0] != 0 && hex[1] != 0 && len < max; hex += 2) {
+        unsigned int byte;
+
+        if (sscanf(hex, "%2x", &byte) != 1)
+            return -1;
+        id[len++] = byte;
+    }
+    return *hex == 0 && len > 0 ? len : -1;
+}
+
+// Answer one request into out, after the space left for the length
+static void answer(char *request, Output *out) {
+    char *line_end = strchr(request, '\n'), *token, *rest, *save;
+    const char *error = NULL;
+    Serve_image *image = NULL;
+
+    if (line_end != NULL)
+        *line_end = 0;
+    rest = line_end != NULL ? line_end + 1 : request + strlen(request);
+
+    if (strncmp(request, "path ", 5) == 0) {
+        if ((image = image_of_path(request + 5)) == NULL)
+            error = strerror(errno);
+    } else if (strncmp(request, "build-id ", 9) == 0) {
+        uint8_t id[BUILDID_MAX];
+        int len = parse_hex(request + 9, id, BUILDID_MAX);
+
+        if (len < 0)
+            error = "invalid build-id";
+        else
+            image = image_of_build_id(id, len, &error);
+    } else {
+        error = "expected path or build-id";
+    }
+
+    if (image == NULL) {
+        out_str(out, "error ");
+        out_str(out, error);
+        out_char(out, '\n');
+        return;
+    }
+
+    out_str(out, "ok ");
+    out_str(out, image->path);
+    out_char(out, '\n');
+
+    pthread_mutex_lock(&image->lock);
+    for (token = strtok_r(rest, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save))
+        print_line(out, image->has_symbols ? &image->symbols : NULL, &image->lines, token);
+    pthread_mutex_unlock(&image->lock);
+    put_image(image);
+}
+
+static int read_all(int fd, void *data, size_t size) {
+    char *p = data;
+
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+static int send_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+// Answer the requests of one connection until it is closed
+static void *serve_client(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    char *request = NULL;
+    uint32_t capacity = 0, length;
+    Output out;
+
+    out_open_memory(&out);
+    while (read_all(fd, &length, sizeof(length)) == 0) {
+        if (length > SERVE_MAX_FRAME)
+            break;
+        if (length + 1 > capacity) {
+            capacity = length + 1;
+            if ((request = realloc(request, capacity)) == NULL) {
+                perror("alfur");
+                exit(1);
+            }
+        }
+        if (read_all(fd, request, length) < 0)
+            break;
+        request[length] = 0;
+
+        // Room for the length, written once the reply is known
+        out.len = 0;
+        out_strn(&out, (const char*)&length, sizeof(length));
+        answer(request, &out);
+        length = out.len - sizeof(length);
+        memcpy(out.buf, &length, sizeof(length));
+        if (send_all(fd, out.buf, out.len) < 0)
+            break;
+    }
+
+    close(fd);
+    free(request);
+    out_close(&out);
+    return NULL;
+}
+
+// Listen on socket_path and answer requests until killed
+int serve(const char *socket_path, const char *cache_dir) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    struct stat st;
+    pthread_attr_t attr;
+    int listener;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s: Socket path too long\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+    images.cache_dir = cache_dir;
+
+    // A socket left by a previous run is replaced, any other file is not
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    if ((listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0
+        || bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        fprintf(stderr, "%s: Failed listening! %s\n", socket_path, strerror(errno));
+        if (listener >= 0)
+            close(listener);
+        return -1;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        pthread_t thread;
+        int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                // Out of descriptors until a client leaves
+                fprintf(stderr, "%s: Failed accepting! %s\n", socket_path, strerror(errno));
+                usleep(100000);
+                continue;
+            }
+            fprintf(stderr, "%s: Failed accepting! %s\n", socket_path, strerror(errno));
+            break;
+        }
+        if (pthread_create(&thread, &attr, serve_client, (void*)(intptr_t)fd) != 0) {
+            fprintf(stderr, "Failed starting a thread! %s\n", strerror(errno));
+            close(fd);
+        }
+    }
+
+    pthread_attr_destroy(&attr);
+    close(listener);
+    return -1;
+}
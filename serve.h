@@ -0,0 +1,27 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+// Symbolization daemon of --serve, answering over a Unix socket.
+//
+// Requests and replies are frames: a 32-bit length in the byte order of the
+// host, then that many bytes of text. A request names an image on its first
+// line, as "path <file>" or "build-id <hex>" (looked up in the build-id index
+// of --cache), followed by addresses in hexadecimal separated by blanks. The
+// reply is "ok <file>" then one line per address as --addr2line prints them,
+// or "error <message>". A client sends as many requests on a connection as it
+// wants, one at a time; each connection has its own thread.
+//
+// Images stay open in a cache of the SERVE_IMAGES most recently used, with
+// their symbol index built and their line tables opened, so a request for a
+// hot image is a hash lookup, by path or by build-id, a stat of the file (by
+// path) to notice it changed, and the searches. The lock of the cache is only
+// held for the lookups: files and the build-id index are checked, opened and
+// mapped outside of it. Requests on one image are answered one at a time.
+
+#define SERVE_IMAGES    512
+#define SERVE_BUCKETS   1024
+#define SERVE_MAX_FRAME (16 << 20)
+
+int serve(const char *socket_path, const char *cache_dir);
+
+#endif
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "output.h"
+#include "segmap.h"
+#include "sizeprof.h"
+
+// Bytes attributed to one name
+typedef struct {
+    const char *name;
+    uint64_t file;
+    uint64_t vm;
+} Prof_row;
+
+typedef struct {
+    uint32_t index;
+    uint64_t file;
+    uint64_t vm;
+} Prof_section;
+
+static int compare_symbols(const void *a, const void *b) {
+    const Prof_symbol *x = a, *y = b;
+
+    if (x->shndx != y->shndx)
+        return x->shndx < y->shndx ? -1 : 1;
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    // Biggest first, so it is the one kept among aliases
+    if (x->size != y->size)
+        return x->size > y->size ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static int compare_rows(const void *a, const void *b) {
+    const Prof_row *x = a, *y = b;
+    uint64_t sx = x->file > x->vm ? x->file : x->vm;
+    uint64_t sy = y->file > y->vm ? y->file : y->vm;
+
+    if (sx != sy)
+        return sx > sy ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static int compare_sections(const void *a, const void *b) {
+    const Prof_section *x = a, *y = b;
+    uint64_t sx = x->file > x->vm ? x->file : x->vm;
+    uint64_t sy = y->file > y->vm ? y->file : y->vm;
+
+    if (sx != sy)
+        return sx > sy ? -1 : 1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+// Sized symbols of SYMTAB, or DYNSYM without one, keyed by their section
+int profindex_build(Prof_index *index, Elf64_data *file) {
+    Elf64_Shdr *table = NULL;
+    int relocatable = file->elf_head->e_type == ET_REL;
+
+    memset(index, 0, sizeof(Prof_index));
+    for (int i = 0; i < file->elf_head->e_shnum; i++) {
+        Elf64_Shdr *section = get_section(file, i);
+        if (section->sh_type == SHT_SYMTAB || (section->sh_type == SHT_DYNSYM && table == NULL))
+            table = section;
+    }
+    if (table == NULL)
+        return 0;
+
+    Elf64_Sym *sym;
+    char *names;
+    uint64_t names_size;
+    uint64_t sym_num = elf_symbols(file, table, &sym, &names, &names_size);
+
+    if ((index->symbols = malloc((sym_num + 1) * sizeof(Prof_symbol))) == NULL)
+        return -1;
+
+    for (uint64_t i = 0; i < sym_num; i++, sym++) {
+        uint8_t type = ELF64_ST_TYPE(sym->st_info);
+
+        // TLS values are offsets in the TLS template, not addresses
+        if (sym->st_size == 0 || sym->st_shndx == SHN_UNDEF || sym->st_shndx >= file->elf_head->e_shnum
+            || (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE))
+            continue;
+
+        Elf64_Shdr *section = get_section(file, sym->st_shndx);
+        uint64_t base = relocatable ? 0 : section->sh_addr;
+        if (sym->st_value < base)
+            continue;
+
+        Prof_symbol *entry = &index->symbols[index->count++];
+        entry->shndx = sym->st_shndx;
+        entry->start = sym->st_value - base;
+        entry->size = sym->st_size;
+        entry->name = elf_string(names, names_size, sym->st_name);
+    }
+
+    qsort(index->symbols, index->count, sizeof(Prof_symbol), compare_symbols);
+    return 0;
+}
+
+void profindex_free(Prof_index *index) {
+    free(index->symbols);
+    memset(index, 0, sizeof(Prof_index));
+}
+
+// First symbol of section shndx
+static uint64_t first_symbol(Prof_index *index, uint32_t shndx) {
+    uint64_t low = 0, high = index->count;
+
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (index->symbols[mid].shndx < shndx)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static void display_row(Output *out, int level, uint64_t file, uint64_t vm, uint64_t total,
+                        const char *name) {
+    out_udec(out, file, 13, 0);
+    out_udec(out, vm, 14, 0);
+    out_printf(out, " %6.2f%%  ", total ? file * 100.0 / total : 0.0);
+    out_pad_str(out, "", level * 2, 0);
+    out_str(out, name);
+    out_char(out, '\n');
+}
+
+static int is_tbss(Elf64_Shdr *section) {
+    return section->sh_type == SHT_NOBITS && (section->sh_flags & SHF_TLS);
+}
+
+static uint64_t section_file_size(Elf64_Shdr *section) {
+    return section->sh_type == SHT_NOBITS ? 0 : section->sh_size;
+}
+
+static uint64_t section_vm_size(Elf64_Shdr *section) {
+    return (section->sh_flags & SHF_ALLOC) && !is_tbss(section) ? section->sh_size : 0;
+}
+
+// Split a section between its symbols, biggest first, and what is left
+static void display_section(Elf64_data *file, Prof_index *index, uint32_t shndx, int mapped,
+                            uint64_t total) {
+    Output *out = file->out;
+    Elf64_Shdr *section = get_section(file, shndx);
+    uint64_t file_size = section_file_size(section), vm_size = mapped ? section_vm_size(section) : 0;
+    uint64_t first = first_symbol(index, shndx), last = first;
+
+    display_row(out, 1, file_size, vm_size, total, elf_section_name(file, section));
+
+    while (last < index->count && index->symbols[last].shndx == shndx)
+        last++;
+    if (last == first)
+        return;
+
+    Prof_row *rows = malloc((last - first) * sizeof(Prof_row));
+    uint64_t n = 0, cursor = 0, attributed = 0;
+
+    if (rows == NULL)
+        return;
+
+    // Overlapping symbols only get the bytes not taken by the previous ones
+    for (uint64_t i = first; i < last; i++) {
+        Prof_symbol *sym = &index->symbols[i];
+        uint64_t start = sym->start > cursor ? sym->start : cursor;
+        uint64_t end = sym->size > section->sh_size - sym->start || sym->start > section->sh_size
+                     ? section->sh_size : sym->start + sym->size;
+
+        if (end <= start)
+            continue;
+        rows[n].name = sym->name;
+        rows[n].file = file_size ? end - start : 0;
+        rows[n].vm = vm_size ? end - start : 0;
+        attributed += end - start;
+        cursor = end;
+        n++;
+    }
+
+    qsort(rows, n, sizeof(Prof_row), compare_rows);
+    for (uint64_t i = 0; i < n; i++)
+        display_row(out, 2, rows[i].file, rows[i].vm, total, rows[i].name);
+    if (attributed < section->sh_size)
+        display_row(out, 2, file_size ? section->sh_size - attributed : 0,
+                    vm_size ? section->sh_size - attributed : 0, total, "[unattributed]");
+
+    free(rows);
+}
+
+// Display the sections of a group, biggest first, then the headers in it and
+// what is left of the file and VM bytes of the group. Sections outside of the
+// LOAD segments (not mapped) take no VM bytes, whatever their flags.
+static void display_group(Elf64_data *file, Prof_index *index, uint32_t *sections, uint64_t n,
+                          int mapped, Prof_row *headers, int header_n, uint64_t file_size,
+                          uint64_t vm_size, uint64_t total) {
+    Prof_section *rows = malloc((n + 1) * sizeof(Prof_section));
+    uint64_t file_used = 0, vm_used = 0;
+
+    if (rows == NULL)
+        return;
+
+    for (uint64_t i = 0; i < n; i++) {
+        Elf64_Shdr *section = get_section(file, sections[i]);
+        rows[i].index = sections[i];
+        rows[i].file = section_file_size(section);
+        rows[i].vm = mapped ? section_vm_size(section) : 0;
+    }
+    qsort(rows, n, sizeof(Prof_section), compare_sections);
+
+    for (uint64_t i = 0; i < n; i++) {
+        if (rows[i].file == 0 && rows[i].vm == 0)
+            continue;
+        display_section(file, index, rows[i].index, mapped, total);
+        file_used += rows[i].file;
+        vm_used += rows[i].vm;
+    }
+    for (int i = 0; i < header_n; i++) {
+        display_row(file->out, 1, headers[i].file, headers[i].vm, total, headers[i].name);
+        file_used += headers[i].file;
+        vm_used += headers[i].vm;
+    }
+    if (file_used < file_size || vm_used < vm_size)
+        display_row(file->out, 1, file_used < file_size ? file_size - file_used : 0,
+                    vm_used < vm_size ? vm_size - vm_used : 0, total, "[unattributed]");
+
+    free(rows);
+}
+
+void display_size_profile(Elf64_data *file, const char *elf_path) {
+    Elf64_Ehdr *head = file->elf_head;
+    Output *out = file->out;
+    uint64_t total = file->elf_size, vm_total = 0, loaded = 0;
+    Prof_index index;
+    Seg_map map;
+
+    // The tables outside of the sections
+    Prof_row headers[3] = {
+        { "[ELF header]", head->e_ehsize, 0 },
+        { "[program headers]", (uint64_t)head->e_phnum * head->e_phentsize, 0 },
+        { "[section headers]", (uint64_t)head->e_shnum * head->e_shentsize, 0 },
+    };
+    uint64_t header_offsets[3] = { 0, head->e_phoff, head->e_shoff };
+    int header_load[3] = { -1, -1, -1 };
+
+    if (profindex_build(&index, file) < 0 || segmap_build(&map, file) < 0) {
+        profindex_free(&index);
+        fprintf(stderr, "Failed indexing %s\n", elf_path);
+        return;
+    }
+
+    char *assigned = calloc(head->e_shnum + 1, 1);
+    uint32_t *rest = malloc((head->e_shnum + 1) * sizeof(uint32_t));
+    if (assigned == NULL || rest == NULL) {
+        free(assigned);
+        free(rest);
+        segmap_free(&map);
+        profindex_free(&index);
+        return;
+    }
+
+    Elf64_Phdr *segment = (Elf64_Phdr*)file->elf_phead;
+    for (int i = 0; i < head->e_phnum; i++, segment++) {
+        if (segment->p_type != PT_LOAD)
+            continue;
+        vm_total += segment->p_memsz;
+        loaded += segment->p_filesz;
+        for (int j = 0; j < 3; j++)
+            if (header_load[j] < 0 && headers[j].file > 0 && header_offsets[j] >= segment->p_offset
+                && header_offsets[j] - segment->p_offset < segment->p_filesz)
+                header_load[j] = i;
+    }
+
+    out_printf(out, "== Size profile of %s ==\n\n", elf_path);
+    out_str(out, "   File bytes      VM bytes  File %   Name\n");
+    display_row(out, 0, total, vm_total, total, "TOTAL");
+
+    segment = (Elf64_Phdr*)file->elf_phead;
+    for (int i = 0; i < head->e_phnum; i++, segment++) {
+        if (segment->p_type != PT_LOAD)
+            continue;
+
+        Prof_row in_load[3];
+        int header_n = 0;
+        for (int j = 0; j < 3; j++) {
+            if (header_load[j] == i) {
+                in_load[header_n] = headers[j];
+                in_load[header_n++].vm = headers[j].file;
+            }
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "LOAD [%d] %c%c%c", i,
+                 segment->p_flags & PF_R ? 'R' : ' ',
+                 segment->p_flags & PF_W ? 'W' : ' ',
+                 segment->p_flags & PF_X ? 'X' : ' ');
+        display_row(out, 0, segment->p_filesz, segment->p_memsz, total, name);
+
+        uint64_t n = map.first[i + 1] - map.first[i];
+        uint32_t *sections = map.sections + map.first[i];
+        for (uint64_t j = 0; j < n; j++)
+            assigned[sections[j]] = 1;
+        display_group(file, &index, sections, n, 1, in_load, header_n,
+                      segment->p_filesz, segment->p_memsz, total);
+    }
+
+    // Everything else only takes room in the file
+    uint64_t rest_n = 0;
+    for (int i = 1; i < head->e_shnum; i++)
+        if (!assigned[i] && section_file_size(get_section(file, i)) > 0)
+            rest[rest_n++] = i;
+
+    Prof_row not_loaded[3];
+    int header_n = 0;
+    for (int j = 0; j < 3; j++)
+        if (header_load[j] < 0 && headers[j].file > 0)
+            not_loaded[header_n++] = headers[j];
+
+    display_row(out, 0, loaded < total ? total - loaded : 0, 0, total, "[not loaded]");
+    display_group(file, &index, rest, rest_n, 0, not_loaded, header_n,
+                  loaded < total ? total - loaded : 0, 0, total);
+
+    free(assigned);
+    free(rest);
+    segmap_free(&map);
+    profindex_free(&index);
+}
@@ -0,0 +1,28 @@
+#ifndef SIZEPROF_H
+#define SIZEPROF_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Attribution of the file and VM bytes of an image to its LOAD segments, their
+// sections and the symbols of these sections. Symbols are indexed by section
+// and offset in it, so each section finds its own with a binary search.
+
+typedef struct {
+    uint32_t shndx;
+    uint64_t start;  // Offset in the section
+    uint64_t size;
+    const char *name;
+} Prof_symbol;
+
+typedef struct {
+    Prof_symbol *symbols; // Sorted by section, start, then biggest first
+    uint64_t count;
+} Prof_index;
+
+int profindex_build(Prof_index *index, Elf64_data *file);
+void profindex_free(Prof_index *index);
+void display_size_profile(Elf64_data *file, const char *elf_path);
+
+#endif
@@ -0,0 +1,288 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source.h"
+
+// Read all of fd in memory
+static int read_all(Elf_source *source) {
+    size_t capacity = 1 << 20;
+    size_t len = 0;
+    char *buf = malloc(capacity);
+
+    if (buf == NULL)
+        return -1;
+
+    for (;;) {
+        if (len == capacity) {
+            char *bigger = realloc(buf, capacity * 2);
+            if (bigger == NULL) {
+                free(buf);
+                return -1;
+            }
+            buf = bigger;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(source->fd, buf + len, capacity - len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            free(buf);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+
+    source->kind = SOURCE_MEMORY;
+    source->image = buf;
+    source->size = len;
+    return 0;
+}
+
+// Open path, "-" being stdin. Returns -1 with errno set on failure.
+int source_open(Elf_source *source, const char *path, int flags) {
+    struct stat st;
+
+    memset(source, 0, sizeof(Elf_source));
+
+    if (strcmp(path, "-") == 0)
+        source->fd = dup(STDIN_FILENO);
+    else
+        source->fd = open(path, O_RDONLY);
+    if (source->fd < 0)
+        return -1;
+
+    if (fstat(source->fd, &st) < 0 || (!S_ISREG(st.st_mode) && read_all(source) < 0)) {
+        int saved = errno;
+        close(source->fd);
+        errno = saved;
+        return -1;
+    }
+
+    if (source->kind == SOURCE_MEMORY) {
+        close(source->fd);
+        source->fd = -1;
+        return 0;
+    }
+
+    source->size = st.st_size;
+
+    if (!(flags & SOURCE_FORCE_PREAD) && source->size > 0 && source->size < SOURCE_PREAD_MIN) {
+        source->image = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, source->fd, 0);
+        if (source->image != MAP_FAILED) {
+            source->kind = SOURCE_MMAP;
+            close(source->fd);
+            source->fd = -1;
+            return 0;
+        }
+        source->image = NULL;
+    }
+
+    // Too big to map, or cannot be mapped
+    if ((source->blocks = calloc(SOURCE_BUCKETS, sizeof(Source_block*))) == NULL) {
+        close(source->fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    source->kind = SOURCE_PREAD;
+    return 0;
+}
+
+// Use size bytes at image, which must outlive the source
+void source_open_memory(Elf_source *source, const void *image, size_t size) {
+    memset(source, 0, sizeof(Elf_source));
+    source->kind = SOURCE_USER;
+    source->fd = -1;
+    source->image = (char*)image;
+    source->size = size;
+}
+
+int source_close(Elf_source *source) {
+    int status = 0;
+
+    switch (source->kind) {
+        case SOURCE_MMAP:
+            status = munmap(source->image, source->size);
+            break;
+        case SOURCE_MEMORY:
+            free(source->image);
+            break;
+        case SOURCE_USER:
+            break;
+        case SOURCE_PREAD:
+            for (int i = 0; source->blocks != NULL && i < SOURCE_BUCKETS; i++) {
+                while (source->blocks[i] != NULL) {
+                    Source_block *next = source->blocks[i]->hash_next;
+                    free(source->blocks[i]);
+                    source->blocks[i] = next;
+                }
+            }
+            free(source->blocks);
+            free(source->window);
+            status = close(source->fd);
+            break;
+    }
+
+    source->image = NULL;
+    return status;
+}
+
+// Read size bytes at offset into buf
+static int read_at(Elf_source *source, char *buf, uint64_t offset, uint64_t size) {
+    for (uint64_t done = 0; done < size;) {
+        ssize_t n = pread(source->fd, buf + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        done += n;
+    }
+
+    source->read += size;
+    return 0;
+}
+
+static Source_block **bucket(Elf_source *source, uint64_t offset) {
+    return &source->blocks[(offset / SOURCE_BLOCK) % SOURCE_BUCKETS];
+}
+
+// The block or span starting at the block of offset and covering size bytes
+static Source_block *find_block(Elf_source *source, uint64_t offset, uint64_t size) {
+    uint64_t start = offset & ~(uint64_t)(SOURCE_BLOCK - 1);
+
+    for (Source_block *block = *bucket(source, offset); block != NULL; block = block->hash_next) {
+        if (block->offset == start && offset + size <= block->offset + block->size)
+            return block;
+    }
+    return NULL;
+}
+
+// Read the blocks covering size bytes at offset, as one block or span
+static Source_block *read_block(Elf_source *source, uint64_t offset, uint64_t size) {
+    uint64_t start = offset & ~(uint64_t)(SOURCE_BLOCK - 1);
+    uint64_t end = (offset + size + SOURCE_BLOCK - 1) & ~(uint64_t)(SOURCE_BLOCK - 1);
+    if (end > source->size)
+        end = source->size;
+
+    Source_block *block = malloc(sizeof(Source_block) + (end - start));
+    if (block == NULL)
+        return NULL;
+    if (read_at(source, block->data, start, end - start) < 0) {
+        free(block);
+        return NULL;
+    }
+
+    block->offset = start;
+    block->size = end - start;
+    block->pinned = 0;
+    block->older = block->newer = NULL;
+    block->hash_next = *bucket(source, start);
+    *bucket(source, start) = block;
+    return block;
+}
+
+static void unlink_lru(Elf_source *source, Source_block *block) {
+    if (block->newer != NULL)
+        block->newer->older = block->older;
+    else
+        source->newest = block->older;
+    if (block->older != NULL)
+        block->older->newer = block->newer;
+    else
+        source->oldest = block->newer;
+    block->older = block->newer = NULL;
+    source->cached -= block->size;
+}
+
+static void push_lru(Elf_source *source, Source_block *block) {
+    block->older = source->newest;
+    block->newer = NULL;
+    if (source->newest != NULL)
+        source->newest->newer = block;
+    else
+        source->oldest = block;
+    source->newest = block;
+    source->cached += block->size;
+}
+
+// Drop the least recently used unpinned blocks beyond SOURCE_CACHE bytes,
+// keeping the newest
+static void evict(Elf_source *source) {
+    while (source->cached > SOURCE_CACHE && source->oldest != source->newest) {
+        Source_block *block = source->oldest;
+        Source_block **link = bucket(source, block->offset);
+
+        unlink_lru(source, block);
+        while (*link != block)
+            link = &(*link)->hash_next;
+        *link = block->hash_next;
+        free(block);
+    }
+}
+
+// Pointer to size bytes at offset, valid until the source is closed. NULL if
+// the range is not in the file.
+char *source_fetch(Elf_source *source, uint64_t offset, uint64_t size) {
+    if (offset > source->size || size > source->size - offset)
+        return NULL;
+
+    source->fetched += size;
+
+    if (source->kind != SOURCE_PREAD)
+        return source->image + offset;
+
+    Source_block *block = find_block(source, offset, size);
+    if (block == NULL) {
+        if ((block = read_block(source, offset, size)) == NULL)
+            return NULL;
+    } else if (!block->pinned) {
+        unlink_lru(source, block);
+    }
+    block->pinned = 1;
+    return block->data + (offset - block->offset);
+}
+
+// Pointer to size bytes at offset, valid until the next call on the source,
+// for data scanned once. NULL if the range is not in the file.
+const char *source_window(Elf_source *source, uint64_t offset, uint64_t size) {
+    if (offset > source->size || size > source->size - offset)
+        return NULL;
+
+    source->fetched += size;
+
+    if (source->kind != SOURCE_PREAD)
+        return source->image + offset;
+
+    // Within a block: cached
+    if (offset / SOURCE_BLOCK == (offset + size - (size > 0)) / SOURCE_BLOCK) {
+        Source_block *block = find_block(source, offset, size);
+
+        if (block == NULL) {
+            if ((block = read_block(source, offset, size)) == NULL)
+                return NULL;
+            push_lru(source, block);
+            evict(source);
+        } else if (!block->pinned) {
+            unlink_lru(source, block);
+            push_lru(source, block);
+        }
+        return block->data + (offset - block->offset);
+    }
+
+    // Longer: read as is into the window
+    if (size > source->window_size) {
+        char *window = realloc(source->window, size);
+        if (window == NULL)
+            return NULL;
+        source->window = window;
+        source->window_size = size;
+    }
+    return read_at(source, source->window, offset, size) < 0 ? NULL : source->window;
+}
@@ -0,0 +1,63 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where the bytes of an image come from. Regular files are mapped, or read
+// with pread when they are big or on demand. Pipes and other unseekable input
+// are read whole in memory. Images already in memory, see
+// source_open_memory, are used in place.
+//
+// A pread source reads aligned blocks of SOURCE_BLOCK bytes, found again
+// through a hash of their number. What source_fetch hands out is pinned, kept
+// until the source is closed since callers hold on to it: a range within a
+// block pins the block, a longer one is read whole as a span. Blocks read by
+// source_window are only cached, up to SOURCE_CACHE bytes, the least recently
+// used dropped first.
+
+#define SOURCE_MMAP   0
+#define SOURCE_PREAD  1
+#define SOURCE_MEMORY 2
+#define SOURCE_USER   3 // Memory of the caller, not freed
+
+#define SOURCE_BLOCK      4096
+#define SOURCE_BUCKETS    1024
+#define SOURCE_CACHE      (4 << 20)    // Bytes of blocks kept for source_window
+#define SOURCE_PREAD_MIN  (1ULL << 30) // Files this big are not mapped
+
+// Flags for source_open
+#define SOURCE_FORCE_PREAD 0x1
+
+// A block, or a span of several, hashed by the number of its first block
+typedef struct Source_block {
+    uint64_t offset;
+    uint64_t size;       // SOURCE_BLOCK, less at the end of the file, more for spans
+    struct Source_block *hash_next;
+    struct Source_block *older, *newer; // Unpinned blocks, by last use
+    int pinned;
+    int padding;         // Aligns data
+    char data[];
+} Source_block;
+
+typedef struct {
+    int kind;
+    int fd;
+    uint64_t size;
+    char *image;             // SOURCE_MMAP, SOURCE_MEMORY and SOURCE_USER
+    Source_block **blocks;   // SOURCE_PREAD, SOURCE_BUCKETS chains
+    Source_block *newest, *oldest; // Unpinned blocks
+    uint64_t cached;         // Their bytes
+    char *window;            // Ranges of source_window over several blocks
+    uint64_t window_size;
+    uint64_t read;           // Bytes read with pread
+    uint64_t fetched;        // Bytes handed out by source_fetch, for --stats
+} Elf_source;
+
+int source_open(Elf_source *source, const char *path, int flags);
+void source_open_memory(Elf_source *source, const void *image, size_t size);
+int source_close(Elf_source *source);
+char *source_fetch(Elf_source *source, uint64_t offset, uint64_t size);
+const char *source_window(Elf_source *source, uint64_t offset, uint64_t size);
+
+#endif
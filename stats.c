@@ -0,0 +1,225 @@
+#define _GNU_SOURCE // RUSAGE_THREAD
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "stats.h"
+
+typedef struct {
+    uint64_t calls;
+    uint64_t ns;
+    uint64_t fetched;
+    uint64_t minflt;
+    uint64_t majflt;
+    uint64_t counters[STAT_COUNTERS];
+    uint64_t counted; // Calls with counters read
+} Stat_phase;
+
+// Counters of a thread, or of the process for the phases of main()
+typedef struct {
+    int fds[STAT_COUNTERS];
+} Stat_counters;
+
+static const char *phase_names[STAT_PHASES] = {
+    "arguments", "run", "open", "header", "programs", "sections", "symbols",
+    "relocations", "strings", "hash", "contents", "dependencies", "disassembly",
+    "close",
+};
+
+static const uint64_t counter_configs[STAT_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+};
+
+int stats_enabled = 0;
+
+static Stat_phase phases[STAT_PHASES];
+static pthread_mutex_t phases_lock = PTHREAD_MUTEX_INITIALIZER;
+static Stat_counters process_counters = { { -1, -1, -1 } };
+static pthread_key_t thread_key;
+static int print_ndjson;
+
+// Current phase of main()
+static int main_phase = -1;
+static Stat_mark main_mark;
+
+// Counters of the calling thread, or with inherit of the threads it creates
+// too. All of them or none: -1 everywhere when one cannot be opened.
+static void open_counters(Stat_counters *counters, int inherit) {
+    for (int i = 0; i < STAT_COUNTERS; i++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counter_configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = inherit;
+
+        counters->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters->fds[i] < 0) {
+            for (int j = 0; j < i; j++)
+                close(counters->fds[j]);
+            for (int j = 0; j < STAT_COUNTERS; j++)
+                counters->fds[j] = -1;
+            return;
+        }
+    }
+}
+
+static void close_counters(void *arg) {
+    Stat_counters *counters = arg;
+
+    for (int i = 0; i < STAT_COUNTERS; i++)
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+    free(counters);
+}
+
+static Stat_counters *thread_counters(void) {
+    Stat_counters *counters = pthread_getspecific(thread_key);
+
+    if (counters == NULL) {
+        if ((counters = malloc(sizeof(Stat_counters))) == NULL) {
+            perror("alfur");
+            exit(1);
+        }
+        open_counters(counters, 0);
+        pthread_setspecific(thread_key, counters);
+    }
+    return counters;
+}
+
+static int read_counters(Stat_counters *counters, uint64_t *values) {
+    for (int i = 0; i < STAT_COUNTERS; i++)
+        if (counters->fds[i] < 0 || read(counters->fds[i], &values[i], sizeof(uint64_t)) != sizeof(uint64_t))
+            return 0;
+    return 1;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void mark(Stat_mark *mark, int who, Stat_counters *counters, const Elf_source *source) {
+    struct rusage usage;
+
+    getrusage(who, &usage);
+    mark->minflt = usage.ru_minflt;
+    mark->majflt = usage.ru_majflt;
+    mark->fetched = source != NULL ? source->fetched : 0;
+    mark->counted = read_counters(counters, mark->counters);
+    mark->ns = now_ns();
+}
+
+static void add(Stat_mark *start, int phase, int who, Stat_counters *counters,
+                const Elf_source *source) {
+    Stat_mark end;
+    uint64_t ns = now_ns();
+
+    mark(&end, who, counters, source);
+
+    pthread_mutex_lock(&phases_lock);
+    Stat_phase *p = &phases[phase];
+    p->calls++;
+    p->ns += ns - start->ns;
+    p->fetched += end.fetched - start->fetched;
+    p->minflt += end.minflt - start->minflt;
+    p->majflt += end.majflt - start->majflt;
+    if (start->counted && end.counted) {
+        for (int i = 0; i < STAT_COUNTERS; i++)
+            p->counters[i] += end.counters[i] - start->counters[i];
+        p->counted++;
+    }
+    pthread_mutex_unlock(&phases_lock);
+}
+
+// End the current phase of main() and start phase. The start is marked even
+// before --stats is parsed, so the arguments phase covers all of them.
+void stats_phase(int phase) {
+    if (stats_enabled && main_phase >= 0)
+        add(&main_mark, main_phase, RUSAGE_SELF, &process_counters, NULL);
+    main_phase = phase;
+    mark(&main_mark, RUSAGE_SELF, &process_counters, NULL);
+}
+
+// Phase of a file, source is the image it reads (NULL before it is opened)
+void stats_begin(Stat_mark *start, const Elf_source *source) {
+    if (stats_enabled)
+        mark(start, RUSAGE_THREAD, thread_counters(), source);
+}
+
+void stats_end(Stat_mark *start, int phase, const Elf_source *source) {
+    if (stats_enabled)
+        add(start, phase, RUSAGE_THREAD, thread_counters(), source);
+}
+
+static void print_counter(const Stat_phase *p, int counter, int width) {
+    if (p->counted)
+        fprintf(stderr, " %*lu", width, p->counters[counter]);
+    else
+        fprintf(stderr, " %*s", width, "-");
+}
+
+// Phases never run are left out. The bytes of the run are those of its files.
+static void stats_print(void) {
+    for (int i = STAT_OPEN; i < STAT_PHASES; i++)
+        phases[STAT_RUN].fetched += phases[i].fetched;
+
+    if (!print_ndjson)
+        fprintf(stderr, "%-12s %8s %10s %12s %8s %6s %14s %14s %12s\n", "phase", "calls",
+                "time (s)", "bytes", "minflt", "majflt", "cycles", "instructions", "cache-misses");
+
+    for (int i = 0; i < STAT_PHASES; i++) {
+        const Stat_phase *p = &phases[i];
+
+        if (p->calls == 0)
+            continue;
+
+        if (print_ndjson) {
+            fprintf(stderr, "{\"record\":\"stats\",\"phase\":\"%s\",\"calls\":%lu,\"ns\":%lu,"
+                    "\"bytes\":%lu,\"minflt\":%lu,\"majflt\":%lu", phase_names[i], p->calls,
+                    p->ns, p->fetched, p->minflt, p->majflt);
+            if (p->counted)
+                fprintf(stderr, ",\"cycles\":%lu,\"instructions\":%lu,\"cache_misses\":%lu",
+                        p->counters[STAT_CYCLES], p->counters[STAT_INSTRUCTIONS],
+                        p->counters[STAT_CACHE_MISSES]);
+            fprintf(stderr, "}\n");
+            continue;
+        }
+
+        fprintf(stderr, "%-12s %8lu %10.6f %12lu %8lu %6lu", phase_names[i], p->calls,
+                p->ns / 1e9, p->fetched, p->minflt, p->majflt);
+        print_counter(p, STAT_CYCLES, 14);
+        print_counter(p, STAT_INSTRUCTIONS, 14);
+        print_counter(p, STAT_CACHE_MISSES, 12);
+        fputc('\n', stderr);
+    }
+}
+
+static void stats_exit(void) {
+    stats_phase(-1);
+    stats_print();
+}
+
+// Open the process counters before any thread is created, so they count the
+// workers too. The totals are printed at exit.
+void stats_enable(int ndjson) {
+    print_ndjson = ndjson;
+    if (stats_enabled)
+        return;
+    stats_enabled = 1;
+    pthread_key_create(&thread_key, close_counters);
+    open_counters(&process_counters, 1);
+    atexit(stats_exit);
+}
@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+#include "source.h"
+
+// --stats: what each phase of a run costs. Every time a phase runs, its wall
+// time, the bytes of the image it fetched, its page faults and, when
+// perf_event_open is allowed, its cycles, instructions and cache misses are
+// added to the phase totals, printed on stderr at exit.
+//
+// The phases of main() follow each other and are measured for the whole
+// process, worker threads included. The phases of a file are measured for
+// the thread dumping it.
+
+#define STAT_ARGS      0  // Options and directory walking
+#define STAT_RUN       1  // Everything after, all the files
+#define STAT_OPEN      2
+#define STAT_HEADER    3
+#define STAT_PROGRAMS  4
+#define STAT_SECTIONS  5
+#define STAT_SYMBOLS   6
+#define STAT_RELOCS    7
+#define STAT_STRINGS   8
+#define STAT_HASH      9
+#define STAT_CONTENTS  10 // Notes, hex dumps and sections without a decoder
+#define STAT_DEPS      11 // Resolving the libraries of a file
+#define STAT_CODE      12 // Disassembly
+#define STAT_CLOSE     13
+#define STAT_PHASES    14
+
+// Hardware counters
+#define STAT_CYCLES       0
+#define STAT_INSTRUCTIONS 1
+#define STAT_CACHE_MISSES 2
+#define STAT_COUNTERS     3
+
+// Values at the start of a phase
+typedef struct {
+    uint64_t ns;
+    uint64_t fetched;
+    uint64_t minflt;
+    uint64_t majflt;
+    uint64_t counters[STAT_COUNTERS];
+    int counted; // Whether counters were read
+} Stat_mark;
+
+extern int stats_enabled;
+
+void stats_enable(int ndjson);
+void stats_phase(int phase);
+void stats_begin(Stat_mark *mark, const Elf_source *source);
+void stats_end(Stat_mark *mark, int phase, const Elf_source *source);
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "strscan.h"
+
+static int is_plain(unsigned char c) {
+    return c >= 0x20 && c != 0x7f;
+}
+
+static int is_printable(unsigned char c) {
+    return c >= 0x20 && c < 0x7f;
+}
+
+#ifdef __SSE2__
+
+// Bytes of v that are not plain, as a bit mask. Bytes are signed for the
+// comparisons: 0x80 and above are negative and plain.
+static int stop_mask(__m128i v) {
+    __m128i control = _mm_andnot_si128(_mm_cmplt_epi8(v, _mm_setzero_si128()),
+                                       _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)));
+    return _mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f))));
+}
+
+// Printable bytes of v, as a bit mask
+static int printable_mask(__m128i v) {
+    __m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)),
+                                         _mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)));
+    return _mm_movemask_epi8(printable);
+}
+
+// Length of the leading plain bytes of data
+size_t strscan_plain(const char *data, size_t size) {
+    size_t i = 0;
+
+    // Long strings: 64 bytes per test
+    for (; i + 64 <= size; i += 64) {
+        const __m128i *p = (const __m128i*)(data + i);
+        int mask = stop_mask(_mm_loadu_si128(p)) | stop_mask(_mm_loadu_si128(p + 1))
+                 | stop_mask(_mm_loadu_si128(p + 2)) | stop_mask(_mm_loadu_si128(p + 3));
+        if (mask)
+            break;
+    }
+    for (; i + 16 <= size; i += 16) {
+        int mask = stop_mask(_mm_loadu_si128((const __m128i*)(data + i)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    for (; i < size && is_plain(data[i]); i++)
+        ;
+    return i;
+}
+
+// Length of the leading printable bytes of data
+size_t strscan_printable(const char *data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        int mask = ~printable_mask(_mm_loadu_si128((const __m128i*)(data + i))) & 0xffff;
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    for (; i < size && is_printable(data[i]); i++)
+        ;
+    return i;
+}
+
+// Length of the leading bytes of data that are not printable
+size_t strscan_unprintable(const char *data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        int mask = printable_mask(_mm_loadu_si128((const __m128i*)(data + i)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    for (; i < size && !is_printable(data[i]); i++)
+        ;
+    return i;
+}
+
+#else
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+// Whether a byte of x is below n, for n <= 128
+#define HAS_LESS(x, n) (((x) - ONES * (n)) & ~(x) & HIGHS)
+
+// Whether a byte of x is above m and below n, for m <= 127 and n <= 128
+#define HAS_BETWEEN(x, m, n) \
+    ((ONES * (127 + (n)) - ((x) & ONES * 127)) & ~(x) & (((x) & ONES * 127) + ONES * (127 - (m))) & HIGHS)
+
+static uint64_t load_word(const char *data) {
+    uint64_t word;
+
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+// Same with words: skip the words without a byte to stop at, then find it in
+// the word that has one
+size_t strscan_plain(const char *data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = load_word(data + i);
+        if (HAS_LESS(word, 0x20) || HAS_LESS(word ^ (ONES * 0x7f), 1))
+            break;
+    }
+    for (; i < size && is_plain(data[i]); i++)
+        ;
+    return i;
+}
+
+// A word of printable bytes has none below 0x20, none from 0x7f on (high bit)
+// and no DEL
+size_t strscan_printable(const char *data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = load_word(data + i);
+        if (HAS_LESS(word, 0x20) || (word & HIGHS) || HAS_LESS(word ^ (ONES * 0x7f), 1))
+            break;
+    }
+    for (; i < size && is_printable(data[i]); i++)
+        ;
+    return i;
+}
+
+size_t strscan_unprintable(const char *data, size_t size) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = load_word(data + i);
+        if (HAS_BETWEEN(word, 0x1f, 0x7f))
+            break;
+    }
+    for (; i < size && !is_printable(data[i]); i++)
+        ;
+    return i;
+}
+
+#endif
+
+static void out_offset(Output *out, uint64_t offset) {
+    out_str(out, "   [|");
+    out_hex(out, offset, 8, 0);
+    out_str(out, "|]  ");
+}
+
+// Strings of a string table, from their first printable byte to their NUL.
+// Controls are written as ^X, and a newline ends the line, the rest of the
+// string going on the next one, indented.
+void strscan_table(Output *out, const char *data, uint64_t size) {
+    const char *p = data, *end = data + size;
+    int newline = 0;
+
+    while (p < end) {
+        p += strscan_unprintable(p, end - p);
+        if (p == end)
+            break;
+
+        if (newline) {
+            out_str(out, "                 ");
+            newline = 0;
+        }
+        out_offset(out, p - data);
+
+        for (;;) {
+            size_t n = strscan_plain(p, end - p);
+            out_strn(out, p, n);
+            p += n;
+
+            // A string cut by the end of the table ends there
+            if (p == end) {
+                out_char(out, '\n');
+                break;
+            }
+
+            unsigned char c = *p++;
+            if (c == 0) {
+                out_char(out, '\n');
+                break;
+            }
+            if (c == '\n') {
+                out_str(out, "\\n\n");
+                newline = p < end && *p != 0;
+                break;
+            }
+            out_char(out, '^');
+            out_char(out, c + 0x40);
+        }
+    }
+}
+
+void strscan_begin(Strscan_runs *scan, Output *out, uint64_t min) {
+    memset(scan, 0, sizeof(Strscan_runs));
+    scan->out = out;
+    scan->min = min;
+}
+
+// Scan the next size bytes. A run reaching their end goes on in the next
+// ones: it is written as soon as it is min bytes long, and its first bytes
+// are kept until then.
+void strscan_feed(Strscan_runs *scan, const char *data, uint64_t size) {
+    const char *p = data, *end = data + size;
+
+    while (p < end) {
+        if (scan->run == 0) {
+            p += strscan_unprintable(p, end - p);
+            if (p == end)
+                break;
+            scan->start = scan->offset + (p - data);
+        }
+
+        size_t n = strscan_printable(p, end - p);
+        if (scan->run >= scan->min) {
+            out_strn(scan->out, p, n);
+        } else if (scan->run + n >= scan->min) {
+            out_offset(scan->out, scan->start);
+            if (scan->run > 0)
+                out_strn(scan->out, scan->carry, scan->run);
+            out_strn(scan->out, p, n);
+        } else if (p + n == end) {
+            if (scan->run + n > scan->carry_size) {
+                uint64_t size = (scan->run + n) * 2 < scan->min ? (scan->run + n) * 2 : scan->min;
+                if ((scan->carry = realloc(scan->carry, size)) == NULL) {
+                    perror("alfur");
+                    exit(1);
+                }
+                scan->carry_size = size;
+            }
+            memcpy(scan->carry + scan->run, p, n);
+        }
+        scan->run += n;
+        p += n;
+
+        if (p < end) {
+            if (scan->run >= scan->min)
+                out_char(scan->out, '\n');
+            scan->run = 0;
+        }
+    }
+
+    scan->offset += size;
+}
+
+void strscan_end(Strscan_runs *scan) {
+    if (scan->run >= scan->min && scan->run > 0)
+        out_char(scan->out, '\n');
+    free(scan->carry);
+    scan->carry = NULL;
+    scan->carry_size = 0;
+}
+
+// Runs of printable bytes at least min bytes long, like strings(1)
+void strscan_runs(Output *out, const char *data, uint64_t size, uint64_t min) {
+    Strscan_runs scan;
+
+    strscan_begin(&scan, out, min);
+    strscan_feed(&scan, data, size);
+    strscan_end(&scan);
+}
@@ -0,0 +1,39 @@
+#ifndef STRSCAN_H
+#define STRSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "output.h"
+
+// Runs of text in string tables and raw data, found 8 bytes at a time with
+// 64-bit arithmetic, or 16 at a time with SSE2 when the compiler has it (gcc
+// and clang for x86-64, not tcc), and written in bulk.
+//
+// Printable bytes are 0x20 to 0x7e. In string tables, plain bytes are written
+// as they are: all but NUL, the other C0 controls and DEL, so UTF-8 text is
+// kept whole.
+
+size_t strscan_plain(const char *data, size_t size);
+size_t strscan_printable(const char *data, size_t size);
+size_t strscan_unprintable(const char *data, size_t size);
+
+// Runs of printable bytes of data read in pieces, offsets counted from the
+// first piece
+typedef struct {
+    Output *out;
+    uint64_t min;
+    uint64_t offset;   // Of the next byte fed
+    uint64_t start;    // Offset of the current run
+    uint64_t run;      // Its length so far, 0 outside of a run
+    char *carry;       // Its bytes while it is shorter than min
+    uint64_t carry_size;
+} Strscan_runs;
+
+void strscan_table(Output *out, const char *data, uint64_t size);
+void strscan_runs(Output *out, const char *data, uint64_t size, uint64_t min);
+void strscan_begin(Strscan_runs *scan, Output *out, uint64_t min);
+void strscan_feed(Strscan_runs *scan, const char *data, uint64_t size);
+void strscan_end(Strscan_runs *scan);
+
+#endif
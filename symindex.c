@@ -0,0 +1,266 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elf.h"
+#include "output.h"
+#include "symindex.h"
+#include "zsection.h"
+
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    const char *name;
+    uint64_t end; // End of the section of the symbol
+} Sym_entry;
+
+int compare_sym_entries(const void *a, const void *b) {
+    const Sym_entry *x = a, *y = b;
+
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    // Biggest first, so it is the one kept among aliases
+    if (x->size != y->size)
+        return x->size > y->size ? -1 : 1;
+    return 0;
+}
+
+// Symbols that name code or data at an address
+int is_indexed(Elf64_Sym *sym) {
+    uint8_t type = ELF64_ST_TYPE(sym->st_info);
+
+    if (sym->st_shndx == SHN_UNDEF || sym->st_shndx == SHN_ABS || sym->st_value == 0)
+        return 0;
+    return type == STT_FUNC || type == STT_OBJECT || type == STT_NOTYPE;
+}
+
+// Add the symbols of SYMTAB and DYNSYM sections to entries, returns the new
+// count
+uint64_t collect_symbols(Elf64_data *file, Sym_entry *entries) {
+    Elf64_Shdr *section = (Elf64_Shdr*)file->elf_shead;
+    uint64_t count = 0;
+
+    for (int i = 0; i < file->elf_head->e_shnum; i++, section++) {
+        if (section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM)
+            continue;
+
+        Elf64_Sym *s;
+        char *names;
+        uint64_t names_size;
+        uint64_t sym_num = elf_symbols(file, section, &s, &names, &names_size);
+
+        for (uint64_t j = 0; j < sym_num; j++, s++) {
+            if (!is_indexed(s))
+                continue;
+            if (entries) {
+                entries[count].start = s->st_value;
+                entries[count].size = s->st_size;
+                entries[count].name = elf_string(names, names_size, s->st_name);
+                entries[count].end = s->st_value;
+                if (s->st_shndx < file->elf_head->e_shnum) {
+                    Elf64_Shdr *target = get_section(file, s->st_shndx);
+                    if (target->sh_addr <= s->st_value)
+                        entries[count].end = target->sh_addr + target->sh_size;
+                }
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int symindex_build(Sym_index *index, Elf64_data *file) {
+    memset(index, 0, sizeof(Sym_index));
+
+    uint64_t total = collect_symbols(file, NULL);
+    Sym_entry *entries = malloc((total ? total : 1) * sizeof(Sym_entry));
+    if (entries == NULL)
+        return -1;
+
+    collect_symbols(file, entries);
+    qsort(entries, total, sizeof(Sym_entry), compare_sym_entries);
+
+    index->start = malloc((total ? total : 1) * sizeof(uint64_t));
+    index->size = malloc((total ? total : 1) * sizeof(uint64_t));
+    index->name = malloc((total ? total : 1) * sizeof(const char*));
+    if (!index->start || !index->size || !index->name) {
+        free(entries);
+        symindex_free(index);
+        return -1;
+    }
+
+    // Keep one symbol per address, SYMTAB and DYNSYM usually repeat each
+    // other. Symbols without a size (assembly labels) extend up to the next
+    // symbol or the end of their section.
+    for (uint64_t i = 0; i < total; i++) {
+        Sym_entry *entry = &entries[i];
+
+        if (index->count > 0 && index->start[index->count - 1] == entry->start)
+            continue;
+
+        if (entry->size == 0) {
+            uint64_t end = entry->end;
+            uint64_t next = i + 1;
+            while (next < total && entries[next].start == entry->start)
+                next++;
+            if (next < total && entries[next].start < end)
+                end = entries[next].start;
+            entry->size = end > entry->start ? end - entry->start : 0;
+        }
+
+        index->start[index->count] = entry->start;
+        index->size[index->count] = entry->size;
+        index->name[index->count] = entry->name;
+        index->count++;
+    }
+
+    free(entries);
+    return 0;
+}
+
+void symindex_free(Sym_index *index) {
+    free(index->start);
+    free(index->size);
+    free(index->name);
+    memset(index, 0, sizeof(Sym_index));
+}
+
+// Index of the last symbol starting at or before addr, in [lo, hi)
+uint64_t upper_bound(const uint64_t *start, uint64_t lo, uint64_t hi, uint64_t addr) {
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (start[mid] <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Returns the index of the symbol covering addr, or -1. Increasing addresses are looked
+// up by galloping from the previous match, so a sorted batch is merged with
+// the index rather than searched from scratch each time.
+int64_t symindex_find(Sym_index *index, uint64_t addr) {
+    const uint64_t *start = index->start;
+    uint64_t lo = 0, hi = index->count;
+    uint64_t i;
+
+    if (index->count == 0 || addr < start[0])
+        return -1;
+
+    if (start[index->cursor] <= addr) {
+        uint64_t step = 1;
+        lo = index->cursor;
+        while (lo + step < index->count && start[lo + step] <= addr) {
+            lo += step;
+            step *= 2;
+        }
+        hi = lo + step < index->count ? lo + step : index->count;
+    }
+
+    i = upper_bound(start, lo, hi, addr) - 1;
+    index->cursor = i;
+
+    if (addr - start[i] >= index->size[i] && addr != start[i])
+        return -1;
+    return i;
+}
+
+// Print "addr symbol+offset" for one address token
+void print_addr(Output *out, Elf64_data *file, Sym_index *index, char *token) {
+    char *end;
+    uint64_t addr = strtoull(token, &end, 16);
+    int64_t i;
+
+    if (*end != 0) {
+        out_str(out, token);
+        out_str(out, " ??\n");
+        return;
+    }
+
+    out_str(out, "0x");
+    out_hex(out, addr, 0, 0);
+
+    if ((i = symindex_find(index, addr)) < 0) {
+        out_str(out, " ??\n");
+        return;
+    }
+
+    out_char(out, ' ');
+    out_str(out, index->name[i]);
+    if (addr != index->start[i]) {
+        out_str(out, "+0x");
+        out_hex(out, addr - index->start[i], 0, 0);
+    }
+    out_char(out, '\n');
+}
+
+// Call each on every token of the addresses read from fd, separated by
+// blanks, newlines or commas
+void read_addresses(int fd, void (*each)(char *token, void *arg), void *arg) {
+    char buf[65536];
+    char token[32];
+    size_t token_len = 0;
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Failed reading addresses! %s\n", strerror(errno));
+            break;
+        }
+
+        for (ssize_t k = 0; k < n; k++) {
+            char c = buf[k];
+
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != ',') {
+                // Overlong tokens are cut, and reported as not an address
+                if (token_len < sizeof(token) - 1)
+                    token[token_len++] = c;
+                else
+                    token[token_len - 1] = '?';
+                continue;
+            }
+
+            if (token_len > 0) {
+                token[token_len] = 0;
+                each(token, arg);
+                token_len = 0;
+            }
+        }
+    }
+
+    // Input not ending with a newline
+    if (token_len > 0) {
+        token[token_len] = 0;
+        each(token, arg);
+    }
+}
+
+typedef struct {
+    Elf64_data *file;
+    Sym_index index;
+} Addr2sym;
+
+static void print_symbol(char *token, void *arg) {
+    Addr2sym *query = arg;
+
+    print_addr(query->file->out, query->file, &query->index, token);
+}
+
+// Print the symbol of each address read from fd, one per line
+void addr2sym(Elf64_data *file, int fd) {
+    Addr2sym query = { file };
+
+    if (symindex_build(&query.index, file) < 0) {
+        fprintf(stderr, "Failed building the symbol index! %s\n", strerror(errno));
+        return;
+    }
+
+    read_addresses(fd, print_symbol, &query);
+    symindex_free(&query.index);
+}
@@ -0,0 +1,25 @@
+#ifndef SYMINDEX_H
+#define SYMINDEX_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Address to symbol index, sorted by start address. Kept as separate arrays
+// so the binary search only walks the start addresses.
+
+typedef struct {
+    uint64_t *start;
+    uint64_t *size;
+    const char **name; // In the string tables of the image
+    uint64_t count;
+    uint64_t cursor; // Last match, where searches for sorted addresses resume
+} Sym_index;
+
+int symindex_build(Sym_index *index, Elf64_data *file);
+void symindex_free(Sym_index *index);
+int64_t symindex_find(Sym_index *index, uint64_t addr);
+void read_addresses(int fd, void (*each)(char *token, void *arg), void *arg);
+void addr2sym(Elf64_data *file, int fd);
+
+#endif
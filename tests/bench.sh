@@ -0,0 +1,67 @@
+#!/bin/sh
+# Time each stage of the dump on generated files and print its throughput.
+# usage: bench.sh <alfur> <genelf> [runs]
+#
+# A stage is the dump restricted by its selector, output to /dev/null; the
+# header stage measures what opening and mapping the file costs the others.
+# Each stage is run `runs` times (3 by default) and the best time is kept.
+
+alfur=$1
+genelf=$2
+runs=${3:-3}
+
+if [ ! -x "$alfur" ] || [ ! -x "$genelf" ]; then
+    echo "usage: bench.sh <alfur> <genelf> [runs]" >&2
+    exit 1
+fi
+
+# Nanoseconds taken by the best of `runs` runs of the command
+best() {
+    best_ns=
+    i=0
+    while [ $i -lt "$runs" ]; do
+        start=$(date +%s%N)
+        "$@" > /dev/null || exit 1
+        ns=$(($(date +%s%N) - start))
+        if [ -z "$best_ns" ] || [ $ns -lt "$best_ns" ]; then
+            best_ns=$ns
+        fi
+        i=$((i + 1))
+    done
+    echo "$best_ns"
+}
+
+# stage <name> <entries> <bytes> <file> <selector>...
+stage() {
+    name=$1 entries=$2 bytes=$3 file=$4
+    shift 4
+    ns=$(best "$alfur" "$@" "$file")
+    awk -v name="$name" -v n="$entries" -v b="$bytes" -v ns="$ns" 'BEGIN {
+        s = ns / 1e9
+        if (s <= 0) s = 1e-9
+        printf "  %-10s %10d entries %10.1f MB %9.4f s %14.0f entries/s %10.1f MB/s\n",
+               name, n, b / 1e6, s, n / s, b / 1e6 / s
+    }'
+}
+
+# bench <title> <genelf options>...
+bench() {
+    title=$1
+    shift
+    file=bench_$title.o
+    stats=$("$genelf" "$@" "$file") || exit 1
+    count() { echo "$stats" | awk -v k="$1" '$1 == k { print $2 }'; }
+    size() { echo "$stats" | awk -v k="$1" '$1 == k { print $3 }'; }
+
+    echo "$title: $* ($(wc -c < "$file") bytes)"
+    stage header 1 64 "$file" -h
+    stage sections "$(count sections)" "$(size sections)" "$file" -S
+    stage symbols "$(count symbols)" "$(size symbols)" "$file" -s
+    stage rela "$(count relocations)" "$(size relocations)" "$file" --relocs
+    stage strings "$(count strings)" "$(size strings)" "$file" -p .strtab
+    rm -f "$file"
+}
+
+bench sections -n 65000 -s 65000 -r 65000
+bench symbols -n 1000 -s 2M -r 2M
+bench strings -n 100 -s 100k -r 0 -t 64M
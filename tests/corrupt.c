@@ -0,0 +1,142 @@
+// Walk every part of the libalfur API over copies of an ELF file with a
+// few bytes flipped, mostly in its headers. Meant to run under ASan and
+// UBSan (see make check): a corrupted file must give error codes or empty
+// names, never a read out of the image.
+//
+// Usage: corrupt <file> [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libalfur.h"
+
+#define FLIPS 8
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static char *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    char *data;
+    long len;
+
+    if (f == NULL || fseek(f, 0, SEEK_END) < 0 || (len = ftell(f)) <= 0) {
+        perror(path);
+        exit(1);
+    }
+    rewind(f);
+    if ((data = malloc(len)) == NULL || fread(data, 1, len, f) != (size_t)len) {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    *size = len;
+    return data;
+}
+
+// Touch what every function returns, so out of bounds views are caught
+static uint64_t walk(Elf64_data *file) {
+    uint64_t sum = 0, index;
+    Alfur_iter iter;
+    const Elf64_Shdr *section;
+    const Elf64_Phdr *segment;
+    const char *data;
+    uint64_t size;
+    char name[32];
+
+    sum += alfur_name(ALFUR_NAME_MACHINE, alfur_header(file)->e_machine, name, sizeof(name));
+    alfur_segments(&iter, file);
+    while (alfur_next_segment(&iter, &index, &segment))
+        sum += segment->p_type + alfur_name(ALFUR_NAME_PTYPE, segment->p_type, name, sizeof(name));
+
+    alfur_sections(&iter, file);
+    while (alfur_next_section(&iter, &index, &section)) {
+        Alfur_symbol_iter symbols;
+        Alfur_symbol symbol;
+        Alfur_reloc_iter relocs;
+        Alfur_reloc reloc;
+
+        sum += strlen(alfur_section_name(file, section));
+        if (alfur_section_data(file, index, &data, &size) == ALFUR_OK && size > 0)
+            sum += (uint8_t)data[0] + (uint8_t)data[size - 1];
+        if (alfur_symbols(&symbols, file, index) == ALFUR_OK)
+            while (alfur_next_symbol(&symbols, &symbol))
+                sum += strlen(symbol.name) + symbol.sym->st_value;
+        if (alfur_relocs(&relocs, file, index) == ALFUR_OK)
+            while (alfur_next_reloc(&relocs, &reloc))
+                sum += reloc.offset + reloc.type;
+    }
+
+    if (alfur_find_section(file, ".text", &index) == ALFUR_OK)
+        sum += index;
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    size_t size;
+    char *image;
+    long iterations = 20000, opened = 0;
+    uint64_t sum = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: corrupt <file> [iterations]\n");
+        return 1;
+    }
+    image = read_file(argv[1], &size);
+    if (argc > 2)
+        iterations = atol(argv[2]);
+
+    // Flips land in the headers (the ELF header, then the section and
+    // program header tables, found in the intact file) or anywhere
+    Elf64_data file;
+    uint64_t shoff = 0, shsize = 0, phoff = 0, phsize = 0;
+    if (alfur_open_memory(&file, image, size, 0) == ALFUR_OK) {
+        const Elf64_Ehdr *head = alfur_header(&file);
+        shoff = head->e_shoff;
+        shsize = (uint64_t)head->e_shnum * head->e_shentsize;
+        phoff = head->e_phoff;
+        phsize = (uint64_t)head->e_phnum * head->e_phentsize;
+        alfur_close(&file);
+    }
+
+    for (long i = 0; i < iterations; i++) {
+        uint64_t offsets[FLIPS];
+        char saved[FLIPS];
+        int flips = 1 + next_random() % FLIPS;
+
+        for (int j = 0; j < flips; j++) {
+            uint64_t r = next_random();
+            switch (r % 4) {
+                case 0:  offsets[j] = (r >> 8) % (size < 64 ? size : 64); break;
+                case 1:  offsets[j] = shsize ? shoff + (r >> 8) % shsize : 0; break;
+                case 2:  offsets[j] = phsize ? phoff + (r >> 8) % phsize : 0; break;
+                default: offsets[j] = (r >> 8) % size;
+            }
+            if (offsets[j] >= size)
+                offsets[j] = 0;
+            saved[j] = image[offsets[j]];
+            image[offsets[j]] ^= 1 << (r >> 40) % 8;
+        }
+
+        if (alfur_open_memory(&file, image, size, 0) == ALFUR_OK) {
+            sum += walk(&file);
+            alfur_close(&file);
+            opened++;
+        }
+
+        for (int j = flips - 1; j >= 0; j--)
+            image[offsets[j]] = saved[j];
+    }
+
+    printf("%ld of %ld corrupted copies opened (%llx)\n", opened, iterations,
+           (unsigned long long)sum);
+    free(image);
+    return 0;
+}
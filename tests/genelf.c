@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../elf.h"
+
+// Generate a valid ELF64 relocatable file of a chosen size, to measure alfur
+// on inputs bigger than what a compiler produces:
+//   [ELF header] [.text.0 ... .text.N-1] [.symtab] [.strtab] [.rela.text]
+//   [.shstrtab] [section headers]
+// Symbols are spread over the text sections, relocations over the symbols, and
+// .strtab is padded with extra strings up to the requested size.
+
+#define TEXT_SIZE 16
+
+// Without extended section numbering, which alfur does not read
+#define MAX_TEXT (0xff00 - 5)
+
+static void usage(void) {
+    fprintf(stderr, "usage: genelf [-n sections] [-s symbols] [-r relocations] "
+                    "[-t strtab-bytes] <output>\n");
+    exit(1);
+}
+
+static void fail(const char *message) {
+    perror(message);
+    exit(1);
+}
+
+static uint64_t parse_count(const char *arg) {
+    char *end;
+    uint64_t n = strtoull(arg, &end, 0);
+    if (end == arg)
+        usage();
+    switch (*end) {
+        case 'k': n *= 1000; end++; break;
+        case 'M': n *= 1000000; end++; break;
+    }
+    if (*end)
+        usage();
+    return n;
+}
+
+static void put(const void *data, size_t size, FILE *out) {
+    if (fwrite(data, 1, size, out) != size)
+        fail("genelf: write");
+}
+
+static void pad(uint64_t size, FILE *out) {
+    static const char zeros[64];
+    for (; size > sizeof(zeros); size -= sizeof(zeros))
+        put(zeros, sizeof(zeros), out);
+    put(zeros, size, out);
+}
+
+// Symbol names are "sym_<i>", stretched with 'x' so .strtab reaches its size
+// without filler when there are enough symbols
+static int name_length(uint64_t i, uint64_t symbols, uint64_t strtab_size) {
+    int length = snprintf(NULL, 0, "sym_%lu", i);
+    uint64_t share = symbols ? strtab_size / symbols : 0;
+    if (share > 256)
+        share = 256;
+    return share > (uint64_t)length + 1 ? (int)share - 1 : length;
+}
+
+static void put_name(uint64_t i, int length, FILE *out) {
+    char name[260];
+    int n = snprintf(name, sizeof(name), "sym_%lu", i);
+    memset(name + n, 'x', length - n);
+    name[length] = 0;
+    put(name, length + 1, out);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t texts = 1000, symbols = 100000, relocations = 100000, strtab_size = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:r:t:")) != -1) {
+        switch (opt) {
+            case 'n': texts = parse_count(optarg); break;
+            case 's': symbols = parse_count(optarg); break;
+            case 'r': relocations = parse_count(optarg); break;
+            case 't': strtab_size = parse_count(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+    if (texts == 0 || texts > MAX_TEXT) {
+        fprintf(stderr, "genelf: between 1 and %d text sections\n", MAX_TEXT);
+        return 1;
+    }
+    if (relocations && !symbols) {
+        fprintf(stderr, "genelf: relocations need symbols\n");
+        return 1;
+    }
+
+    // .strtab: empty string, symbol names, then filler strings
+    uint64_t names_size = 1;
+    for (uint64_t i = 0; i < symbols; i++)
+        names_size += name_length(i, symbols, strtab_size) + 1;
+    uint64_t fillers = 0, filler_size = 0;
+    while (names_size + filler_size < strtab_size)
+        filler_size += snprintf(NULL, 0, "filler_%lu", fillers++) + 1;
+
+    // .shstrtab: empty string, ".text.<i>", then the fixed names
+    static const char *fixed[] = { ".symtab", ".strtab", ".rela.text", ".shstrtab" };
+    uint64_t shstr_size = 1;
+    for (uint64_t i = 0; i < texts; i++)
+        shstr_size += snprintf(NULL, 0, ".text.%lu", i) + 1;
+    uint64_t fixed_name[4];
+    for (int i = 0; i < 4; i++) {
+        fixed_name[i] = shstr_size;
+        shstr_size += strlen(fixed[i]) + 1;
+    }
+
+    uint64_t text_offset = sizeof(Elf64_Ehdr);
+    uint64_t symtab_offset = text_offset + texts * TEXT_SIZE;
+    uint64_t symtab_size = (symbols + 1) * sizeof(Elf64_Sym);
+    uint64_t strtab_offset = symtab_offset + symtab_size;
+    uint64_t rela_offset = (strtab_offset + names_size + filler_size + 7) & ~7UL;
+    uint64_t rela_size = relocations * sizeof(Elf64_Rela);
+    uint64_t shstr_offset = rela_offset + rela_size;
+    uint64_t shoff = (shstr_offset + shstr_size + 7) & ~7UL;
+    uint64_t shnum = texts + 5;
+    uint64_t symtab_index = texts + 1;
+
+    FILE *out = fopen(argv[optind], "wb");
+    if (!out)
+        fail(argv[optind]);
+    static char buffer[1 << 20];
+    setvbuf(out, buffer, _IOFBF, sizeof(buffer));
+
+    Elf64_Ehdr head = {
+        .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB, 1 },
+        .e_type = ET_REL,
+        .e_machine = EM_X86_64,
+        .e_version = 1,
+        .e_shoff = shoff,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_shentsize = sizeof(Elf64_Shdr),
+        .e_shnum = shnum,
+        .e_shstrndx = shnum - 1,
+    };
+    put(&head, sizeof(head), out);
+
+    // Each text section is a run of ret
+    unsigned char text[TEXT_SIZE];
+    memset(text, 0xc3, sizeof(text));
+    for (uint64_t i = 0; i < texts; i++)
+        put(text, sizeof(text), out);
+
+    Elf64_Sym sym = { 0 };
+    put(&sym, sizeof(sym), out);
+    uint64_t name = 1;
+    for (uint64_t i = 0; i < symbols; i++) {
+        sym.st_name = name;
+        sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        sym.st_shndx = 1 + i % texts;
+        sym.st_value = (i / texts) % TEXT_SIZE;
+        sym.st_size = 1;
+        put(&sym, sizeof(sym), out);
+        name += name_length(i, symbols, strtab_size) + 1;
+    }
+
+    put("", 1, out);
+    for (uint64_t i = 0; i < symbols; i++)
+        put_name(i, name_length(i, symbols, strtab_size), out);
+    for (uint64_t i = 0; i < fillers; i++)
+        fprintf(out, "filler_%lu%c", i, 0);
+    pad(rela_offset - strtab_offset - names_size - filler_size, out);
+
+    // R_X86_64_PC32 against each symbol in turn, all applied to .text.0
+    for (uint64_t i = 0; i < relocations; i++) {
+        Elf64_Rela rela = {
+            .r_offset = i % (TEXT_SIZE - 3),
+            .r_info = ELF64_R_INFO(1 + i % symbols, 2),
+            .r_addend = -4,
+        };
+        put(&rela, sizeof(rela), out);
+    }
+
+    put("", 1, out);
+    for (uint64_t i = 0; i < texts; i++)
+        fprintf(out, ".text.%lu%c", i, 0);
+    for (int i = 0; i < 4; i++)
+        put(fixed[i], strlen(fixed[i]) + 1, out);
+    pad(shoff - shstr_offset - shstr_size, out);
+
+    Elf64_Shdr section = { 0 };
+    put(&section, sizeof(section), out);
+    name = 1;
+    for (uint64_t i = 0; i < texts; i++) {
+        section = (Elf64_Shdr) {
+            .sh_name = name,
+            .sh_type = SHT_PROGBITS,
+            .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+            .sh_offset = text_offset + i * TEXT_SIZE,
+            .sh_size = TEXT_SIZE,
+            .sh_addralign = 1,
+        };
+        put(&section, sizeof(section), out);
+        name += snprintf(NULL, 0, ".text.%lu", i) + 1;
+    }
+    Elf64_Shdr tables[4] = {
+        { .sh_name = fixed_name[0], .sh_type = SHT_SYMTAB, .sh_offset = symtab_offset,
+          .sh_size = symtab_size, .sh_link = symtab_index + 1, .sh_info = 1,
+          .sh_addralign = 8, .sh_entsize = sizeof(Elf64_Sym) },
+        { .sh_name = fixed_name[1], .sh_type = SHT_STRTAB, .sh_offset = strtab_offset,
+          .sh_size = names_size + filler_size, .sh_addralign = 1 },
+        { .sh_name = fixed_name[2], .sh_type = SHT_RELA, .sh_flags = SHF_INFO_LINK,
+          .sh_offset = rela_offset, .sh_size = rela_size, .sh_link = symtab_index,
+          .sh_info = 1, .sh_addralign = 8, .sh_entsize = sizeof(Elf64_Rela) },
+        { .sh_name = fixed_name[3], .sh_type = SHT_STRTAB, .sh_offset = shstr_offset,
+          .sh_size = shstr_size, .sh_addralign = 1 },
+    };
+    put(tables, sizeof(tables), out);
+
+    if (fclose(out))
+        fail(argv[optind]);
+
+    // For the benchmark: what each stage has to go through
+    printf("sections %lu %lu\n", shnum, shnum * sizeof(Elf64_Shdr));
+    printf("symbols %lu %lu\n", symbols + 1, symtab_size);
+    printf("relocations %lu %lu\n", relocations, rela_size);
+    printf("strings %lu %lu\n", symbols + fillers, names_size + filler_size);
+    return 0;
+}
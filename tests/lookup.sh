@@ -0,0 +1,28 @@
+#!/bin/sh
+# Check that --lookup binds versioned names the way ld.so does, on a library
+# defining version_data@V1 (4 bytes) and version_data@@V2 (32 bytes).
+# usage: lookup.sh <alfur> <library>
+
+alfur=$1
+lib=$2
+status=0
+
+# expect <query> <size>, the size being "-" when the lookup has to fail
+expect() {
+    size=$("$alfur" --lookup "$1" "$lib" 2>/dev/null | awk 'NR == 2 { print $4 }')
+    if [ "${size:--}" != "$2" ]; then
+        echo "lookup $1: size ${size:--}, expected $2" >&2
+        status=1
+    fi
+}
+
+expect version_data 32
+expect version_data@@V2 32
+expect version_data@V2 32
+expect version_data@V1 4
+expect version_data@@V1 -
+expect version_data@V3 -
+expect version_data_v1 -
+
+[ $status -eq 0 ] && echo "versioned lookups ok"
+exit $status
@@ -0,0 +1,7 @@
+// Two versions of version_data, as libc has of memcpy: V1, kept for old
+// binaries and hidden, and the default V2. Their sizes tell them apart.
+int version_data_v1 = 1;
+long version_data_v2[4] = { 2 };
+
+__asm__(".symver version_data_v1, version_data@V1");
+__asm__(".symver version_data_v2, version_data@@V2");
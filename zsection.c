@@ -0,0 +1,297 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "elf.h"
+#include "reader.h"
+#include "zsection.h"
+
+// Biggest piece handed to zlib at once, its counts are 32-bit
+#define ZSECTION_PIECE (1U << 30)
+
+// Most a byte of compressed data expands to: 1032 for deflate, and a few
+// bytes of a zstd RLE block stand for up to 128 KiB
+#define ZSECTION_ZLIB_RATIO 1032
+#define ZSECTION_ZSTD_RATIO (1 << 16)
+
+// One section to decompress from in to out
+typedef struct {
+    Elf64_Shdr *section;
+    uint32_t type; // ELFCOMPRESS_*
+    const char *in;
+    uint64_t in_size;
+    char *out;
+    uint64_t out_size;
+    int error;
+} Zsection_job;
+
+typedef struct {
+    Zsection_job *jobs;
+    uint64_t count;
+    uint64_t next;
+    pthread_mutex_t lock;
+} Zsection_pool;
+
+int zsection_compressed(Elf64_data *file, Elf64_Shdr *section) {
+    return section->sh_type != SHT_NOBITS
+        && ((section->sh_flags & SHF_COMPRESSED)
+            || strncmp(elf_section_name(file, section), ".zdebug", 7) == 0);
+}
+
+// Read the compression header of section into job. Returns -1 if it is not
+// one.
+static int parse_header(Elf64_data *file, Elf64_Shdr *section, Zsection_job *job) {
+    const char *raw = elf_section_data(file, section);
+    uint64_t header;
+
+    if (raw == NULL)
+        return -1;
+
+    if (!(section->sh_flags & SHF_COMPRESSED)) {
+        // .zdebug
+        if (section->sh_size < 12 || memcmp(raw, "ZLIB", 4) != 0)
+            return -1;
+        job->type = ELFCOMPRESS_ZLIB;
+        job->out_size = 0;
+        for (int i = 4; i < 12; i++)
+            job->out_size = job->out_size << 8 | (uint8_t)raw[i];
+        header = 12;
+    } else if (file->elf_head->e_ident[EI_CLASS] == ELFCLASS32) {
+        Elf32_Chdr chdr;
+
+        if (section->sh_size < sizeof(chdr))
+            return -1;
+        memcpy(&chdr, raw, sizeof(chdr));
+        job->type = file->reader->word(chdr.ch_type);
+        job->out_size = file->reader->word(chdr.ch_size);
+        header = sizeof(chdr);
+    } else {
+        Elf64_Chdr chdr;
+
+        if (section->sh_size < sizeof(chdr))
+            return -1;
+        memcpy(&chdr, raw, sizeof(chdr));
+        job->type = file->reader->word(chdr.ch_type);
+        job->out_size = file->reader->xword(chdr.ch_size);
+        header = sizeof(chdr);
+    }
+
+    job->in = raw + header;
+    job->in_size = section->sh_size - header;
+    return 0;
+}
+
+static int inflate_zlib(Zsection_job *job) {
+    z_stream stream;
+    uint64_t in_left = job->in_size, out_left = job->out_size;
+    int status = Z_OK;
+
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK)
+        return -1;
+    stream.next_in = (Bytef*)job->in;
+    stream.next_out = (Bytef*)job->out;
+
+    while (status == Z_OK) {
+        if (stream.avail_in == 0) {
+            stream.avail_in = in_left < ZSECTION_PIECE ? in_left : ZSECTION_PIECE;
+            in_left -= stream.avail_in;
+        }
+        if (stream.avail_out == 0) {
+            stream.avail_out = out_left < ZSECTION_PIECE ? out_left : ZSECTION_PIECE;
+            out_left -= stream.avail_out;
+        }
+        status = inflate(&stream, Z_NO_FLUSH);
+    }
+
+    inflateEnd(&stream);
+    return status == Z_STREAM_END && stream.total_out == job->out_size ? 0 : -1;
+}
+
+#ifdef HAVE_ZSTD
+static int inflate_zstd(Zsection_job *job) {
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_inBuffer in = { job->in, job->in_size, 0 };
+    ZSTD_outBuffer out = { job->out, job->out_size, 0 };
+    size_t status = 0;
+
+    if (stream == NULL)
+        return -1;
+    while (in.pos < in.size && out.pos < out.size) {
+        status = ZSTD_decompressStream(stream, &out, &in);
+        if (ZSTD_isError(status))
+            break;
+    }
+    ZSTD_freeDStream(stream);
+    return !ZSTD_isError(status) && out.pos == out.size ? 0 : -1;
+}
+#endif
+
+static void decompress(Zsection_job *job) {
+    switch (job->type) {
+        case ELFCOMPRESS_ZLIB:
+            job->error = inflate_zlib(job) < 0;
+            break;
+#ifdef HAVE_ZSTD
+        case ELFCOMPRESS_ZSTD:
+            job->error = inflate_zstd(job) < 0;
+            break;
+#endif
+        default:
+            job->error = 1;
+    }
+}
+
+// Tell on stderr why section cannot be read, unless the file is quiet
+static void warn(Elf64_data *file, Elf64_Shdr *section, const char *message, ...) {
+    va_list args;
+
+    if (file->quiet)
+        return;
+    fprintf(stderr, "Section %s ", elf_section_name(file, section));
+    va_start(args, message);
+    vfprintf(stderr, message, args);
+    va_end(args);
+}
+
+// Set up job for section, with memory for its contents. Returns -1 if it
+// cannot be decompressed, after telling why.
+static int prepare(Elf64_data *file, Elf64_Shdr *section, Zsection_job *job) {
+    memset(job, 0, sizeof(Zsection_job));
+    job->section = section;
+
+    if (parse_header(file, section, job) < 0) {
+        warn(file, section, "has no valid compression header\n");
+        return -1;
+    }
+#ifndef HAVE_ZSTD
+    if (job->type == ELFCOMPRESS_ZSTD) {
+        warn(file, section, "is compressed with zstd, which this build cannot read\n");
+        return -1;
+    }
+#endif
+    if (job->type != ELFCOMPRESS_ZLIB && job->type != ELFCOMPRESS_ZSTD) {
+        warn(file, section, "is compressed with unknown method %u\n", job->type);
+        return -1;
+    }
+    // A damaged header may claim any size, more than the data can expand to
+    uint64_t ratio = job->type == ELFCOMPRESS_ZLIB ? ZSECTION_ZLIB_RATIO : ZSECTION_ZSTD_RATIO;
+    if (job->out_size / ratio > job->in_size) {
+        warn(file, section, "claims a size of %llu bytes, more than its data holds\n",
+             (unsigned long long)job->out_size);
+        return -1;
+    }
+    if ((job->out = elf_table_alloc(file, job->out_size, section->sh_offset, ELF_T_DATA)) == NULL) {
+        warn(file, section, "is too big to decompress\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Remember that section cannot be decompressed, so it is only tried once
+static void mark_bad(Elf64_data *file, Elf64_Shdr *section) {
+    elf_table_alloc(file, 0, section->sh_offset, ELF_T_BAD);
+}
+
+// Contents of a section, decompressed if needed, and their size. NULL if the
+// section has none in the file or they cannot be decompressed.
+char *zsection_contents(Elf64_data *file, Elf64_Shdr *section, uint64_t *size) {
+    Zsection_job job;
+    char *data;
+
+    if (!zsection_compressed(file, section)) {
+        *size = section->sh_size;
+        return elf_section_data(file, section);
+    }
+
+    *size = 0;
+    if (elf_table_find(file, section->sh_offset, ELF_T_BAD, size) != NULL)
+        return NULL;
+    if ((data = elf_table_find(file, section->sh_offset, ELF_T_DATA, size)) != NULL)
+        return data;
+
+    if (prepare(file, section, &job) == 0)
+        decompress(&job);
+    else
+        job.error = 1;
+
+    if (job.error) {
+        if (job.out != NULL)
+            warn(file, section, "could not be decompressed\n");
+        mark_bad(file, section);
+        return NULL;
+    }
+
+    *size = job.out_size;
+    return job.out;
+}
+
+static void *zsection_worker(void *arg) {
+    Zsection_pool *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        uint64_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->count)
+            break;
+        decompress(&pool->jobs[i]);
+    }
+
+    return NULL;
+}
+
+// Decompress the compressed ones of sections on jobs threads, so that
+// zsection_contents finds them ready. Sections are read and their memory
+// allocated here: the workers only run the decoders.
+void zsection_prefetch(Elf64_data *file, const uint32_t *sections, uint64_t count, int jobs) {
+    Zsection_pool pool = { .count = 0 };
+    uint64_t size;
+
+    if ((pool.jobs = malloc(count * sizeof(Zsection_job))) == NULL)
+        return;
+
+    for (uint64_t i = 0; i < count; i++) {
+        Elf64_Shdr *section = get_section(file, sections[i]);
+
+        if (!zsection_compressed(file, section)
+            || elf_table_find(file, section->sh_offset, ELF_T_DATA, &size) != NULL
+            || elf_table_find(file, section->sh_offset, ELF_T_BAD, &size) != NULL)
+            continue;
+        if (prepare(file, section, &pool.jobs[pool.count]) < 0)
+            mark_bad(file, section);
+        else
+            pool.count++;
+    }
+
+    if ((uint64_t)jobs > pool.count)
+        jobs = pool.count;
+    if (jobs > 0) {
+        pthread_t threads[jobs];
+        int started = 0;
+
+        // This thread is the last worker, and the only one if no thread starts
+        pthread_mutex_init(&pool.lock, NULL);
+        while (started < jobs - 1 && pthread_create(&threads[started], NULL, zsection_worker, &pool) == 0)
+            started++;
+        zsection_worker(&pool);
+        for (int i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&pool.lock);
+    }
+
+    for (uint64_t i = 0; i < pool.count; i++) {
+        if (pool.jobs[i].error) {
+            warn(file, pool.jobs[i].section, "could not be decompressed\n");
+            mark_bad(file, pool.jobs[i].section);
+        }
+    }
+    free(pool.jobs);
+}
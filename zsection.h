@@ -0,0 +1,19 @@
+#ifndef ZSECTION_H
+#define ZSECTION_H
+
+#include <stdint.h>
+
+#include "elf.h"
+
+// Compressed sections: SHF_COMPRESSED ones, starting with an Elf32_Chdr or
+// Elf64_Chdr, and the older .zdebug ones, starting with "ZLIB" and their size
+// as a big-endian u64. zlib is always read, zstd when built with HAVE_ZSTD.
+//
+// Contents are decompressed once into memory kept until elf_release, straight
+// from the image, the input and output fed to the decoder in pieces.
+
+int zsection_compressed(Elf64_data *file, Elf64_Shdr *section);
+char *zsection_contents(Elf64_data *file, Elf64_Shdr *section, uint64_t *size);
+void zsection_prefetch(Elf64_data *file, const uint32_t *sections, uint64_t count, int jobs);
+
+#endif